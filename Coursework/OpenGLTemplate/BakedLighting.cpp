@@ -0,0 +1,74 @@
+#include "Common.h"
+#include "BakedLighting.h"
+#include "StaticLighting.h"
+
+CBakedLighting::CBakedLighting()
+{
+	m_misses = 0;
+}
+
+CBakedLighting::~CBakedLighting()
+{}
+
+// Reads a .bake file.  Returns false without an error message if the file is missing, since baking is optional.
+bool CBakedLighting::Load(string sFilename)
+{
+	m_vertices.clear();
+	m_positions.clear();
+	m_misses = 0;
+
+	FILE* fp;
+	fopen_s(&fp, sFilename.c_str(), "rb");
+	if (!fp)
+		return false;
+
+	BakedLightingHeader header;
+	if (fread(&header, sizeof(header), 1, fp) != 1 || header.magic != BAKED_LIGHTING_MAGIC || header.version != BAKED_LIGHTING_VERSION) {
+		fclose(fp);
+		MessageBox(NULL, sFilename.c_str(), "Baked lighting file is invalid or out of date", MB_ICONHAND);
+		return false;
+	}
+
+	vector<BakedVertexRecord> records(header.count);
+	bool bValid = header.count > 0 && fread(&records[0], sizeof(BakedVertexRecord), header.count, fp) == header.count;
+	fclose(fp);
+	if (!bValid)
+		return false;
+
+	for (unsigned int i = 0; i < header.count; i++) {
+		glm::vec4 colour(records[i].colour[0], records[i].colour[1], records[i].colour[2], records[i].colour[3]);
+		m_vertices[GetBakedVertexKey(records[i], true)] = colour;
+		m_positions.insert(make_pair(GetBakedVertexKey(records[i], false), colour));
+	}
+
+	return true;
+}
+
+// Finds the baked colour of a vertex given in object coordinates.  Returns false (and unlit, unoccluded) if it was not baked.
+bool CBakedLighting::Lookup(const glm::vec3 &position, const glm::vec3 &normal, glm::vec4* pColour)
+{
+	BakedVertexRecord record;
+	QuantiseBakedVertex(position, normal, &record);
+
+	unordered_map<unsigned long long, glm::vec4>::iterator it = m_vertices.find(GetBakedVertexKey(record, true));
+	if (it != m_vertices.end()) {
+		*pColour = it->second;
+		return true;
+	}
+
+	it = m_positions.find(GetBakedVertexKey(record, false));
+	if (it != m_positions.end()) {
+		*pColour = it->second;
+		return true;
+	}
+
+	*pColour = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+	m_misses++;
+	return false;
+}
+
+// Number of vertices looked up that had no baked record
+int CBakedLighting::GetMissCount()
+{
+	return m_misses;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "Common.h"
+#include <unordered_map>
+
+struct BakedVertexRecord;
+
+
+// A class that holds the per-vertex lighting written by the offline light baker for one static mesh, and looks it up
+// by vertex position and normal when the mesh is loaded
+class CBakedLighting
+{
+public:
+	CBakedLighting();
+	~CBakedLighting();
+
+	bool Load(string sFilename);
+	bool Lookup(const glm::vec3 &position, const glm::vec3 &normal, glm::vec4* pColour);
+
+	int GetMissCount();
+
+private:
+	unordered_map<unsigned long long, glm::vec4> m_vertices;		// Keyed by quantised position and normal
+	unordered_map<unsigned long long, glm::vec4> m_positions;		// Keyed by quantised position only, used if the normal differs
+	int m_misses;
+};
@@ -0,0 +1,78 @@
+#include "BenchmarkReport.h"
+
+CBenchmarkReport::Run::Run(int iCameraMode, int iFrames) : frameTimes(iFrames), cpuTimes(iFrames), simTimes(iFrames), 
+	gpuTimes(iFrames)
+{
+	this->iCameraMode = iCameraMode;
+	glTotals = GLFrameCounts();
+}
+
+void CBenchmarkReport::BeginRun(int iCameraMode, int iFrames)
+{
+	m_runs.push_back(Run(iCameraMode, iFrames));
+}
+
+void CBenchmarkReport::AddFrame(double dFrameTime, double dCpuTime, double dSimTime, double dGpuTime, const GLFrameCounts &counts)
+{
+	Run &run = m_runs.back();
+	run.frameTimes.AddFrame(dFrameTime);
+	run.cpuTimes.AddFrame(dCpuTime);
+	run.simTimes.AddFrame(dSimTime);
+	run.gpuTimes.AddFrame(dGpuTime);
+
+	run.glTotals.draws += counts.draws;
+	run.glTotals.indirectDraws += counts.indirectDraws;
+	run.glTotals.triangles += counts.triangles;
+	run.glTotals.programBinds += counts.programBinds;
+	run.glTotals.textureBinds += counts.textureBinds;
+	run.glTotals.vertexArrayBinds += counts.vertexArrayBinds;
+	run.glTotals.uniformUploads += counts.uniformUploads;
+	run.glTotals.bytesUploaded += counts.bytesUploaded;
+}
+
+void CBenchmarkReport::WriteTimes(FILE* pFile, const char* szName, CFrameStats &times)
+{
+	fprintf(pFile, "      \"%s\": {\"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f},\n", szName, 
+		times.GetMean(), times.GetPercentile(50.0), times.GetPercentile(95.0), times.GetPercentile(99.0), times.GetMax());
+}
+
+bool CBenchmarkReport::Write(const char* szFilename, const BenchmarkSettings &settings)
+{
+	FILE* pFile = NULL;
+	if (fopen_s(&pFile, szFilename, "w") != 0 || !pFile)
+		return false;
+
+	fprintf(pFile, "{\n  \"settings\": {\"laps\": %d, \"width\": %d, \"height\": %d, \"tick_ms\": %.4f, \"speed\": %.4f, ", settings.laps, 
+		settings.width, settings.height, settings.tick, settings.speed);
+	fprintf(pFile, "\"upscaling\": %s, \"render_scale\": %.4f, \"depth_prepass\": \"%s\", ", settings.upscaling ? "true" : "false", 
+		settings.renderScale, settings.depthPrepass);
+	fprintf(pFile, "\"instancing\": %s, \"cpu_occlusion\": %s, \"occlusion_queries\": %s, \"pvs\": %s, \"gpu_driven\": %s},\n", 
+		settings.instancing ? "true" : "false", settings.cpuOcclusion ? "true" : "false", settings.occlusionQueries ? "true" : "false", 
+		settings.pvs ? "true" : "false", settings.gpuDriven ? "true" : "false");
+
+	fprintf(pFile, "  \"runs\": [\n");
+	for (unsigned int i = 0; i < m_runs.size(); i++) {
+		Run &run = m_runs[i];
+		int iFrames = run.frameTimes.GetFrameCount();
+		double dFrames = iFrames > 0 ? (double) iFrames : 1.0;
+
+		fprintf(pFile, "    {\n      \"camera_mode\": %d,\n      \"frames\": %d,\n      \"hitches\": %d,\n", run.iCameraMode, iFrames, 
+			run.frameTimes.GetHitchCount());
+		WriteTimes(pFile, "frame_ms", run.frameTimes);
+		WriteTimes(pFile, "cpu_ms", run.cpuTimes);
+		WriteTimes(pFile, "sim_ms", run.simTimes);
+		WriteTimes(pFile, "gpu_ms", run.gpuTimes);
+		fprintf(pFile, "      \"bound\": \"%s\",\n", run.cpuTimes.GetMean() >= run.gpuTimes.GetMean() ? "cpu" : "gpu");
+
+		const GLFrameCounts &gl = run.glTotals;
+		fprintf(pFile, "      \"gl_per_frame\": {\"draws\": %.1f, \"indirect_draws\": %.1f, \"triangles\": %.0f, \"program_binds\": %.1f, ", 
+			gl.draws / dFrames, gl.indirectDraws / dFrames, gl.triangles / dFrames, gl.programBinds / dFrames);
+		fprintf(pFile, "\"texture_binds\": %.1f, \"vertex_array_binds\": %.1f, \"uniform_uploads\": %.1f, \"bytes_uploaded\": %.0f}\n", 
+			gl.textureBinds / dFrames, gl.vertexArrayBinds / dFrames, gl.uniformUploads / dFrames, gl.bytesUploaded / dFrames);
+		fprintf(pFile, "    }%s\n", i + 1 < m_runs.size() ? "," : "");
+	}
+	fprintf(pFile, "  ]\n}\n");
+
+	fclose(pFile);
+	return true;
+}
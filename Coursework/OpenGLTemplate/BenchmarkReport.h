@@ -0,0 +1,51 @@
+#pragma once
+
+#include "Common.h"
+#include "FrameStats.h"
+
+// What a benchmark was run with, for the report
+struct BenchmarkSettings
+{
+	int laps;								// Per run
+	int width;
+	int height;
+	double tick;							// Milliseconds of simulation per frame
+	float speed;							// Along the track, per millisecond
+	bool upscaling;
+	float renderScale;
+	const char* depthPrepass;				// "on" or "off"
+	bool instancing;
+	bool cpuOcclusion;
+	bool occlusionQueries;
+	bool pvs;								// Only if the sets were loaded
+	bool gpuDriven;
+};
+
+// Collects the frames of the runs of a benchmark (run the game with --benchmark), and writes them as JSON.  Each run is
+// one track camera mode; for each, the report gives the percentiles and hitches of the frame times, the split between
+// the CPU and GPU times, and the GL calls made per frame.  The frame and CPU times include the simulation's tick, which
+// is also given on its own.
+class CBenchmarkReport
+{
+public:
+	void BeginRun(int iCameraMode, int iFrames);
+	void AddFrame(double dFrameTime, double dCpuTime, double dSimTime, double dGpuTime, const GLFrameCounts &counts);
+	bool Write(const char* szFilename, const BenchmarkSettings &settings);
+
+private:
+	struct Run
+	{
+		Run(int iCameraMode, int iFrames);
+
+		int iCameraMode;
+		CFrameStats frameTimes;
+		CFrameStats cpuTimes;
+		CFrameStats simTimes;
+		CFrameStats gpuTimes;
+		GLFrameCounts glTotals;
+	};
+
+	void WriteTimes(FILE* pFile, const char* szName, CFrameStats &times);
+
+	vector<Run> m_runs;
+};
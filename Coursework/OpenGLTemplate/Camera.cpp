@@ -8,6 +8,7 @@ CCamera::CCamera()
 	m_view = glm::vec3(0.0f, 0.0f, 0.0f);
 	m_upVector = glm::vec3(0.0f, 1.0f, 0.0f);
 	m_speed = 0.025f;
+	m_projectionJitter = glm::vec2(0.0f);
 }
 CCamera::~CCamera()
 {}
@@ -105,22 +106,23 @@ void CCamera::Update(double dt)
 	TranslateByKeyboard(dt);
 }
 
-// Update the camera to respond to key presses for translation
+// Update the camera to respond to key presses for translation.  The game updates its camera on the simulation thread,
+// which has no keyboard state of its own, so the keys are read directly.
 void CCamera::TranslateByKeyboard(double dt)
 {
-	if (GetKeyState(VK_UP) & 0x80 || GetKeyState('W') & 0x80) {
+	if (GetAsyncKeyState(VK_UP) & 0x8000 || GetAsyncKeyState('W') & 0x8000) {
 		Advance(5.0*dt);
 	}
 
-	if (GetKeyState(VK_DOWN) & 0x80 || GetKeyState('S') & 0x80) {
+	if (GetAsyncKeyState(VK_DOWN) & 0x8000 || GetAsyncKeyState('S') & 0x8000) {
 		Advance(-5.0*dt);
 	}
 
-	if (GetKeyState(VK_LEFT) & 0x80 || GetKeyState('A') & 0x80) {
+	if (GetAsyncKeyState(VK_LEFT) & 0x8000 || GetAsyncKeyState('A') & 0x8000) {
 		Strafe(-5.0*dt);
 	}
 
-	if (GetKeyState(VK_RIGHT) & 0x80 || GetKeyState('D') & 0x80) {
+	if (GetAsyncKeyState(VK_RIGHT) & 0x8000 || GetAsyncKeyState('D') & 0x8000) {
 		Strafe(5.0*dt);
 	}
 }
@@ -154,6 +156,12 @@ glm::mat4* CCamera::GetPerspectiveProjectionMatrix()
 	return &m_perspectiveProjectionMatrix;
 }
 
+// Return the camera perspective projection matrix without the jitter
+glm::mat4* CCamera::GetUnjitteredProjectionMatrix()
+{
+	return &m_unjitteredProjectionMatrix;
+}
+
 // Return the camera orthographic projection matrix
 glm::mat4* CCamera::GetOrthographicProjectionMatrix()
 {
@@ -164,7 +172,15 @@ glm::mat4* CCamera::GetOrthographicProjectionMatrix()
 // and near / far clipping planes
 void CCamera::SetPerspectiveProjectionMatrix(float fov, float aspectRatio, float nearClippingPlane, float farClippingPlane)
 {
-	m_perspectiveProjectionMatrix = glm::perspective(fov, aspectRatio, nearClippingPlane, farClippingPlane);
+	m_unjitteredProjectionMatrix = glm::perspective(fov, aspectRatio, nearClippingPlane, farClippingPlane);
+	SetProjectionJitter(m_projectionJitter);
+}
+
+// Offset the perspective projection in clip space, so the whole image moves by a fraction of a pixel
+void CCamera::SetProjectionJitter(const glm::vec2 &offset)
+{
+	m_projectionJitter = offset;
+	m_perspectiveProjectionMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(offset, 0.0f)) * m_unjitteredProjectionMatrix;
 }
 
 // The the camera orthographic projection matrix to match the width and height passed in
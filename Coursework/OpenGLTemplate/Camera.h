@@ -13,6 +13,7 @@ public:
 	glm::vec3 GetUpVector() const;					// Gets the camera up vector
 	glm::vec3 GetStrafeVector() const;				// Gets the camera strafe vector
 	glm::mat4* GetPerspectiveProjectionMatrix();	// Gets the camera perspective projection matrix
+	glm::mat4* GetUnjitteredProjectionMatrix();		// Gets the perspective projection matrix without the jitter
 	glm::mat4* GetOrthographicProjectionMatrix();	// Gets the camera orthographic projection matrix
 	glm::mat4 GetViewMatrix();						// Gets the camera view matrix - note this is not stored in the class but returned using glm::lookAt() in GetViewMatrix()
 
@@ -41,6 +42,9 @@ public:
 	void SetPerspectiveProjectionMatrix(float fov, float aspectRatio, float nearClippingPlane, float farClippingPlane);
 	void SetOrthographicProjectionMatrix(int width, int height);
 
+	// Shift the perspective projection by a fraction of a pixel, given in normalised device coordinates
+	void SetProjectionJitter(const glm::vec2 &offset);
+
 	glm::mat3 ComputeNormalMatrix(const glm::mat4 &modelViewMatrix);
 
 private:
@@ -52,5 +56,7 @@ private:
 	float m_speed;					// How fast the camera moves
 
 	glm::mat4 m_perspectiveProjectionMatrix;		// Perspective projection matrix
+	glm::mat4 m_unjitteredProjectionMatrix;			// Perspective projection matrix before the jitter
+	glm::vec2 m_projectionJitter;					// Offset of the projection in normalised device coordinates
 	glm::mat4 m_orthographicProjectionMatrix;		// Orthographic projection matrix
 };
@@ -1,6 +1,7 @@
 #include "CatmullRom.h"
 #define _USE_MATH_DEFINES
 #include <math.h>
+#include "CpuTrace.h"
 
 
 
@@ -216,6 +217,7 @@ void CCatmullRom::ComputeLengthsAlongControlPoints()
 // Return the point (and upvector, if control upvectors provided) based on a distance d along the control polygon
 bool CCatmullRom::Sample(float d, glm::vec3& p, glm::vec3& up)
 {
+	CPU_TRACE_SCOPE("CCatmullRom::Sample");
 	if (d < 0)
 		return false;
 
@@ -264,6 +266,7 @@ bool CCatmullRom::Sample(float d, glm::vec3& p, glm::vec3& up)
 // Sample a set of control points using an open Catmull-Rom spline, to produce a set of iNumSamples that are (roughly) equally spaced
 void CCatmullRom::UniformlySampleControlPoints(int numSamples)
 {
+	CPU_TRACE_SCOPE("CCatmullRom::UniformlySampleControlPoints");
 	glm::vec3 p, up;
 
 	// Compute the lengths of each segment along the control polygon, and the total length
@@ -543,8 +546,7 @@ void CCatmullRom::RenderTrack()
 {
 	//glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	// The grid is alpha blended; the caller turns blending on
 
 	// Bind the VAO m_vaoTrack and render it
 	glBindVertexArray(m_vaoTrack);
@@ -554,6 +556,15 @@ void CCatmullRom::RenderTrack()
 	//glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 }
 
+void CCatmullRom::GetTrackBounds(glm::vec3 &boundsMin, glm::vec3 &boundsMax)
+{
+	boundsMin = boundsMax = m_leftOffsetPoints[0];
+	for (unsigned int i = 0; i < m_leftOffsetPoints.size(); i++) {
+		boundsMin = glm::min(boundsMin, glm::min(m_leftOffsetPoints[i], m_rightOffsetPoints[i]));
+		boundsMax = glm::max(boundsMax, glm::max(m_leftOffsetPoints[i], m_rightOffsetPoints[i]));
+	}
+}
+
 int CCatmullRom::CurrentLap(float d)
 {
 
@@ -561,6 +572,11 @@ int CCatmullRom::CurrentLap(float d)
 
 }
 
+float CCatmullRom::GetTrackLength()
+{
+	return m_distances.back();
+}
+
 glm::vec3 CCatmullRom::_dummy_vector(0.0f, 0.0f, 0.0f);
 
 
@@ -589,6 +605,7 @@ void CCatmullRom::Env_ComputeLengthsAlongControlPoints()
 // Return the point (and upvector, if control upvectors provided) based on a distance d along the control polygon
 bool CCatmullRom::Env_Sample(float d, glm::vec3& p, glm::vec3& up)
 {
+	CPU_TRACE_SCOPE("CCatmullRom::Env_Sample");
 	if (d < 0)
 		return false;
 
@@ -637,6 +654,7 @@ bool CCatmullRom::Env_Sample(float d, glm::vec3& p, glm::vec3& up)
 // Sample a set of control points using an open Catmull-Rom spline, to produce a set of iNumSamples that are (roughly) equally spaced
 void CCatmullRom::Env_UniformlySampleControlPoints(int numSamples)
 {
+	CPU_TRACE_SCOPE("CCatmullRom::Env_UniformlySampleControlPoints");
 	glm::vec3 p, up;
 
 	// Compute the lengths of each segment along the control polygon, and the total length
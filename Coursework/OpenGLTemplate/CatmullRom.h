@@ -19,8 +19,10 @@ public:
 
 	void CreateTrack(string filename);
 	void RenderTrack();
+	void GetTrackBounds(glm::vec3 &boundsMin, glm::vec3 &boundsMax); // Bounding box of the track's offset curves, used for culling
 
 	int CurrentLap(float d); // Return the currvent lap (starting from 0) based on distance along the control curve.
+	float GetTrackLength(); // Length of one lap along the control curve
 
 	bool Sample(float d, glm::vec3& p, glm::vec3& up = _dummy_vector); // Return a point on the centreline based on a certain distance along the control curve.
 
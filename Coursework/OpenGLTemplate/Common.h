@@ -11,6 +11,7 @@
 
 #include "include/gl/glew.h"
 #include <gl/gl.h>
+#include "GLCounters.h"
 
 #define _USE_MATH_DEFINES
 #include <math.h>
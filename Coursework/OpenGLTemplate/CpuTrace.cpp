@@ -0,0 +1,173 @@
+#include "CpuTrace.h"
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Each thread's buffer holds this many scopes per capture; later ones are dropped and counted
+static const int THREAD_EVENT_CAPACITY = 1 << 18;
+
+struct TraceEvent
+{
+	const char* szName;
+	uint64_t uiBegin;
+	uint64_t uiEnd;
+};
+
+// One thread's events.  Buffers live until the program ends, so a capture still has the events of threads that have
+// since finished.
+struct ThreadTrace
+{
+	std::vector<TraceEvent> events;
+	std::atomic<int> count;
+	std::atomic<int> dropped;
+	// The capture the events belong to; a new capture empties the buffer.  It is stored with release once the buffer is
+	// emptied, so StopCapture, reading it with acquire, never pairs a new capture with the last one's count.
+	std::atomic<int> iCapture;
+	int iThread;
+	std::string name;
+};
+
+std::atomic<bool> CCpuTrace::s_capturing(false);
+
+static std::mutex s_threadsMutex;		// Only taken when a thread first records, and to write a capture
+static std::vector<std::unique_ptr<ThreadTrace> > s_threads;
+static std::atomic<int> s_capture(0);
+static thread_local ThreadTrace* t_pThread = NULL;
+
+static uint64_t s_captureBeginTicks;
+static std::chrono::steady_clock::time_point s_captureBeginTime;
+
+static ThreadTrace* GetThreadTrace()
+{
+	if (!t_pThread) {
+		std::lock_guard<std::mutex> lock(s_threadsMutex);
+		ThreadTrace* pThread = new ThreadTrace;
+		pThread->count = 0;
+		pThread->dropped = 0;
+		pThread->iCapture = -1;
+		pThread->iThread = (int) s_threads.size();
+		s_threads.push_back(std::unique_ptr<ThreadTrace>(pThread));
+		t_pThread = pThread;
+	}
+	return t_pThread;
+}
+
+void CCpuTrace::StartCapture()
+{
+	if (IsCapturing())
+		return;
+	s_capture++;
+	s_captureBeginTime = std::chrono::steady_clock::now();
+	s_captureBeginTicks = Now();
+	s_capturing = true;
+}
+
+void CCpuTrace::SetThreadName(const char* szName)
+{
+	ThreadTrace* pThread = GetThreadTrace();
+	std::lock_guard<std::mutex> lock(s_threadsMutex);
+	pThread->name = szName;
+}
+
+void CCpuTrace::Record(const char* szName, uint64_t uiBegin, uint64_t uiEnd)
+{
+	ThreadTrace* pThread = GetThreadTrace();
+	int iCapture = s_capture.load(std::memory_order_relaxed);
+	if (pThread->iCapture.load(std::memory_order_relaxed) != iCapture) {
+		if (pThread->events.empty())
+			pThread->events.resize(THREAD_EVENT_CAPACITY);
+		pThread->count.store(0, std::memory_order_relaxed);
+		pThread->dropped.store(0, std::memory_order_relaxed);
+		pThread->iCapture.store(iCapture, std::memory_order_release);
+	}
+
+	int iCount = pThread->count.load(std::memory_order_relaxed);
+	if (iCount == THREAD_EVENT_CAPACITY) {
+		pThread->dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	TraceEvent &event = pThread->events[iCount];
+	event.szName = szName;
+	event.uiBegin = uiBegin;
+	event.uiEnd = uiEnd;
+	pThread->count.store(iCount + 1, std::memory_order_release);
+}
+
+static void WriteJsonString(FILE* pFile, const char* sz)
+{
+	fputc('"', pFile);
+	for (; *sz; sz++) {
+		if (*sz == '"' || *sz == '\\')
+			fputc('\\', pFile);
+		fputc(*sz, pFile);
+	}
+	fputc('"', pFile);
+}
+
+// Stops recording and writes every thread's events from this capture.  A thread still inside Record may add one more
+// event after this has read its count; it is left for the next capture to clear.
+bool CCpuTrace::StopCapture(const char* szFilename)
+{
+	if (!IsCapturing())
+		return false;
+	s_capturing = false;
+	uint64_t uiEndTicks = Now();
+	std::chrono::steady_clock::time_point endTime = std::chrono::steady_clock::now();
+
+	double dMicroseconds = std::chrono::duration<double, std::micro>(endTime - s_captureBeginTime).count();
+	double dMicrosecondsPerTick = uiEndTicks > s_captureBeginTicks ? dMicroseconds / (uiEndTicks - s_captureBeginTicks) : 0.0;
+
+	FILE* pFile = NULL;
+#ifdef _MSC_VER
+	if (fopen_s(&pFile, szFilename, "w") != 0)
+		pFile = NULL;
+#else
+	pFile = fopen(szFilename, "w");
+#endif
+	if (!pFile)
+		return false;
+
+	std::lock_guard<std::mutex> lock(s_threadsMutex);
+	int iCapture = s_capture.load();
+	fprintf(pFile, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	bool bFirst = true;
+	for (unsigned int t = 0; t < s_threads.size(); t++) {
+		const ThreadTrace &thread = *s_threads[t];
+		if (thread.iCapture.load(std::memory_order_acquire) != iCapture)
+			continue;
+
+		if (!thread.name.empty()) {
+			fprintf(pFile, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", bFirst ? "" : ",\n", 
+				thread.iThread);
+			WriteJsonString(pFile, thread.name.c_str());
+			fprintf(pFile, "}}");
+			bFirst = false;
+		}
+
+		int iCount = thread.count.load(std::memory_order_acquire);
+		for (int i = 0; i < iCount; i++) {
+			const TraceEvent &event = thread.events[i];
+			if (event.uiBegin < s_captureBeginTicks)
+				continue;
+			fprintf(pFile, "%s{\"name\":", bFirst ? "" : ",\n");
+			WriteJsonString(pFile, event.szName);
+			fprintf(pFile, ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", thread.iThread, 
+				(event.uiBegin - s_captureBeginTicks) * dMicrosecondsPerTick, (event.uiEnd - event.uiBegin) * dMicrosecondsPerTick);
+			bFirst = false;
+		}
+
+		int iDropped = thread.dropped.load();
+		if (iDropped > 0) {
+			fprintf(pFile, "%s{\"name\":\"dropped events\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"args\":{\"count\":%d}}", 
+				bFirst ? "" : ",\n", thread.iThread, dMicroseconds, iDropped);
+			bFirst = false;
+		}
+	}
+	fprintf(pFile, "\n]}\n");
+	fclose(pFile);
+	return true;
+}
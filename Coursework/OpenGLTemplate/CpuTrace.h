@@ -0,0 +1,71 @@
+#pragma once
+
+// Like TripleBuffer.h, this only depends on the standard library
+#include <atomic>
+#include <cstdint>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+// Comment this out to compile every trace scope away to nothing
+#define ENABLE_CPU_TRACE
+
+#ifdef ENABLE_CPU_TRACE
+#define CPU_TRACE_CONCAT_INNER(a, b) a##b
+#define CPU_TRACE_CONCAT(a, b) CPU_TRACE_CONCAT_INNER(a, b)
+#define CPU_TRACE_SCOPE(szName) CCpuTraceScope CPU_TRACE_CONCAT(cpuTraceScope, __LINE__)(szName)
+#define CPU_TRACE_THREAD_NAME(szName) CCpuTrace::SetThreadName(szName)
+#else
+#define CPU_TRACE_SCOPE(szName) ((void) 0)
+#define CPU_TRACE_THREAD_NAME(szName) ((void) 0)
+#endif
+
+// Records timed scopes from any thread while a capture is running, and writes the capture as Chrome trace event JSON.
+// Each thread appends to its own buffer, which only it writes, so recording takes no locks; a buffer's count is
+// published with a release store for the writer of the capture to read.  Times are read from the CPU's timestamp counter
+// and converted to microseconds against the system clock over the capture.  Scope names must be string literals.
+class CCpuTrace
+{
+public:
+	static void StartCapture();
+	static bool StopCapture(const char* szFilename);	// Writes the capture, returning false if the file could not be written
+	static bool IsCapturing()
+	{
+		return s_capturing.load(std::memory_order_relaxed);
+	}
+	static void SetThreadName(const char* szName);
+
+	static uint64_t Now()
+	{
+		return __rdtsc();
+	}
+	static void Record(const char* szName, uint64_t uiBegin, uint64_t uiEnd);
+
+private:
+	static std::atomic<bool> s_capturing;
+};
+
+// Times the enclosing scope, if a capture was running when it began
+class CCpuTraceScope
+{
+public:
+	explicit CCpuTraceScope(const char* szName)
+	{
+		m_szName = szName;
+		m_uiBegin = CCpuTrace::IsCapturing() ? CCpuTrace::Now() : 0;
+	}
+	~CCpuTraceScope()
+	{
+		if (m_uiBegin != 0)
+			CCpuTrace::Record(m_szName, m_uiBegin, CCpuTrace::Now());
+	}
+
+private:
+	CCpuTraceScope(const CCpuTraceScope&);
+	CCpuTraceScope& operator=(const CCpuTraceScope&);
+
+	const char* m_szName;
+	uint64_t m_uiBegin;
+};
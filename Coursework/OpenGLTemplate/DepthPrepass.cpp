@@ -0,0 +1,146 @@
+#include "Common.h"
+#include "DepthPrepass.h"
+
+// Overdraw levels for switching the pre-pass in automatic mode.  The gap between them stops it flickering on and off.
+static const float PREPASS_ENABLE_OVERDRAW = 2.0f;
+static const float PREPASS_DISABLE_OVERDRAW = 1.5f;
+static const float OVERDRAW_SMOOTHING = 0.1f;
+
+CDepthPrepass::CDepthPrepass()
+{
+	m_mode = PREPASS_AUTO;
+	m_autoEnabled = false;
+	m_overdraw = 0.0f;
+	m_nextQuery = 0;
+	m_frame = 0;
+	m_measuring = false;
+	m_created = false;
+}
+
+CDepthPrepass::~CDepthPrepass()
+{
+	Release();
+}
+
+// Creates the occlusion queries used to measure overdraw
+void CDepthPrepass::Create()
+{
+	glGenQueries(QUERY_COUNT, m_queries);
+	for (int i = 0; i < QUERY_COUNT; i++) {
+		m_queryPixels[i] = 0;
+		m_queryPending[i] = false;
+	}
+	m_created = true;
+}
+
+void CDepthPrepass::Release()
+{
+	if (!m_created)
+		return;
+	glDeleteQueries(QUERY_COUNT, m_queries);
+	m_created = false;
+}
+
+// Steps through off, on and automatic
+void CDepthPrepass::CycleMode()
+{
+	m_mode = (Mode)((m_mode + 1) % 3);
+}
+
+void CDepthPrepass::SetMode(Mode mode)
+{
+	m_mode = mode;
+}
+
+CDepthPrepass::Mode CDepthPrepass::GetMode()
+{
+	return m_mode;
+}
+
+const char* CDepthPrepass::GetModeName()
+{
+	switch (m_mode) {
+	case PREPASS_OFF:
+		return "off";
+	case PREPASS_ON:
+		return "on";
+	default:
+		return m_autoEnabled ? "auto (on)" : "auto (off)";
+	}
+}
+
+bool CDepthPrepass::IsEnabled()
+{
+	if (m_mode == PREPASS_AUTO)
+		return m_autoEnabled;
+	return m_mode == PREPASS_ON;
+}
+
+float CDepthPrepass::GetOverdraw()
+{
+	return m_overdraw;
+}
+
+// Starts counting samples that pass the depth test, every MEASURE_INTERVAL frames.  Skipped if the query from 
+// QUERY_COUNT measurements ago is still in flight.
+void CDepthPrepass::BeginMeasure()
+{
+	ReadResults();
+
+	m_measuring = false;
+	m_frame++;
+	if (!m_created || m_frame % MEASURE_INTERVAL != 0 || m_queryPending[m_nextQuery])
+		return;
+	glBeginQuery(GL_SAMPLES_PASSED, m_queries[m_nextQuery]);
+	m_measuring = true;
+}
+
+void CDepthPrepass::EndMeasure(int iPixels)
+{
+	if (!m_measuring)
+		return;
+	glEndQuery(GL_SAMPLES_PASSED);
+	m_measuring = false;
+
+	m_queryPixels[m_nextQuery] = iPixels;
+	m_queryPending[m_nextQuery] = true;
+	m_nextQuery = (m_nextQuery + 1) % QUERY_COUNT;
+}
+
+bool CDepthPrepass::IsMeasuring()
+{
+	return m_measuring;
+}
+
+// Collects any query results that are available, without waiting, and updates the automatic decision
+void CDepthPrepass::ReadResults()
+{
+	if (!m_created)
+		return;
+
+	for (int i = 0; i < QUERY_COUNT; i++) {
+		// Oldest first, so the smoothing sees results in order
+		int iQuery = (m_nextQuery + i) % QUERY_COUNT;
+		if (!m_queryPending[iQuery])
+			continue;
+
+		GLuint uiAvailable = GL_FALSE;
+		glGetQueryObjectuiv(m_queries[iQuery], GL_QUERY_RESULT_AVAILABLE, &uiAvailable);
+		if (uiAvailable == GL_FALSE)
+			break;
+
+		GLuint uiSamples = 0;
+		glGetQueryObjectuiv(m_queries[iQuery], GL_QUERY_RESULT, &uiSamples);
+		m_queryPending[iQuery] = false;
+
+		if (m_queryPixels[iQuery] <= 0)
+			continue;
+		float fOverdraw = (float)uiSamples / (float)m_queryPixels[iQuery];
+		m_overdraw = m_overdraw == 0.0f ? fOverdraw : m_overdraw + (fOverdraw - m_overdraw) * OVERDRAW_SMOOTHING;
+	}
+
+	if (m_overdraw > PREPASS_ENABLE_OVERDRAW)
+		m_autoEnabled = true;
+	else if (m_overdraw < PREPASS_DISABLE_OVERDRAW)
+		m_autoEnabled = false;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Common.h"
+
+// A class that decides whether opaque geometry gets a depth-only pre-pass before the expensive lit pass, and measures
+// overdraw with occlusion queries.  In automatic mode the pre-pass is turned on when overdraw is high.
+class CDepthPrepass
+{
+public:
+	enum Mode
+	{
+		PREPASS_OFF,
+		PREPASS_ON,
+		PREPASS_AUTO,
+	};
+
+	CDepthPrepass();
+	~CDepthPrepass();
+
+	void Create();
+	void Release();
+
+	void CycleMode();
+	void SetMode(Mode mode);
+	Mode GetMode();
+	const char* GetModeName();
+
+	bool IsEnabled();			// Whether to run the pre-pass this frame
+	float GetOverdraw();		// Smoothed samples passing the depth test per pixel, for the opaque geometry
+
+	// Wrap the pass that draws the opaque geometry with depth writes on (the pre-pass, or the lit pass without one)
+	void BeginMeasure();
+	void EndMeasure(int iPixels);
+	bool IsMeasuring();			// Whether a sample count is active, which other occlusion queries cannot overlap
+
+private:
+	void ReadResults();
+
+	static const int QUERY_COUNT = 4;	// Results are read a few frames late so the CPU never waits for them
+	static const int MEASURE_INTERVAL = 4;	// Frames between measurements, leaving the rest free for other queries
+
+	Mode m_mode;
+	bool m_autoEnabled;
+	float m_overdraw;
+	UINT m_queries[QUERY_COUNT];
+	int m_queryPixels[QUERY_COUNT];
+	bool m_queryPending[QUERY_COUNT];
+	int m_nextQuery;
+	int m_frame;
+	bool m_measuring;
+	bool m_created;
+};
@@ -0,0 +1,64 @@
+#include "Common.h"
+#include "FrameLatencyLimiter.h"
+#include "HighResolutionTimer.h"
+
+// Long enough for any real frame; a lost context or hung GPU should not hang the game
+static const GLuint64 FENCE_TIMEOUT_NS = 1000000000;
+
+CFrameLatencyLimiter::CFrameLatencyLimiter()
+{
+	m_maxQueuedFrames = 1;
+	m_waitTime = 0.0;
+}
+
+CFrameLatencyLimiter::~CFrameLatencyLimiter()
+{
+	Release();
+}
+
+// Drops the fences without waiting on them, for when the limiter is switched off
+void CFrameLatencyLimiter::Release()
+{
+	for (unsigned int i = 0; i < m_fences.size(); i++)
+		glDeleteSync(m_fences[i]);
+	m_fences.clear();
+	m_waitTime = 0.0;
+}
+
+void CFrameLatencyLimiter::SetMaxQueuedFrames(int iFrames)
+{
+	m_maxQueuedFrames = glm::clamp(iFrames, 1, MAX_QUEUED_FRAMES);
+}
+
+int CFrameLatencyLimiter::GetMaxQueuedFrames()
+{
+	return m_maxQueuedFrames;
+}
+
+void CFrameLatencyLimiter::CycleMaxQueuedFrames()
+{
+	SetMaxQueuedFrames(m_maxQueuedFrames % MAX_QUEUED_FRAMES + 1);
+}
+
+// Before frame N, waits for frame N - k to finish, so at most k - 1 earlier frames are still queued
+void CFrameLatencyLimiter::BeginFrame()
+{
+	CHighResolutionTimer timer;
+	timer.Start();
+	while ((int)m_fences.size() >= m_maxQueuedFrames) {
+		glClientWaitSync(m_fences.front(), GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT_NS);
+		glDeleteSync(m_fences.front());
+		m_fences.pop_front();
+	}
+	m_waitTime = timer.Elapsed();
+}
+
+void CFrameLatencyLimiter::EndFrame()
+{
+	m_fences.push_back(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+}
+
+double CFrameLatencyLimiter::GetWaitTime()
+{
+	return m_waitTime;
+}
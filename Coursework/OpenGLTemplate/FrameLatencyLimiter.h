@@ -0,0 +1,33 @@
+#pragma once
+
+#include "Common.h"
+#include <deque>
+
+// A class that bounds how many frames the driver can queue ahead of the GPU.  A fence goes in after each frame is
+// presented, and before starting a frame the CPU waits for the fence of the frame that many frames back.  Fewer frames
+// in flight means the frame drawn from the latest input reaches the screen sooner, at the cost of the CPU and GPU
+// overlapping less.
+class CFrameLatencyLimiter
+{
+public:
+	CFrameLatencyLimiter();
+	~CFrameLatencyLimiter();
+
+	void Release();
+
+	void SetMaxQueuedFrames(int iFrames);
+	int GetMaxQueuedFrames();
+	void CycleMaxQueuedFrames();
+
+	void BeginFrame();						// Waits until fewer than the maximum frames are in flight
+	void EndFrame();						// Call after SwapBuffers
+
+	double GetWaitTime();					// Milliseconds BeginFrame waited, last frame
+
+private:
+	static const int MAX_QUEUED_FRAMES = 3;
+
+	deque<GLsync> m_fences;
+	int m_maxQueuedFrames;
+	double m_waitTime;
+};
@@ -0,0 +1,108 @@
+#include "FramePacer.h"
+
+#pragma comment(lib, "winmm.lib")
+
+// Below this much time left, Sleep could wake too late, so the wait spins instead
+static const double SPIN_THRESHOLD_MS = 2.0;
+
+static const int TARGET_RATES[] = { 30, 60, 120, 144, 0 };
+
+CFramePacer::CFramePacer()
+{
+	m_targetRate = 60;
+	m_nextDeadline = 0.0;
+	m_lastFrameEnd = 0.0;
+	m_nextInterval = 0;
+	m_periodRaised = false;
+}
+
+CFramePacer::~CFramePacer()
+{
+	if (m_periodRaised)
+		timeEndPeriod(1);
+}
+
+// Sleep only wakes on the system timer's tick, which is 15.6 ms by default, so ask for 1 ms ticks while pacing
+void CFramePacer::Start()
+{
+	if (!m_periodRaised)
+		m_periodRaised = timeBeginPeriod(1) == TIMERR_NOERROR;
+	m_clock.Start();
+	m_nextDeadline = 0.0;
+	m_lastFrameEnd = 0.0;
+	m_intervals.clear();
+	m_nextInterval = 0;
+}
+
+void CFramePacer::SetTargetRate(int iFramesPerSecond)
+{
+	m_targetRate = max(0, iFramesPerSecond);
+	m_nextDeadline = m_clock.Elapsed();
+}
+
+int CFramePacer::GetTargetRate()
+{
+	return m_targetRate;
+}
+
+void CFramePacer::CycleTargetRate()
+{
+	int iRates = sizeof(TARGET_RATES) / sizeof(TARGET_RATES[0]);
+	int iNext = 0;
+	for (int i = 0; i < iRates; i++) {
+		if (TARGET_RATES[i] == m_targetRate)
+			iNext = (i + 1) % iRates;
+	}
+	SetTargetRate(TARGET_RATES[iNext]);
+}
+
+void CFramePacer::Wait()
+{
+	double fNow = m_clock.Elapsed();
+	if (m_targetRate > 0) {
+		double fPeriod = 1000.0 / m_targetRate;
+		m_nextDeadline += fPeriod;
+
+		// A frame that ran more than a period over starts the schedule again, rather than rushing the frames after it
+		if (fNow > m_nextDeadline + fPeriod)
+			m_nextDeadline = fNow;
+
+		while (m_nextDeadline - fNow > SPIN_THRESHOLD_MS) {
+			Sleep(1);
+			fNow = m_clock.Elapsed();
+		}
+		while (fNow < m_nextDeadline) {
+			YieldProcessor();
+			fNow = m_clock.Elapsed();
+		}
+	}
+
+	double fInterval = fNow - m_lastFrameEnd;
+	m_lastFrameEnd = fNow;
+	if ((int)m_intervals.size() < INTERVAL_HISTORY)
+		m_intervals.push_back(fInterval);
+	else
+		m_intervals[m_nextInterval] = fInterval;
+	m_nextInterval = (m_nextInterval + 1) % INTERVAL_HISTORY;
+}
+
+double CFramePacer::GetAverageInterval()
+{
+	if (m_intervals.empty())
+		return 0.0;
+	double fSum = 0.0;
+	for (unsigned int i = 0; i < m_intervals.size(); i++)
+		fSum += m_intervals[i];
+	return fSum / m_intervals.size();
+}
+
+double CFramePacer::GetJitter()
+{
+	if (m_intervals.size() < 2)
+		return 0.0;
+	double fAverage = GetAverageInterval();
+	double fSum = 0.0;
+	for (unsigned int i = 0; i < m_intervals.size(); i++)
+		fSum += (m_intervals[i] - fAverage) * (m_intervals[i] - fAverage);
+	return sqrt(fSum / m_intervals.size());
+}
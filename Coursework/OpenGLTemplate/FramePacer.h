@@ -0,0 +1,35 @@
+#pragma once
+
+#include "Common.h"
+#include "HighResolutionTimer.h"
+
+// A class that holds the main loop to a target frame rate.  Each frame has a deadline a frame period after the last; the
+// wait sleeps while the deadline is well off, then spins for the last stretch, since Sleep can overshoot by a millisecond
+// or more.  It also keeps the recent frame intervals, to show how steady the pacing is.
+class CFramePacer
+{
+public:
+	CFramePacer();
+	~CFramePacer();
+
+	void Start();
+	void SetTargetRate(int iFramesPerSecond);	// 0 for no limit
+	int GetTargetRate();
+	void CycleTargetRate();
+
+	void Wait();							// Call once a frame, after the frame is presented
+
+	double GetAverageInterval();			// Milliseconds over the recent frames
+	double GetJitter();						// Standard deviation of the recent frame intervals, in milliseconds
+
+private:
+	static const int INTERVAL_HISTORY = 120;
+
+	CHighResolutionTimer m_clock;			// Started once, so its elapsed time is the time since Start
+	int m_targetRate;
+	double m_nextDeadline;
+	double m_lastFrameEnd;
+	vector<double> m_intervals;
+	int m_nextInterval;
+	bool m_periodRaised;
+};
@@ -0,0 +1,145 @@
+#include "FrameStats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+// Until the window has this many frames, the median is too noisy to judge hitches by
+static const int HITCH_MIN_FRAMES = 30;
+
+CFrameStats::CFrameStats(int iWindowFrames)
+{
+	m_window = iWindowFrames > 1 ? iWindowFrames : 1;
+	m_times.resize(m_window, 0.0);
+	m_hitches.resize(m_window, 0);
+	Reset();
+}
+
+void CFrameStats::Reset()
+{
+	m_next = 0;
+	m_count = 0;
+	m_hitchCount = 0;
+	m_sortedValid = false;
+}
+
+// The ring slot of a frame counted from the oldest
+int CFrameStats::Slot(int iFrame)
+{
+	return (m_next - m_count + iFrame + m_window) % m_window;
+}
+
+void CFrameStats::AddFrame(double dFrameTime)
+{
+	bool bHitch = m_count >= HITCH_MIN_FRAMES && dFrameTime > GetHitchThreshold();
+
+	// The frame leaving the window takes its hitch with it
+	if (m_count == m_window)
+		m_hitchCount -= m_hitches[m_next];
+	else
+		m_count++;
+
+	m_times[m_next] = dFrameTime;
+	m_hitches[m_next] = bHitch ? 1 : 0;
+	m_hitchCount += m_hitches[m_next];
+	m_next = (m_next + 1) % m_window;
+	m_sortedValid = false;
+}
+
+int CFrameStats::GetWindowFrames()
+{
+	return m_window;
+}
+
+int CFrameStats::GetFrameCount()
+{
+	return m_count;
+}
+
+double CFrameStats::GetFrame(int iFrame)
+{
+	return m_times[Slot(iFrame)];
+}
+
+bool CFrameStats::IsHitch(int iFrame)
+{
+	return m_hitches[Slot(iFrame)] != 0;
+}
+
+void CFrameStats::Sort()
+{
+	if (m_sortedValid)
+		return;
+	m_sorted.resize(m_count);
+	for (int i = 0; i < m_count; i++)
+		m_sorted[i] = GetFrame(i);
+	std::sort(m_sorted.begin(), m_sorted.end());
+	m_sortedValid = true;
+}
+
+// Nearest rank, so every percentile is a frame time that happened
+double CFrameStats::GetPercentile(double dPercent)
+{
+	if (m_count == 0)
+		return 0.0;
+	Sort();
+	int iRank = (int) ceil(dPercent / 100.0 * m_count) - 1;
+	return m_sorted[std::min(m_count - 1, std::max(0, iRank))];
+}
+
+double CFrameStats::GetMax()
+{
+	return GetPercentile(100.0);
+}
+
+double CFrameStats::GetMean()
+{
+	if (m_count == 0)
+		return 0.0;
+	double dTotal = 0.0;
+	for (int i = 0; i < m_count; i++)
+		dTotal += GetFrame(i);
+	return dTotal / m_count;
+}
+
+int CFrameStats::GetHitchCount()
+{
+	return m_hitchCount;
+}
+
+// Asked every frame, so this finds the median of only the latest frames, with a partial sort
+double CFrameStats::GetHitchThreshold()
+{
+	int iFrames = std::min(m_count, (int) HITCH_MEDIAN_FRAMES);
+	if (iFrames == 0)
+		return 0.0;
+	m_scratch.resize(iFrames);
+	for (int i = 0; i < iFrames; i++)
+		m_scratch[i] = GetFrame(m_count - iFrames + i);
+	std::nth_element(m_scratch.begin(), m_scratch.begin() + (iFrames - 1) / 2, m_scratch.end());
+	return HITCH_FACTOR * m_scratch[(iFrames - 1) / 2];
+}
+
+// The summary, then every frame in the window from the oldest
+bool CFrameStats::Export(const char* szFilename)
+{
+	FILE* pFile = NULL;
+#ifdef _MSC_VER
+	if (fopen_s(&pFile, szFilename, "w") != 0)
+		pFile = NULL;
+#else
+	pFile = fopen(szFilename, "w");
+#endif
+	if (!pFile)
+		return false;
+
+	fprintf(pFile, "frames,p50 ms,p95 ms,p99 ms,max ms,hitches,hitch threshold ms\n");
+	fprintf(pFile, "%d,%.4f,%.4f,%.4f,%.4f,%d,%.4f\n", m_count, GetPercentile(50.0), GetPercentile(95.0), GetPercentile(99.0), 
+		GetMax(), m_hitchCount, GetHitchThreshold());
+	fprintf(pFile, "\nframe,ms,hitch\n");
+	for (int i = 0; i < m_count; i++)
+		fprintf(pFile, "%d,%.4f,%d\n", i, GetFrame(i), IsHitch(i) ? 1 : 0);
+
+	fclose(pFile);
+	return true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+// Like TripleBuffer.h, this only depends on the standard library
+#include <vector>
+
+// A class that keeps the times of the recent frames, to show stutter that an average hides.  The times are in a ring over
+// a sliding window; percentiles come from a sorted copy, made only when they are asked for after a new frame.  A frame
+// is a hitch when it takes more than HITCH_FACTOR times the median of the HITCH_MEDIAN_FRAMES frames before it.
+class CFrameStats
+{
+public:
+	explicit CFrameStats(int iWindowFrames = WINDOW_FRAMES);
+
+	void AddFrame(double dFrameTime);		// Once a frame, in milliseconds
+	void Reset();
+
+	int GetWindowFrames();
+	int GetFrameCount();					// In the window, up to its size
+	double GetFrame(int iFrame);			// From the oldest frame in the window
+	bool IsHitch(int iFrame);
+	double GetPercentile(double dPercent);	// Milliseconds, for 0 to 100
+	double GetMax();
+	double GetMean();
+	int GetHitchCount();					// In the window
+	double GetHitchThreshold();				// Milliseconds, for the next frame
+	bool Export(const char* szFilename);
+
+	static const int WINDOW_FRAMES = 600;
+	static const int HITCH_FACTOR = 2;
+	static const int HITCH_MEDIAN_FRAMES = 120;
+
+private:
+	int Slot(int iFrame);
+	void Sort();
+
+	std::vector<double> m_times;
+	std::vector<unsigned char> m_hitches;
+	std::vector<double> m_sorted;
+	std::vector<double> m_scratch;			// For the median of each new frame
+	int m_window;
+	int m_next;
+	int m_count;
+	int m_hitchCount;
+	bool m_sortedValid;
+};
@@ -0,0 +1,89 @@
+#include "FrameTimeGraph.h"
+#include "FrameStats.h"
+#include "Shaders.h"
+
+CFrameTimeGraph::CFrameTimeGraph()
+{
+	m_pProgram = NULL;
+	m_vao = 0;
+	m_vbo = 0;
+	m_created = false;
+}
+
+CFrameTimeGraph::~CFrameTimeGraph()
+{
+	Release();
+}
+
+void CFrameTimeGraph::Create(CShaderProgram* pProgram)
+{
+	Release();
+	m_pProgram = pProgram;
+
+	glGenVertexArrays(1, &m_vao);
+	glBindVertexArray(m_vao);
+	glGenBuffers(1, &m_vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), 0);
+	glBindVertexArray(0);
+
+	m_created = true;
+}
+
+void CFrameTimeGraph::Release()
+{
+	if (!m_created)
+		return;
+	glDeleteBuffers(1, &m_vbo);
+	glDeleteVertexArrays(1, &m_vao);
+	m_vertices.clear();
+	m_created = false;
+}
+
+void CFrameTimeGraph::Render(CFrameStats* pStats, float x, float y, float fWidth, float fHeight, double dBudget, glm::mat4* pProjection)
+{
+	int iFrames = pStats->GetFrameCount();
+	if (!m_created || iFrames < 2 || dBudget <= 0.0)
+		return;
+
+	// Frame times, with the newest at the right edge and anything over the top clipped to it
+	float fScale = fHeight / (float) (dBudget * GRAPH_BUDGETS);
+	float fStep = fWidth / (pStats->GetWindowFrames() - 1);
+	float fLeft = x + fWidth - fStep * (iFrames - 1);
+	m_vertices.clear();
+	for (int i = 0; i < iFrames; i++)
+		m_vertices.push_back(glm::vec2(fLeft + fStep * i, y + min(fHeight, (float) pStats->GetFrame(i) * fScale)));
+
+	m_vertices.push_back(glm::vec2(x, y));
+	m_vertices.push_back(glm::vec2(x + fWidth, y));
+	m_vertices.push_back(glm::vec2(x + fWidth, y + fHeight));
+	m_vertices.push_back(glm::vec2(x, y + fHeight));
+	float fBudgetY = y + (float) dBudget * fScale;
+	m_vertices.push_back(glm::vec2(x, fBudgetY));
+	m_vertices.push_back(glm::vec2(x + fWidth, fBudgetY));
+	float fHitchY = y + min(fHeight, (float) pStats->GetHitchThreshold() * fScale);
+	m_vertices.push_back(glm::vec2(x, fHitchY));
+	m_vertices.push_back(glm::vec2(x + fWidth, fHitchY));
+
+	// Orphan the buffer, then fill it
+	int iCapacity = pStats->GetWindowFrames() + MARKER_VERTICES;
+	glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+	glBufferData(GL_ARRAY_BUFFER, iCapacity * sizeof(glm::vec2), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, m_vertices.size() * sizeof(glm::vec2), &m_vertices[0]);
+
+	m_pProgram->UseProgram();
+	m_pProgram->SetUniform("projMatrix", pProjection);
+	glBindVertexArray(m_vao);
+
+	m_pProgram->SetUniform("vColour", glm::vec4(0.6f, 0.6f, 0.6f, 1.0f));
+	glDrawArrays(GL_LINE_LOOP, iFrames, 4);
+	m_pProgram->SetUniform("vColour", glm::vec4(0.2f, 0.9f, 0.2f, 1.0f));
+	glDrawArrays(GL_LINES, iFrames + 4, 2);
+	m_pProgram->SetUniform("vColour", glm::vec4(0.9f, 0.2f, 0.2f, 1.0f));
+	glDrawArrays(GL_LINES, iFrames + 6, 2);
+	m_pProgram->SetUniform("vColour", glm::vec4(1.0f, 1.0f, 0.3f, 1.0f));
+	glDrawArrays(GL_LINE_STRIP, 0, iFrames);
+
+	glBindVertexArray(0);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "Common.h"
+
+class CShaderProgram;
+class CFrameStats;
+
+// A class that draws the recent frame times as a line graph in the HUD, with the frame budget and the hitch threshold
+// marked across it.  The graph's vertices are rebuilt every frame into one dynamic vertex buffer, which is orphaned
+// before each upload so the CPU never waits for the GPU to finish drawing the last frame's.
+class CFrameTimeGraph
+{
+public:
+	CFrameTimeGraph();
+	~CFrameTimeGraph();
+
+	void Create(CShaderProgram* pProgram);
+	void Release();
+
+	// Draws at (x, y), the bottom left corner in pixels, scaled so the top of the graph is GRAPH_BUDGETS frame budgets
+	void Render(CFrameStats* pStats, float x, float y, float fWidth, float fHeight, double dBudget, glm::mat4* pProjection);
+
+private:
+	static const int GRAPH_BUDGETS = 3;
+	static const int MARKER_VERTICES = 8;	// The border, then the budget and hitch lines
+
+	CShaderProgram* m_pProgram;
+	UINT m_vao;
+	UINT m_vbo;
+	vector<glm::vec2> m_vertices;
+	bool m_created;
+};
@@ -0,0 +1,168 @@
+#include "Common.h"
+#include "Frustum.h"
+#include <xmmintrin.h>
+
+// Starts a new set of bounds, keeping the allocated space
+void CCullBounds::Clear()
+{
+	m_centreX.clear();
+	m_centreY.clear();
+	m_centreZ.clear();
+	m_extentX.clear();
+	m_extentY.clear();
+	m_extentZ.clear();
+	m_radius.clear();
+}
+
+// Adds an object-space bounding box placed by a model matrix.  The result is the world-space box around the transformed box.
+int CCullBounds::AddBox(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, const glm::mat4 &modelMatrix)
+{
+	glm::vec3 centre = glm::vec3(modelMatrix * glm::vec4((boundsMin + boundsMax) * 0.5f, 1.0f));
+	glm::vec3 localExtents = (boundsMax - boundsMin) * 0.5f;
+
+	// Each world axis extent is the sum of the absolute contributions of the local axes
+	glm::vec3 extents;
+	for (int i = 0; i < 3; i++)
+		extents[i] = fabs(modelMatrix[0][i]) * localExtents.x + fabs(modelMatrix[1][i]) * localExtents.y + fabs(modelMatrix[2][i]) * localExtents.z;
+
+	m_centreX.push_back(centre.x);
+	m_centreY.push_back(centre.y);
+	m_centreZ.push_back(centre.z);
+	m_extentX.push_back(extents.x);
+	m_extentY.push_back(extents.y);
+	m_extentZ.push_back(extents.z);
+	m_radius.push_back(glm::length(extents));
+	return GetCount() - 1;
+}
+
+// Adds a world-space sphere.  Its box is the cube around it.
+int CCullBounds::AddSphere(const glm::vec3 &centre, float radius)
+{
+	m_centreX.push_back(centre.x);
+	m_centreY.push_back(centre.y);
+	m_centreZ.push_back(centre.z);
+	m_extentX.push_back(radius);
+	m_extentY.push_back(radius);
+	m_extentZ.push_back(radius);
+	m_radius.push_back(radius);
+	return GetCount() - 1;
+}
+
+int CCullBounds::GetCount()
+{
+	return (int)m_radius.size();
+}
+
+glm::vec3 CCullBounds::GetCentre(int i)
+{
+	return glm::vec3(m_centreX[i], m_centreY[i], m_centreZ[i]);
+}
+
+glm::vec3 CCullBounds::GetExtents(int i)
+{
+	return glm::vec3(m_extentX[i], m_extentY[i], m_extentZ[i]);
+}
+
+float CCullBounds::GetRadius(int i)
+{
+	return m_radius[i];
+}
+
+
+CFrustum::CFrustum()
+{
+	for (int i = 0; i < 6; i++)
+		m_planes[i] = glm::vec4(0.0f);
+}
+
+// Extracts the planes from the combined projection and view matrix (Gribb and Hartmann), so they are in world space
+void CFrustum::Extract(const glm::mat4 &projMatrix, const glm::mat4 &viewMatrix)
+{
+	glm::mat4 m = projMatrix * viewMatrix;
+	glm::vec4 row[4];
+	for (int i = 0; i < 4; i++)
+		row[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+
+	m_planes[0] = row[3] + row[0];	// Left
+	m_planes[1] = row[3] - row[0];	// Right
+	m_planes[2] = row[3] + row[1];	// Bottom
+	m_planes[3] = row[3] - row[1];	// Top
+	m_planes[4] = row[3] + row[2];	// Near
+	m_planes[5] = row[3] - row[2];	// Far
+
+	for (int i = 0; i < 6; i++)
+		m_planes[i] /= glm::length(glm::vec3(m_planes[i]));
+}
+
+// Moves the far plane to the given distance in front of the eye, if that is nearer than the projection's far plane
+void CFrustum::SetFarDistance(const glm::vec3 &eye, const glm::vec3 &forward, float distance)
+{
+	if (distance < glm::dot(glm::vec3(m_planes[5]), eye) + m_planes[5].w)
+		m_planes[5] = glm::vec4(-forward, glm::dot(forward, eye) + distance);
+}
+
+// Tests one object.  It is outside if it lies wholly behind any plane, by either its box or its sphere.
+bool CFrustum::IsVisible(const glm::vec3 &centre, const glm::vec3 &extents, float radius)
+{
+	for (int i = 0; i < 6; i++) {
+		glm::vec3 normal = glm::vec3(m_planes[i]);
+		float distance = glm::dot(normal, centre) + m_planes[i].w;
+		float boxRadius = glm::dot(glm::abs(normal), extents);
+		if (distance < -glm::min(boxRadius, radius))
+			return false;
+	}
+	return true;
+}
+
+// Tests every object against the frustum, four at a time with SSE.  Objects left over at the end are tested one by one.
+int CFrustum::Cull(CCullBounds &bounds, vector<unsigned char> &visible)
+{
+	int iCount = bounds.GetCount();
+	visible.resize(iCount);
+
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	int iVisible = 0;
+	int i = 0;
+	for (; i + 4 <= iCount; i += 4) {
+		__m128 centreX = _mm_loadu_ps(&bounds.m_centreX[i]);
+		__m128 centreY = _mm_loadu_ps(&bounds.m_centreY[i]);
+		__m128 centreZ = _mm_loadu_ps(&bounds.m_centreZ[i]);
+		__m128 extentX = _mm_loadu_ps(&bounds.m_extentX[i]);
+		__m128 extentY = _mm_loadu_ps(&bounds.m_extentY[i]);
+		__m128 extentZ = _mm_loadu_ps(&bounds.m_extentZ[i]);
+		__m128 radius = _mm_loadu_ps(&bounds.m_radius[i]);
+
+		__m128 outside = _mm_setzero_ps();
+		for (int p = 0; p < 6; p++) {
+			__m128 normalX = _mm_set1_ps(m_planes[p].x);
+			__m128 normalY = _mm_set1_ps(m_planes[p].y);
+			__m128 normalZ = _mm_set1_ps(m_planes[p].z);
+
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(normalX, centreX), _mm_mul_ps(normalY, centreY)),
+				_mm_add_ps(_mm_mul_ps(normalZ, centreZ), _mm_set1_ps(m_planes[p].w)));
+			__m128 boxRadius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, normalX), extentX), 
+				_mm_mul_ps(_mm_andnot_ps(signMask, normalY), extentY)), _mm_mul_ps(_mm_andnot_ps(signMask, normalZ), extentZ));
+
+			__m128 reach = _mm_min_ps(boxRadius, radius);
+			outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, _mm_xor_ps(reach, signMask)));
+		}
+
+		int iOutsideMask = _mm_movemask_ps(outside);
+		for (int j = 0; j < 4; j++) {
+			visible[i + j] = (iOutsideMask & (1 << j)) ? 0 : 1;
+			iVisible += visible[i + j];
+		}
+	}
+
+	for (; i < iCount; i++) {
+		visible[i] = IsVisible(bounds.GetCentre(i), bounds.GetExtents(i), bounds.GetRadius(i)) ? 1 : 0;
+		iVisible += visible[i];
+	}
+
+	return iVisible;
+}
+
+glm::vec4* CFrustum::GetPlanes()
+{
+	return m_planes;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Common.h"
+
+// World-space bounds of the objects to be culled.  Each object has a box (centre and half extents) and a bounding sphere
+// radius.  The values are kept in separate flat arrays so that CFrustum::Cull can test four objects at a time.
+class CCullBounds
+{
+public:
+	void Clear();
+	int AddBox(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, const glm::mat4 &modelMatrix);	// Object-space box, transformed
+	int AddSphere(const glm::vec3 &centre, float radius);
+
+	int GetCount();
+	glm::vec3 GetCentre(int i);
+	glm::vec3 GetExtents(int i);
+	float GetRadius(int i);
+
+private:
+	friend class CFrustum;
+
+	vector<float> m_centreX, m_centreY, m_centreZ;
+	vector<float> m_extentX, m_extentY, m_extentZ;
+	vector<float> m_radius;
+};
+
+
+// A class for the six planes of the camera's view volume, used to skip objects that cannot be seen
+class CFrustum
+{
+public:
+	CFrustum();
+
+	void Extract(const glm::mat4 &projMatrix, const glm::mat4 &viewMatrix);
+	void SetFarDistance(const glm::vec3 &eye, const glm::vec3 &forward, float distance);	// Pulls the far plane in
+
+	bool IsVisible(const glm::vec3 &centre, const glm::vec3 &extents, float radius);
+	int Cull(CCullBounds &bounds, vector<unsigned char> &visible);	// Fills in one flag per object; returns the number visible
+	glm::vec4* GetPlanes();			// Left, right, bottom, top, near, far
+
+private:
+	glm::vec4 m_planes[6];	// xyz: inward normal, w: distance, normalised so plane distances are in world units
+};
@@ -0,0 +1,10 @@
+#include "Common.h"
+
+thread_local GLFrameCounts CGLCounters::s_counts = {};
+
+GLFrameCounts CGLCounters::TakeFrameCounts()
+{
+	GLFrameCounts counts = s_counts;
+	s_counts = GLFrameCounts();
+	return counts;
+}
@@ -0,0 +1,214 @@
+#pragma once
+
+// Included at the end of Common.h, after GLEW, so every file that draws is counted.  Comment this out to call GL directly.
+#define ENABLE_GL_COUNTERS
+
+// What one frame asked of GL
+struct GLFrameCounts
+{
+	int draws;							// Draw calls, with each multi-draw counted once
+	int indirectDraws;					// Commands submitted by multi-draws, whose triangles are not known on the CPU
+	long long triangles;				// Of the direct draws, times their instances
+	int programBinds;
+	int textureBinds;
+	int vertexArrayBinds;
+	int uniformUploads;
+	long long bytesUploaded;			// To buffers
+};
+
+// Counts the GL calls this project makes that cost the most on the CPU.  The entry points are redefined below to inline
+// wrappers, which add to the calling thread's counts and then make the call.  Counts are per thread, as GL contexts are,
+// so the shader compiler's work on its own context does not show up in the frame's.
+class CGLCounters
+{
+public:
+	static GLFrameCounts TakeFrameCounts();	// The calling thread's counts since the last call, which are then reset
+
+	static GLFrameCounts& Current()
+	{
+		return s_counts;
+	}
+
+	static long long Triangles(GLenum mode, GLsizei count)
+	{
+		if (mode == GL_TRIANGLES)
+			return count / 3;
+		if (mode == GL_TRIANGLE_STRIP || mode == GL_TRIANGLE_FAN)
+			return count > 2 ? count - 2 : 0;
+		return 0;
+	}
+
+private:
+	static thread_local GLFrameCounts s_counts;
+};
+
+#ifdef ENABLE_GL_COUNTERS
+
+// Each wrapper calls the real entry point, which is still visible here as the redefinitions come after
+inline void CountedDrawArrays(GLenum mode, GLint first, GLsizei count)
+{
+	GLFrameCounts &counts = CGLCounters::Current();
+	counts.draws++;
+	counts.triangles += CGLCounters::Triangles(mode, count);
+	glDrawArrays(mode, first, count);
+}
+
+inline void CountedDrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices)
+{
+	GLFrameCounts &counts = CGLCounters::Current();
+	counts.draws++;
+	counts.triangles += CGLCounters::Triangles(mode, count);
+	glDrawElements(mode, count, type, indices);
+}
+
+inline void CountedDrawElementsBaseVertex(GLenum mode, GLsizei count, GLenum type, void* indices, GLint baseVertex)
+{
+	GLFrameCounts &counts = CGLCounters::Current();
+	counts.draws++;
+	counts.triangles += CGLCounters::Triangles(mode, count);
+	glDrawElementsBaseVertex(mode, count, type, indices, baseVertex);
+}
+
+inline void CountedDrawElementsInstancedBaseVertex(GLenum mode, GLsizei count, GLenum type, const void* indices, GLsizei instances, 
+	GLint baseVertex)
+{
+	GLFrameCounts &counts = CGLCounters::Current();
+	counts.draws++;
+	counts.triangles += CGLCounters::Triangles(mode, count) * instances;
+	glDrawElementsInstancedBaseVertex(mode, count, type, indices, instances, baseVertex);
+}
+
+inline void CountedMultiDrawElementsIndirect(GLenum mode, GLenum type, const void* indirect, GLsizei drawCount, GLsizei stride)
+{
+	GLFrameCounts &counts = CGLCounters::Current();
+	counts.draws++;
+	counts.indirectDraws += drawCount;
+	glMultiDrawElementsIndirect(mode, type, indirect, drawCount, stride);
+}
+
+inline void CountedUseProgram(GLuint program)
+{
+	CGLCounters::Current().programBinds++;
+	glUseProgram(program);
+}
+
+inline void CountedBindTexture(GLenum target, GLuint texture)
+{
+	CGLCounters::Current().textureBinds++;
+	glBindTexture(target, texture);
+}
+
+inline void CountedBindVertexArray(GLuint array)
+{
+	CGLCounters::Current().vertexArrayBinds++;
+	glBindVertexArray(array);
+}
+
+// Buffer storage made without data is not an upload
+inline void CountedBufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+{
+	if (data)
+		CGLCounters::Current().bytesUploaded += size;
+	glBufferData(target, size, data, usage);
+}
+
+inline void CountedBufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data)
+{
+	CGLCounters::Current().bytesUploaded += size;
+	glBufferSubData(target, offset, size, data);
+}
+
+// GL ignores a uniform at location -1 (one the program does not have), so those are not counted
+inline void CountedUniform1i(GLint location, GLint v0)
+{
+	if (location >= 0)
+		CGLCounters::Current().uniformUploads++;
+	glUniform1i(location, v0);
+}
+
+inline void CountedUniform1iv(GLint location, GLsizei count, const GLint* value)
+{
+	if (location >= 0)
+		CGLCounters::Current().uniformUploads++;
+	glUniform1iv(location, count, value);
+}
+
+inline void CountedUniform1fv(GLint location, GLsizei count, const GLfloat* value)
+{
+	if (location >= 0)
+		CGLCounters::Current().uniformUploads++;
+	glUniform1fv(location, count, value);
+}
+
+inline void CountedUniform2fv(GLint location, GLsizei count, const GLfloat* value)
+{
+	if (location >= 0)
+		CGLCounters::Current().uniformUploads++;
+	glUniform2fv(location, count, value);
+}
+
+inline void CountedUniform3fv(GLint location, GLsizei count, const GLfloat* value)
+{
+	if (location >= 0)
+		CGLCounters::Current().uniformUploads++;
+	glUniform3fv(location, count, value);
+}
+
+inline void CountedUniform4fv(GLint location, GLsizei count, const GLfloat* value)
+{
+	if (location >= 0)
+		CGLCounters::Current().uniformUploads++;
+	glUniform4fv(location, count, value);
+}
+
+inline void CountedUniformMatrix3fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
+{
+	if (location >= 0)
+		CGLCounters::Current().uniformUploads++;
+	glUniformMatrix3fv(location, count, transpose, value);
+}
+
+inline void CountedUniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
+{
+	if (location >= 0)
+		CGLCounters::Current().uniformUploads++;
+	glUniformMatrix4fv(location, count, transpose, value);
+}
+
+// GLEW defines most entry points as macros of its own, so those are replaced
+#undef glDrawElementsBaseVertex
+#undef glDrawElementsInstancedBaseVertex
+#undef glMultiDrawElementsIndirect
+#undef glUseProgram
+#undef glBindVertexArray
+#undef glBufferData
+#undef glBufferSubData
+#undef glUniform1i
+#undef glUniform1iv
+#undef glUniform1fv
+#undef glUniform2fv
+#undef glUniform3fv
+#undef glUniform4fv
+#undef glUniformMatrix3fv
+#undef glUniformMatrix4fv
+
+#define glDrawArrays CountedDrawArrays
+#define glDrawElements CountedDrawElements
+#define glDrawElementsBaseVertex CountedDrawElementsBaseVertex
+#define glDrawElementsInstancedBaseVertex CountedDrawElementsInstancedBaseVertex
+#define glMultiDrawElementsIndirect CountedMultiDrawElementsIndirect
+#define glUseProgram CountedUseProgram
+#define glBindTexture CountedBindTexture
+#define glBindVertexArray CountedBindVertexArray
+#define glBufferData CountedBufferData
+#define glBufferSubData CountedBufferSubData
+#define glUniform1i CountedUniform1i
+#define glUniform1iv CountedUniform1iv
+#define glUniform1fv CountedUniform1fv
+#define glUniform2fv CountedUniform2fv
+#define glUniform3fv CountedUniform3fv
+#define glUniform4fv CountedUniform4fv
+#define glUniformMatrix3fv CountedUniformMatrix3fv
+#define glUniformMatrix4fv CountedUniformMatrix4fv
+
+#endif
@@ -39,13 +39,213 @@ Source code drawn from a number of sources and examples, including contributions
 #include "Cube.h"
 #include "Tetrahedron.h"
 #include "CatmullRom.h"
+#include "ShaderPermutations.h"
+#include "ProgramBinaryCache.h"
+#include "ShaderCompiler.h"
+#include "BakedLighting.h"
+#include "StaticLighting.h"
+#include "DepthPrepass.h"
+#include "InstancedMeshBatch.h"
+#include "Frustum.h"
+#include "Occluders.h"
+#include "OcclusionBuffer.h"
+#include "OcclusionQueries.h"
+#include "PotentiallyVisibleSet.h"
+#include "RenderQueue.h"
+#include "WorkerThreads.h"
+#include "TripleBuffer.h"
+#include "JobSystem.h"
+#include "JobBenchmark.h"
+#include "FramePacer.h"
+#include "FrameLatencyLimiter.h"
+#include "include/glm/gtc/quaternion.hpp"
+#include "MeshPool.h"
+#include "GpuDrivenScene.h"
+#include "RenderTarget.h"
+#include "GpuProfiler.h"
+#include "FrameStats.h"
+#include "FrameTimeGraph.h"
+#include "BenchmarkReport.h"
+#include "CpuTrace.h"
+#include "QualityGovernor.h"
+#include "TemporalUpscaler.h"
+#include <algorithm>
+
+// The vehicles that make up each environment convoy, placed relative to the convoy's lead starship
+enum EnvVehicleMesh
+{
+	ENV_STARSHIP,
+	ENV_FREIGHTER,
+	ENV_TRANSPORT,
+	ENV_FLYING_CAR,
+	ENV_POLICE_CAR,
+	ENV_PATROL_CAR,
+};
+
+struct EnvVehicle
+{
+	int iMesh;
+	glm::vec3 offset;
+};
+
+static const EnvVehicle envConvoyLayout[] = {
+	{ ENV_STARSHIP, glm::vec3(0, 0, 0) },
+	{ ENV_FREIGHTER, glm::vec3(10, 10, 70) },
+	{ ENV_TRANSPORT, glm::vec3(-10, -10, 50) },
+	{ ENV_TRANSPORT, glm::vec3(0, 15, 130) },
+	{ ENV_FREIGHTER, glm::vec3(0, 0, -130) },
+	{ ENV_FLYING_CAR, glm::vec3(25, -10, 30) },
+	{ ENV_FLYING_CAR, glm::vec3(-25, 5, 30) },
+	{ ENV_FLYING_CAR, glm::vec3(25, 10, -30) },
+	{ ENV_POLICE_CAR, glm::vec3(-25, 10, -30) },
+	{ ENV_POLICE_CAR, glm::vec3(30, -4, -10) },
+	{ ENV_PATROL_CAR, glm::vec3(-25, 10, -100) },
+	{ ENV_PATROL_CAR, glm::vec3(30, -4, -70) },
+};
+static const int ENV_CONVOY_VEHICLES = sizeof(envConvoyLayout) / sizeof(envConvoyLayout[0]);
+
+// Software occlusion culling: size of the CPU depth buffer, and the smallest occluder box worth keeping (world units cubed)
+static const int OCCLUSION_BUFFER_WIDTH = 256;
+static const int OCCLUSION_BUFFER_HEIGHT = 128;
+static const float OCCLUDER_MIN_VOLUME = 8000.0f;
+
+// The static city meshes are split into this many chunks along each side, so they can be culled a piece at a time
+static const int STATIC_MESH_CHUNK_GRID = 4;
+
+// Objects whose bounds the camera is within this distance of are drawn without occlusion queries, since the near plane
+// would clip their bounding box
+static const float OCCLUSION_QUERY_NEAR_MARGIN = 2.0f;
+
+// Fog falls off as exp(-FOG_DENSITY * distance) towards mid grey.  Once the largest change an object can make to a pixel
+// (half the colour range, times the fog weight) is below FOG_VISIBLE_CONTRAST, it cannot be seen and is culled.
+static const float CAMERA_FAR_PLANE = 5000.0f;
+static const float FOG_DENSITY = 0.0007f;
+static const float FOG_VISIBLE_CONTRAST = 0.02f;
+static const float FOG_MAX_LOD_BIAS = 2.0f;
+
+// Half the side of the skybox cube, which stays centred on the camera.  It is drawn at the far plane's depth, so it need
+// not fit inside the far plane.
+static const float SKYBOX_SIZE = 2500.0f;
+
+// The lowest settings the quality governor may drop to when frames run over budget.  The highest are the full window
+// resolution, CAMERA_FAR_PLANE, every city light and the full fog cut-off distance.
+static const float QUALITY_MIN_RESOLUTION_SCALE = 0.5f;
+static const float QUALITY_MIN_FAR_PLANE = 1500.0f;
+static const int QUALITY_MIN_SPOTLIGHTS = 8;
+static const float QUALITY_MIN_CULL_SCALE = 0.4f;
+
+// While upscaling, the scene is drawn at this fraction of the window's width and height (half the pixels), unless 
+// --renderscale is given.  The quality governor's resolution scale applies on top.
+static const float DEFAULT_RENDER_SCALE = 0.7071f;
+static const float MIN_RENDER_SCALE = 0.25f;
+
+// Where F2 writes the GPU profiler's scope timings, F3 the CPU trace and F4 the frame time statistics
+static const char* GPU_PROFILE_FILENAME = "gpuprofile.csv";
+static const char* CPU_TRACE_FILENAME = "cputrace.json";
+static const char* FRAME_STATS_FILENAME = "framestats.csv";
+
+// The size of the debug HUD's frame time graph, in pixels
+static const float FRAME_GRAPH_WIDTH = 400.0f;
+static const float FRAME_GRAPH_HEIGHT = 120.0f;
+
+// Potentially visible sets for the static city chunks, baked for each track camera mode and sector with --bakepvs.  Each 
+// sector is sampled at a few distances and strafe positions, with the field of view widened to cover the gaps between.
+static const char* PVS_FILENAME = "resources\\models\\city.pvs";
+static const int TRACK_CAMERA_MODES = 3;
+static const int PVS_SECTOR_COUNT = 200;
+static const int PVS_SAMPLES_PER_SECTOR = 4;
+static const float PVS_FOV_MARGIN = 1.25f;
+
+// Programs a queued draw can ask for.  Each pass over the queue says which actual program to use for each.
+enum RenderProgram
+{
+	RENDER_PROGRAM_SPOTLIGHT,
+	RENDER_PROGRAM_STATIC,
+	RENDER_PROGRAM_TRACK,
+	RENDER_PROGRAM_INDIRECT_SPOTLIGHT,	// The GPU-driven draws read their matrices from a buffer, so they have their own programs
+	RENDER_PROGRAM_INDIRECT_STATIC,
+	RENDER_PROGRAM_COUNT,
+};
+
+// Materials for the render queue's sort keys.  Each mesh binds its own textures, so a mesh is a material.
+enum RenderMaterial
+{
+	MATERIAL_TERRAIN,
+	MATERIAL_HORSE,
+	MATERIAL_FIGHTER,
+	MATERIAL_STARSHIP,
+	MATERIAL_CUBE,
+	MATERIAL_TETRAHEDRON,
+	MATERIAL_CONVOY_BATCH,
+	MATERIAL_TRACK,
+	MATERIAL_ENV_VEHICLE,									// One per vehicle mesh from here
+	MATERIAL_STATIC_MESH = MATERIAL_ENV_VEHICLE + ENV_PATROL_CAR + 1,	// One per static mesh from here
+	MATERIAL_INDIRECT_BUCKET = MATERIAL_STATIC_MESH + STATIC_MESH_COUNT,	// One per GPU-driven bucket from here
+};
+
+// Distance of each convoy along the environment path
+static const float envConvoyDistances[] = { 0.0f, 800.0f, 1800.0f, 3000.0f, 4800.0f, 5200.0f };
+
+// The simulation ticks 120 times a second whatever the frame rate.  After a long stall it runs at most this many ticks
+// to catch up, and lets the rest of the time go.
+static const double SIM_TICK_MS = 1000.0 / 120.0;
+static const int SIM_MAX_CATCH_UP_TICKS = 12;
+
+// Convoys per job when the environment ships are updated.  A convoy's spline samples are cheap, so it takes a few to be
+// worth a job.
+static const int ENV_CONVOYS_PER_JOB = 4;
+
+static const char* JOB_BENCHMARK_FILENAME = "jobbench.txt";
+
+// The benchmark drives each track camera mode for this many laps, unless --benchmark=N is given, after some frames to
+// settle that are not counted
+static const char* BENCHMARK_FILENAME = "benchmark.json";
+static const int BENCHMARK_DEFAULT_LAPS = 1;
+static const int BENCHMARK_WARMUP_FRAMES = 30;
+
+// It draws offscreen at this resolution, unless --benchmark-size=WxH is given, since a hidden window's pixels need not be
+// shaded at all
+static const int BENCHMARK_DEFAULT_WIDTH = 1280;
+static const int BENCHMARK_DEFAULT_HEIGHT = 720;
+
+// Blends between two snapshots' rotations
+static glm::mat4 InterpolateOrientation(const glm::mat4 &a, const glm::mat4 &b, float t)
+{
+	return glm::mat4_cast(glm::slerp(glm::quat_cast(a), glm::quat_cast(b), t));
+}
 
 // Constructor
 Game::Game()
 {
 	m_pSkybox = NULL;
 	m_pCamera = NULL;
+	m_pSimCamera = NULL;
 	m_pShaderPrograms = NULL;
+	m_pSpotlightShaders = NULL;
+	m_pProgramBinaryCache = NULL;
+	m_pShaderCompiler = NULL;
+	m_pDepthPrepass = NULL;
+	m_pEnvConvoyBatch = NULL;
+	m_pFrustum = NULL;
+	m_pCullBounds = NULL;
+	m_pOcclusionBuffer = NULL;
+	m_pOcclusionQueries = NULL;
+	m_pPvs = NULL;
+	m_pRenderQueue = NULL;
+	m_pRenderWorkers = NULL;
+	m_pJobSystem = NULL;
+	m_pFramePacer = NULL;
+	m_pLatencyLimiter = NULL;
+	m_pMeshPool = NULL;
+	m_pGpuScene = NULL;
+	m_pIndirectShaders = NULL;
+	m_pIndirectDepthProgram = NULL;
+	m_pSceneTarget = NULL;
+	m_pGpuProfiler = NULL;
+	m_pQualityGovernor = NULL;
+	m_pUpscaler = NULL;
+	m_pFrameStats = NULL;
+	m_pFrameTimeGraph = NULL;
 	m_pPlanarTerrain = NULL;
 	m_pFtFont = NULL;
 	m_pBarrelMesh = NULL;
@@ -63,7 +263,8 @@ Game::Game()
 	
 	m_pStarship = NULL;
 
-	m_dt = 0.0;
+	m_dt = SIM_TICK_MS;
+	m_frameTime = 0.0;
 	m_framesPerSecond = 0;
 	m_frameCount = 0;
 	m_elapsedTime = 0.0f;
@@ -78,13 +279,59 @@ Game::Game()
 	m_showPath = true;
 	m_fogOn = true;
 	m_headlightOn = true;
+	m_bakedLightingAvailable = false;
+	m_bakedLightingOn = true;
+	m_instancingOn = true;
+	m_cullingOn = true;
+	m_objectsDrawn = 0;
+	m_occlusionCullingOn = true;
+	m_objectsOccluded = 0;
+	m_occlusionTime = 0.0;
+	m_occlusionQueriesOn = true;
+	m_sceneObjectQuery = false;
+	m_sceneObjectConditional = false;
+	m_pvsOn = true;
+	m_bakePvs = false;
+	m_jobBench = false;
+	m_benchmarkLaps = 0;
+	m_benchmarkWidth = BENCHMARK_DEFAULT_WIDTH;
+	m_benchmarkHeight = BENCHMARK_DEFAULT_HEIGHT;
+	m_targetFrameRate = FPS;
+	m_lowLatencyOn = false;
+	m_inputLatency = 0.0;
+	m_farPlane = CAMERA_FAR_PLANE;
+	m_cpuFrameTime = 0.0;
+	m_glCounts = GLFrameCounts();
+	m_upscalingOn = true;
+	m_renderScale = DEFAULT_RENDER_SCALE;
+	m_previousViewProjection = glm::mat4(1);
+	m_objectsPvsCulled = 0;
+	m_pvsSector = 0;
+	m_renderSortingOn = true;
+	m_gpuDrivenOn = true;
+	m_parallelRecordingOn = true;
+	m_recordingTime = 0.0;
+	for (int i = 0; i < RENDER_JOB_COUNT; i++)
+		m_renderJobs[i].pCommands = NULL;
+	m_pSimFrames = NULL;
+	m_stopSimulation = false;
+	m_simPaused = false;
+	m_pendingSimInput.bFreeview = false;
+	m_pendingSimInput.iCameraMode = 3;
+	m_pendingSimInput.bShowPath = true;
+	m_pendingSimInput.bResetPath = false;
+	m_simInput = m_pendingSimInput;
 }
 
 // Destructor
 Game::~Game() 
 { 
+	StopSimulation();
+
 	//game objects
 	delete m_pCamera;
+	delete m_pSimCamera;
+	delete m_pSimFrames;
 	delete m_pSkybox;
 	delete m_pPlanarTerrain;
 	delete m_pFtFont;
@@ -105,12 +352,39 @@ Game::~Game()
 	delete m_pFlyingCar;
 	delete m_pPoliceCar;
 	delete m_pPatrolCar;
+	delete m_pGpuScene;
+	delete m_pMeshPool;
 
 	if (m_pShaderPrograms != NULL) {
 		for (unsigned int i = 0; i < m_pShaderPrograms->size(); i++)
 			delete (*m_pShaderPrograms)[i];
 	}
 	delete m_pShaderPrograms;
+	delete m_pShaderCompiler;
+	delete m_pDepthPrepass;
+	delete m_pEnvConvoyBatch;
+	delete m_pFrustum;
+	delete m_pCullBounds;
+	delete m_pOcclusionBuffer;
+	delete m_pOcclusionQueries;
+	delete m_pPvs;
+	delete m_pRenderQueue;
+	delete m_pRenderWorkers;
+	delete m_pJobSystem;
+	delete m_pFramePacer;
+	delete m_pLatencyLimiter;
+	for (int i = 0; i < RENDER_JOB_COUNT; i++)
+		delete m_renderJobs[i].pCommands;
+	delete m_pSpotlightShaders;
+	delete m_pIndirectShaders;
+	delete m_pIndirectDepthProgram;
+	delete m_pSceneTarget;
+	delete m_pGpuProfiler;
+	delete m_pQualityGovernor;
+	delete m_pUpscaler;
+	delete m_pFrameStats;
+	delete m_pFrameTimeGraph;
+	delete m_pProgramBinaryCache;
 
 	//setup objects
 	delete m_pHighResolutionTimer;
@@ -126,8 +400,36 @@ void Game::Initialise()
 
 	/// Create objects
 	m_pCamera = new CCamera;
+	m_pSimCamera = new CCamera;
+	m_pSimFrames = new CTripleBuffer<SimFrame>;
 	m_pSkybox = new CSkybox;
 	m_pShaderPrograms = new vector <CShaderProgram *>;
+	m_pSpotlightShaders = new CShaderPermutations;
+	m_pProgramBinaryCache = new CProgramBinaryCache;
+	m_pShaderCompiler = new CShaderCompiler;
+	m_pDepthPrepass = new CDepthPrepass;
+	m_pEnvConvoyBatch = new CInstancedMeshBatch;
+	m_pFrustum = new CFrustum;
+	m_pCullBounds = new CCullBounds;
+	m_pOcclusionBuffer = new COcclusionBuffer;
+	m_pOcclusionQueries = new COcclusionQueries;
+	m_pPvs = new CPotentiallyVisibleSet;
+	m_pRenderQueue = new CRenderQueue;
+	m_pRenderWorkers = new CWorkerThreads;
+	m_pJobSystem = new CJobSystem;
+	m_pFramePacer = new CFramePacer;
+	m_pLatencyLimiter = new CFrameLatencyLimiter;
+	for (int i = 0; i < RENDER_JOB_COUNT; i++)
+		m_renderJobs[i].pCommands = new CRenderCommandList;
+	m_pMeshPool = new CMeshPool;
+	m_pGpuScene = new CGpuDrivenScene;
+	m_pIndirectShaders = new CShaderPermutations;
+	m_pSceneTarget = new CRenderTarget;
+	m_pGpuProfiler = new CGpuProfiler;
+	m_pQualityGovernor = new CQualityGovernor;
+	m_pUpscaler = new CTemporalUpscaler;
+	m_pFrameStats = new CFrameStats;
+	m_pFrameTimeGraph = new CFrameTimeGraph;
 	m_pPlanarTerrain = new CPlane;
 	m_pFtFont = new CFreeTypeFont;
 	m_pBarrelMesh = new COpenAssetImportMesh;
@@ -147,6 +449,12 @@ void Game::Initialise()
 	m_pPoliceCar = new COpenAssetImportMesh;
 	m_pPatrolCar = new COpenAssetImportMesh;
 
+	// The meshes share one set of buffers, so the GPU-driven draws can reach any of them
+	COpenAssetImportMesh* pMeshes[] = { m_pBarrelMesh, m_pHorseMesh, m_pFighterMesh, m_pCity, m_pCenterCity, m_pDowntown, m_pStarship, 
+		m_pTransport, m_pFreighter, m_pFlyingCar, m_pPoliceCar, m_pPatrolCar };
+	for (unsigned int i = 0; i < sizeof(pMeshes) / sizeof(pMeshes[0]); i++)
+		pMeshes[i]->SetMeshPool(m_pMeshPool);
+
 	m_pCube = new CCube;
 	m_pTetrahedron = new CTetrahedron;
 	m_pCatmullRom = new CCatmullRom;
@@ -171,67 +479,95 @@ void Game::Initialise()
 	m_starshipOrientation = glm::mat4(1);
 
 
-	RECT dimensions = m_gameWindow.GetDimensions();
+	RECT dimensions = GetOutputDimensions();
 
 	int width = dimensions.right - dimensions.left;
 	int height = dimensions.bottom - dimensions.top;
 
 	// Set the orthographic and perspective projection matrices based on the image size
 	m_pCamera->SetOrthographicProjectionMatrix(width, height); 
-	m_pCamera->SetPerspectiveProjectionMatrix(45.0f, (float) width / (float) height, 0.5f, 5000.0f);
-
-	// Load shaders
-	vector<CShader> shShaders;
-	vector<string> sShaderFileNames;
-	sShaderFileNames.push_back("mainShader.vert");
-	sShaderFileNames.push_back("mainShader.frag");
-	sShaderFileNames.push_back("textShader.vert");
-	sShaderFileNames.push_back("textShader.frag");
-	sShaderFileNames.push_back("spotlightShader.vert");
-	sShaderFileNames.push_back("spotlightShader.frag");
-
-	for (int i = 0; i < (int) sShaderFileNames.size(); i++) {
-		string sExt = sShaderFileNames[i].substr((int) sShaderFileNames[i].size()-4, 4);
-		int iShaderType;
-		if (sExt == "vert") iShaderType = GL_VERTEX_SHADER;
-		else if (sExt == "frag") iShaderType = GL_FRAGMENT_SHADER;
-		else if (sExt == "geom") iShaderType = GL_GEOMETRY_SHADER;
-		else if (sExt == "tcnl") iShaderType = GL_TESS_CONTROL_SHADER;
-		else iShaderType = GL_TESS_EVALUATION_SHADER;
-		CShader shader;
-		shader.LoadShader("resources\\shaders\\"+sShaderFileNames[i], iShaderType);
-		shShaders.push_back(shader);
-	}
+	m_pCamera->SetPerspectiveProjectionMatrix(45.0f, (float) width / (float) height, 0.5f, CAMERA_FAR_PLANE);
+
+	// Load shaders.  Linked programs are cached on disk as driver binaries, so only the first run compiles from source.
+	m_pProgramBinaryCache->Create("cache\\");
+	vector<string> sNoDefines;
 
 	// Create the main shader program
-	CShaderProgram *pMainProgram = new CShaderProgram;
-	pMainProgram->CreateProgram();
-	pMainProgram->AddShaderToProgram(&shShaders[0]);
-	pMainProgram->AddShaderToProgram(&shShaders[1]);
-	pMainProgram->LinkProgram();
+	CShaderProgram *pMainProgram = m_pProgramBinaryCache->BuildProgram("resources\\shaders\\mainShader.vert", "resources\\shaders\\mainShader.frag", sNoDefines);
 	m_pShaderPrograms->push_back(pMainProgram);
 
 	// Create a shader program for fonts
-	CShaderProgram *pFontProgram = new CShaderProgram;
-	pFontProgram->CreateProgram();
-	pFontProgram->AddShaderToProgram(&shShaders[2]);
-	pFontProgram->AddShaderToProgram(&shShaders[3]);
-	pFontProgram->LinkProgram();
+	CShaderProgram *pFontProgram = m_pProgramBinaryCache->BuildProgram("resources\\shaders\\textShader.vert", "resources\\shaders\\textShader.frag", sNoDefines);
 	m_pShaderPrograms->push_back(pFontProgram);
 
-	// Create the spotlight shader program
-	CShaderProgram* pSpotlightProgram = new CShaderProgram;
-	pSpotlightProgram->CreateProgram();
-	pSpotlightProgram->AddShaderToProgram(&shShaders[4]);
-	pSpotlightProgram->AddShaderToProgram(&shShaders[5]);
-	pSpotlightProgram->LinkProgram();
-	m_pShaderPrograms->push_back(pSpotlightProgram);
+	// Create a depth-only shader program for the depth pre-pass
+	CShaderProgram *pDepthProgram = m_pProgramBinaryCache->BuildProgram("resources\\shaders\\depthOnly.vert", "resources\\shaders\\depthOnly.frag", sNoDefines);
+	m_pShaderPrograms->push_back(pDepthProgram);
+
+	// Create the programs for the temporal upscaler's motion vectors and resolve, which draw a full screen triangle
+	CShaderProgram *pMotionProgram = m_pProgramBinaryCache->BuildProgram("resources\\shaders\\fullscreen.vert", "resources\\shaders\\motionVectors.frag", sNoDefines);
+	m_pShaderPrograms->push_back(pMotionProgram);
+	CShaderProgram *pResolveProgram = m_pProgramBinaryCache->BuildProgram("resources\\shaders\\fullscreen.vert", "resources\\shaders\\temporalResolve.frag", sNoDefines);
+	m_pShaderPrograms->push_back(pResolveProgram);
+	m_pUpscaler->Create(pMotionProgram, pResolveProgram);
+
+	// Create a shader program for the HUD's frame time graph
+	CShaderProgram *pGraphProgram = m_pProgramBinaryCache->BuildProgram("resources\\shaders\\frameGraph.vert", "resources\\shaders\\frameGraph.frag", sNoDefines);
+	m_pShaderPrograms->push_back(pGraphProgram);
+	m_pFrameTimeGraph->Create(pGraphProgram);
+	m_pDepthPrepass->Create();
+	m_pEnvConvoyBatch->Create();
+	m_pOcclusionQueries->Create();
+	m_pGpuProfiler->Create();
+
+	QualitySettings highestQuality = { 1.0f, CAMERA_FAR_PLANE, (int)GetCityLights().size(), 1.0f };
+	QualitySettings lowestQuality = { QUALITY_MIN_RESOLUTION_SCALE, QUALITY_MIN_FAR_PLANE, QUALITY_MIN_SPOTLIGHTS, QUALITY_MIN_CULL_SCALE };
+	m_pQualityGovernor->SetBounds(highestQuality, lowestQuality);
+
+	// Variants are compiled in the background.  The driver's own compiler threads are used if it has them, otherwise 
+	// a worker thread with a shared context.
+	HGLRC hrcShaderWorker = NULL;
+	if (!GLEW_KHR_parallel_shader_compile)
+		hrcShaderWorker = m_gameWindow.CreateSharedContext();
+	m_pShaderCompiler->Create(m_pProgramBinaryCache, m_gameWindow.Hdc(), hrcShaderWorker);
+
+	// Set up the spotlight shader permutations.  The uber program is built now; Render uses it until the variants are ready.
+	vector<string> sSpotlightFeatures;
+	sSpotlightFeatures.push_back("RENDER_SKYBOX");
+	sSpotlightFeatures.push_back("RENDER_TRACK");
+	sSpotlightFeatures.push_back("SHOW_TRACK");
+	sSpotlightFeatures.push_back("FOG_ON");
+	sSpotlightFeatures.push_back("BAKED_LIGHTING");
+	m_pSpotlightShaders->Create("resources\\shaders\\spotlightShader.vert", "resources\\shaders\\spotlightShader.frag", sSpotlightFeatures, m_pProgramBinaryCache, 
+		m_pShaderCompiler);
+
+	// Issue every variant Render can ask for up front, so they compile while the meshes load
+	for (unsigned int uiFog = 0; uiFog <= SHADER_FOG_ON; uiFog += SHADER_FOG_ON) {
+		m_pSpotlightShaders->Request(SHADER_RENDER_SKYBOX | uiFog);
+		m_pSpotlightShaders->Request(uiFog);
+		m_pSpotlightShaders->Request(SHADER_RENDER_TRACK | uiFog);
+		m_pSpotlightShaders->Request(SHADER_RENDER_TRACK | SHADER_SHOW_TRACK | uiFog);
+		m_pSpotlightShaders->Request(SHADER_BAKED_LIGHTING | uiFog);
+	}
+
+	// The GPU-driven draws need compute shaders.  Their programs share the spotlight fragment shader and its variants, and 
+	// their depth-only program shares the vertex shader, so the pre-pass depth matches exactly.
+	if (m_pGpuScene->Create(m_pMeshPool)) {
+		m_pIndirectShaders->Create("resources\\shaders\\indirectDraw.vert", "resources\\shaders\\spotlightShader.frag", sSpotlightFeatures, 
+			m_pProgramBinaryCache, m_pShaderCompiler);
+		for (unsigned int uiFog = 0; uiFog <= SHADER_FOG_ON; uiFog += SHADER_FOG_ON) {
+			m_pIndirectShaders->Request(uiFog);
+			m_pIndirectShaders->Request(SHADER_BAKED_LIGHTING | uiFog);
+		}
+		m_pIndirectDepthProgram = m_pProgramBinaryCache->BuildProgram("resources\\shaders\\indirectDraw.vert", "resources\\shaders\\depthOnly.frag", 
+			sNoDefines);
+	}
 
 	// You can follow this pattern to load additional shaders
 
 	// Create the skybox
 	// Skybox downloaded from http://www.akimbo.in/forum/viewtopic.php?f=10&t=9
-	m_pSkybox->Create(2500.0f);
+	m_pSkybox->Create(SKYBOX_SIZE);
 	
 	// Create the planar terrain
 	m_pPlanarTerrain->Create("resources\\textures\\", "sea.jpg", 10000.0f, 10000.0f, 50.0f); // Downloaded from https://www.sketchuptextureclub.com/textures/nature-elements/water/sea-water/sea-water-texture-seamless-13246 on 18/03/2021
@@ -243,9 +579,22 @@ void Game::Initialise()
 	m_pBarrelMesh->Load("resources\\models\\Barrel\\Barrel02.obj");  // Downloaded from http://www.psionicgames.com/?page_id=24 on 24 Jan 2013
 	m_pHorseMesh->Load("resources\\models\\Horse\\Horse2.obj");  // Downloaded from http://opengameart.org/content/horse-lowpoly on 24 Jan 2013
 	m_pFighterMesh->Load("resources\\models\\Fighter\\fighter1.obj"); 
-	m_pCity->Load("resources\\models\\City\\City.obj"); // Downloaded from https://free3d.com/3d-model/sci-fi-city-83682.html on 17/03/2021
-	m_pCenterCity->Load("resources\\models\\CenterCity\\CenterCity.obj"); // Downloaded from https://free3d.com/3d-model/sci-fi-downtown-city-53758.html on 17/03/2021
-	m_pDowntown->Load("resources\\models\\Downtown\\downtown.obj"); // Downloaded from https://free3d.com/3d-model/sci-fi-downtown-city-23035.html on 17/03/2021
+
+	// The static city meshes use baked lighting if the light baker has been run for all of them
+	vector<OccluderBox> occluders;
+	m_bakedLightingAvailable = LoadStaticMesh(m_pCity, STATIC_MESH_CITY, occluders);
+	m_bakedLightingAvailable = LoadStaticMesh(m_pCenterCity, STATIC_MESH_CENTER_CITY, occluders) && m_bakedLightingAvailable;
+	m_bakedLightingAvailable = LoadStaticMesh(m_pDowntown, STATIC_MESH_DOWNTOWN, occluders) && m_bakedLightingAvailable;
+
+	// The city's buildings hide the objects behind them.  Band threads rasterise them; the main thread takes one band.
+	m_pOcclusionBuffer->Create(OCCLUSION_BUFFER_WIDTH, OCCLUSION_BUFFER_HEIGHT, min(4, max(1, (int)thread::hardware_concurrency())));
+	m_pOcclusionBuffer->SetOccluders(occluders);
+
+	// The render jobs are recorded on the main thread and up to one worker per other job
+	m_pRenderWorkers->Create(min((int)RENDER_JOB_COUNT, max(1, (int)thread::hardware_concurrency())));
+
+	// The simulation's update jobs run on the simulation thread and a worker per other core
+	m_pJobSystem->Create(max(1, (int)thread::hardware_concurrency()));
 
 	m_pStarship->Load("resources\\models\\Starship\\Starship.obj"); // Downloaded from https://free3d.com/3d-model/wraith-raider-starship-22193.html on 17/03/2021
 	m_pTransport->Load("resources\\models\\Transport\\transport.obj"); // Downloaded from https://free3d.com/3d-model/futuristic-transport-shuttle-rigged--18765.html on 17/03/2021
@@ -253,6 +602,7 @@ void Game::Initialise()
 	m_pFlyingCar->Load("resources\\models\\FlyingCar\\FlyingCar.obj"); // Downloaded from https://free3d.com/3d-model/hn48-flying-car-10381.html on 17/03/2021
 	m_pPoliceCar->Load("resources\\models\\PoliceCar\\policecar.obj"); // Downloaded from https://free3d.com/3d-model/city-patrol-vehicle-84293.html on 17/03/2021
 	m_pPatrolCar->Load("resources\\models\\PatrolCar\\PatrolCar.obj"); // Downloaded from https://free3d.com/3d-model/city-patrol-vehicle-84293.html on 17/03/2021
+	m_pMeshPool->Upload();
 
 	// Create a sphere
 	m_pSphere->Create("resources\\textures\\", "dirtpile01.jpg", 25, 25);  // Texture downloaded from http://www.psionicgames.com/?page_id=26 on 24 Jan 2013
@@ -272,11 +622,64 @@ void Game::Initialise()
 	m_pCatmullRom->CreateTrack("resources\\textures\\grid.png");
 
 	m_pCatmullRom->Env_CreateCentreline();
+
+	// The sets only fit the chunks and track they were baked for; without them, the chunks are culled dynamically
+	int iStaticChunks = m_pDowntown->GetChunkCount() + m_pCity->GetChunkCount() + m_pCenterCity->GetChunkCount();
+	m_pPvs->Load(PVS_FILENAME, iStaticChunks, m_pCatmullRom->GetTrackLength());
+
+	// The static chunks follow the convoy vehicles in the scene objects
+	m_staticChunkObjects.resize(STATIC_MESH_COUNT);
+	int iObject = OBJECT_ENV_VEHICLES + ENV_CONVOY_COUNT * ENV_CONVOY_VEHICLES;
+	for (int i = 0; i < STATIC_MESH_COUNT; i++) {
+		m_staticChunkObjects[i] = iObject;
+		iObject += GetStaticMesh(i)->GetChunkCount();
+	}
+
+	// Both are also set up as GPU-driven draws, which replace their queued draws while switched on
+	if (m_pGpuScene->IsCreated()) {
+		for (int i = 0; i < STATIC_MESH_COUNT; i++) {
+			unsigned int uiState = i == STATIC_MESH_DOWNTOWN ? 0 : RENDER_STATE_NO_CULL;
+			for (int c = 0; c < GetStaticMesh(i)->GetChunkCount(); c++)
+				m_pGpuScene->AddDraws(m_staticChunkObjects[i] + c, GetStaticMesh(i), c, RENDER_PROGRAM_INDIRECT_STATIC, uiState);
+		}
+		for (int i = 0; i < ENV_CONVOY_COUNT * ENV_CONVOY_VEHICLES; i++)
+			m_pGpuScene->AddDraws(OBJECT_ENV_VEHICLES + i, GetEnvVehicleMesh(envConvoyLayout[i % ENV_CONVOY_VEHICLES].iMesh), -1, 
+				RENDER_PROGRAM_INDIRECT_SPOTLIGHT, 0);
+		m_pGpuScene->Finish();
+	}
 }
 
 // Render method runs repeatedly in a loop
 void Game::Render() 
 {
+	CPU_TRACE_SCOPE("Game::Render");
+
+	// Each part of the frame is a GPU profiler scope, shown on the debug HUD
+	m_pGpuProfiler->BeginFrame();
+
+	// Below full resolution, or while upscaling, the scene is drawn offscreen and scaled up onto the window before the HUD.
+	// The benchmark always draws offscreen, at its own size, and the blit onto its hidden window is the only present.
+	RECT dimensions = GetOutputDimensions();
+	int iWindowWidth = dimensions.right - dimensions.left;
+	int iWindowHeight = dimensions.bottom - dimensions.top;
+	float fResolutionScale = m_pQualityGovernor->GetSettings().resolutionScale;
+	if (m_upscalingOn)
+		fResolutionScale *= m_renderScale;
+	bool bScaled = fResolutionScale < 1.0f || m_upscalingOn || m_benchmarkLaps > 0;
+	int iSceneWidth = iWindowWidth;
+	int iSceneHeight = iWindowHeight;
+	if (bScaled) {
+		iSceneWidth = glm::max(1, (int) (iWindowWidth * fResolutionScale));
+		iSceneHeight = glm::max(1, (int) (iWindowHeight * fResolutionScale));
+		m_pSceneTarget->Create(iSceneWidth, iSceneHeight);
+		m_pSceneTarget->Bind();
+	}
+
+	// The upscaler needs each frame's samples at a different sub-pixel offset
+	if (m_upscalingOn)
+		m_pCamera->SetProjectionJitter(m_pUpscaler->NextJitter(iSceneWidth, iSceneHeight));
+	else
+		m_pCamera->SetProjectionJitter(glm::vec2(0.0f));
 	
 	// Clear the buffers and enable depth testing (z-buffering)
 	glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -297,53 +700,37 @@ void Game::Render()
 	glm::mat4 viewMatrix = modelViewMatrixStack.Top();
 	glm::mat3 viewNormalMatrix = m_pCamera->ComputeNormalMatrix(viewMatrix);
 
-	// Set light and materials in main shader program
-	glm::vec4 lightPosition1 = glm::vec4(-100, 100, -100, 1); // Position of light source *in world coordinates*
-
-	// Switch to the spotlight program
-	CShaderProgram* pSpotlightProgram = (*m_pShaderPrograms)[2];
-	pSpotlightProgram->UseProgram();
-	pSpotlightProgram->SetUniform("sampler0", 0);
-
-	pSpotlightProgram->SetUniform("matrices.projMatrix", m_pCamera->GetPerspectiveProjectionMatrix());
+	// Pick up any shader variants that finished compiling since the last frame
+	m_pShaderCompiler->Poll();
 
-	pSpotlightProgram->SetUniform("fogOn", m_fogOn);
-
-	// world light
-	pSpotlightProgram->SetUniform("light1.position", viewMatrix * lightPosition1); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("light1.La", glm::vec3(0.1f));
-	pSpotlightProgram->SetUniform("light1.Ld", glm::vec3(0.1f));
-	pSpotlightProgram->SetUniform("light1.Ls", glm::vec3(0.1f));
-	pSpotlightProgram->SetUniform("material1.shininess", 15.0f);
-	pSpotlightProgram->SetUniform("material1.Ma", glm::vec3(1.0f));	// Ambient material reflectance
-	pSpotlightProgram->SetUniform("material1.Md", glm::vec3(0.0f));	// Diffuse material reflectance
-	pSpotlightProgram->SetUniform("material1.Ms", glm::vec3(0.0f));	// Specular material reflectance
+	// Pick the specialised spotlight shader variants for this frame, rather than switching paths with uniforms.  While a 
+	// variant is still compiling this returns the uber program, which reads the feature uniforms instead.
+	unsigned int uiFog = m_fogOn ? SHADER_FOG_ON : 0;
+	unsigned int uiSkyboxFeatures = SHADER_RENDER_SKYBOX | uiFog;
+	unsigned int uiTrackFeatures = SHADER_RENDER_TRACK | (m_showPath ? SHADER_SHOW_TRACK : 0) | uiFog;
+	CShaderProgram* pSkyboxProgram = m_pSpotlightShaders->GetProgram(uiSkyboxFeatures);
+	CShaderProgram* pSpotlightProgram = m_pSpotlightShaders->GetProgram(uiFog);
+	CShaderProgram* pTrackProgram = m_pSpotlightShaders->GetProgram(uiTrackFeatures);
 
 	//render skybox
-	pSpotlightProgram->SetUniform("CubeMapTex", cubeMapTextureUnit);
+	m_pGpuProfiler->BeginScope("Skybox");
+	pSkyboxProgram->UseProgram();
+	SetShaderFeatureUniforms(pSkyboxProgram, uiSkyboxFeatures);
+	pSkyboxProgram->SetUniform("matrices.projMatrix", m_pCamera->GetPerspectiveProjectionMatrix());
+	pSkyboxProgram->SetUniform("CubeMapTex", cubeMapTextureUnit);
 	modelViewMatrixStack.Push();
-		pSpotlightProgram->SetUniform("renderSkybox", true);
 		// Translate the modelview matrix to the camera eye point so skybox stays centred around camera
 		glm::vec3 vEye = m_pCamera->GetPosition();
 		modelViewMatrixStack.Translate(vEye);
-		pSpotlightProgram->SetUniform("matrices.modelViewMatrix", modelViewMatrixStack.Top());
-		pSpotlightProgram->SetUniform("matrices.normalMatrix", m_pCamera->ComputeNormalMatrix(modelViewMatrixStack.Top()));
+		pSkyboxProgram->SetUniform("matrices.modelViewMatrix", modelViewMatrixStack.Top());
+		pSkyboxProgram->SetUniform("matrices.normalMatrix", m_pCamera->ComputeNormalMatrix(modelViewMatrixStack.Top()));
+		// The sky's depth is exactly the cleared depth, so it needs GL_LEQUAL to pass
+		glDepthFunc(GL_LEQUAL);
 		m_pSkybox->Render(cubeMapTextureUnit);
-		pSpotlightProgram->SetUniform("renderSkybox", false);
+		glDepthFunc(GL_LESS);
 	modelViewMatrixStack.Pop();
+	m_pGpuProfiler->EndScope();
 
-	//change mat for objects
-	pSpotlightProgram->SetUniform("material1.Ma", glm::vec3(0.5f));
-	pSpotlightProgram->SetUniform("material1.Md", glm::vec3(0.5f));
-	pSpotlightProgram->SetUniform("material1.Ms", glm::vec3(1.0f));
-
-	// Render the planar terrain
-	modelViewMatrixStack.Push();
-		pSpotlightProgram->SetUniform("matrices.modelViewMatrix", modelViewMatrixStack.Top());
-		pSpotlightProgram->SetUniform("matrices.normalMatrix", m_pCamera->ComputeNormalMatrix(modelViewMatrixStack.Top()));
-		m_pPlanarTerrain->Render();
-	modelViewMatrixStack.Pop();
-	
 	//toggle headlight
 	if (m_headlightOn) {
 		headlightColour = glm::vec3(1.f);
@@ -352,117 +739,114 @@ void Game::Render()
 		headlightColour = glm::vec3(0.f);
 	}
 
-	glm::vec4 starshipFrontLightPosition(m_starshipFrontLightPosition, 1);
-	pSpotlightProgram->SetUniform("spotlight[0].position", viewMatrix * starshipFrontLightPosition); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[0].Ld", glm::vec3(headlightColour));			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[0].Ls", glm::vec3(headlightColour));			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[0].direction", glm::normalize(viewNormalMatrix * m_starship_B * glm::vec3(0, 0, -1)));
-	pSpotlightProgram->SetUniform("spotlight[0].exponent", 40.f); // the blend between outer circle and environment
-	pSpotlightProgram->SetUniform("spotlight[0].cutoff", 15.f); // size of circle
+	// Static city meshes have the city lights baked in if the light baker has been run, so they use the variant that only adds the dynamic lights
+	unsigned int uiStaticFeatures = uiFog;
+	CShaderProgram* pStaticProgram = pSpotlightProgram;
+	if (m_bakedLightingAvailable && m_bakedLightingOn) {
+		uiStaticFeatures = SHADER_BAKED_LIGHTING | uiFog;
+		pStaticProgram = m_pSpotlightShaders->GetProgram(uiStaticFeatures);
+	}
 
-	glm::vec4 pointlightPosition(m_starshipBackLightPosition, 1);
-	//glm::vec4 pointlightPosition(m_pCamera->GetPosition() , 1);
-	pSpotlightProgram->SetUniform("pointlight.position", viewMatrix* pointlightPosition); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("pointlight.Ld", glm::vec3(1.f, 0.f, 0.f));			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("pointlight.Ls", glm::vec3(1.f, 0.f, 0.f));			// Specular colour of light
+	// Place everything and work out what the camera can see, once for all the passes below
+	UpdateSceneObjects(viewMatrix);
 
-	//render city lights
-	RenderLights(pSpotlightProgram, viewMatrix, viewNormalMatrix);
+	// Both opaque passes draw the convoys from the same instance buffer, unless they are GPU-driven
+	bool bGpuDriven = IsGpuDrivenOn();
+	if (m_instancingOn && !bGpuDriven)
+		BatchEnvConvoys();
 
-	// Render the horse 
-	modelViewMatrixStack.Push();
-		modelViewMatrixStack.Translate(glm::vec3(287.0f, 52.0f, -926.0f));
-		modelViewMatrixStack.Rotate(glm::vec3(0.0f, 1.0f, 0.0f), glm::radians(180.0f));
-		modelViewMatrixStack.Scale(1.f);
-		pSpotlightProgram->SetUniform("matrices.modelViewMatrix", modelViewMatrixStack.Top());
-		pSpotlightProgram->SetUniform("matrices.normalMatrix", m_pCamera->ComputeNormalMatrix(modelViewMatrixStack.Top()));
-		m_pHorseMesh->Render();
-	modelViewMatrixStack.Pop();	
-	
-	// Render the fighter 
-	modelViewMatrixStack.Push();
-		modelViewMatrixStack.Translate(m_spaceShipPosition + glm::vec3(700.f, 200.0f, -381.0f));
-		modelViewMatrixStack *= m_spaceShipOrientation;
-		modelViewMatrixStack.Rotate(glm::vec3(0.0f, 1.0f, 0.0f), 0.0f);
-		modelViewMatrixStack.Scale(1.f);
-		pSpotlightProgram->SetUniform("matrices.modelViewMatrix", modelViewMatrixStack.Top());
-		pSpotlightProgram->SetUniform("matrices.normalMatrix", m_pCamera->ComputeNormalMatrix(modelViewMatrixStack.Top()));
-		m_pFighterMesh->Render();
-	modelViewMatrixStack.Pop();
+	// Queue the visible draws, sorted so draws sharing a program, state and material run together
+	BuildRenderQueue(viewMatrix);
 
-	// Render the Starship 
-	modelViewMatrixStack.Push();
-		modelViewMatrixStack.Translate(m_starshipPosition);
-		modelViewMatrixStack *= m_starshipOrientation;
-		modelViewMatrixStack.Rotate(glm::vec3(0.0f, 1.0f, 0.0f), 0.0f);
-		modelViewMatrixStack.Scale(1.f);
-		pSpotlightProgram->SetUniform("matrices.modelViewMatrix", modelViewMatrixStack.Top());
-		pSpotlightProgram->SetUniform("matrices.normalMatrix", m_pCamera->ComputeNormalMatrix(modelViewMatrixStack.Top()));
-		m_pStarship->Render();
-	modelViewMatrixStack.Pop();
+	// The GPU-driven draws are culled on the GPU, once for both passes
+	if (bGpuDriven) {
+		m_pGpuProfiler->BeginScope("GPU culling");
+		m_pGpuScene->UpdateObjects(m_objectModelMatrices, *m_pCullBounds, m_objectVisible);
+		m_pGpuScene->Cull(m_pFrustum->GetPlanes());
+		m_pGpuProfiler->EndScope();
+	}
 
-	//render environment vehicles
-	RenderEnvCars(pSpotlightProgram, modelViewMatrixStack, m_EnvStarshipPosition, m_EnvStarshipOrientation);
-	RenderEnvCars(pSpotlightProgram, modelViewMatrixStack, m_EnvStarshipPosition2, m_EnvStarshipOrientation2);
-	RenderEnvCars(pSpotlightProgram, modelViewMatrixStack, m_EnvStarshipPosition3, m_EnvStarshipOrientation3);
-	RenderEnvCars(pSpotlightProgram, modelViewMatrixStack, m_EnvStarshipPosition4, m_EnvStarshipOrientation4);
-	RenderEnvCars(pSpotlightProgram, modelViewMatrixStack, m_EnvStarshipPosition5, m_EnvStarshipOrientation5);
-	RenderEnvCars(pSpotlightProgram, modelViewMatrixStack, m_EnvStarshipPosition6, m_EnvStarshipOrientation6);
-
-	if (!m_cubePickedUp) {
-		// Render the cube 
-		modelViewMatrixStack.Push();
-			modelViewMatrixStack.Translate(m_cubePosition);
-			modelViewMatrixStack.Rotate(glm::vec3(0.0f, 1.0f, 0.0f), glm::radians(m_pickupRotation));
-			modelViewMatrixStack.Scale(2.f);
-			pSpotlightProgram->SetUniform("matrices.modelViewMatrix", modelViewMatrixStack.Top());
-			pSpotlightProgram->SetUniform("matrices.normalMatrix", m_pCamera->ComputeNormalMatrix(modelViewMatrixStack.Top()));
-			m_pCube->Render();
-		modelViewMatrixStack.Pop();
-	}
-
-	if (!m_tetraPickedUp) {
-		// Render the tetrahedron 
-		modelViewMatrixStack.Push();
-			modelViewMatrixStack.Translate(m_tetraPosition);
-			modelViewMatrixStack.Rotate(glm::vec3(0.0f, 1.0f, 0.0f), glm::radians(m_pickupRotation));
-			modelViewMatrixStack.Scale(2.f);
-			pSpotlightProgram->SetUniform("matrices.modelViewMatrix", modelViewMatrixStack.Top());
-			pSpotlightProgram->SetUniform("matrices.normalMatrix", m_pCamera->ComputeNormalMatrix(modelViewMatrixStack.Top()));
-			m_pTetrahedron->Render();
-		modelViewMatrixStack.Pop();
-	}
-
-	// Render the Downtown 
-	modelViewMatrixStack.Push();
-		modelViewMatrixStack.Translate(glm::vec3(120.f, 0.f, 290.0f));
-		modelViewMatrixStack.Rotate(glm::vec3(0.0f, 1.0f, 0.0f), glm::radians(10.f));
-		modelViewMatrixStack.Scale(1.7f, 3.5f, 1.7f);
-		pSpotlightProgram->SetUniform("matrices.modelViewMatrix", modelViewMatrixStack.Top());
-		pSpotlightProgram->SetUniform("matrices.normalMatrix", m_pCamera->ComputeNormalMatrix(modelViewMatrixStack.Top()));
-		m_pDowntown->Render();
-	modelViewMatrixStack.Pop();
+	// Optional depth pre-pass: lay down the depth of the opaque geometry with a trivial shader, so the lit pass below only 
+	// shades the visible fragment of each pixel
+	int iPixels = iSceneWidth * iSceneHeight;
+	bool bDepthPrepass = m_pDepthPrepass->IsEnabled();
+	if (bDepthPrepass) {
+		CShaderProgram* pDepthProgram = (*m_pShaderPrograms)[2];
+		CShaderProgram* pIndirectDepthProgram = bGpuDriven ? m_pIndirectDepthProgram : pDepthProgram;
+		CShaderProgram* depthPrograms[RENDER_PROGRAM_COUNT] = { pDepthProgram, pDepthProgram, pDepthProgram, pIndirectDepthProgram, 
+			pIndirectDepthProgram };
+		unsigned int depthFeatures[RENDER_PROGRAM_COUNT] = { 0, 0, 0, 0, 0 };
+		if (bGpuDriven) {
+			pIndirectDepthProgram->UseProgram();
+			pIndirectDepthProgram->SetUniform("matrices.projMatrix", m_pCamera->GetPerspectiveProjectionMatrix());
+		}
+		pDepthProgram->UseProgram();
+		pDepthProgram->SetUniform("matrices.projMatrix", m_pCamera->GetPerspectiveProjectionMatrix());
+		glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+		m_pGpuProfiler->BeginScope("Depth pre-pass");
+		m_pDepthPrepass->BeginMeasure();
+		ExecuteRenderQueue(RENDER_PASS_OPAQUE, depthPrograms, depthFeatures, !m_pDepthPrepass->IsMeasuring(), viewMatrix);
+		m_pDepthPrepass->EndMeasure(iPixels);
+		m_pGpuProfiler->EndScope();
+		glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+		// Only the nearest surface matches the stored depth, and it is already written
+		glDepthFunc(GL_EQUAL);
+		glDepthMask(GL_FALSE);
+	}
 
-	glDisable(GL_CULL_FACE);
-	// Render the City 
-	modelViewMatrixStack.Push();
-		modelViewMatrixStack.Translate(glm::vec3(0.0f, 0.0f, 0.0f));
-		modelViewMatrixStack.Rotate(glm::vec3(0.0f, 1.0f, 0.0f), 0.0f);
-		modelViewMatrixStack.Scale(1.f);
-		pSpotlightProgram->SetUniform("matrices.modelViewMatrix", modelViewMatrixStack.Top());
-		pSpotlightProgram->SetUniform("matrices.normalMatrix", m_pCamera->ComputeNormalMatrix(modelViewMatrixStack.Top()));
-		m_pCity->Render();
-	modelViewMatrixStack.Pop();
+	// The static city meshes may use a different program, such as the baked lighting variant, and the track has its own.
+	// The GPU-driven draws use the same variants of their own programs.
+	CShaderProgram* pIndirectProgram = pSpotlightProgram;
+	CShaderProgram* pIndirectStaticProgram = pStaticProgram;
+	if (bGpuDriven) {
+		pIndirectProgram = m_pIndirectShaders->GetProgram(uiFog);
+		pIndirectStaticProgram = m_pIndirectShaders->GetProgram(uiStaticFeatures);
+		if (pIndirectStaticProgram != pIndirectProgram) {
+			pIndirectStaticProgram->UseProgram();
+			SetSpotlightUniforms(pIndirectStaticProgram, viewMatrix, viewNormalMatrix, false);
+		}
+		pIndirectProgram->UseProgram();
+		SetSpotlightUniforms(pIndirectProgram, viewMatrix, viewNormalMatrix);
+	}
+	CShaderProgram* litPrograms[RENDER_PROGRAM_COUNT] = { pSpotlightProgram, pStaticProgram, pTrackProgram, pIndirectProgram, pIndirectStaticProgram };
+	unsigned int litFeatures[RENDER_PROGRAM_COUNT] = { uiFog, uiStaticFeatures, uiTrackFeatures, uiFog, uiStaticFeatures };
+	if (pStaticProgram != pSpotlightProgram) {
+		pStaticProgram->UseProgram();
+		SetSpotlightUniforms(pStaticProgram, viewMatrix, viewNormalMatrix, false);
+	}
+	pTrackProgram->UseProgram();
+	SetSpotlightUniforms(pTrackProgram, viewMatrix, viewNormalMatrix);
 
-	// Render the Center City 
-	modelViewMatrixStack.Push();
-		modelViewMatrixStack.Translate(glm::vec3(1050.0f, -54.f, -450.0f));
-		modelViewMatrixStack.Rotate(glm::vec3(0.0f, 1.0f, 0.0f), glm::radians(60.f));
-		modelViewMatrixStack.Scale(1.2f, 2.5f, 1.2f);
-		pSpotlightProgram->SetUniform("matrices.modelViewMatrix", modelViewMatrixStack.Top());
-		pSpotlightProgram->SetUniform("matrices.normalMatrix", m_pCamera->ComputeNormalMatrix(modelViewMatrixStack.Top()));
-		m_pCenterCity->Render();
-	modelViewMatrixStack.Pop();
+	// Switch to the spotlight program for lit objects
+	pSpotlightProgram->UseProgram();
+	SetSpotlightUniforms(pSpotlightProgram, viewMatrix, viewNormalMatrix);
+
+	// Without a pre-pass, overdraw is measured on the lit pass instead, so automatic mode can decide to turn it on
+	m_pGpuProfiler->BeginScope("Opaque");
+	if (!bDepthPrepass)
+		m_pDepthPrepass->BeginMeasure();
+	// The occlusion queries go in whichever pass writes depth, unless the overdraw count is using the query hardware
+	ExecuteRenderQueue(RENDER_PASS_OPAQUE, litPrograms, litFeatures, !bDepthPrepass && !m_pDepthPrepass->IsMeasuring(), viewMatrix);
+	if (!bDepthPrepass)
+		m_pDepthPrepass->EndMeasure(iPixels);
+	m_pGpuProfiler->EndScope();
+	if (bDepthPrepass) {
+		glDepthFunc(GL_LESS);
+		glDepthMask(GL_TRUE);
+	}
+
+	// The next frame's GPU culling tests against this frame's opaque depth
+	if (bGpuDriven) {
+		m_pGpuProfiler->BeginScope("Depth pyramid");
+		m_pGpuScene->UpdateDepthPyramid(iSceneWidth, iSceneHeight, *m_pCamera->GetPerspectiveProjectionMatrix() * viewMatrix);
+		m_pGpuProfiler->EndScope();
+	}
+
+	// Then the blended geometry, back to front
+	m_pGpuProfiler->BeginScope("Transparent");
+	ExecuteRenderQueue(RENDER_PASS_TRANSPARENT, litPrograms, litFeatures, false, viewMatrix);
+	m_pGpuProfiler->EndScope();
 
 	// Render Catmull Spline Route
 	//modelViewMatrixStack.Push();
@@ -478,59 +862,86 @@ void Game::Render()
 	//m_pCatmullRom->RenderOffsetCurves();
 	//modelViewMatrixStack.Pop();
 
-	// Render Catmull Spline Route Track
-	modelViewMatrixStack.Push();
-		pSpotlightProgram->SetUniform("renderTrack", true);
-		pSpotlightProgram->SetUniform("showTrack", m_showPath);
-		pSpotlightProgram->SetUniform("discardTime", m_pathDiscardTime);
-		pSpotlightProgram->SetUniform("light1.La", glm::vec3(1.f));
-		pSpotlightProgram->SetUniform("material1.Ma", glm::vec3(1.0f));	// Ambient material reflectance
-		pSpotlightProgram->SetUniform("matrices.modelViewMatrix", modelViewMatrixStack.Top());
-		pSpotlightProgram->SetUniform("matrices.normalMatrix", m_pCamera->ComputeNormalMatrix(modelViewMatrixStack.Top()));
-		m_pCatmullRom->RenderTrack();
-		pSpotlightProgram->SetUniform("renderTrack", false);
-	modelViewMatrixStack.Pop();
-
+	m_pGpuProfiler->BeginScope("Upscale");
+	if (m_upscalingOn) {
+		glm::mat4 viewProjection = *m_pCamera->GetUnjitteredProjectionMatrix() * viewMatrix;
+		m_pUpscaler->Resolve(m_pSceneTarget, iWindowWidth, iWindowHeight, viewProjection, m_previousViewProjection);
+		m_previousViewProjection = viewProjection;
+	}
+	else if (bScaled)
+		m_pSceneTarget->BlitToScreen(iWindowWidth, iWindowHeight);
+	m_pGpuProfiler->EndScope();
 		
 	// Draw the 2D graphics after the 3D graphics
 	if (m_showHUD) {
+		m_pGpuProfiler->BeginScope("HUD");
 		DisplayFrameRate();
+		m_pGpuProfiler->EndScope();
 	}
 
+	// The frame's CPU time stops here, since the swap can block on the GPU
+	m_cpuFrameTime = m_pHighResolutionTimer->Elapsed();
+	if (m_lowLatencyOn)
+		m_cpuFrameTime -= m_pLatencyLimiter->GetWaitTime();
+	m_pGpuProfiler->EndFrame();
+
 	// Swap buffers to show the rendered image
-	SwapBuffers(m_gameWindow.Hdc());		
+	{
+		CPU_TRACE_SCOPE("SwapBuffers");
+		SwapBuffers(m_gameWindow.Hdc());
+	}
 
 }
 
 // Update method runs repeatedly with the Render method
 void Game::Update()
 {
-	// Update the camera using the amount of time that has elapsed to avoid framerate dependent motion
-	m_pCamera->Update(m_dt);
+	CPU_TRACE_SCOPE("Game::Update");
 
-	//Update environment ships
-	HandleEnvShips();
+	// The update runs as a small graph of jobs.  The player's movement follows the camera, and the pickups follow the 
+	// movement; the environment ships do not depend on the player, so they run alongside.
+	m_pJobSystem->Reset();
+
+	// Update the camera using the amount of time that has elapsed to avoid framerate dependent motion
+	CJobSystem::Job* pCamera = m_pJobSystem->CreateJob([this] {
+		CPU_TRACE_SCOPE("CCamera::Update");
+		m_pSimCamera->Update(m_dt);
+	});
 
 	//Update movement
-	HandleMovement();
+	CJobSystem::Job* pMovement = m_pJobSystem->CreateJob([this] { HandleMovement(); });
+	m_pJobSystem->AddDependency(pMovement, pCamera);
 
-	//Update pickups
-	HandlePickups();
+	//Update pickups, and the timer for the HUD they take time off
+	CJobSystem::Job* pPickups = m_pJobSystem->CreateJob([this] {
+		HandlePickups();
+		m_hudTime += (float)m_dt / 1000;
+	});
+	m_pJobSystem->AddDependency(pPickups, pMovement);
 
-	m_pAudio->Update();
+	//Update environment ships
+	CJobSystem::Job* pEnvShips = m_pJobSystem->CreateJob([this] { HandleEnvShips(); });
 
-	//Update Timer for HUD
-	m_hudTime += (float)m_dt / 1000;
+	m_pJobSystem->Submit(pCamera);
+	m_pJobSystem->Submit(pMovement);
+	m_pJobSystem->Submit(pPickups);
+	m_pJobSystem->Submit(pEnvShips);
 
 	//Toggle path
-	if (!m_showPath) {	
+	if (m_simInput.bResetPath)
+		m_pathDiscardTime = 0;
+	if (!m_simInput.bShowPath) {	
 		if (m_pathDiscardTime < 2.f) {
 			m_pathDiscardTime += 0.00035f * (float)m_dt;
 		}
 	}
+
+	m_pJobSystem->Wait(pPickups);
+	m_pJobSystem->Wait(pEnvShips);
 }
 
 void Game::HandlePickups() {
+	CPU_TRACE_SCOPE("Game::HandlePickups");
 
 	//pickup rotation
 	m_pickupRotation += 0.1f * (float)m_dt;
@@ -550,77 +961,30 @@ void Game::HandlePickups() {
 }
 
 void Game::HandleEnvShips() {
+	CPU_TRACE_SCOPE("Game::HandleEnvShips");
 	m_EnvCurrentDistance += 0.05f * m_dt;
 
-	glm::vec3 p;
-	glm::vec3 p_y;
-	m_pCatmullRom->Env_Sample(m_EnvCurrentDistance, p, p_y);
-
-	glm::vec3 pNext;
-	m_pCatmullRom->Env_Sample(m_EnvCurrentDistance + 1.0f, pNext);
-
-	glm::vec3 cam_T = glm::normalize(pNext - p); //(z axis)
-	glm::vec3 cam_N = glm::normalize(glm::cross(cam_T, p_y)); //(x axis)
-	glm::vec3 cam_B = glm::normalize(glm::cross(cam_N, cam_T)); //(y axis)
-
-	m_EnvStarshipPosition = p;
-	m_EnvStarshipOrientation = glm::mat4(glm::mat3(cam_T, cam_B, cam_N));
-
-	//2
-	m_pCatmullRom->Env_Sample(m_EnvCurrentDistance + 800, p, p_y);
-	m_pCatmullRom->Env_Sample(m_EnvCurrentDistance + 801.0f, pNext);
-
-	cam_T = glm::normalize(pNext - p); //(z axis)
-	cam_N = glm::normalize(glm::cross(cam_T, p_y)); //(x axis)
-	cam_B = glm::normalize(glm::cross(cam_N, cam_T)); //(y axis)
-
-	m_EnvStarshipPosition2 = p;
-	m_EnvStarshipOrientation2 = glm::mat4(glm::mat3(cam_T, cam_B, cam_N));
-
-
-	//3
-	m_pCatmullRom->Env_Sample(m_EnvCurrentDistance + 1800, p, p_y);
-	m_pCatmullRom->Env_Sample(m_EnvCurrentDistance + 1801.0f, pNext);
-
-	cam_T = glm::normalize(pNext - p); //(z axis)
-	cam_N = glm::normalize(glm::cross(cam_T, p_y)); //(x axis)
-	cam_B = glm::normalize(glm::cross(cam_N, cam_T)); //(y axis)
-
-	m_EnvStarshipPosition3 = p;
-	m_EnvStarshipOrientation3 = glm::mat4(glm::mat3(cam_T, cam_B, cam_N));
-
-	//4
-	m_pCatmullRom->Env_Sample(m_EnvCurrentDistance + 3000, p, p_y);
-	m_pCatmullRom->Env_Sample(m_EnvCurrentDistance + 3001.0f, pNext);
-
-	cam_T = glm::normalize(pNext - p); //(z axis)
-	cam_N = glm::normalize(glm::cross(cam_T, p_y)); //(x axis)
-	cam_B = glm::normalize(glm::cross(cam_N, cam_T)); //(y axis)
-
-	m_EnvStarshipPosition4 = p;
-	m_EnvStarshipOrientation4 = glm::mat4(glm::mat3(cam_T, cam_B, cam_N));
-
-	//5
-	m_pCatmullRom->Env_Sample(m_EnvCurrentDistance + 4800, p, p_y);
-	m_pCatmullRom->Env_Sample(m_EnvCurrentDistance + 4801.0f, pNext);
-
-	cam_T = glm::normalize(pNext - p); //(z axis)
-	cam_N = glm::normalize(glm::cross(cam_T, p_y)); //(x axis)
-	cam_B = glm::normalize(glm::cross(cam_N, cam_T)); //(y axis)
-
-	m_EnvStarshipPosition5 = p;
-	m_EnvStarshipOrientation5 = glm::mat4(glm::mat3(cam_T, cam_B, cam_N));
-
-	//6
-	m_pCatmullRom->Env_Sample(m_EnvCurrentDistance + 5200, p, p_y);
-	m_pCatmullRom->Env_Sample(m_EnvCurrentDistance + 5201.0f, pNext);
-
-	cam_T = glm::normalize(pNext - p); //(z axis)
-	cam_N = glm::normalize(glm::cross(cam_T, p_y)); //(x axis)
-	cam_B = glm::normalize(glm::cross(cam_N, cam_T)); //(y axis)
-
-	m_EnvStarshipPosition6 = p;
-	m_EnvStarshipOrientation6 = glm::mat4(glm::mat3(cam_T, cam_B, cam_N));
+	// Each convoy is placed on its own.  The samples' up vectors are passed in even where unused, since the default is
+	// shared between threads.
+	m_pJobSystem->ParallelFor(ENV_CONVOY_COUNT, ENV_CONVOYS_PER_JOB, [this](int iBegin, int iEnd) {
+		CPU_TRACE_SCOPE("Place convoys");
+		for (int i = iBegin; i < iEnd; i++) {
+			glm::vec3 p;
+			glm::vec3 p_y;
+			m_pCatmullRom->Env_Sample(m_EnvCurrentDistance + envConvoyDistances[i], p, p_y);
+
+			glm::vec3 pNext;
+			glm::vec3 pNext_y;
+			m_pCatmullRom->Env_Sample(m_EnvCurrentDistance + envConvoyDistances[i] + 1.0f, pNext, pNext_y);
+
+			glm::vec3 cam_T = glm::normalize(pNext - p); //(z axis)
+			glm::vec3 cam_N = glm::normalize(glm::cross(cam_T, p_y)); //(x axis)
+			glm::vec3 cam_B = glm::normalize(glm::cross(cam_N, cam_T)); //(y axis)
+
+			m_EnvStarshipPositions[i] = p;
+			m_EnvStarshipOrientations[i] = glm::mat4(glm::mat3(cam_T, cam_B, cam_N));
+		}
+	});
 
 	//Circling fighter
 	m_t += 0.001f * (float)m_dt;
@@ -638,9 +1002,12 @@ void Game::HandleEnvShips() {
 }
 
 void Game::HandleMovement() {
+	CPU_TRACE_SCOPE("Game::HandleMovement");
 
 	//Vehicle Drag
-	if (m_cameraSpeed > 0.f) {
+	if (m_benchmarkLaps > 0)
+		m_cameraSpeed = m_topSpeed;
+	else if (m_cameraSpeed > 0.f) {
 		m_cameraSpeed -= 0.00004 * m_dt;
 
 		if (m_cameraSpeed < 0.f) {
@@ -658,29 +1025,15 @@ void Game::HandleMovement() {
 	//calculate track 
 	m_currentDistance += m_cameraSpeed * m_dt;
 
-	glm::vec3 p;
-	glm::vec3 p_y;
-	m_pCatmullRom->Sample(m_currentDistance, p, p_y);
-
-	glm::vec3 pNext;
-	m_pCatmullRom->Sample(m_currentDistance + 1.0f, pNext);
-
-	glm::vec3 cam_T = glm::normalize(pNext - p); //(z axis)
-	glm::vec3 cam_N = glm::normalize(glm::cross(cam_T, p_y)); //(x axis)
-	glm::vec3 cam_B = glm::normalize(glm::cross(cam_N, cam_T)); //(y axis)
+	glm::vec3 p, p_y, cam_T, cam_N, cam_B;
+	GetTrackFrame(m_currentDistance, p, p_y, cam_T, cam_N, cam_B);
 
 	m_starship_B = cam_B;
 
-	if (!m_freeview) {
-		if (m_cameraMode == 1) {
-			m_pCamera->Set(p + (5.f * cam_B) + (4.f * cam_T) + (m_starshipStrafe * cam_N), p + (500.0f * cam_T), p_y);
-		}
-		else if (m_cameraMode == 2) {
-			m_pCamera->Set(p + (5.f * cam_B) + (1.5f * cam_T) + (m_starshipStrafe * cam_N), p + (500.0f * cam_T), p_y);
-		}
-		else if (m_cameraMode == 3) {
-			m_pCamera->Set(p + (13.f * cam_B) + (-30.f * cam_T) + ((m_starshipStrafe * 0.7f) * cam_N), p + (200.0f * cam_T), p_y);
-		}
+	if (!m_simInput.bFreeview) {
+		glm::vec3 eye, view;
+		GetTrackCamera(m_simInput.iCameraMode, m_starshipStrafe, p, cam_T, cam_N, cam_B, eye, view);
+		m_pSimCamera->Set(eye, view, p_y);
 	}
 
 	m_starshipFrontLightPosition = p + (2.9f * cam_B) + (m_starshipStrafe * cam_N) + (2.f * cam_T);
@@ -688,15 +1041,19 @@ void Game::HandleMovement() {
 	m_starshipPosition = p + (2.9f * cam_B) + (m_starshipStrafe * cam_N);
 	m_starshipOrientation = glm::mat4(glm::mat3(cam_T, cam_B, cam_N));
 
-	//Movement
-	if(GetKeyState('W') & 0x80) {
+	// The benchmark holds its speed and line, whatever the keys
+	if (m_benchmarkLaps > 0)
+		return;
+
+	//Movement.  This runs on the simulation thread, which has no keyboard state of its own, so the keys are read directly.
+	if(GetAsyncKeyState('W') & 0x8000) {
 
 		m_cameraSpeed += 0.0001f * m_dt;
 		if (m_cameraSpeed > m_topSpeed) {
 			m_cameraSpeed = m_topSpeed;
 		}
 	}
-	else if (GetKeyState('S') & 0x80) {
+	else if (GetAsyncKeyState('S') & 0x8000) {
 
 		m_cameraSpeed -= 0.0001f * m_dt;
 		if (m_cameraSpeed < -m_topSpeed) {
@@ -704,7 +1061,7 @@ void Game::HandleMovement() {
 		}
 	}
 
-	if(GetKeyState('D') & 0x80) {
+	if(GetAsyncKeyState('D') & 0x8000) {
 
 		m_starshipStrafe += 0.1f * m_dt;
 
@@ -712,7 +1069,7 @@ void Game::HandleMovement() {
 			m_starshipStrafe = m_routeWidth * 0.4;
 		}
 	}
-	else if (GetKeyState('A') & 0x80) {
+	else if (GetAsyncKeyState('A') & 0x8000) {
 
 		m_starshipStrafe -= 0.1f * m_dt;
 
@@ -724,14 +1081,16 @@ void Game::HandleMovement() {
 
 void Game::DisplayFrameRate()
 {
+	CPU_TRACE_SCOPE("Game::DisplayFrameRate");
+
 	CShaderProgram *fontProgram = (*m_pShaderPrograms)[1];
 
-	RECT dimensions = m_gameWindow.GetDimensions();
+	RECT dimensions = GetOutputDimensions();
 	int height = dimensions.bottom - dimensions.top;
 	int width = dimensions.right - dimensions.left;
 
 	// Increase the elapsed time and frame counter
-	m_elapsedTime += m_dt;
+	m_elapsedTime += m_frameTime;
 	m_frameCount++;
 
 	// Now we want to subtract the current time by the last time that was stored
@@ -753,36 +1112,59 @@ void Game::DisplayFrameRate()
 		fontProgram->SetUniform("matrices.projMatrix", m_pCamera->GetOrthographicProjectionMatrix());
 		fontProgram->SetUniform("vColour", glm::vec4(1.0f, 1.0f, 1.0f, 1.0f));
 		if (m_showDebug) {
-			m_pFtFont->Render(20, height - 20, 20, "FPS: %d", m_framesPerSecond);
-			m_pFtFont->Render(20, height - 40, 20, "X: %f", m_pCamera->GetPosition().x);
-			m_pFtFont->Render(20, height - 60, 20, "Y: %f", m_pCamera->GetPosition().y);
-			m_pFtFont->Render(20, height - 80, 20, "Z: %f", m_pCamera->GetPosition().z);
+			for (int i = 0; i < (int)m_hudLines.size(); i++)
+				m_pFtFont->Render(20, height - 20 * (i + 1), 20, "%s", m_hudLines[i].c_str());
 		}
-		m_pFtFont->Render(100, height * 0.1f, 20, "KM/H: %.0f", abs(m_cameraSpeed * 800));
-		m_pFtFont->Render(width * 0.47f, height * 0.95f, 20, "Time: %.0fs", m_hudTime);
-		m_pFtFont->Render(width * 0.48f, height * 0.9f, 20, "Lap: %d", m_pCatmullRom->CurrentLap(m_currentDistance));
+		m_pFtFont->Render(100, height * 0.1f, 20, "KM/H: %.0f", abs(m_frame.cameraSpeed * 800));
+		m_pFtFont->Render(width * 0.47f, height * 0.95f, 20, "Time: %.0fs", m_frame.hudTime);
+		m_pFtFont->Render(width * 0.48f, height * 0.9f, 20, "Lap: %d", m_pCatmullRom->CurrentLap(m_frame.currentDistance));
+
+		// The recent frame times, in the bottom right corner
+		if (m_showDebug)
+			m_pFrameTimeGraph->Render(m_pFrameStats, width - FRAME_GRAPH_WIDTH - 20.0f, 20.0f, FRAME_GRAPH_WIDTH, FRAME_GRAPH_HEIGHT, 
+				GetFrameBudget(), m_pCamera->GetOrthographicProjectionMatrix());
 	}
 }
 
 // The game loop runs repeatedly until game over
 void Game::GameLoop()
 {
-	/*
-	// Fixed timer
-	dDt = pHighResolutionTimer->Elapsed();
-	if (dDt > 1000.0 / (double) Game::FPS) {
-		pHighResolutionTimer->Start();
-		Update();
-		Render();
-	}
-	*/
-	
-	
-	// Variable timer
+	CPU_TRACE_SCOPE("Game::GameLoop");
+
+	// Variable timer for the frame; the simulation runs on its own thread at a fixed tick
 	m_pHighResolutionTimer->Start();
-	Update();
+	{
+		lock_guard<mutex> lock(m_simInputMutex);
+		m_pendingSimInput.bFreeview = m_freeview;
+		m_pendingSimInput.iCameraMode = m_cameraMode;
+		m_pendingSimInput.bShowPath = m_showPath;
+	}
+	m_pAudio->Update();
+
+	// In low-latency mode, wait for the GPU to work through all but the last few frames before taking the newest
+	// snapshot, so the frame is drawn from the latest input the simulation has
+	if (m_lowLatencyOn) {
+		CPU_TRACE_SCOPE("Latency limiter wait");
+		m_pLatencyLimiter->BeginFrame();
+	}
+	UpdateFrameState();
 	Render();
-	m_dt = m_pHighResolutionTimer->Elapsed();
+	m_glCounts = CGLCounters::TakeFrameCounts();
+	if (m_lowLatencyOn)
+		m_pLatencyLimiter->EndFrame();
+	UpdateQualityGovernor();
+
+	// The time from when the simulation read the input this frame shows to the frame being swapped, smoothed
+	double fLatency = chrono::duration<double, milli>(chrono::steady_clock::now() - m_frame.inputTime).count();
+	m_inputLatency = m_inputLatency > 0.0 ? m_inputLatency * 0.95 + fLatency * 0.05 : fLatency;
+
+	// Hold the frame to the target rate, rather than spinning through frames the display cannot show
+	{
+		CPU_TRACE_SCOPE("Frame pacer wait");
+		m_pFramePacer->Wait();
+	}
+	m_frameTime = m_pHighResolutionTimer->Elapsed();
+	m_pFrameStats->AddFrame(m_frameTime);
 	
 
 }
@@ -791,7 +1173,18 @@ void Game::GameLoop()
 WPARAM Game::Execute() 
 {
 	m_pHighResolutionTimer = new CHighResolutionTimer;
-	m_gameWindow.Init(m_hInstance);
+
+	// The job system's micro-benchmarks need no window
+	if (m_jobBench) {
+		CJobBenchmark benchmark;
+		if (!benchmark.Run(JOB_BENCHMARK_FILENAME))
+			MessageBox(NULL, "Could not write the job system benchmarks", "Error", MB_ICONERROR);
+		return 0;
+	}
+
+	// The benchmark needs no one to watch it
+	m_gameWindow.Init(m_hInstance, m_benchmarkLaps == 0);
+	CPU_TRACE_THREAD_NAME("Main");
 
 	if(!m_gameWindow.Hdc()) {
 		return 1;
@@ -799,7 +1192,22 @@ WPARAM Game::Execute()
 
 	Initialise();
 
+	if (m_bakePvs) {
+		BakePvs();
+		m_gameWindow.Deinit();
+		return 0;
+	}
+
+	if (m_benchmarkLaps > 0) {
+		RunBenchmark();
+		m_gameWindow.Deinit();
+		return 0;
+	}
+
 	m_pHighResolutionTimer->Start();
+	m_pFramePacer->SetTargetRate(m_targetFrameRate);
+	m_pFramePacer->Start();
+	StartSimulation();
 
 	
 	MSG msg;
@@ -818,6 +1226,7 @@ WPARAM Game::Execute()
 		else Sleep(200); // Do not consume processor power if application isn't active
 	}
 
+	StopSimulation();
 	m_gameWindow.Deinit();
 
 	return(msg.wParam);
@@ -837,10 +1246,12 @@ LRESULT Game::ProcessEvents(HWND window,UINT message, WPARAM w_param, LPARAM l_p
 			case WA_ACTIVE:
 			case WA_CLICKACTIVE:
 				m_appActive = true;
+				m_simPaused = false;
 				m_pHighResolutionTimer->Start();
 				break;
 			case WA_INACTIVE:
 				m_appActive = false;
+				m_simPaused = true;
 				break;
 		}
 		break;
@@ -870,9 +1281,29 @@ LRESULT Game::ProcessEvents(HWND window,UINT message, WPARAM w_param, LPARAM l_p
 			m_pAudio->PlayEventSound();
 			break;	
 		
+		case VK_F2:
+			m_pGpuProfiler->Export(GPU_PROFILE_FILENAME);
+			break;
+
+#ifdef ENABLE_CPU_TRACE
+		case VK_F3:
+			if (CCpuTrace::IsCapturing())
+				CCpuTrace::StopCapture(CPU_TRACE_FILENAME);
+			else
+				CCpuTrace::StartCapture();
+			break;
+#endif
+
+		case VK_F4:
+			m_pFrameStats->Export(FRAME_STATS_FILENAME);
+			break;
+
 		case VK_F5:
 			m_showPath = !m_showPath;
-			m_pathDiscardTime = 0;
+			{
+				lock_guard<mutex> lock(m_simInputMutex);
+				m_pendingSimInput.bResetPath = true;
+			}
 			break;
 
 		case VK_F6:
@@ -883,6 +1314,29 @@ LRESULT Game::ProcessEvents(HWND window,UINT message, WPARAM w_param, LPARAM l_p
 			m_showDebug = !m_showDebug;
 			break;
 
+		case VK_F8:
+			m_pFramePacer->CycleTargetRate();
+			break;
+
+		case 'L':
+			m_lowLatencyOn = !m_lowLatencyOn;
+			if (!m_lowLatencyOn)
+				m_pLatencyLimiter->Release();
+			break;
+
+		case 'K':
+			m_pLatencyLimiter->CycleMaxQueuedFrames();
+			break;
+
+		case 'G':
+			m_pQualityGovernor->SetEnabled(!m_pQualityGovernor->IsEnabled());
+			break;
+
+		case 'T':
+			m_upscalingOn = !m_upscalingOn;
+			m_pUpscaler->ResetHistory();
+			break;
+
 		case 'V':
 			m_freeview = !m_freeview;
 			break;
@@ -891,6 +1345,46 @@ LRESULT Game::ProcessEvents(HWND window,UINT message, WPARAM w_param, LPARAM l_p
 			m_headlightOn = !m_headlightOn;
 			break;
 
+		case 'B':
+			m_bakedLightingOn = !m_bakedLightingOn;
+			break;
+
+		case 'P':
+			m_pDepthPrepass->CycleMode();
+			break;
+
+		case 'I':
+			m_instancingOn = !m_instancingOn;
+			break;
+
+		case '2':
+			m_cullingOn = !m_cullingOn;
+			break;
+
+		case '3':
+			m_occlusionCullingOn = !m_occlusionCullingOn;
+			break;
+
+		case '4':
+			m_occlusionQueriesOn = !m_occlusionQueriesOn;
+			break;
+
+		case '5':
+			m_pvsOn = !m_pvsOn;
+			break;
+
+		case '6':
+			m_renderSortingOn = !m_renderSortingOn;
+			break;
+
+		case '7':
+			m_gpuDrivenOn = !m_gpuDrivenOn;
+			break;
+
+		case '8':
+			m_parallelRecordingOn = !m_parallelRecordingOn;
+			break;
+
 		case 'H':
 			m_showHUD = !m_showHUD;
 			break;
@@ -928,581 +1422,1101 @@ void Game::SetHinstance(HINSTANCE hinstance)
 	m_hInstance = hinstance;
 }
 
+void Game::SetCommandLine(const char* szCommandLine)
+{
+	m_bakePvs = strstr(szCommandLine, "--bakepvs") != NULL;
+	m_jobBench = strstr(szCommandLine, "--jobbench") != NULL;
+
+	// --benchmark, or --benchmark=N for N laps, times a fixed drive round the track in each camera mode and quits.  It
+	// draws through WGL in a hidden window, so it needs a Windows host with an OpenGL 4 GPU; it cannot run headless.
+	// --benchmark-size=WxH sets the resolution it draws at.
+	for (const char* szBenchmark = strstr(szCommandLine, "--benchmark"); szBenchmark; szBenchmark = strstr(szBenchmark + 1, "--benchmark")) {
+		char cNext = szBenchmark[strlen("--benchmark")];
+		if (cNext == '-')
+			continue;
+		m_benchmarkLaps = BENCHMARK_DEFAULT_LAPS;
+		if (cNext == '=')
+			m_benchmarkLaps = max(1, atoi(szBenchmark + strlen("--benchmark=")));
+	}
+	const char* szBenchmarkSize = strstr(szCommandLine, "--benchmark-size=");
+	if (szBenchmarkSize) {
+		const char* szWidth = szBenchmarkSize + strlen("--benchmark-size=");
+		const char* szHeight = strchr(szWidth, 'x');
+		if (szHeight && atoi(szWidth) > 0 && atoi(szHeight + 1) > 0) {
+			m_benchmarkWidth = atoi(szWidth);
+			m_benchmarkHeight = atoi(szHeight + 1);
+		}
+	}
+
+	// --fps=N sets the frame pacer's target rate, with 0 for no limit
+	const char* szFps = strstr(szCommandLine, "--fps=");
+	if (szFps)
+		m_targetFrameRate = atoi(szFps + strlen("--fps="));
+
+	// --renderscale=F sets the fraction of the window's width and height the scene is drawn at while upscaling
+	const char* szRenderScale = strstr(szCommandLine, "--renderscale=");
+	if (szRenderScale)
+		m_renderScale = glm::clamp((float) atof(szRenderScale + strlen("--renderscale=")), MIN_RENDER_SCALE, 1.0f);
+}
+
 LRESULT CALLBACK WinProc(HWND window, UINT message, WPARAM w_param, LPARAM l_param)
 {
 	return Game::GetInstance().ProcessEvents(window, message, w_param, l_param);
 }
 
-int WINAPI WinMain(HINSTANCE hinstance, HINSTANCE, PSTR, int) 
+int WINAPI WinMain(HINSTANCE hinstance, HINSTANCE, PSTR lpszCmdLine, int) 
 {
 	Game &game = Game::GetInstance();
 	game.SetHinstance(hinstance);
+	game.SetCommandLine(lpszCmdLine);
 
 	return game.Execute();
 }
 
+// Sets the runtime switches of the uber spotlight programs.  Specialised variants have the switches compiled in, so they
+// are skipped rather than sent uniforms they do not have.
+void Game::SetShaderFeatureUniforms(CShaderProgram* pSpotlightProgram, unsigned int uiFeatures) {
+	if (!m_pSpotlightShaders->IsUberProgram(pSpotlightProgram) && !m_pIndirectShaders->IsUberProgram(pSpotlightProgram))
+		return;
+
+	pSpotlightProgram->SetUniform("renderSkybox", (uiFeatures & SHADER_RENDER_SKYBOX) ? 1 : 0);
+	pSpotlightProgram->SetUniform("renderTrack", (uiFeatures & SHADER_RENDER_TRACK) ? 1 : 0);
+	pSpotlightProgram->SetUniform("showTrack", (uiFeatures & SHADER_SHOW_TRACK) ? 1 : 0);
+	pSpotlightProgram->SetUniform("fogOn", (uiFeatures & SHADER_FOG_ON) ? 1 : 0);
+	pSpotlightProgram->SetUniform("bakedLighting", (uiFeatures & SHADER_BAKED_LIGHTING) ? 1 : 0);
+}
+
+// Sets the lights and materials shared by every lit variant of the spotlight shader.  The program must be in use.
+void Game::SetSpotlightUniforms(CShaderProgram* pSpotlightProgram, glm::mat4 viewMatrix, glm::mat3 viewNormalMatrix, bool bCityLights) {
+
+	pSpotlightProgram->SetUniform("sampler0", 0);
+	pSpotlightProgram->SetUniform("matrices.projMatrix", m_pCamera->GetPerspectiveProjectionMatrix());
+	pSpotlightProgram->SetUniform("fogDensity", FOG_DENSITY);
+	pSpotlightProgram->SetUniform("fogLodBias", FOG_MAX_LOD_BIAS);
+
+	// world light
+	glm::vec4 lightPosition1 = glm::vec4(-100, 100, -100, 1); // Position of light source *in world coordinates*
+	pSpotlightProgram->SetUniform("light1.position", viewMatrix * lightPosition1); // Light position in eye coordinates
+	pSpotlightProgram->SetUniform("light1.La", glm::vec3(0.1f));
+	pSpotlightProgram->SetUniform("light1.Ld", glm::vec3(0.1f));
+	pSpotlightProgram->SetUniform("light1.Ls", glm::vec3(0.1f));
+
+	// material for objects
+	pSpotlightProgram->SetUniform("material1.shininess", 15.0f);
+	pSpotlightProgram->SetUniform("material1.Ma", glm::vec3(0.5f));	// Ambient material reflectance
+	pSpotlightProgram->SetUniform("material1.Md", glm::vec3(0.5f));	// Diffuse material reflectance
+	pSpotlightProgram->SetUniform("material1.Ms", glm::vec3(1.0f));	// Specular material reflectance
+
+	glm::vec4 starshipFrontLightPosition(m_frame.starshipFrontLightPosition, 1);
+	pSpotlightProgram->SetUniform("spotlight[0].position", viewMatrix * starshipFrontLightPosition); // Light position in eye coordinates
+	pSpotlightProgram->SetUniform("spotlight[0].Ld", glm::vec3(headlightColour));			// Diffuse colour of light
+	pSpotlightProgram->SetUniform("spotlight[0].Ls", glm::vec3(headlightColour));			// Specular colour of light
+	pSpotlightProgram->SetUniform("spotlight[0].direction", glm::normalize(viewNormalMatrix * m_frame.starship_B * glm::vec3(0, 0, -1)));
+	pSpotlightProgram->SetUniform("spotlight[0].exponent", 40.f); // the blend between outer circle and environment
+	pSpotlightProgram->SetUniform("spotlight[0].cutoff", 15.f); // size of circle
+
+	glm::vec4 pointlightPosition(m_frame.starshipBackLightPosition, 1);
+	pSpotlightProgram->SetUniform("pointlight.position", viewMatrix* pointlightPosition); // Light position in eye coordinates
+	pSpotlightProgram->SetUniform("pointlight.Ld", glm::vec3(1.f, 0.f, 0.f));			// Diffuse colour of light
+	pSpotlightProgram->SetUniform("pointlight.Ls", glm::vec3(1.f, 0.f, 0.f));			// Specular colour of light
+
+	//city lights, unless they are baked into the geometry being drawn
+	if (bCityLights)
+		RenderLights(pSpotlightProgram, viewMatrix, viewNormalMatrix);
+	else
+		pSpotlightProgram->SetUniform("spotlightCount", 1);
+}
+
 void Game::RenderLights(CShaderProgram* pSpotlightProgram, glm::mat4 viewMatrix, glm::mat3 viewNormalMatrix) {
 
-	pSpotlightProgram->SetUniform("spotlight[1].position", viewMatrix * glm::vec4(-1018, 20 - 120, 489, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[1].Ld", teal);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[1].Ls", teal);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[1].direction", glm::normalize(viewNormalMatrix * glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[1].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[1].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[2].position", viewMatrix * glm::vec4(-1304, 60 - 120, 145, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[2].Ld", white);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[2].Ls", white);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[2].direction", glm::normalize(viewNormalMatrix * glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[2].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[2].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[3].position", viewMatrix * glm::vec4(-1221, 104 - 120, 26, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[3].Ld", white);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[3].Ls", white);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[3].direction", glm::normalize(viewNormalMatrix * glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[3].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[3].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[4].position", viewMatrix * glm::vec4(-1180, 60 - 120, -129, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[4].Ld", white);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[4].Ls", white);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[4].direction", glm::normalize(viewNormalMatrix * glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[4].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[4].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[5].position", viewMatrix * glm::vec4(-779, 20 - 120, -198, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[5].Ld", pink);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[5].Ls", pink);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[5].direction", glm::normalize(viewNormalMatrix * glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[5].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[5].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[6].position", viewMatrix * glm::vec4(-600, 132 - 120, -79, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[6].Ld", green);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[6].Ls", green);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[6].direction", glm::normalize(viewNormalMatrix * glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[6].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[6].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[7].position", viewMatrix * glm::vec4(-462, 245 - 120, -256, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[7].Ld", blue);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[7].Ls", blue);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[7].direction", glm::normalize(viewNormalMatrix * glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[7].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[7].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[8].position", viewMatrix * glm::vec4(-613, 211 - 120, -461, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[8].Ld", purple);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[8].Ls", purple);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[8].direction", glm::normalize(viewNormalMatrix * glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[8].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[8].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[9].position", viewMatrix * glm::vec4(-720, 15 - 120, -617, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[9].Ld", teal);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[9].Ls", teal);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[9].direction", glm::normalize(viewNormalMatrix * glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[9].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[9].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[10].position", viewMatrix * glm::vec4(-344, 10 - 120, -787, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[10].Ld", aqua);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[10].Ls", aqua);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[10].direction", glm::normalize(viewNormalMatrix * glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[10].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[10].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[11].position", viewMatrix * glm::vec4(614, 15 - 120, -1082, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[11].Ld", teal);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[11].Ls", teal);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[11].direction", glm::normalize(viewNormalMatrix * glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[11].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[11].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[12].position", viewMatrix * glm::vec4(849, 12 - 120, -1204, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[12].Ld", red);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[12].Ls", red);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[12].direction", glm::normalize(viewNormalMatrix * glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[12].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[12].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[13].position", viewMatrix * glm::vec4(1106, 12 - 120, -1179, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[13].Ld", purple);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[13].Ls", purple);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[13].direction", glm::normalize(viewNormalMatrix * glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[13].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[13].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[14].position", viewMatrix * glm::vec4(1295, 12 - 120, -987, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[14].Ld", yellow);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[14].Ls", yellow);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[14].direction", glm::normalize(viewNormalMatrix * glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[14].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[14].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[15].position", viewMatrix * glm::vec4(1627, 24 - 120, -813, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[15].Ld", purple);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[15].Ls", purple);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[15].direction", glm::normalize(viewNormalMatrix * glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[15].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[15].cutoff", 30.f);
-	
-	pSpotlightProgram->SetUniform("spotlight[16].position", viewMatrix * glm::vec4(1883, 212 - 120, -732, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[16].Ld", green);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[16].Ls", green);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[16].direction", glm::normalize(viewNormalMatrix * glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[16].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[16].cutoff", 30.f);
-	
-	pSpotlightProgram->SetUniform("spotlight[17].position", viewMatrix* glm::vec4(906, 17 - 120, 230, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[17].Ld", yellow);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[17].Ls", yellow);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[17].direction", glm::normalize(viewNormalMatrix* glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[17].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[17].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[18].position", viewMatrix* glm::vec4(708, 17 - 120, 180, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[18].Ld", yellow);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[18].Ls", yellow);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[18].direction", glm::normalize(viewNormalMatrix* glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[18].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[18].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[19].position", viewMatrix * glm::vec4(1806, 231 - 120, -516, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[19].Ld", teal);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[19].Ls", teal);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[19].direction", glm::normalize(viewNormalMatrix * glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[19].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[19].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[20].position", viewMatrix * glm::vec4(1658, 100 - 120, -353, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[20].Ld", blue);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[20].Ls", blue);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[20].direction", glm::normalize(viewNormalMatrix * glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[20].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[20].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[21].position", viewMatrix * glm::vec4(1648, 619 - 120, -331, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[21].Ld", blue);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[21].Ls", blue);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[21].direction", glm::normalize(viewNormalMatrix * glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[21].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[21].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[22].position", viewMatrix * glm::vec4(1968, 13 - 120, -360, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[22].Ld", purple);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[22].Ls", purple);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[22].direction", glm::normalize(viewNormalMatrix * glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[22].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[22].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[23].position", viewMatrix * glm::vec4(1910, 13 - 120, 23, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[23].Ld", blue * 2.f);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[23].Ls", blue * 2.f);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[23].direction", glm::normalize(viewNormalMatrix * glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[23].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[23].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[24].position", viewMatrix * glm::vec4(1858, 15 - 120, 257, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[24].Ld", blue * 2.f);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[24].Ls", blue * 2.f);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[24].direction", glm::normalize(viewNormalMatrix * glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[24].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[24].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[25].position", viewMatrix * glm::vec4(1586, 13 - 120, 117, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[25].Ld", aqua);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[25].Ls", aqua);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[25].direction", glm::normalize(viewNormalMatrix * glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[25].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[25].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[26].position", viewMatrix * glm::vec4(1581, 445 - 120, 29, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[26].Ld", yellow * 2.f);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[26].Ls", yellow * 2.f);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[26].direction", glm::normalize(viewNormalMatrix * glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[26].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[26].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[27].position", viewMatrix * glm::vec4(1296, 363 - 120, -9, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[27].Ld", teal);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[27].Ls", teal);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[27].direction", glm::normalize(viewNormalMatrix * glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[27].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[27].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[28].position", viewMatrix * glm::vec4(1272, 15 - 120, 22, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[28].Ld", teal);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[28].Ls", teal);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[28].direction", glm::normalize(viewNormalMatrix * glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[28].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[28].cutoff", 30.f);
-
-	//left 1
-	pSpotlightProgram->SetUniform("spotlight[29].position", viewMatrix* glm::vec4(1101, 15 - 120, 79, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[29].Ld", pink);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[29].Ls", pink);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[29].direction", glm::normalize(viewNormalMatrix* glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[29].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[29].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[30].position", viewMatrix* glm::vec4(888, 143 - 120, 82, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[30].Ld", teal);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[30].Ls", teal);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[30].direction", glm::normalize(viewNormalMatrix* glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[30].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[30].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[31].position", viewMatrix* glm::vec4(985, 15 - 120, -148, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[31].Ld", purple);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[31].Ls", purple);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[31].direction", glm::normalize(viewNormalMatrix* glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[31].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[31].cutoff", 30.f);
-
-	//right 1
-	pSpotlightProgram->SetUniform("spotlight[32].position", viewMatrix* glm::vec4(1342, 15 - 120, -367, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[32].Ld", teal);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[32].Ls", teal);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[32].direction", glm::normalize(viewNormalMatrix* glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[32].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[32].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[33].position", viewMatrix* glm::vec4(1109, 15 - 120, -356, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[33].Ld", teal);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[33].Ls", teal);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[33].direction", glm::normalize(viewNormalMatrix* glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[33].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[33].cutoff", 30.f);
-
-	//left 2
-	pSpotlightProgram->SetUniform("spotlight[34].position", viewMatrix* glm::vec4(689, 125 - 120, -20, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[34].Ld", green);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[34].Ls", green);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[34].direction", glm::normalize(viewNormalMatrix* glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[34].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[34].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[35].position", viewMatrix* glm::vec4(788, 15 - 120, -253, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[35].Ld", blue);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[35].Ls", blue);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[35].direction", glm::normalize(viewNormalMatrix* glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[35].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[35].cutoff", 30.f);
-
-	//right 2
-	pSpotlightProgram->SetUniform("spotlight[36].position", viewMatrix* glm::vec4(955, 15 - 120, -556, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[36].Ld", red);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[36].Ls", red);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[36].direction", glm::normalize(viewNormalMatrix* glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[36].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[36].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[37].position", viewMatrix* glm::vec4(888, 15 - 120, -453, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[37].Ld", magenta);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[37].Ls", magenta);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[37].direction", glm::normalize(viewNormalMatrix* glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[37].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[37].cutoff", 30.f);
-
-	//left 3
-	pSpotlightProgram->SetUniform("spotlight[38].position", viewMatrix* glm::vec4(446, 15 - 120, -116, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[38].Ld", blue);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[38].Ls", blue);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[38].direction", glm::normalize(viewNormalMatrix* glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[38].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[38].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[39].position", viewMatrix* glm::vec4(597, 15 - 120, -389, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[39].Ld", green);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[39].Ls", green);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[39].direction", glm::normalize(viewNormalMatrix* glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[39].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[39].cutoff", 30.f);
-
-	//right 3
-	pSpotlightProgram->SetUniform("spotlight[40].position", viewMatrix* glm::vec4(764, 15 - 120, -668, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[40].Ld", yellow);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[40].Ls", yellow);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[40].direction", glm::normalize(viewNormalMatrix* glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[40].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[40].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[41].position", viewMatrix* glm::vec4(700, 15 - 120, -552, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[41].Ld", yellow);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[41].Ls", yellow);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[41].direction", glm::normalize(viewNormalMatrix* glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[41].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[41].cutoff", 30.f);
-
-	//left 4
-	pSpotlightProgram->SetUniform("spotlight[42].position", viewMatrix* glm::vec4(249, 15 - 120, -276, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[42].Ld", yellow);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[42].Ls", yellow);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[42].direction", glm::normalize(viewNormalMatrix* glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[42].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[42].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[43].position", viewMatrix* glm::vec4(391, 15 - 120, -476, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[43].Ld", red);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[43].Ls", red);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[43].direction", glm::normalize(viewNormalMatrix* glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[43].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[43].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[44].position", viewMatrix* glm::vec4(139, 15 - 120, -495, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[44].Ld", magenta);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[44].Ls", magenta);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[44].direction", glm::normalize(viewNormalMatrix* glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[44].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[44].cutoff", 30.f);
-
-	//right 4
-	pSpotlightProgram->SetUniform("spotlight[45].position", viewMatrix* glm::vec4(637, 15 - 120, -736, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[45].Ld", red);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[45].Ls", red);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[45].direction", glm::normalize(viewNormalMatrix* glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[45].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[45].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[46].position", viewMatrix* glm::vec4(514, 15 - 120, -672, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[46].Ld", purple);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[46].Ls", purple);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[46].direction", glm::normalize(viewNormalMatrix* glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[46].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[46].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[47].position", viewMatrix* glm::vec4(353, 15 - 120, -875, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[47].Ld", aqua);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[47].Ls", aqua);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[47].direction", glm::normalize(viewNormalMatrix* glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[47].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[47].cutoff", 30.f);
-
-	//end of center city
-
-	pSpotlightProgram->SetUniform("spotlight[48].position", viewMatrix* glm::vec4(-399, 209 - 120, -481, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[48].Ld", purple);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[48].Ls", purple);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[48].direction", glm::normalize(viewNormalMatrix* glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[48].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[48].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[49].position", viewMatrix* glm::vec4(-64, 85 - 120, -656, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[49].Ld", red);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[49].Ls", red);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[49].direction", glm::normalize(viewNormalMatrix* glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[49].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[49].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[50].position", viewMatrix* glm::vec4(-83, 268 - 120, -211, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[50].Ld", purple);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[50].Ls", purple);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[50].direction", glm::normalize(viewNormalMatrix* glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[50].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[50].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[51].position", viewMatrix* glm::vec4(-226, 170 - 120, -241, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[51].Ld", purple);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[51].Ls", purple);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[51].direction", glm::normalize(viewNormalMatrix* glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[51].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[51].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[52].position", viewMatrix* glm::vec4(-118, 19 - 123, 90, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[52].Ld", aqua * 2.f);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[52].Ls", aqua * 2.f);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[52].direction", glm::normalize(viewNormalMatrix* glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[52].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[52].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[53].position", viewMatrix* glm::vec4(25, 19 - 120, 380, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[53].Ld", magenta);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[53].Ls", magenta);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[53].direction", glm::normalize(viewNormalMatrix* glm::vec3(0, 1, -0.5)));
-	pSpotlightProgram->SetUniform("spotlight[53].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[53].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[54].position", viewMatrix* glm::vec4(221, 19 - 120, 351, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[54].Ld", purple);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[54].Ls", purple);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[54].direction", glm::normalize(viewNormalMatrix* glm::vec3(0, 1, -0.5)));
-	pSpotlightProgram->SetUniform("spotlight[54].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[54].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[55].position", viewMatrix* glm::vec4(135, 17 -120, 412, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[55].Ld", blue);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[55].Ls", blue);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[55].direction", glm::normalize(viewNormalMatrix* glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[55].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[55].cutoff", 30.f);
-
-
-	pSpotlightProgram->SetUniform("spotlight[56].position", viewMatrix* glm::vec4(525, 19 - 120, 227, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[56].Ld", red * 3.f);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[56].Ls", red * 3.f);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[56].direction", glm::normalize(viewNormalMatrix* glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[56].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[56].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[57].position", viewMatrix* glm::vec4(1332, 10 - 120, 270, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[57].Ld", aqua);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[57].Ls", aqua);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[57].direction", glm::normalize(viewNormalMatrix* glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[57].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[57].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[58].position", viewMatrix* glm::vec4(-758, 19 - 120, 518, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[58].Ld", purple * 3.f);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[58].Ls", purple * 3.f);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[58].direction", glm::normalize(viewNormalMatrix* glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[58].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[58].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[59].position", viewMatrix* glm::vec4(-815, 0 - 120, 240, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[59].Ld", green * 0.2f);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[59].Ls", green * 0.2f);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[59].direction", glm::normalize(viewNormalMatrix* glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[59].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[59].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[60].position", viewMatrix* glm::vec4(-965, 13 - 120, -89, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[60].Ld", purple);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[60].Ls", purple);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[60].direction", glm::normalize(viewNormalMatrix* glm::vec3(0, 1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[60].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[60].cutoff", 30.f);
-
-	pSpotlightProgram->SetUniform("spotlight[61].position", viewMatrix* glm::vec4(-391, 276, 209, 1)); // Light position in eye coordinates
-	pSpotlightProgram->SetUniform("spotlight[61].Ld", yellow);			// Diffuse colour of light
-	pSpotlightProgram->SetUniform("spotlight[61].Ls", yellow);			// Specular colour of light
-	pSpotlightProgram->SetUniform("spotlight[61].direction", glm::normalize(viewNormalMatrix* glm::vec3(0, -1, 0)));
-	pSpotlightProgram->SetUniform("spotlight[61].exponent", 5.f);
-	pSpotlightProgram->SetUniform("spotlight[61].cutoff", 30.f);
+	// The city lights are listed in StaticLighting.cpp, which the light baker also reads.  Only the ones nearest the 
+	// camera are shaded, as many as the quality governor allows.
+	const vector<CityLight>& cityLights = GetCityLights();
+	vector<pair<float, int> > nearestLights;
+	for (unsigned int i = 0; i < cityLights.size(); i++)
+		nearestLights.push_back(make_pair(glm::distance(cityLights[i].position, m_pCamera->GetPosition()), (int) i));
+	int iLights = glm::min(m_pQualityGovernor->GetSettings().spotlights, (int) nearestLights.size());
+	partial_sort(nearestLights.begin(), nearestLights.begin() + iLights, nearestLights.end());
+
+	for (int l = 0; l < iLights; l++) {
+		int i = nearestLights[l].second;
+		char sLight[32];
+		sprintf_s(sLight, "spotlight[%d]", l + 1);
+		string sName(sLight);
+
+		pSpotlightProgram->SetUniform(sName + ".position", viewMatrix * glm::vec4(cityLights[i].position, 1)); // Light position in eye coordinates
+		pSpotlightProgram->SetUniform(sName + ".Ld", cityLights[i].colour);			// Diffuse colour of light
+		pSpotlightProgram->SetUniform(sName + ".Ls", cityLights[i].colour);			// Specular colour of light
+		pSpotlightProgram->SetUniform(sName + ".direction", glm::normalize(viewNormalMatrix * cityLights[i].direction));
+		pSpotlightProgram->SetUniform(sName + ".exponent", cityLights[i].exponent);
+		pSpotlightProgram->SetUniform(sName + ".cutoff", cityLights[i].cutoff);
+	}
+	pSpotlightProgram->SetUniform("spotlightCount", iLights + 1);
+}
+
+// Loads one of the static city meshes, with its baked lighting if there is a bake file for it.  Returns true if it was baked.
+bool Game::LoadStaticMesh(COpenAssetImportMesh* pMesh, int iMesh, vector<OccluderBox> &occluders)
+{
+	const StaticMeshPlacement& placement = GetStaticMeshPlacement(iMesh);
 
+	CBakedLighting bakedLighting;
+	bool bBaked = bakedLighting.Load(GetBakedLightingFilename(placement.filename));
+	vector<glm::vec3> triangles;
+	pMesh->SetChunkGrid(STATIC_MESH_CHUNK_GRID);
+	pMesh->Load(placement.filename, bBaked ? &bakedLighting : NULL, &triangles);
 
+	// Boxes filling the enclosed space inside the buildings, for the occlusion culling
+	GenerateOccluders(triangles, placement.GetModelMatrix(), OCCLUDER_MIN_VOLUME, occluders);
+
+	if (m_bakePvs) {
+		m_staticMeshTriangles.resize(STATIC_MESH_COUNT);
+		m_staticMeshTriangles[iMesh].swap(triangles);
+	}
+
+	return bBaked;
 }
 
-void Game::RenderEnvCars(CShaderProgram* pSpotlightProgram, glutil::MatrixStack modelViewMatrixStack, glm::vec3 EnvStarshipPosition, glm::mat4 EnvStarshipOrientation) {
+// Records the frame's draws with a job for each part of the scene, then merges the jobs' commands into the queue in the
+// order they used to be drawn in, and sorts them.  The jobs only read the scene, so they can run in parallel.
+void Game::BuildRenderQueue(glm::mat4 viewMatrix) {
 
-	modelViewMatrixStack.Push();
-	modelViewMatrixStack.Translate(EnvStarshipPosition + glm::vec3(0, 0, 0));
-	modelViewMatrixStack *= EnvStarshipOrientation;
-	modelViewMatrixStack.Rotate(glm::vec3(0.0f, 1.0f, 0.0f), 0.0f);
-	modelViewMatrixStack.Scale(1.f);
-	pSpotlightProgram->SetUniform("matrices.modelViewMatrix", modelViewMatrixStack.Top());
-	pSpotlightProgram->SetUniform("matrices.normalMatrix", m_pCamera->ComputeNormalMatrix(modelViewMatrixStack.Top()));
-	m_pStarship->Render();
-	modelViewMatrixStack.Pop();
+	CPU_TRACE_SCOPE("Game::BuildRenderQueue");
+	CHighResolutionTimer timer;
+	timer.Start();
 
-	modelViewMatrixStack.Push();
-	modelViewMatrixStack.Translate(EnvStarshipPosition + glm::vec3(10, 10, 70));
-	modelViewMatrixStack *= EnvStarshipOrientation;
-	modelViewMatrixStack.Rotate(glm::vec3(0.0f, 1.0f, 0.0f), 0.0f);
-	modelViewMatrixStack.Scale(1.f);
-	pSpotlightProgram->SetUniform("matrices.modelViewMatrix", modelViewMatrixStack.Top());
-	pSpotlightProgram->SetUniform("matrices.normalMatrix", m_pCamera->ComputeNormalMatrix(modelViewMatrixStack.Top()));
-	m_pFreighter->Render();
-	modelViewMatrixStack.Pop();
+	vector<function<void()> > jobs;
+	for (int i = 0; i < RENDER_JOB_COUNT; i++)
+		jobs.push_back([this, i, viewMatrix] { RecordRenderJob(i, viewMatrix); });
 
-	modelViewMatrixStack.Push();
-	modelViewMatrixStack.Translate(EnvStarshipPosition + glm::vec3(-10, -10, 50));
-	modelViewMatrixStack *= EnvStarshipOrientation;
-	modelViewMatrixStack.Rotate(glm::vec3(0.0f, 1.0f, 0.0f), 0.0f);
-	modelViewMatrixStack.Scale(1.f);
-	pSpotlightProgram->SetUniform("matrices.modelViewMatrix", modelViewMatrixStack.Top());
-	pSpotlightProgram->SetUniform("matrices.normalMatrix", m_pCamera->ComputeNormalMatrix(modelViewMatrixStack.Top()));
-	m_pTransport->Render();
-	modelViewMatrixStack.Pop();
+	if (m_parallelRecordingOn)
+		m_pRenderWorkers->Run(jobs);
+	else {
+		for (int i = 0; i < RENDER_JOB_COUNT; i++)
+			jobs[i]();
+	}
 
-	modelViewMatrixStack.Push();
-	modelViewMatrixStack.Translate(EnvStarshipPosition + glm::vec3(0, 15, 130));
-	modelViewMatrixStack *= EnvStarshipOrientation;
-	modelViewMatrixStack.Rotate(glm::vec3(0.0f, 1.0f, 0.0f), 0.0f);
-	modelViewMatrixStack.Scale(1.f);
-	pSpotlightProgram->SetUniform("matrices.modelViewMatrix", modelViewMatrixStack.Top());
-	pSpotlightProgram->SetUniform("matrices.normalMatrix", m_pCamera->ComputeNormalMatrix(modelViewMatrixStack.Top()));
-	m_pTransport->Render();
-	modelViewMatrixStack.Pop();
+	m_sceneDraws.clear();
+	m_pRenderQueue->Clear(m_farPlane);
+	for (int i = 0; i < RENDER_JOB_COUNT; i++) {
+		int iDrawOffset = (int)m_sceneDraws.size();
+		m_sceneDraws.insert(m_sceneDraws.end(), m_renderJobs[i].draws.begin(), m_renderJobs[i].draws.end());
+		m_pRenderQueue->Append(*m_renderJobs[i].pCommands, iDrawOffset);
+	}
+	m_pRenderQueue->Finish(m_renderSortingOn);
 
-	modelViewMatrixStack.Push();
-	modelViewMatrixStack.Translate(EnvStarshipPosition + glm::vec3(0, 0, -130));
-	modelViewMatrixStack *= EnvStarshipOrientation;
-	modelViewMatrixStack.Rotate(glm::vec3(0.0f, 1.0f, 0.0f), 0.0f);
-	modelViewMatrixStack.Scale(1.f);
-	pSpotlightProgram->SetUniform("matrices.modelViewMatrix", modelViewMatrixStack.Top());
-	pSpotlightProgram->SetUniform("matrices.normalMatrix", m_pCamera->ComputeNormalMatrix(modelViewMatrixStack.Top()));
-	m_pFreighter->Render();
-	modelViewMatrixStack.Pop();
+	m_recordingTime = timer.Elapsed();
+}
 
-	modelViewMatrixStack.Push();
-	modelViewMatrixStack.Translate(EnvStarshipPosition + glm::vec3(25, -10, 30));
-	modelViewMatrixStack *= EnvStarshipOrientation;
-	modelViewMatrixStack.Rotate(glm::vec3(0.0f, 1.0f, 0.0f), 0.0f);
-	modelViewMatrixStack.Scale(1.f);
-	pSpotlightProgram->SetUniform("matrices.modelViewMatrix", modelViewMatrixStack.Top());
-	pSpotlightProgram->SetUniform("matrices.normalMatrix", m_pCamera->ComputeNormalMatrix(modelViewMatrixStack.Top()));
-	m_pFlyingCar->Render();
-	modelViewMatrixStack.Pop();
+// Records one job's draws into its own list.  This runs on a render worker, so it must not touch GL or change the scene.
+void Game::RecordRenderJob(int iJob, glm::mat4 viewMatrix) {
 
-	modelViewMatrixStack.Push();
-	modelViewMatrixStack.Translate(EnvStarshipPosition + glm::vec3(-25, 5, 30));
-	modelViewMatrixStack *= EnvStarshipOrientation;
-	modelViewMatrixStack.Rotate(glm::vec3(0.0f, 1.0f, 0.0f), 0.0f);
-	modelViewMatrixStack.Scale(1.f);
-	pSpotlightProgram->SetUniform("matrices.modelViewMatrix", modelViewMatrixStack.Top());
-	pSpotlightProgram->SetUniform("matrices.normalMatrix", m_pCamera->ComputeNormalMatrix(modelViewMatrixStack.Top()));
-	m_pFlyingCar->Render();
-	modelViewMatrixStack.Pop();
+	CPU_TRACE_SCOPE("Game::RecordRenderJob");
+	m_renderJobs[iJob].draws.clear();
+	m_renderJobs[iJob].pCommands->Clear(m_farPlane);
 
-	modelViewMatrixStack.Push();
-	modelViewMatrixStack.Translate(EnvStarshipPosition + glm::vec3(25, 10, -30));
-	modelViewMatrixStack *= EnvStarshipOrientation;
-	modelViewMatrixStack.Rotate(glm::vec3(0.0f, 1.0f, 0.0f), 0.0f);
-	modelViewMatrixStack.Scale(1.f);
-	pSpotlightProgram->SetUniform("matrices.modelViewMatrix", modelViewMatrixStack.Top());
-	pSpotlightProgram->SetUniform("matrices.normalMatrix", m_pCamera->ComputeNormalMatrix(modelViewMatrixStack.Top()));
-	m_pFlyingCar->Render();
-	modelViewMatrixStack.Pop();
+	// The GPU-driven buckets draw the environment vehicles and the static chunks
+	bool bGpuDriven = IsGpuDrivenOn();
 
-	modelViewMatrixStack.Push();
-	modelViewMatrixStack.Translate(EnvStarshipPosition + glm::vec3(-25, 10, -30));
-	modelViewMatrixStack *= EnvStarshipOrientation;
-	modelViewMatrixStack.Rotate(glm::vec3(0.0f, 1.0f, 0.0f), 0.0f);
-	modelViewMatrixStack.Scale(1.f);
-	pSpotlightProgram->SetUniform("matrices.modelViewMatrix", modelViewMatrixStack.Top());
-	pSpotlightProgram->SetUniform("matrices.normalMatrix", m_pCamera->ComputeNormalMatrix(modelViewMatrixStack.Top()));
-	m_pPoliceCar->Render();
-	modelViewMatrixStack.Pop();
+	switch (iJob) {
+	case RENDER_JOB_ENVIRONMENT:
+		AddSceneDraw(iJob, DRAW_TERRAIN, -1, NULL, 0, RENDER_PASS_OPAQUE, RENDER_PROGRAM_SPOTLIGHT, MATERIAL_TERRAIN, 0, viewMatrix);
+		AddSceneDraw(iJob, DRAW_MESH, OBJECT_HORSE, m_pHorseMesh, 0, RENDER_PASS_OPAQUE, RENDER_PROGRAM_SPOTLIGHT, MATERIAL_HORSE, 0, viewMatrix);
+		AddSceneDraw(iJob, DRAW_MESH, OBJECT_FIGHTER, m_pFighterMesh, 0, RENDER_PASS_OPAQUE, RENDER_PROGRAM_SPOTLIGHT, MATERIAL_FIGHTER, 0, viewMatrix);
+		AddSceneDraw(iJob, DRAW_MESH, OBJECT_STARSHIP, m_pStarship, 0, RENDER_PASS_OPAQUE, RENDER_PROGRAM_SPOTLIGHT, MATERIAL_STARSHIP, 0, viewMatrix);
+		break;
 
-	modelViewMatrixStack.Push();
-	modelViewMatrixStack.Translate(EnvStarshipPosition + glm::vec3(30, -4, -10));
-	modelViewMatrixStack *= EnvStarshipOrientation;
-	modelViewMatrixStack.Rotate(glm::vec3(0.0f, 1.0f, 0.0f), 0.0f);
-	modelViewMatrixStack.Scale(1.f);
-	pSpotlightProgram->SetUniform("matrices.modelViewMatrix", modelViewMatrixStack.Top());
-	pSpotlightProgram->SetUniform("matrices.normalMatrix", m_pCamera->ComputeNormalMatrix(modelViewMatrixStack.Top()));
-	m_pPoliceCar->Render();
-	modelViewMatrixStack.Pop();
+	// Otherwise the vehicles are either one instanced draw per mesh or one draw per vehicle
+	case RENDER_JOB_CONVOYS:
+		if (bGpuDriven) {
+			for (int i = 0; i < m_pGpuScene->GetBucketCount(); i++) {
+				if (m_pGpuScene->GetBucketProgram(i) == RENDER_PROGRAM_INDIRECT_SPOTLIGHT)
+					AddSceneDraw(iJob, DRAW_INDIRECT_BUCKET, -1, NULL, i, RENDER_PASS_OPAQUE, RENDER_PROGRAM_INDIRECT_SPOTLIGHT, 
+						MATERIAL_INDIRECT_BUCKET + i, m_pGpuScene->GetBucketState(i), viewMatrix);
+			}
+		}
+		else if (m_instancingOn)
+			AddSceneDraw(iJob, DRAW_CONVOY_BATCH, -1, NULL, 0, RENDER_PASS_OPAQUE, RENDER_PROGRAM_SPOTLIGHT, MATERIAL_CONVOY_BATCH, 0, viewMatrix);
+		else {
+			for (int i = 0; i < ENV_CONVOY_COUNT * ENV_CONVOY_VEHICLES; i++) {
+				int iMesh = envConvoyLayout[i % ENV_CONVOY_VEHICLES].iMesh;
+				AddSceneDraw(iJob, DRAW_MESH, OBJECT_ENV_VEHICLES + i, GetEnvVehicleMesh(iMesh), 0, RENDER_PASS_OPAQUE, RENDER_PROGRAM_SPOTLIGHT, 
+					MATERIAL_ENV_VEHICLE + iMesh, 0, viewMatrix);
+			}
+		}
+		break;
 
-	modelViewMatrixStack.Push();
-	modelViewMatrixStack.Translate(EnvStarshipPosition + glm::vec3(-25, 10, -100));
-	modelViewMatrixStack *= EnvStarshipOrientation;
-	modelViewMatrixStack.Rotate(glm::vec3(0.0f, 1.0f, 0.0f), 0.0f);
-	modelViewMatrixStack.Scale(1.f);
-	pSpotlightProgram->SetUniform("matrices.modelViewMatrix", modelViewMatrixStack.Top());
-	pSpotlightProgram->SetUniform("matrices.normalMatrix", m_pCamera->ComputeNormalMatrix(modelViewMatrixStack.Top()));
-	m_pPatrolCar->Render();
-	modelViewMatrixStack.Pop();
+	case RENDER_JOB_PICKUPS:
+		if (!m_frame.cubePickedUp)
+			AddSceneDraw(iJob, DRAW_CUBE, OBJECT_CUBE, NULL, 0, RENDER_PASS_OPAQUE, RENDER_PROGRAM_SPOTLIGHT, MATERIAL_CUBE, 0, viewMatrix);
+		if (!m_frame.tetraPickedUp)
+			AddSceneDraw(iJob, DRAW_TETRAHEDRON, OBJECT_TETRAHEDRON, NULL, 0, RENDER_PASS_OPAQUE, RENDER_PROGRAM_SPOTLIGHT, MATERIAL_TETRAHEDRON, 0, 
+				viewMatrix);
+		break;
 
-	modelViewMatrixStack.Push();
-	modelViewMatrixStack.Translate(EnvStarshipPosition + glm::vec3(30, -4, -70));
-	modelViewMatrixStack *= EnvStarshipOrientation;
-	modelViewMatrixStack.Rotate(glm::vec3(0.0f, 1.0f, 0.0f), 0.0f);
-	modelViewMatrixStack.Scale(1.f);
-	pSpotlightProgram->SetUniform("matrices.modelViewMatrix", modelViewMatrixStack.Top());
-	pSpotlightProgram->SetUniform("matrices.normalMatrix", m_pCamera->ComputeNormalMatrix(modelViewMatrixStack.Top()));
-	m_pPatrolCar->Render();
-	modelViewMatrixStack.Pop();
+	// The Downtown, City and Center City a chunk at a time.  Only the Downtown is drawn with back faces culled.
+	case RENDER_JOB_CITY:
+		if (bGpuDriven) {
+			for (int i = 0; i < m_pGpuScene->GetBucketCount(); i++) {
+				if (m_pGpuScene->GetBucketProgram(i) != RENDER_PROGRAM_INDIRECT_SPOTLIGHT)
+					AddSceneDraw(iJob, DRAW_INDIRECT_BUCKET, -1, NULL, i, RENDER_PASS_OPAQUE, m_pGpuScene->GetBucketProgram(i), 
+						MATERIAL_INDIRECT_BUCKET + i, m_pGpuScene->GetBucketState(i), viewMatrix);
+			}
+			break;
+		}
+		for (int i = 0; i < STATIC_MESH_COUNT; i++) {
+			COpenAssetImportMesh* pMesh = GetStaticMesh(i);
+			unsigned int uiState = i == STATIC_MESH_DOWNTOWN ? 0 : RENDER_STATE_NO_CULL;
+			for (int c = 0; c < pMesh->GetChunkCount(); c++)
+				AddSceneDraw(iJob, DRAW_STATIC_CHUNK, m_staticChunkObjects[i] + c, pMesh, c, RENDER_PASS_OPAQUE, RENDER_PROGRAM_STATIC, 
+					MATERIAL_STATIC_MESH + i, uiState, viewMatrix);
+		}
+		break;
+
+	// The track's grid is alpha blended
+	case RENDER_JOB_TRACK:
+		AddSceneDraw(iJob, DRAW_TRACK, OBJECT_TRACK, NULL, 0, RENDER_PASS_TRANSPARENT, RENDER_PROGRAM_TRACK, MATERIAL_TRACK, 
+			RENDER_STATE_NO_CULL | RENDER_STATE_BLEND, viewMatrix);
+		break;
+
+	case RENDER_JOB_HUD:
+		RecordHudLines();
+		break;
+	}
+}
+
+// Formats the debug text, drawn later by DisplayFrameRate.  The render queue and recording figures are the last frame's,
+// since this runs while they are being rebuilt.
+void Game::RecordHudLines() {
+
+	m_hudLines.clear();
+	if (!m_showDebug)
+		return;
+
+	char szLine[256];
+	sprintf_s(szLine, "FPS: %d", m_framesPerSecond);
+	m_hudLines.push_back(szLine);
+	sprintf_s(szLine, "X: %f", m_pCamera->GetPosition().x);
+	m_hudLines.push_back(szLine);
+	sprintf_s(szLine, "Y: %f", m_pCamera->GetPosition().y);
+	m_hudLines.push_back(szLine);
+	sprintf_s(szLine, "Z: %f", m_pCamera->GetPosition().z);
+	m_hudLines.push_back(szLine);
+	sprintf_s(szLine, "Shader variants: %d/%d", m_pSpotlightShaders->GetReadyCount(), m_pSpotlightShaders->GetVariantCount());
+	m_hudLines.push_back(szLine);
+	sprintf_s(szLine, "Depth pre-pass: %s, overdraw %.2f", m_pDepthPrepass->GetModeName(), m_pDepthPrepass->GetOverdraw());
+	m_hudLines.push_back(szLine);
+	if (m_instancingOn)
+		sprintf_s(szLine, "Convoys: %d vehicles, %d instanced meshes", m_pEnvConvoyBatch->GetInstanceCount(), m_pEnvConvoyBatch->GetMeshCount());
+	else
+		sprintf_s(szLine, "Convoys: %d vehicles, not instanced", ENV_CONVOY_COUNT * ENV_CONVOY_VEHICLES);
+	m_hudLines.push_back(szLine);
+	sprintf_s(szLine, "Frustum culling %s: %d drawn, %d culled, cut off at %.0f", m_cullingOn ? "on" : "off", 
+		m_objectsDrawn, m_pCullBounds->GetCount() - m_objectsDrawn - m_objectsOccluded - m_objectsPvsCulled, GetFogCutoffDistance());
+	m_hudLines.push_back(szLine);
+	sprintf_s(szLine, "Occlusion culling %s: %d occluded by %d boxes, %.2f ms", m_occlusionCullingOn ? "on" : "off", 
+		m_objectsOccluded, m_pOcclusionBuffer->GetOccluderCount(), m_occlusionTime);
+	m_hudLines.push_back(szLine);
+	sprintf_s(szLine, "Occlusion queries %s: %d hidden, %d queries", m_occlusionQueriesOn ? "on" : "off", 
+		m_pOcclusionQueries->GetHiddenCount(), m_pOcclusionQueries->GetQueryCount());
+	m_hudLines.push_back(szLine);
+	if (m_pPvs->IsLoaded())
+		sprintf_s(szLine, "PVS %s: sector %d of %d, %d chunks culled", m_pvsOn ? "on" : "off", m_pvsSector, m_pPvs->GetSectorCount(), 
+			m_objectsPvsCulled);
+	else
+		sprintf_s(szLine, "PVS: not baked (run with --bakepvs)");
+	m_hudLines.push_back(szLine);
+	sprintf_s(szLine, "Render queue %s: %d draws, %d state changes (%d in submission order)", m_renderSortingOn ? "sorted" : "unsorted", 
+		m_pRenderQueue->GetCount(), m_pRenderQueue->GetSortedStateChanges(), m_pRenderQueue->GetUnsortedStateChanges());
+	m_hudLines.push_back(szLine);
+	if (m_pGpuScene->IsCreated())
+		sprintf_s(szLine, "GPU-driven draws %s: %d draws in %d multi-draws", m_gpuDrivenOn ? "on" : "off", m_pGpuScene->GetDrawCount(), 
+			m_pGpuScene->GetBucketCount());
+	else
+		sprintf_s(szLine, "GPU-driven draws: not available (needs OpenGL 4.3)");
+	m_hudLines.push_back(szLine);
+	sprintf_s(szLine, "Command recording: %s on %d threads, %.2f ms", m_parallelRecordingOn ? "parallel" : "serial", 
+		m_parallelRecordingOn ? m_pRenderWorkers->GetThreadCount() : 1, m_recordingTime);
+	m_hudLines.push_back(szLine);
+	if (m_pFramePacer->GetTargetRate() > 0)
+		sprintf_s(szLine, "Frame pacing: %d fps target, %.2f ms average, %.2f ms jitter", m_pFramePacer->GetTargetRate(), 
+			m_pFramePacer->GetAverageInterval(), m_pFramePacer->GetJitter());
+	else
+		sprintf_s(szLine, "Frame pacing: no limit, %.2f ms average, %.2f ms jitter", m_pFramePacer->GetAverageInterval(), 
+			m_pFramePacer->GetJitter());
+	m_hudLines.push_back(szLine);
+	sprintf_s(szLine, "Low latency %s: %d frames queued, waited %.2f ms, input to swap %.1f ms", m_lowLatencyOn ? "on" : "off", 
+		m_pLatencyLimiter->GetMaxQueuedFrames(), m_lowLatencyOn ? m_pLatencyLimiter->GetWaitTime() : 0.0, m_inputLatency);
+	m_hudLines.push_back(szLine);
+	const QualitySettings &quality = m_pQualityGovernor->GetSettings();
+	sprintf_s(szLine, "Quality governor %s: level %.2f, %s, %s bound at %.2f ms (CPU %.2f, GPU %.2f)", 
+		m_pQualityGovernor->IsEnabled() ? "on" : "off", m_pQualityGovernor->GetLevel(), m_pQualityGovernor->GetDecisionName(), 
+		m_pQualityGovernor->GetBottleneckName(), m_pQualityGovernor->GetFrameTime(), m_cpuFrameTime, m_pGpuProfiler->GetFrameTime());
+	m_hudLines.push_back(szLine);
+	sprintf_s(szLine, "Quality: %.0f%% resolution, far plane %.0f, %d city lights, cull distance %.0f%%", quality.resolutionScale * 100.0f, 
+		quality.farPlane, quality.spotlights, quality.cullDistanceScale * 100.0f);
+	m_hudLines.push_back(szLine);
+	if (m_upscalingOn) {
+		RECT dimensions = GetOutputDimensions();
+		int iWindowWidth = dimensions.right - dimensions.left;
+		int iWindowHeight = dimensions.bottom - dimensions.top;
+		sprintf_s(szLine, "Temporal upscaling on: %dx%d to %dx%d, %.0f%% of the pixels shaded", m_pSceneTarget->GetWidth(), 
+			m_pSceneTarget->GetHeight(), iWindowWidth, iWindowHeight, 100.0f * m_pSceneTarget->GetWidth() * m_pSceneTarget->GetHeight() / 
+			(iWindowWidth * iWindowHeight));
+	}
+	else
+		sprintf_s(szLine, "Temporal upscaling off");
+	m_hudLines.push_back(szLine);
+#ifdef ENABLE_GL_COUNTERS
+	sprintf_s(szLine, "GL calls: %d draws (%d indirect), %.2fM triangles, %d programs, %d textures, %d vertex arrays, %d uniforms, %.1f KB uploaded", 
+		m_glCounts.draws, m_glCounts.indirectDraws, m_glCounts.triangles / 1000000.0, m_glCounts.programBinds, m_glCounts.textureBinds, 
+		m_glCounts.vertexArrayBinds, m_glCounts.uniformUploads, m_glCounts.bytesUploaded / 1024.0);
+#else
+	sprintf_s(szLine, "GL calls: not counted (define ENABLE_GL_COUNTERS in GLCounters.h)");
+#endif
+	m_hudLines.push_back(szLine);
+	sprintf_s(szLine, "Frame times over %d frames (F4 to export): p50 %.2f ms, p95 %.2f, p99 %.2f, max %.2f, %d hitches over %.1f ms", 
+		m_pFrameStats->GetFrameCount(), m_pFrameStats->GetPercentile(50.0), m_pFrameStats->GetPercentile(95.0), 
+		m_pFrameStats->GetPercentile(99.0), m_pFrameStats->GetMax(), m_pFrameStats->GetHitchCount(), m_pFrameStats->GetHitchThreshold());
+	m_hudLines.push_back(szLine);
+
+#ifdef ENABLE_CPU_TRACE
+	sprintf_s(szLine, "CPU trace: %s", CCpuTrace::IsCapturing() ? "capturing, F3 to stop and write it" : "F3 to start a capture");
+#else
+	sprintf_s(szLine, "CPU trace: compiled out (define ENABLE_CPU_TRACE in CpuTrace.h)");
+#endif
+	m_hudLines.push_back(szLine);
+
+	// The GPU profiler's scopes, indented under their parents
+	sprintf_s(szLine, "GPU profile (F2 to export), %d frames dropped:", m_pGpuProfiler->GetDroppedFrames());
+	m_hudLines.push_back(szLine);
+	vector<int> scopes;
+	m_pGpuProfiler->GetScopeOrder(scopes);
+	for (unsigned int i = 0; i < scopes.size(); i++) {
+		string sIndent(4 * (m_pGpuProfiler->GetScopeDepth(scopes[i]) + 1), ' ');
+		sprintf_s(szLine, "%s%s: %.3f ms", sIndent.c_str(), m_pGpuProfiler->GetScopeName(scopes[i]).c_str(), 
+			m_pGpuProfiler->GetScopeAverage(scopes[i]));
+		m_hudLines.push_back(szLine);
+	}
+}
+
+// Records a draw into a job's list unless its object has been culled.  The sort depth is the view depth of the object's 
+// bounds.
+void Game::AddSceneDraw(int iJob, int iType, int iObject, COpenAssetImportMesh* pMesh, int iChunk, int iPass, int iProgram, int iMaterial, 
+	unsigned int uiState, glm::mat4 viewMatrix) {
+
+	if (iObject >= 0 && !IsObjectVisible(iObject))
+		return;
+
+	SceneDraw draw;
+	draw.iType = iType;
+	draw.iObject = iObject;
+	draw.pMesh = pMesh;
+	draw.iChunk = iChunk;
+	draw.modelViewMatrix = iObject >= 0 ? viewMatrix * m_objectModelMatrices[iObject] : viewMatrix;
+	draw.normalMatrix = m_pCamera->ComputeNormalMatrix(draw.modelViewMatrix);
+	draw.iJob = iJob;
+
+	RenderJobList &list = m_renderJobs[iJob];
+	list.draws.push_back(draw);
+
+	float fViewDepth = 0.0f;
+	if (iObject >= 0)
+		fViewDepth = -(viewMatrix * glm::vec4(m_pCullBounds->GetCentre(iObject), 1.0f)).z;
+	list.pCommands->Add(iPass, iProgram, iMaterial, uiState, fViewDepth, (int)list.draws.size() - 1);
+}
+
+// Draws one pass of the queue.  pPrograms and puiFeatures give the program for each RenderProgram slot; a program is only
+// bound, and the cull and blend state only set, when they differ from the previous draw's.  Each run of draws from the 
+// same part of the scene is a GPU profiler scope; once sorted, a part's runs are added together.
+void Game::ExecuteRenderQueue(int iPass, CShaderProgram** pPrograms, unsigned int* puiFeatures, bool bQueryPass, glm::mat4 viewMatrix) {
+
+	CPU_TRACE_SCOPE("Game::ExecuteRenderQueue");
+	static const char* renderJobNames[RENDER_JOB_COUNT] = { "Environment", "Convoys", "Pickups", "City", "Track", "HUD" };
+
+	CShaderProgram* pCurrentProgram = NULL;
+	unsigned int uiCurrentFeatures = 0;
+	unsigned int uiCurrentState = 0;
+	int iCurrentJob = -1;
+	glEnable(GL_CULL_FACE);
+	glDisable(GL_BLEND);
+
+	for (int i = 0; i < m_pRenderQueue->GetCount(); i++) {
+		const RenderCommand& command = m_pRenderQueue->GetCommand(i);
+		if (command.pass != iPass)
+			continue;
+
+		int iJob = m_sceneDraws[command.iDraw].iJob;
+		if (iJob != iCurrentJob) {
+			if (iCurrentJob >= 0)
+				m_pGpuProfiler->EndScope();
+			m_pGpuProfiler->BeginScope(renderJobNames[iJob]);
+			iCurrentJob = iJob;
+		}
+
+		CShaderProgram* pProgram = pPrograms[command.program];
+		if (pProgram != pCurrentProgram || puiFeatures[command.program] != uiCurrentFeatures) {
+			pCurrentProgram = pProgram;
+			uiCurrentFeatures = puiFeatures[command.program];
+			pCurrentProgram->UseProgram();
+			SetShaderFeatureUniforms(pCurrentProgram, uiCurrentFeatures);
+		}
+
+		unsigned int uiChanged = command.state ^ uiCurrentState;
+		if (uiChanged & RENDER_STATE_NO_CULL) {
+			if (command.state & RENDER_STATE_NO_CULL)
+				glDisable(GL_CULL_FACE);
+			else
+				glEnable(GL_CULL_FACE);
+		}
+		if (uiChanged & RENDER_STATE_BLEND) {
+			if (command.state & RENDER_STATE_BLEND) {
+				glEnable(GL_BLEND);
+				glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			}
+			else
+				glDisable(GL_BLEND);
+		}
+		uiCurrentState = command.state;
+
+		RenderSceneDraw(command.iDraw, pCurrentProgram, bQueryPass, viewMatrix);
+	}
+	if (iCurrentJob >= 0)
+		m_pGpuProfiler->EndScope();
+
+	glEnable(GL_CULL_FACE);
+	glDisable(GL_BLEND);
+}
+
+void Game::RenderSceneDraw(int iDraw, CShaderProgram* pProgram, bool bQueryPass, glm::mat4 viewMatrix) {
+
+	// The track is never occlusion tested; the other culled objects go through the occlusion queries
+	const SceneDraw& draw = m_sceneDraws[iDraw];
+	bool bSceneObject = draw.iObject >= 0 && draw.iType != DRAW_TRACK;
+	if (bSceneObject && !BeginSceneObject(draw.iObject, pProgram, viewMatrix, bQueryPass))
+		return;
+
+	pProgram->SetUniform("matrices.modelViewMatrix", draw.modelViewMatrix);
+	pProgram->SetUniform("matrices.normalMatrix", draw.normalMatrix);
+
+	switch (draw.iType) {
+	case DRAW_TERRAIN:
+		m_pPlanarTerrain->Render();
+		break;
+
+	case DRAW_MESH:
+		draw.pMesh->Render();
+		break;
+
+	case DRAW_STATIC_CHUNK:
+		draw.pMesh->RenderChunk(draw.iChunk);
+		break;
+
+	case DRAW_CUBE:
+		m_pCube->Render();
+		break;
+
+	case DRAW_TETRAHEDRON:
+		m_pTetrahedron->Render();
+		break;
+
+	case DRAW_CONVOY_BATCH:
+		pProgram->SetUniform("instanced", 1);
+		m_pEnvConvoyBatch->Render();
+		pProgram->SetUniform("instanced", 0);
+
+		// Instanced vehicles cannot be drawn conditionally one by one, so hidden ones wait for their box query to pass
+		if (bQueryPass && m_occlusionQueriesOn) {
+			for (int i = 0; i < ENV_CONVOY_COUNT * ENV_CONVOY_VEHICLES; i++) {
+				int iObject = OBJECT_ENV_VEHICLES + i;
+				if (IsObjectVisible(iObject) && !IsCameraNearObject(iObject) && m_pOcclusionQueries->IsQueryDue(iObject))
+					QueryObjectBounds(iObject, pProgram, viewMatrix);
+			}
+		}
+		break;
+
+	case DRAW_TRACK:
+		pProgram->SetUniform("discardTime", m_frame.pathDiscardTime);
+		pProgram->SetUniform("light1.La", glm::vec3(1.f));
+		pProgram->SetUniform("material1.Ma", glm::vec3(1.0f));	// Ambient material reflectance
+		m_pCatmullRom->RenderTrack();
+		break;
+
+	case DRAW_INDIRECT_BUCKET:
+		m_pGpuScene->RenderBucket(draw.iChunk);
+		break;
+	}
+
+	if (bSceneObject)
+		EndSceneObject();
+}
+
+// Starts drawing a scene object, returning false if it has been culled.  With occlusion queries on, an object seen last
+// frame has its draw queried now and then.  An object hidden last frame gets a bounding box query in the pass that 
+// writes depth, and is drawn under conditional rendering, so the GPU skips it if the box is still hidden.
+bool Game::BeginSceneObject(int iObject, CShaderProgram* pProgram, glm::mat4 viewMatrix, bool bQueryPass) {
+
+	m_sceneObjectQuery = false;
+	m_sceneObjectConditional = false;
+	if (!IsObjectVisible(iObject))
+		return false;
+	if (!m_occlusionQueriesOn || IsCameraNearObject(iObject))
+		return true;
+
+	if (m_pOcclusionQueries->WasVisible(iObject)) {
+		if (bQueryPass && m_pOcclusionQueries->IsQueryDue(iObject)) {
+			m_pOcclusionQueries->BeginQuery(iObject);
+			m_sceneObjectQuery = true;
+		}
+		return true;
+	}
+
+	if (bQueryPass && m_pOcclusionQueries->IsQueryDue(iObject))
+		QueryObjectBounds(iObject, pProgram, viewMatrix);
+	m_sceneObjectConditional = m_pOcclusionQueries->BeginConditionalRender(iObject);
+	return true;
+}
+
+void Game::EndSceneObject() {
+
+	if (m_sceneObjectQuery)
+		m_pOcclusionQueries->EndQuery();
+	if (m_sceneObjectConditional)
+		m_pOcclusionQueries->EndConditionalRender();
+	m_sceneObjectQuery = false;
+	m_sceneObjectConditional = false;
+}
+
+// Draws an object's bounding box in an occlusion query, without writing colour or depth
+void Game::QueryObjectBounds(int iObject, CShaderProgram* pProgram, glm::mat4 viewMatrix) {
+
+	GLboolean colourMask[4];
+	glGetBooleanv(GL_COLOR_WRITEMASK, colourMask);
+	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+	glDepthMask(GL_FALSE);
+
+	glm::mat4 boxMatrix = glm::scale(glm::translate(glm::mat4(1), m_pCullBounds->GetCentre(iObject)), m_pCullBounds->GetExtents(iObject));
+	pProgram->SetUniform("matrices.modelViewMatrix", viewMatrix * boxMatrix);
+	m_pOcclusionQueries->BeginQuery(iObject);
+	m_pOcclusionQueries->RenderBox();
+	m_pOcclusionQueries->EndQuery();
+
+	glColorMask(colourMask[0], colourMask[1], colourMask[2], colourMask[3]);
+	glDepthMask(GL_TRUE);
+}
+
+// The point on the centreline at a distance along the track, and the frame there: T along the track, N to the side and B up
+void Game::GetTrackFrame(float fDistance, glm::vec3 &p, glm::vec3 &up, glm::vec3 &T, glm::vec3 &N, glm::vec3 &B) {
+
+	m_pCatmullRom->Sample(fDistance, p, up);
+
+	glm::vec3 pNext, upNext;
+	m_pCatmullRom->Sample(fDistance + 1.0f, pNext, upNext);
+
+	T = glm::normalize(pNext - p); //(z axis)
+	N = glm::normalize(glm::cross(T, up)); //(x axis)
+	B = glm::normalize(glm::cross(N, T)); //(y axis)
+}
+
+// Where each track camera mode puts the camera and what it looks at, for the player strafed across the track by fStrafe
+void Game::GetTrackCamera(int iMode, float fStrafe, glm::vec3 p, glm::vec3 T, glm::vec3 N, glm::vec3 B, glm::vec3 &eye, glm::vec3 &view) {
+
+	if (iMode == 1) {
+		eye = p + (5.f * B) + (4.f * T) + (fStrafe * N);
+		view = p + (500.0f * T);
+	}
+	else if (iMode == 2) {
+		eye = p + (5.f * B) + (1.5f * T) + (fStrafe * N);
+		view = p + (500.0f * T);
+	}
+	else {
+		eye = p + (13.f * B) + (-30.f * T) + ((fStrafe * 0.7f) * N);
+		view = p + (200.0f * T);
+	}
+}
+
+// Bakes the potentially visible sets of the static chunks (run the game with --bakepvs).  For each camera mode and track 
+// sector, the chunks are rendered by ID on the CPU from cameras along the sector and across the track.
+void Game::BakePvs() {
+
+	vector<glm::vec3> triangles;
+	vector<int> triangleObjects;
+	int iFirstChunk = 0;
+	for (int i = 0; i < STATIC_MESH_COUNT; i++) {
+		COpenAssetImportMesh* pMesh = GetStaticMesh(i);
+		glm::mat4 modelMatrix = GetStaticMeshPlacement(i).GetModelMatrix();
+		const vector<glm::vec3> &meshTriangles = m_staticMeshTriangles[i];
+		for (unsigned int t = 0; t + 2 < meshTriangles.size(); t += 3) {
+			int iChunk = pMesh->FindChunk((meshTriangles[t] + meshTriangles[t + 1] + meshTriangles[t + 2]) / 3.0f);
+			if (iChunk < 0)
+				continue;
+			for (int k = 0; k < 3; k++)
+				triangles.push_back(glm::vec3(modelMatrix * glm::vec4(meshTriangles[t + k], 1.0f)));
+			triangleObjects.push_back(iFirstChunk + iChunk);
+		}
+		iFirstChunk += pMesh->GetChunkCount();
+	}
+
+	// The game's projection, widened
+	glm::mat4 projMatrix = *m_pCamera->GetPerspectiveProjectionMatrix();
+	projMatrix[0][0] /= PVS_FOV_MARGIN;
+	projMatrix[1][1] /= PVS_FOV_MARGIN;
+
+	float fTrackLength = m_pCatmullRom->GetTrackLength();
+	float fSectorLength = fTrackLength / PVS_SECTOR_COUNT;
+	float strafes[] = { -m_routeWidth * 0.4f, 0.0f, m_routeWidth * 0.4f };
+	vector<vector<glm::mat4> > setViews(TRACK_CAMERA_MODES * PVS_SECTOR_COUNT);
+	for (int iMode = 0; iMode < TRACK_CAMERA_MODES; iMode++) {
+		for (int iSector = 0; iSector < PVS_SECTOR_COUNT; iSector++) {
+			for (int iSample = 0; iSample < PVS_SAMPLES_PER_SECTOR; iSample++) {
+				glm::vec3 p, up, T, N, B;
+				GetTrackFrame(fSectorLength * (iSector + iSample / (float)(PVS_SAMPLES_PER_SECTOR - 1)), p, up, T, N, B);
+				for (int iStrafe = 0; iStrafe < 3; iStrafe++) {
+					glm::vec3 eye, view;
+					GetTrackCamera(iMode + 1, strafes[iStrafe], p, T, N, B, eye, view);
+					setViews[iMode * PVS_SECTOR_COUNT + iSector].push_back(projMatrix * glm::lookAt(eye, view, up));
+				}
+			}
+		}
+	}
+
+	m_pPvs->Bake(iFirstChunk, triangles, triangleObjects, TRACK_CAMERA_MODES, PVS_SECTOR_COUNT, fTrackLength, setViews, 
+		max(1, (int)thread::hardware_concurrency()));
+	if (!m_pPvs->Save(PVS_FILENAME))
+		MessageBox(NULL, "Could not save the potentially visible sets", "Error", MB_ICONERROR);
+}
+
+// Drives the player round the track at top speed in each track camera mode, with one simulation tick per frame, so every
+// run draws the same frames on any Windows machine with an OpenGL 4 GPU.  The frame pacer and the quality governor are off, so the times are the
+// frames' own.  Nothing that adapts to the GPU's timing is left to choose the work: the depth pre-pass is forced on rather
+// than automatic, and every shader variant is compiled before the frames are timed, so none are drawn with the uber
+// program.  It draws offscreen at a fixed size, without the HUD.  Writes the results, with the settings they were taken
+// with, to BENCHMARK_FILENAME.
+void Game::RunBenchmark() {
+
+	CPU_TRACE_SCOPE("Game::RunBenchmark");
+	m_pFramePacer->SetTargetRate(0);
+	m_pFramePacer->Start();
+	m_pQualityGovernor->SetEnabled(false);
+	m_pDepthPrepass->SetMode(CDepthPrepass::PREPASS_ON);
+	m_showHUD = false;
+	m_freeview = false;
+	m_showPath = true;
+	WaitForShaderCompiles();
+
+	int iRunFrames = (int) ceil(m_benchmarkLaps * m_pCatmullRom->GetTrackLength() / (m_topSpeed * m_dt));
+	CBenchmarkReport report;
+	for (int iMode = 1; iMode <= TRACK_CAMERA_MODES; iMode++) {
+
+		// Every run starts from the same place
+		m_cameraMode = iMode;
+		{
+			lock_guard<mutex> lock(m_simInputMutex);
+			m_pendingSimInput.bFreeview = false;
+			m_pendingSimInput.iCameraMode = iMode;
+			m_pendingSimInput.bShowPath = true;
+		}
+		m_currentDistance = 0.0f;
+		m_starshipStrafe = 0.0f;
+		m_cameraSpeed = m_topSpeed;
+		m_EnvCurrentDistance = 0.0f;
+		m_t = 0.0f;
+		m_pickupRotation = 0.0f;
+		m_cubePickedUp = false;
+		m_tetraPickedUp = false;
+		m_hudTime = 0.0f;
+		CaptureSnapshot(m_lastSnapshot);
+		m_pUpscaler->ResetHistory();
+
+		report.BeginRun(iMode, iRunFrames);
+		for (int iFrame = -BENCHMARK_WARMUP_FRAMES; iFrame < iRunFrames; iFrame++) {
+			MSG msg;
+			while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
+				if (msg.message == WM_QUIT)
+					return;
+				TranslateMessage(&msg);
+				DispatchMessage(&msg);
+			}
+
+			// The frame timer only starts in GameLoop, so the tick is timed here and added to the frame's times
+			CHighResolutionTimer tickTimer;
+			tickTimer.Start();
+			Tick(chrono::steady_clock::now());
+			double dSimTime = tickTimer.Elapsed();
+			GameLoop();
+
+			// The warm-up can request variants the start-up did not
+			if (iFrame == -1)
+				WaitForShaderCompiles();
+			if (iFrame >= 0)
+				report.AddFrame(m_frameTime + dSimTime, m_cpuFrameTime + dSimTime, dSimTime, m_pGpuProfiler->GetFrameTime(), m_glCounts);
+		}
+	}
+
+	BenchmarkSettings settings;
+	settings.laps = m_benchmarkLaps;
+	settings.width = m_benchmarkWidth;
+	settings.height = m_benchmarkHeight;
+	settings.tick = m_dt;
+	settings.speed = m_topSpeed;
+	settings.upscaling = m_upscalingOn;
+	settings.renderScale = m_upscalingOn ? m_renderScale : 1.0f;
+	settings.depthPrepass = m_pDepthPrepass->GetModeName();
+	settings.instancing = m_instancingOn;
+	settings.cpuOcclusion = m_occlusionCullingOn;
+	settings.occlusionQueries = m_occlusionQueriesOn;
+	settings.pvs = m_pvsOn && m_pPvs->IsLoaded();
+	settings.gpuDriven = IsGpuDrivenOn();
+	if (!report.Write(BENCHMARK_FILENAME, settings))
+		MessageBox(NULL, "Could not write the benchmark results", "Error", MB_ICONERROR);
+}
+
+// Finishes every shader variant that has been submitted, so the frames after it draw with the specialised programs
+void Game::WaitForShaderCompiles() {
+
+	m_pShaderCompiler->Poll();
+	while (m_pShaderCompiler->GetPendingCount() > 0) {
+		this_thread::sleep_for(chrono::milliseconds(1));
+		m_pShaderCompiler->Poll();
+	}
+}
+
+bool Game::IsCameraNearObject(int iObject) {
+
+	glm::vec3 offset = glm::abs(m_pCamera->GetPosition() - m_pCullBounds->GetCentre(iObject));
+	glm::vec3 reach = m_pCullBounds->GetExtents(iObject) + glm::vec3(OCCLUSION_QUERY_NEAR_MARGIN);
+	return offset.x <= reach.x && offset.y <= reach.y && offset.z <= reach.z;
+}
+
+// Collects the model matrix of every visible convoy vehicle, so each vehicle mesh is drawn once per pass with instancing
+void Game::BatchEnvConvoys() {
+
+	m_pEnvConvoyBatch->Clear();
+	for (int i = 0; i < ENV_CONVOY_COUNT * ENV_CONVOY_VEHICLES; i++) {
+		int iObject = OBJECT_ENV_VEHICLES + i;
+		bool bHidden = m_occlusionQueriesOn && !IsCameraNearObject(iObject) && !m_pOcclusionQueries->WasVisible(iObject);
+		if (IsObjectVisible(iObject) && !bHidden)
+			m_pEnvConvoyBatch->Add(GetEnvVehicleMesh(envConvoyLayout[i % ENV_CONVOY_VEHICLES].iMesh), m_objectModelMatrices[iObject]);
+	}
+	m_pEnvConvoyBatch->Upload();
+}
+
+// Works out the model matrix and world bounds of every scene object, then culls them against the camera's view
+void Game::UpdateSceneObjects(glm::mat4 viewMatrix) {
+
+	CPU_TRACE_SCOPE("Game::UpdateSceneObjects");
+	glm::vec3 boundsMin, boundsMax;
+	m_objectModelMatrices.resize(OBJECT_ENV_VEHICLES + ENV_CONVOY_COUNT * ENV_CONVOY_VEHICLES);
+	m_pCullBounds->Clear();
+
+	m_objectModelMatrices[OBJECT_HORSE] = glm::rotate(glm::translate(glm::mat4(1), glm::vec3(287.0f, 52.0f, -926.0f)), glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	m_pHorseMesh->GetBounds(boundsMin, boundsMax);
+	m_pCullBounds->AddBox(boundsMin, boundsMax, m_objectModelMatrices[OBJECT_HORSE]);
+
+	m_objectModelMatrices[OBJECT_FIGHTER] = glm::translate(glm::mat4(1), m_frame.spaceShipPosition + glm::vec3(700.f, 200.0f, -381.0f)) * m_frame.spaceShipOrientation;
+	m_pFighterMesh->GetBounds(boundsMin, boundsMax);
+	m_pCullBounds->AddBox(boundsMin, boundsMax, m_objectModelMatrices[OBJECT_FIGHTER]);
+
+	m_objectModelMatrices[OBJECT_STARSHIP] = glm::translate(glm::mat4(1), m_frame.starshipPosition) * m_frame.starshipOrientation;
+	m_pStarship->GetBounds(boundsMin, boundsMax);
+	m_pCullBounds->AddBox(boundsMin, boundsMax, m_objectModelMatrices[OBJECT_STARSHIP]);
+
+	// The pickups spin and are drawn at twice their size
+	m_objectModelMatrices[OBJECT_CUBE] = glm::scale(glm::rotate(glm::translate(glm::mat4(1), m_cubePosition), glm::radians(m_frame.pickupRotation), glm::vec3(0.0f, 1.0f, 0.0f)), glm::vec3(2.f));
+	m_pCullBounds->AddBox(glm::vec3(-1.0f), glm::vec3(1.0f), m_objectModelMatrices[OBJECT_CUBE]);
+
+	m_objectModelMatrices[OBJECT_TETRAHEDRON] = glm::scale(glm::rotate(glm::translate(glm::mat4(1), m_tetraPosition), glm::radians(m_frame.pickupRotation), glm::vec3(0.0f, 1.0f, 0.0f)), glm::vec3(2.f));
+	m_pCullBounds->AddBox(glm::vec3(-2.0f, 0.0f, -2.0f), glm::vec3(2.0f), m_objectModelMatrices[OBJECT_TETRAHEDRON]);
+
+	m_objectModelMatrices[OBJECT_TRACK] = glm::mat4(1);
+	m_pCatmullRom->GetTrackBounds(boundsMin, boundsMax);
+	m_pCullBounds->AddBox(boundsMin, boundsMax, m_objectModelMatrices[OBJECT_TRACK]);
+
+	for (int i = 0; i < ENV_CONVOY_COUNT; i++) {
+		for (int j = 0; j < ENV_CONVOY_VEHICLES; j++) {
+			int iObject = OBJECT_ENV_VEHICLES + i * ENV_CONVOY_VEHICLES + j;
+			m_objectModelMatrices[iObject] = glm::translate(glm::mat4(1), m_frame.envStarshipPositions[i] + envConvoyLayout[j].offset) * m_frame.envStarshipOrientations[i];
+			GetEnvVehicleMesh(envConvoyLayout[j].iMesh)->GetBounds(boundsMin, boundsMax);
+			m_pCullBounds->AddBox(boundsMin, boundsMax, m_objectModelMatrices[iObject]);
+		}
+	}
+
+	for (int i = 0; i < STATIC_MESH_COUNT; i++) {
+		glm::mat4 modelMatrix = GetStaticMeshPlacement(i).GetModelMatrix();
+		COpenAssetImportMesh* pMesh = GetStaticMesh(i);
+		for (int c = 0; c < pMesh->GetChunkCount(); c++) {
+			m_objectModelMatrices.push_back(modelMatrix);
+			pMesh->GetChunkBounds(c, boundsMin, boundsMax);
+			m_pCullBounds->AddBox(boundsMin, boundsMax, modelMatrix);
+		}
+	}
+
+	m_pFrustum->Extract(*m_pCamera->GetPerspectiveProjectionMatrix(), viewMatrix);
+	glm::vec3 cameraForward = glm::normalize(m_pCamera->GetView() - m_pCamera->GetPosition());
+	m_pFrustum->SetFarDistance(m_pCamera->GetPosition(), cameraForward, GetFogCutoffDistance());
+	if (m_cullingOn)
+		m_objectsDrawn = m_pFrustum->Cull(*m_pCullBounds, m_objectVisible);
+	else {
+		m_objectVisible.assign(m_pCullBounds->GetCount(), 1);
+		m_objectsDrawn = m_pCullBounds->GetCount();
+	}
+
+	// On the track, the static chunks the baked set for this sector leaves out cannot be seen.  The free camera can go 
+	// anywhere, so it relies on the dynamic culling alone.
+	m_objectsPvsCulled = 0;
+	if (m_pvsOn && !m_freeview && m_pPvs->IsLoaded()) {
+		m_pvsSector = m_pPvs->GetSector(m_frame.currentDistance);
+		const vector<unsigned char>& pvsVisible = m_pPvs->GetVisibleObjects(m_cameraMode - 1, m_pvsSector);
+		for (unsigned int i = 0; i < pvsVisible.size(); i++) {
+			int iObject = m_staticChunkObjects[0] + i;
+			if (m_objectVisible[iObject] && !pvsVisible[i]) {
+				m_objectVisible[iObject] = 0;
+				m_objectsPvsCulled++;
+			}
+		}
+		m_objectsDrawn -= m_objectsPvsCulled;
+	}
+
+	// Then drop what the buildings hide
+	m_objectsOccluded = 0;
+	if (m_occlusionCullingOn) {
+		CHighResolutionTimer timer;
+		timer.Start();
+		m_pOcclusionBuffer->Render(*m_pCamera->GetPerspectiveProjectionMatrix() * viewMatrix);
+		for (int i = 0; i < m_pCullBounds->GetCount(); i++) {
+			if (m_objectVisible[i] && !m_pOcclusionBuffer->IsVisible(m_pCullBounds->GetCentre(i), m_pCullBounds->GetExtents(i))) {
+				m_objectVisible[i] = 0;
+				m_objectsOccluded++;
+			}
+		}
+		m_objectsDrawn -= m_objectsOccluded;
+		m_occlusionTime = timer.Elapsed();
+	}
+
+	// The GPU queries carry on from whatever results have arrived.  Objects culled above start again as visible.
+	if (m_occlusionQueriesOn) {
+		m_pOcclusionQueries->BeginFrame(m_pCullBounds->GetCount());
+		for (int i = 0; i < m_pCullBounds->GetCount(); i++) {
+			if (!m_objectVisible[i])
+				m_pOcclusionQueries->MarkCulled(i);
+		}
+	}
+}
+
+// The frame pacer's period, or the default rate's if it has no limit
+double Game::GetFrameBudget()
+{
+	int iTargetRate = m_pFramePacer->GetTargetRate() > 0 ? m_pFramePacer->GetTargetRate() : FPS;
+	return 1000.0 / iTargetRate;
+}
+
+RECT Game::GetOutputDimensions()
+{
+	if (m_benchmarkLaps == 0)
+		return m_gameWindow.GetDimensions();
+	RECT dimensions = {0, 0, m_benchmarkWidth, m_benchmarkHeight};
+	return dimensions;
+}
+
+// Feeds the frame's times to the quality governor, aiming at the frame pacer's period, and applies the far plane it sets.
+// The other settings are read where they are used.
+void Game::UpdateQualityGovernor() {
+
+	m_pQualityGovernor->SetTarget(GetFrameBudget());
+	m_pQualityGovernor->Update(m_cpuFrameTime, m_pGpuProfiler->GetFrameTime());
+
+	float fFarPlane = m_pQualityGovernor->GetSettings().farPlane;
+	if (fFarPlane != m_farPlane) {
+		m_farPlane = fFarPlane;
+		RECT dimensions = GetOutputDimensions();
+		int width = dimensions.right - dimensions.left;
+		int height = dimensions.bottom - dimensions.top;
+		m_pCamera->SetPerspectiveProjectionMatrix(45.0f, (float) width / (float) height, 0.5f, m_farPlane);
+	}
+}
+
+// The distance beyond which the fog hides everything, or the far plane with fog off.  The quality governor can pull the
+// fog distance in further, letting distant objects pop out of the fog.
+float Game::GetFogCutoffDistance() {
+
+	if (!m_fogOn)
+		return m_farPlane;
+	float fCutoff = logf(0.5f / FOG_VISIBLE_CONTRAST) / FOG_DENSITY * m_pQualityGovernor->GetSettings().cullDistanceScale;
+	return glm::min(fCutoff, m_farPlane);
+}
+
+bool Game::IsGpuDrivenOn() {
+	return m_gpuDrivenOn && m_pGpuScene->IsCreated();
+}
+
+bool Game::IsObjectVisible(int iObject) {
+	return m_objectVisible[iObject] != 0;
+}
+
+COpenAssetImportMesh* Game::GetStaticMesh(int iMesh) {
+
+	switch (iMesh) {
+	case STATIC_MESH_DOWNTOWN:
+		return m_pDowntown;
+	case STATIC_MESH_CITY:
+		return m_pCity;
+	default:
+		return m_pCenterCity;
+	}
+}
+
+COpenAssetImportMesh* Game::GetEnvVehicleMesh(int iMesh) {
+
+	switch (iMesh) {
+	case ENV_STARSHIP:
+		return m_pStarship;
+	case ENV_FREIGHTER:
+		return m_pFreighter;
+	case ENV_TRANSPORT:
+		return m_pTransport;
+	case ENV_FLYING_CAR:
+		return m_pFlyingCar;
+	case ENV_POLICE_CAR:
+		return m_pPoliceCar;
+	default:
+		return m_pPatrolCar;
+	}
+}
+
+// Starts the simulation thread, with the state Initialise set up published as the first snapshot
+void Game::StartSimulation() {
+
+	m_tickInputTime = chrono::steady_clock::now();
+	CaptureSnapshot(m_lastSnapshot);
+	PublishSnapshot(chrono::steady_clock::now());
+	UpdateFrameState();
+
+	m_stopSimulation = false;
+	m_simThread = thread(&Game::SimulationLoop, this);
+}
+
+void Game::StopSimulation() {
+
+	if (!m_simThread.joinable())
+		return;
+	m_stopSimulation = true;
+	m_simThread.join();
+}
+
+// Runs the ticks that have come due, publishing a snapshot after each, then sleeps until the next.  Every tick steps the
+// game by the same m_dt, so the game plays the same whatever the frame rate, and a slow frame never holds it up.
+void Game::SimulationLoop() {
+
+	CPU_TRACE_THREAD_NAME("Simulation");
+	chrono::steady_clock::duration tick = chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double, milli>(SIM_TICK_MS));
+	chrono::steady_clock::time_point nextTick = chrono::steady_clock::now();
+	while (!m_stopSimulation) {
+		if (m_simPaused) {
+			this_thread::sleep_for(chrono::milliseconds(50));
+			nextTick = chrono::steady_clock::now();
+			continue;
+		}
+
+		chrono::steady_clock::time_point now = chrono::steady_clock::now();
+		for (int i = 0; i < SIM_MAX_CATCH_UP_TICKS && nextTick <= now; i++) {
+			Tick(nextTick);
+			nextTick += tick;
+		}
+		if (nextTick <= now)
+			nextTick = now;
+
+		this_thread::sleep_until(nextTick);
+	}
+}
+
+// Steps the game by m_dt with the latest input, and publishes the result as a snapshot
+void Game::Tick(chrono::steady_clock::time_point tickTime) {
+
+	{
+		lock_guard<mutex> lock(m_simInputMutex);
+		m_simInput = m_pendingSimInput;
+		m_pendingSimInput.bResetPath = false;
+	}
+	m_tickInputTime = chrono::steady_clock::now();
+	Update();
+	PublishSnapshot(tickTime);
+}
+
+// Copies what the renderer reads out of the simulation's members
+void Game::CaptureSnapshot(SimSnapshot &snapshot) {
+
+	snapshot.cameraPosition = m_pSimCamera->GetPosition();
+	snapshot.cameraView = m_pSimCamera->GetView();
+	snapshot.cameraUp = m_pSimCamera->GetUpVector();
+	snapshot.spaceShipPosition = m_spaceShipPosition;
+	snapshot.spaceShipOrientation = m_spaceShipOrientation;
+	snapshot.starshipPosition = m_starshipPosition;
+	snapshot.starshipOrientation = m_starshipOrientation;
+	snapshot.starshipFrontLightPosition = m_starshipFrontLightPosition;
+	snapshot.starshipBackLightPosition = m_starshipBackLightPosition;
+	snapshot.starship_B = m_starship_B;
+	for (int i = 0; i < ENV_CONVOY_COUNT; i++) {
+		snapshot.envStarshipPositions[i] = m_EnvStarshipPositions[i];
+		snapshot.envStarshipOrientations[i] = m_EnvStarshipOrientations[i];
+	}
+	snapshot.pickupRotation = m_pickupRotation;
+	snapshot.cubePickedUp = m_cubePickedUp;
+	snapshot.tetraPickedUp = m_tetraPickedUp;
+	snapshot.cameraSpeed = m_cameraSpeed;
+	snapshot.hudTime = m_hudTime;
+	snapshot.currentDistance = m_currentDistance;
+	snapshot.pathDiscardTime = m_pathDiscardTime;
+	snapshot.inputTime = m_tickInputTime;
+}
+
+void Game::PublishSnapshot(chrono::steady_clock::time_point tickTime) {
+
+	SimFrame &frame = m_pSimFrames->GetWriteBuffer();
+	frame.previous = m_lastSnapshot;
+	CaptureSnapshot(frame.current);
+	frame.tickTime = tickTime;
+	m_lastSnapshot = frame.current;
+	m_pSimFrames->Publish();
+}
+
+// Works out the state to draw this frame.  The frame is drawn a tick behind the simulation, so it can blend from the
+// previous snapshot to the latest one as the tick passes.  Counts and flags are taken from the latest.
+void Game::UpdateFrameState() {
+
+	CPU_TRACE_SCOPE("Game::UpdateFrameState");
+	m_pSimFrames->Acquire();
+	const SimFrame &frame = m_pSimFrames->GetReadBuffer();
+	const SimSnapshot &a = frame.previous;
+	const SimSnapshot &b = frame.current;
+
+	chrono::duration<double, milli> sinceTick = chrono::steady_clock::now() - frame.tickTime;
+	float t = (float)glm::clamp(sinceTick.count() / SIM_TICK_MS, 0.0, 1.0);
+
+	// Low-latency mode draws the latest snapshot as it is, rather than a tick behind, as does the benchmark, which ticks
+	// once a frame
+	if (m_lowLatencyOn || m_benchmarkLaps > 0)
+		t = 1.0f;
+
+	m_frame = b;
+	m_frame.cameraPosition = glm::mix(a.cameraPosition, b.cameraPosition, t);
+	m_frame.cameraView = glm::mix(a.cameraView, b.cameraView, t);
+	m_frame.cameraUp = glm::normalize(glm::mix(a.cameraUp, b.cameraUp, t));
+	m_frame.spaceShipPosition = glm::mix(a.spaceShipPosition, b.spaceShipPosition, t);
+	m_frame.spaceShipOrientation = InterpolateOrientation(a.spaceShipOrientation, b.spaceShipOrientation, t);
+	m_frame.starshipPosition = glm::mix(a.starshipPosition, b.starshipPosition, t);
+	m_frame.starshipOrientation = InterpolateOrientation(a.starshipOrientation, b.starshipOrientation, t);
+	m_frame.starshipFrontLightPosition = glm::mix(a.starshipFrontLightPosition, b.starshipFrontLightPosition, t);
+	m_frame.starshipBackLightPosition = glm::mix(a.starshipBackLightPosition, b.starshipBackLightPosition, t);
+	m_frame.starship_B = glm::normalize(glm::mix(a.starship_B, b.starship_B, t));
+	for (int i = 0; i < ENV_CONVOY_COUNT; i++) {
+		m_frame.envStarshipPositions[i] = glm::mix(a.envStarshipPositions[i], b.envStarshipPositions[i], t);
+		m_frame.envStarshipOrientations[i] = InterpolateOrientation(a.envStarshipOrientations[i], b.envStarshipOrientations[i], t);
+	}
+
+	// The pickups' rotation wraps from 360 back to 0
+	float fRotation = b.pickupRotation - a.pickupRotation;
+	if (fRotation < -180.0f)
+		fRotation += 360.0f;
+	m_frame.pickupRotation = a.pickupRotation + fRotation * t;
+
+	m_pCamera->Set(m_frame.cameraPosition, m_frame.cameraView, m_frame.cameraUp);
 }
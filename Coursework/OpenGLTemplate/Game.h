@@ -3,6 +3,10 @@
 #include "Common.h"
 #include "GameWindow.h"
 #include "MatrixStack.h"
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
 
 // Classes used in game.  For a new class, declare it here and provide a pointer to an object of this class below.  Then, in Game.cpp, 
 // include the header.  In the Game constructor, set the pointer to NULL and in Game::Initialise, create a new object.  Don't forget to 
@@ -20,6 +24,33 @@ class CAudio;
 class CCube;
 class CTetrahedron;
 class CCatmullRom;
+class CShaderPermutations;
+class CProgramBinaryCache;
+class CBakedLighting;
+class CDepthPrepass;
+class CShaderCompiler;
+class CInstancedMeshBatch;
+class CFrustum;
+class CCullBounds;
+class COcclusionBuffer;
+struct OccluderBox;
+class COcclusionQueries;
+class CPotentiallyVisibleSet;
+class CRenderQueue;
+class CRenderCommandList;
+class CWorkerThreads;
+class CJobSystem;
+class CFramePacer;
+class CFrameLatencyLimiter;
+template <class T> class CTripleBuffer;
+class CMeshPool;
+class CGpuDrivenScene;
+class CRenderTarget;
+class CGpuProfiler;
+class CQualityGovernor;
+class CTemporalUpscaler;
+class CFrameStats;
+class CFrameTimeGraph;
 
 class Game {
 private:
@@ -31,7 +62,33 @@ private:
 	// Pointers to game objects.  They will get allocated in Game::Initialise()
 	CSkybox *m_pSkybox;
 	CCamera *m_pCamera;
+	CCamera *m_pSimCamera;
 	vector <CShaderProgram *> *m_pShaderPrograms;
+	CShaderPermutations *m_pSpotlightShaders;
+	CProgramBinaryCache *m_pProgramBinaryCache;
+	CShaderCompiler *m_pShaderCompiler;
+	CDepthPrepass *m_pDepthPrepass;
+	CInstancedMeshBatch *m_pEnvConvoyBatch;
+	CFrustum *m_pFrustum;
+	CCullBounds *m_pCullBounds;
+	COcclusionBuffer *m_pOcclusionBuffer;
+	COcclusionQueries *m_pOcclusionQueries;
+	CPotentiallyVisibleSet *m_pPvs;
+	CRenderQueue *m_pRenderQueue;
+	CWorkerThreads *m_pRenderWorkers;
+	CJobSystem *m_pJobSystem;
+	CFramePacer *m_pFramePacer;
+	CFrameLatencyLimiter *m_pLatencyLimiter;
+	CMeshPool *m_pMeshPool;
+	CGpuDrivenScene *m_pGpuScene;
+	CShaderPermutations *m_pIndirectShaders;
+	CShaderProgram *m_pIndirectDepthProgram;
+	CRenderTarget *m_pSceneTarget;
+	CGpuProfiler *m_pGpuProfiler;
+	CQualityGovernor *m_pQualityGovernor;
+	CTemporalUpscaler *m_pUpscaler;
+	CFrameStats *m_pFrameStats;
+	CFrameTimeGraph *m_pFrameTimeGraph;
 	CPlane *m_pPlanarTerrain;
 	CFreeTypeFont *m_pFtFont;
 	COpenAssetImportMesh *m_pBarrelMesh;
@@ -58,9 +115,14 @@ private:
 	void HandleMovement();
 	void HandleEnvShips();
 	void HandlePickups();
+	bool LoadStaticMesh(COpenAssetImportMesh* pMesh, int iMesh, vector<OccluderBox> &occluders);
+	void BakePvs();
+	void RunBenchmark();
+	void WaitForShaderCompiles();
 
 	// Some other member variables
-	double m_dt;
+	double m_dt;					// The simulation's fixed tick
+	double m_frameTime;
 	int m_framesPerSecond;
 	bool m_appActive;
 
@@ -76,10 +138,20 @@ public:
 	static Game& GetInstance();
 	LRESULT ProcessEvents(HWND window,UINT message, WPARAM w_param, LPARAM l_param);
 	void SetHinstance(HINSTANCE hinstance);
+	void SetCommandLine(const char* szCommandLine);
 	WPARAM Execute();
 
 private:
-	static const int FPS = 60;
+	static const int FPS = 60;		// The frame pacer's target, unless --fps is given
+	int m_targetFrameRate;
+	bool m_lowLatencyOn;
+	double m_inputLatency;
+	float m_farPlane;				// Set by the quality governor, up to CAMERA_FAR_PLANE
+	double m_cpuFrameTime;			// Of the last frame, up to the swap and less any wait for the GPU
+	GLFrameCounts m_glCounts;		// The GL calls of the last frame
+	bool m_upscalingOn;
+	float m_renderScale;			// Of the window's width and height, while upscaling
+	glm::mat4 m_previousViewProjection;
 	void DisplayFrameRate();
 	void GameLoop();
 	GameWindow m_gameWindow;
@@ -87,8 +159,32 @@ private:
 	int m_frameCount;
 	double m_elapsedTime;
 
+	void SetShaderFeatureUniforms(CShaderProgram* pSpotlightProgram, unsigned int uiFeatures);
+	void SetSpotlightUniforms(CShaderProgram* pSpotlightProgram, glm::mat4 viewMatrix, glm::mat3 viewNormalMatrix, bool bCityLights = true);
+	void BuildRenderQueue(glm::mat4 viewMatrix);
+	void RecordRenderJob(int iJob, glm::mat4 viewMatrix);
+	void RecordHudLines();
+	void AddSceneDraw(int iJob, int iType, int iObject, COpenAssetImportMesh* pMesh, int iChunk, int iPass, int iProgram, int iMaterial, unsigned int uiState, 
+		glm::mat4 viewMatrix);
+	void ExecuteRenderQueue(int iPass, CShaderProgram** pPrograms, unsigned int* puiFeatures, bool bQueryPass, glm::mat4 viewMatrix);
+	void RenderSceneDraw(int iDraw, CShaderProgram* pProgram, bool bQueryPass, glm::mat4 viewMatrix);
 	void RenderLights(CShaderProgram* pSpotlightProgram, glm::mat4 viewMatrix, glm::mat3 viewNormalMatrix);
-	void RenderEnvCars(CShaderProgram* pSpotlightProgram, glutil::MatrixStack modelViewMatrixStack, glm::vec3 EnvStarshipPosition, glm::mat4 EnvStarshipOrientation);
+	void BatchEnvConvoys();
+	void UpdateSceneObjects(glm::mat4 viewMatrix);
+	bool IsObjectVisible(int iObject);
+	bool IsGpuDrivenOn();
+	float GetFogCutoffDistance();
+	void UpdateQualityGovernor();
+	double GetFrameBudget();			// Milliseconds, the frame pacer's period
+	RECT GetOutputDimensions();			// The size frames are drawn at: the window's, or the benchmark's
+	COpenAssetImportMesh* GetEnvVehicleMesh(int iMesh);
+	COpenAssetImportMesh* GetStaticMesh(int iMesh);
+	bool BeginSceneObject(int iObject, CShaderProgram* pProgram, glm::mat4 viewMatrix, bool bQueryPass);
+	void EndSceneObject();
+	void QueryObjectBounds(int iObject, CShaderProgram* pProgram, glm::mat4 viewMatrix);
+	bool IsCameraNearObject(int iObject);
+	void GetTrackFrame(float fDistance, glm::vec3 &p, glm::vec3 &up, glm::vec3 &T, glm::vec3 &N, glm::vec3 &B);
+	void GetTrackCamera(int iMode, float fStrafe, glm::vec3 p, glm::vec3 T, glm::vec3 N, glm::vec3 B, glm::vec3 &eye, glm::vec3 &view);
 
 	float m_t;
 	glm::vec3 m_spaceShipPosition;
@@ -133,37 +229,157 @@ private:
 
 	bool m_fogOn;
 
-	//environment ships
-	float m_EnvCurrentDistance;
-	glm::vec3 m_EnvStarshipPosition;
-	glm::mat4 m_EnvStarshipOrientation;
+	// baked city lighting
+	bool m_bakedLightingAvailable;
+	bool m_bakedLightingOn;
 
-	glm::vec3 m_EnvStarshipPosition2;
-	glm::mat4 m_EnvStarshipOrientation2;
+	// Objects that are placed and culled each frame.  The convoy vehicles follow from OBJECT_ENV_VEHICLES, then the 
+	// chunks of each static city mesh from m_staticChunkObjects.
+	enum SceneObject
+	{
+		OBJECT_HORSE,
+		OBJECT_FIGHTER,
+		OBJECT_STARSHIP,
+		OBJECT_CUBE,
+		OBJECT_TETRAHEDRON,
+		OBJECT_TRACK,
+		OBJECT_ENV_VEHICLES,
+	};
+	vector<int> m_staticChunkObjects;
+	vector<glm::mat4> m_objectModelMatrices;
+	vector<unsigned char> m_objectVisible;
+	int m_objectsDrawn;
+	bool m_cullingOn;
+	int m_objectsOccluded;
+	double m_occlusionTime;
+	bool m_occlusionCullingOn;
+	bool m_occlusionQueriesOn;
+	bool m_sceneObjectQuery;		// The object being drawn is wrapped in a query
+	bool m_sceneObjectConditional;	// The object being drawn is under conditional rendering
+	bool m_pvsOn;
+	bool m_bakePvs;					// Bake the potentially visible sets and quit, rather than play (--bakepvs)
+	bool m_jobBench;				// Run the job system's micro-benchmarks and quit (--jobbench)
+	int m_benchmarkLaps;			// Laps per camera mode to benchmark before quitting (--benchmark, Windows GPU host only), or 0 to play
+	int m_benchmarkWidth;			// The benchmark's offscreen resolution (--benchmark-size)
+	int m_benchmarkHeight;
+	int m_objectsPvsCulled;
+	int m_pvsSector;
+	vector<vector<glm::vec3> > m_staticMeshTriangles;	// Object-space triangles of each static mesh, kept for baking
 
-	glm::vec3 m_EnvStarshipPosition3;
-	glm::mat4 m_EnvStarshipOrientation3;
+	// What a queued draw renders.  pMesh is set for meshes and static chunks.
+	enum SceneDrawType
+	{
+		DRAW_TERRAIN,
+		DRAW_MESH,
+		DRAW_STATIC_CHUNK,
+		DRAW_CUBE,
+		DRAW_TETRAHEDRON,
+		DRAW_CONVOY_BATCH,
+		DRAW_TRACK,
+		DRAW_INDIRECT_BUCKET,
+	};
+	struct SceneDraw
+	{
+		int iType;
+		int iObject;				// Scene object, or -1 for draws that are not culled
+		COpenAssetImportMesh* pMesh;
+		int iChunk;					// Or the bucket, for the GPU-driven draws
+		glm::mat4 modelViewMatrix;	// Worked out while recording, so replaying the draw only sets uniforms
+		glm::mat3 normalMatrix;
+		int iJob;					// The RenderJob that recorded it, which names its GPU profiler scope
+	};
+	vector<SceneDraw> m_sceneDraws;
+	bool m_renderSortingOn;
 
-	glm::vec3 m_EnvStarshipPosition4;
-	glm::mat4 m_EnvStarshipOrientation4;
+	// The draws are recorded by a job for each part of the scene, run in parallel on the render workers.  Each job has its
+	// own draws and commands, which are merged in job order, so the unsorted queue keeps the old drawing order.
+	enum RenderJob
+	{
+		RENDER_JOB_ENVIRONMENT,
+		RENDER_JOB_CONVOYS,
+		RENDER_JOB_PICKUPS,
+		RENDER_JOB_CITY,
+		RENDER_JOB_TRACK,
+		RENDER_JOB_HUD,				// Formats the debug text, rather than recording draws
+		RENDER_JOB_COUNT,
+	};
+	struct RenderJobList
+	{
+		vector<SceneDraw> draws;
+		CRenderCommandList* pCommands;
+	};
+	RenderJobList m_renderJobs[RENDER_JOB_COUNT];
+	vector<string> m_hudLines;		// Debug text, a line at a time from the top of the screen
+	bool m_parallelRecordingOn;
+	double m_recordingTime;
 
-	glm::vec3 m_EnvStarshipPosition5;
-	glm::mat4 m_EnvStarshipOrientation5;
+	// The static chunks and convoy vehicles can instead be culled on the GPU and drawn with indirect multi-draws
+	bool m_gpuDrivenOn;
 
-	glm::vec3 m_EnvStarshipPosition6;
-	glm::mat4 m_EnvStarshipOrientation6;
+	//environment ships
+	static const int ENV_CONVOY_COUNT = 6;
+	float m_EnvCurrentDistance;
+	glm::vec3 m_EnvStarshipPositions[ENV_CONVOY_COUNT];
+	glm::mat4 m_EnvStarshipOrientations[ENV_CONVOY_COUNT];
+	bool m_instancingOn;
 
 	//light colours
 	glm::vec3 headlightColour;
-	const glm::vec3 white = glm::vec3(5.f);
-	const glm::vec3 red = glm::vec3(1, 0.050, 0.2) * 5.f;
-	const glm::vec3 green = glm::vec3(0.450, 0.941, 0.078) * 5.f;
-	const glm::vec3 blue = glm::vec3(0.078, 0.262, 0.941) * 5.f;
-	const glm::vec3 teal = glm::vec3(0.f, 5.f, 5.f);
-	const glm::vec3 aqua = glm::vec3(0.043f, 0.796f, 0.486f) * 5.f;
-	const glm::vec3 pink = glm::vec3(1, 0.321, 0.745) * 8.f;
-	const glm::vec3 purple = glm::vec3(0.450, 0.141, 0.898) * 5.f;
-	const glm::vec3 yellow = glm::vec3(0.996, 0.803, 0.403) * 5.f;
-	const glm::vec3 magenta = glm::vec3(1, 0, 1) * 4.f;
-	
+
+	// Update runs at a fixed tick on the simulation thread, which owns the members it changes and its own camera.  After
+	// each tick it publishes the previous and new snapshots of what the renderer reads, and the render thread draws m_frame,
+	// interpolated between them.  The game's toggles reach the simulation through m_pendingSimInput.
+	struct SimSnapshot
+	{
+		glm::vec3 cameraPosition;
+		glm::vec3 cameraView;
+		glm::vec3 cameraUp;
+		glm::vec3 spaceShipPosition;
+		glm::mat4 spaceShipOrientation;
+		glm::vec3 starshipPosition;
+		glm::mat4 starshipOrientation;
+		glm::vec3 starshipFrontLightPosition;
+		glm::vec3 starshipBackLightPosition;
+		glm::vec3 starship_B;
+		glm::vec3 envStarshipPositions[ENV_CONVOY_COUNT];
+		glm::mat4 envStarshipOrientations[ENV_CONVOY_COUNT];
+		float pickupRotation;
+		bool cubePickedUp;
+		bool tetraPickedUp;
+		float cameraSpeed;
+		float hudTime;
+		float currentDistance;
+		float pathDiscardTime;
+		chrono::steady_clock::time_point inputTime;	// When the tick that made this read the input
+	};
+	struct SimFrame
+	{
+		SimSnapshot previous;
+		SimSnapshot current;
+		chrono::steady_clock::time_point tickTime;	// When current was due
+	};
+	struct SimInput
+	{
+		bool bFreeview;
+		int iCameraMode;
+		bool bShowPath;
+		bool bResetPath;			// F5 was pressed
+	};
+	void StartSimulation();
+	void StopSimulation();
+	void SimulationLoop();
+	void Tick(chrono::steady_clock::time_point tickTime);
+	void CaptureSnapshot(SimSnapshot &snapshot);
+	void PublishSnapshot(chrono::steady_clock::time_point tickTime);
+	void UpdateFrameState();
+	CTripleBuffer<SimFrame> *m_pSimFrames;
+	thread m_simThread;
+	atomic<bool> m_stopSimulation;
+	atomic<bool> m_simPaused;
+	mutex m_simInputMutex;
+	SimInput m_pendingSimInput;
+	SimInput m_simInput;			// The simulation's copy, taken each tick
+	chrono::steady_clock::time_point m_tickInputTime;
+	SimSnapshot m_lastSnapshot;
+	SimSnapshot m_frame;
 };
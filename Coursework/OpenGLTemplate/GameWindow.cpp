@@ -114,7 +114,7 @@ bool GameWindow::InitGLEW()
 }
 
 // Initialise GLEW and create the real game window
-HDC GameWindow::Init(HINSTANCE hinstance) 
+HDC GameWindow::Init(HINSTANCE hinstance, bool bVisible) 
 {
 	m_hinstance = hinstance;
 	if(!InitGLEW())
@@ -122,7 +122,7 @@ HDC GameWindow::Init(HINSTANCE hinstance)
 
 	m_appName = "OpenGL";
 
-	CreateGameWindow("OpenGL Template");
+	CreateGameWindow("OpenGL Template", bVisible);
 
 	// If we never got a valid window handle, quit the program
 	if(m_hwnd == NULL) {
@@ -133,7 +133,7 @@ HDC GameWindow::Init(HINSTANCE hinstance)
 }
 
 // Create the game window
-void GameWindow::CreateGameWindow(string sTitle) 
+void GameWindow::CreateGameWindow(string sTitle, bool bVisible) 
 {
 	WNDCLASSEX wcex;
 	memset(&wcex, 0, sizeof(WNDCLASSEX));
@@ -179,7 +179,7 @@ void GameWindow::CreateGameWindow(string sTitle)
 	// Initialise OpenGL here
 	InitOpenGL();
 	
-	ShowWindow(m_hwnd, SW_SHOW);
+	ShowWindow(m_hwnd, bVisible ? SW_SHOW : SW_HIDE);
 	GetClientRect(m_hwnd, &m_dimensions);
 
 	UpdateWindow(m_hwnd);
@@ -199,7 +199,7 @@ void GameWindow::InitOpenGL()
 	PIXELFORMATDESCRIPTOR pfd;
 
 	int iMajorVersion = 4;
-	int iMinorVersion = 0;
+	int iMinorVersion = 3;
 
 	if(iMajorVersion <= 2)
 	{
@@ -251,7 +251,12 @@ void GameWindow::InitOpenGL()
 		// PFD seems to be only redundant parameter now
 		if(!SetPixelFormat(m_hdc, iPixelFormat, &pfd))return;
 
+		// 4.3 adds compute shaders and indirect multi-draws, used by the GPU-driven renderer; the rest only needs 4.0
 		m_hrc = wglCreateContextAttribsARB(m_hdc, 0, iContextAttribs);
+		if (!m_hrc) {
+			iContextAttribs[3] = iMinorVersion = 0;
+			m_hrc = wglCreateContextAttribsARB(m_hdc, 0, iContextAttribs);
+		}
 		// If everything went OK
 		if(m_hrc) wglMakeCurrent(m_hdc, m_hrc);
 		else bError = true;
@@ -273,6 +278,28 @@ void GameWindow::InitOpenGL()
 	return;
 }
 
+// Creates a second context with the same version as the main one, sharing its objects.  It can be made current on another 
+// thread with Hdc().  Returns NULL if WGL_ARB_create_context is not available.
+HGLRC GameWindow::CreateSharedContext()
+{
+	if (!WGLEW_ARB_create_context || !m_hrc)
+		return NULL;
+
+	int iMajorVersion = 0, iMinorVersion = 0;
+	glGetIntegerv(GL_MAJOR_VERSION, &iMajorVersion);
+	glGetIntegerv(GL_MINOR_VERSION, &iMinorVersion);
+
+	int iContextAttribs[] =
+	{
+		WGL_CONTEXT_MAJOR_VERSION_ARB, iMajorVersion,
+		WGL_CONTEXT_MINOR_VERSION_ARB, iMinorVersion,
+		WGL_CONTEXT_PROFILE_MASK_ARB, WGL_CONTEXT_CORE_PROFILE_BIT_ARB,
+		0 // End of attributes list
+	};
+
+	return wglCreateContextAttribsARB(m_hdc, m_hrc, iContextAttribs);
+}
+
 // Deinitialise the window and rendering context
 void GameWindow::Deinit()
 {
@@ -15,9 +15,11 @@ public:
 		SCREEN_HEIGHT = 600,
 	};
 
-	HDC Init(HINSTANCE hinstance);
+	HDC Init(HINSTANCE hinstance, bool bVisible = true);	// A hidden window still has a context to draw with
 	void Deinit();
 
+	HGLRC CreateSharedContext();
+
 	void SetDimensions(RECT dimensions) {m_dimensions = dimensions;}
 	RECT GetDimensions() {return m_dimensions;}
 
@@ -33,7 +35,7 @@ private:
 	GameWindow(const GameWindow&);
 	void operator=(const GameWindow&);
 
-	void CreateGameWindow(string title);
+	void CreateGameWindow(string title, bool bVisible);
 	void InitOpenGL();
 	bool InitGLEW();
 	void RegisterSimpleOpenGLClass(HINSTANCE hInstance);
@@ -0,0 +1,352 @@
+#include "Common.h"
+#include "GpuDrivenScene.h"
+#include "MeshPool.h"
+#include "OpenAssetImportMesh.h"
+#include "Frustum.h"
+#include "Shaders.h"
+#include <algorithm>
+
+// Matches DrawElementsIndirectCommand in the GL specification
+struct DrawElementsIndirectCommand
+{
+	unsigned int count;
+	unsigned int instanceCount;
+	unsigned int firstIndex;
+	int baseVertex;
+	unsigned int baseInstance;
+};
+
+static const int CULL_GROUP_SIZE = 64;		// local_size_x of cullDraws.comp
+static const int REDUCE_GROUP_SIZE = 8;		// local_size_x and y of hiZReduce.comp
+
+CGpuDrivenScene::CGpuDrivenScene()
+{
+	m_pPool = NULL;
+	m_objectCapacity = 0;
+	m_pCullProgram = NULL;
+	m_pReduceProgram = NULL;
+	m_depthTexture = 0;
+	m_hiZTexture = 0;
+	m_depthWidth = 0;
+	m_depthHeight = 0;
+	m_hiZWidth = 0;
+	m_hiZHeight = 0;
+	m_hiZLevels = 0;
+	m_hiZValid = false;
+	m_created = false;
+}
+
+CGpuDrivenScene::~CGpuDrivenScene()
+{
+	Release();
+}
+
+bool CGpuDrivenScene::Create(CMeshPool* pPool)
+{
+	if (!GLEW_VERSION_4_3)
+		return false;
+
+	m_pCullProgram = LoadComputeProgram("resources\\shaders\\cullDraws.comp");
+	m_pReduceProgram = LoadComputeProgram("resources\\shaders\\hiZReduce.comp");
+	if (!m_pCullProgram || !m_pReduceProgram) {
+		SAFE_DELETE(m_pCullProgram);
+		SAFE_DELETE(m_pReduceProgram);
+		return false;
+	}
+
+	m_pPool = pPool;
+	glGenBuffers(1, &m_objectBuffer);
+	glGenBuffers(1, &m_rangeBuffer);
+	glGenBuffers(1, &m_commandBuffer);
+	glGenBuffers(1, &m_objectIndexBuffer);
+	m_created = true;
+	return true;
+}
+
+void CGpuDrivenScene::Release()
+{
+	if (!m_created)
+		return;
+
+	ReleaseDepthPyramid();
+	glDeleteBuffers(1, &m_objectBuffer);
+	glDeleteBuffers(1, &m_rangeBuffer);
+	glDeleteBuffers(1, &m_commandBuffer);
+	glDeleteBuffers(1, &m_objectIndexBuffer);
+	m_pCullProgram->DeleteProgram();
+	m_pReduceProgram->DeleteProgram();
+	SAFE_DELETE(m_pCullProgram);
+	SAFE_DELETE(m_pReduceProgram);
+	m_draws.clear();
+	m_buckets.clear();
+	m_objectCapacity = 0;
+	m_created = false;
+}
+
+bool CGpuDrivenScene::IsCreated()
+{
+	return m_created;
+}
+
+void CGpuDrivenScene::AddDraws(int iObject, COpenAssetImportMesh* pMesh, int iChunk, int iProgram, unsigned int uiState)
+{
+	vector<MeshDrawRange> ranges;
+	pMesh->GetDrawRanges(iChunk, ranges);
+	for (unsigned int i = 0; i < ranges.size(); i++) {
+		Draw draw;
+		draw.range.object = (unsigned int)iObject;
+		draw.range.count = ranges[i].Count;
+		draw.range.firstIndex = ranges[i].FirstIndex;
+		draw.range.baseVertex = ranges[i].BaseVertex;
+		draw.iProgram = iProgram;
+		draw.uiState = uiState;
+		draw.pTexture = ranges[i].pTexture;
+		m_draws.push_back(draw);
+	}
+}
+
+// Sorts the draws into buckets, and uploads their ranges.  The command buffer is laid out in the same order, so each
+// bucket is a contiguous run of commands.
+void CGpuDrivenScene::Finish()
+{
+	stable_sort(m_draws.begin(), m_draws.end(), IsDrawBefore);
+
+	m_buckets.clear();
+	vector<GpuDrawRange> ranges(m_draws.size());
+	for (unsigned int i = 0; i < m_draws.size(); i++) {
+		const Draw &draw = m_draws[i];
+		ranges[i] = draw.range;
+		if (m_buckets.empty() || IsDrawBefore(m_draws[i - 1], draw)) {
+			Bucket bucket;
+			bucket.iProgram = draw.iProgram;
+			bucket.uiState = draw.uiState;
+			bucket.pTexture = draw.pTexture;
+			bucket.iFirst = i;
+			bucket.iCount = 0;
+			m_buckets.push_back(bucket);
+		}
+		m_buckets.back().iCount++;
+	}
+
+	if (ranges.empty())
+		return;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_rangeBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GpuDrawRange) * ranges.size(), &ranges[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(DrawElementsIndirectCommand) * ranges.size(), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+// Uploads every object's matrices and world bounds.  The normal matrix is worked out here rather than per vertex.
+void CGpuDrivenScene::UpdateObjects(const vector<glm::mat4> &modelMatrices, CCullBounds &bounds, const vector<unsigned char> &visible)
+{
+	int iCount = (int)modelMatrices.size();
+	m_objects.resize(iCount);
+	for (int i = 0; i < iCount; i++) {
+		m_objects[i].modelMatrix = modelMatrices[i];
+		m_objects[i].normalMatrix = glm::mat4(glm::transpose(glm::inverse(glm::mat3(modelMatrices[i]))));
+		m_objects[i].centre = glm::vec4(bounds.GetCentre(i), visible[i] ? 1.0f : 0.0f);
+		m_objects[i].extents = glm::vec4(bounds.GetExtents(i), 0.0f);
+	}
+	if (iCount == 0)
+		return;
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_objectBuffer);
+	if (iCount > m_objectCapacity) {
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GpuObject) * iCount, &m_objects[0], GL_DYNAMIC_DRAW);
+
+		vector<unsigned int> objectIndices(iCount);
+		for (int i = 0; i < iCount; i++)
+			objectIndices[i] = i;
+		glBindBuffer(GL_ARRAY_BUFFER, m_objectIndexBuffer);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(unsigned int) * iCount, &objectIndices[0], GL_STATIC_DRAW);
+		m_objectCapacity = iCount;
+	}
+	else
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GpuObject) * iCount, &m_objects[0]);
+}
+
+// Writes the indirect command of every draw, with no instances if it is culled
+void CGpuDrivenScene::Cull(const glm::vec4* pFrustumPlanes)
+{
+	if (m_draws.empty() || m_objects.empty())
+		return;
+
+	glm::vec4 planes[6];
+	for (int i = 0; i < 6; i++)
+		planes[i] = pFrustumPlanes[i];
+
+	m_pCullProgram->UseProgram();
+	m_pCullProgram->SetUniform("drawCount", (int)m_draws.size());
+	m_pCullProgram->SetUniform("frustumPlanes", planes, 6);
+	m_pCullProgram->SetUniform("hiZOn", m_hiZValid ? 1 : 0);
+	m_pCullProgram->SetUniform("hiZ", 0);
+	m_pCullProgram->SetUniform("hiZViewProjection", m_hiZViewProjection);
+	m_pCullProgram->SetUniform("screenSize", glm::vec2((float)m_depthWidth, (float)m_depthHeight));
+	m_pCullProgram->SetUniform("hiZLevels", m_hiZLevels);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, m_hiZTexture);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_objectBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, m_rangeBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_commandBuffer);
+	glDispatchCompute(((int)m_draws.size() + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+	// The commands are read by the indirect draws, and the objects by their vertex shader
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+// Copies the depth buffer and reduces it to a pyramid, for culling the next frame's draws against.  viewProjection is
+// the camera the depth was drawn with.
+void CGpuDrivenScene::UpdateDepthPyramid(int iWidth, int iHeight, const glm::mat4 &viewProjection)
+{
+	if (m_draws.empty() || iWidth < 2 || iHeight < 2)
+		return;
+	if (iWidth != m_depthWidth || iHeight != m_depthHeight)
+		CreateDepthPyramid(iWidth, iHeight);
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, m_depthTexture);
+	glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, iWidth, iHeight);
+
+	m_pReduceProgram->UseProgram();
+	m_pReduceProgram->SetUniform("source", 0);
+	for (int iLevel = 0; iLevel < m_hiZLevels; iLevel++) {
+		// The first level reads the depth copy, the others the level below
+		if (iLevel == 1)
+			glBindTexture(GL_TEXTURE_2D, m_hiZTexture);
+		m_pReduceProgram->SetUniform("sourceLevel", iLevel == 0 ? 0 : iLevel - 1);
+
+		int iLevelWidth = glm::max(1, m_hiZWidth >> iLevel);
+		int iLevelHeight = glm::max(1, m_hiZHeight >> iLevel);
+		glBindImageTexture(0, m_hiZTexture, iLevel, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+		glDispatchCompute((iLevelWidth + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE, (iLevelHeight + REDUCE_GROUP_SIZE - 1) / REDUCE_GROUP_SIZE, 1);
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	}
+
+	m_hiZViewProjection = viewProjection;
+	m_hiZValid = true;
+}
+
+int CGpuDrivenScene::GetBucketCount()
+{
+	return (int)m_buckets.size();
+}
+
+int CGpuDrivenScene::GetBucketProgram(int iBucket)
+{
+	return m_buckets[iBucket].iProgram;
+}
+
+unsigned int CGpuDrivenScene::GetBucketState(int iBucket)
+{
+	return m_buckets[iBucket].uiState;
+}
+
+// Draws a bucket's commands with one call.  The object index attribute is switched off again afterwards, since the
+// pool's vertex array is shared with the ordinary mesh draws.
+void CGpuDrivenScene::RenderBucket(int iBucket)
+{
+	const Bucket &bucket = m_buckets[iBucket];
+	if (bucket.pTexture)
+		bucket.pTexture->Bind(0);
+
+	m_pPool->Bind();
+	glBindBuffer(GL_ARRAY_BUFFER, m_objectIndexBuffer);
+	glEnableVertexAttribArray(8);
+	glVertexAttribIPointer(8, 1, GL_UNSIGNED_INT, sizeof(unsigned int), 0);
+	glVertexAttribDivisor(8, 1);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_objectBuffer);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_commandBuffer);
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (const GLvoid*)(bucket.iFirst * sizeof(DrawElementsIndirectCommand)),
+		bucket.iCount, 0);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+	glVertexAttribDivisor(8, 0);
+	glDisableVertexAttribArray(8);
+}
+
+int CGpuDrivenScene::GetDrawCount()
+{
+	return (int)m_draws.size();
+}
+
+// Orders draws by program, then state, then texture
+bool CGpuDrivenScene::IsDrawBefore(const Draw &a, const Draw &b)
+{
+	if (a.iProgram != b.iProgram)
+		return a.iProgram < b.iProgram;
+	if (a.uiState != b.uiState)
+		return a.uiState < b.uiState;
+	return a.pTexture < b.pTexture;
+}
+
+CShaderProgram* CGpuDrivenScene::LoadComputeProgram(string sFile)
+{
+	CShader shader;
+	if (!shader.LoadShader(sFile, GL_COMPUTE_SHADER))
+		return NULL;
+
+	CShaderProgram* pProgram = new CShaderProgram;
+	pProgram->CreateProgram();
+	pProgram->AddShaderToProgram(&shader);
+	bool bLinked = pProgram->LinkProgram();
+	shader.DeleteShader();
+	if (!bLinked) {
+		pProgram->DeleteProgram();
+		delete pProgram;
+		return NULL;
+	}
+	return pProgram;
+}
+
+// Level 0 of the pyramid is a power of two at least half the screen size, so a level L texel always covers 2^(L+1) 
+// pixels along each side.  Texels past the edge of the screen repeat the edge.
+void CGpuDrivenScene::CreateDepthPyramid(int iWidth, int iHeight)
+{
+	ReleaseDepthPyramid();
+
+	glGenTextures(1, &m_depthTexture);
+	glBindTexture(GL_TEXTURE_2D, m_depthTexture);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT24, iWidth, iHeight);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+
+	m_hiZWidth = 1;
+	while (m_hiZWidth * 2 < iWidth)
+		m_hiZWidth *= 2;
+	m_hiZHeight = 1;
+	while (m_hiZHeight * 2 < iHeight)
+		m_hiZHeight *= 2;
+	m_hiZLevels = 1;
+	while ((glm::max(m_hiZWidth, m_hiZHeight) >> m_hiZLevels) > 0)
+		m_hiZLevels++;
+
+	glGenTextures(1, &m_hiZTexture);
+	glBindTexture(GL_TEXTURE_2D, m_hiZTexture);
+	glTexStorage2D(GL_TEXTURE_2D, m_hiZLevels, GL_R32F, m_hiZWidth, m_hiZHeight);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	m_depthWidth = iWidth;
+	m_depthHeight = iHeight;
+	m_hiZValid = false;
+}
+
+void CGpuDrivenScene::ReleaseDepthPyramid()
+{
+	if (m_depthTexture)
+		glDeleteTextures(1, &m_depthTexture);
+	if (m_hiZTexture)
+		glDeleteTextures(1, &m_hiZTexture);
+	m_depthTexture = 0;
+	m_hiZTexture = 0;
+	m_depthWidth = 0;
+	m_depthHeight = 0;
+	m_hiZWidth = 0;
+	m_hiZHeight = 0;
+	m_hiZLevels = 0;
+	m_hiZValid = false;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "Common.h"
+
+class CMeshPool;
+class COpenAssetImportMesh;
+class CCullBounds;
+class CShaderProgram;
+class CTexture;
+
+// A class that draws the meshes of many scene objects from the shared mesh pool with indirect multi-draws, so the CPU
+// cost of submitting them does not grow with the number of objects.  Each object's matrices and bounds go in a storage
+// buffer, and a compute pass culls every draw against the frustum and a depth pyramid of the previous frame, writing the
+// indirect commands.  Draws are grouped into buckets that share a program, render state and texture; each bucket is one
+// glMultiDrawElementsIndirect.  Needs OpenGL 4.3.
+class CGpuDrivenScene
+{
+public:
+	CGpuDrivenScene();
+	~CGpuDrivenScene();
+
+	bool Create(CMeshPool* pPool);			// Returns false if compute shaders or indirect multi-draws are not available
+	void Release();
+	bool IsCreated();
+
+	// Adds the draws of a mesh, or of one of its chunks, for an object.  iProgram and uiState are the caller's program
+	// slot and RenderStateBits, which the caller applies before drawing each bucket.  Call Finish once everything is added.
+	void AddDraws(int iObject, COpenAssetImportMesh* pMesh, int iChunk, int iProgram, unsigned int uiState);
+	void Finish();
+
+	// Each frame: upload the objects, then cull before drawing.  Objects the CPU culling has dropped are not drawn.
+	void UpdateObjects(const vector<glm::mat4> &modelMatrices, CCullBounds &bounds, const vector<unsigned char> &visible);
+	void Cull(const glm::vec4* pFrustumPlanes);
+	void UpdateDepthPyramid(int iWidth, int iHeight, const glm::mat4 &viewProjection);	// Once the opaque depth is drawn
+
+	int GetBucketCount();
+	int GetBucketProgram(int iBucket);
+	unsigned int GetBucketState(int iBucket);
+	void RenderBucket(int iBucket);
+	int GetDrawCount();
+
+private:
+	// Matches SceneObject in the shaders (std430)
+	struct GpuObject
+	{
+		glm::mat4 modelMatrix;
+		glm::mat4 normalMatrix;
+		glm::vec4 centre;
+		glm::vec4 extents;
+	};
+
+	// Matches DrawRange in cullDraws.comp
+	struct GpuDrawRange
+	{
+		unsigned int object;
+		unsigned int count;
+		unsigned int firstIndex;
+		int baseVertex;
+	};
+
+	struct Draw
+	{
+		GpuDrawRange range;
+		int iProgram;
+		unsigned int uiState;
+		CTexture* pTexture;
+	};
+
+	struct Bucket
+	{
+		int iProgram;
+		unsigned int uiState;
+		CTexture* pTexture;
+		int iFirst;
+		int iCount;
+	};
+
+	static bool IsDrawBefore(const Draw &a, const Draw &b);
+	CShaderProgram* LoadComputeProgram(string sFile);
+	void CreateDepthPyramid(int iWidth, int iHeight);
+	void ReleaseDepthPyramid();
+
+	CMeshPool* m_pPool;
+	vector<Draw> m_draws;
+	vector<Bucket> m_buckets;
+	vector<GpuObject> m_objects;
+	int m_objectCapacity;
+
+	CShaderProgram* m_pCullProgram;
+	CShaderProgram* m_pReduceProgram;
+	UINT m_objectBuffer;
+	UINT m_rangeBuffer;
+	UINT m_commandBuffer;
+	UINT m_objectIndexBuffer;		// 0, 1, 2... read per instance, so each draw's base instance gives its object
+
+	// The previous frame's depth, and the pyramid of farthest depths built from it
+	UINT m_depthTexture;
+	UINT m_hiZTexture;
+	int m_depthWidth;
+	int m_depthHeight;
+	int m_hiZWidth;				// Level 0
+	int m_hiZHeight;
+	int m_hiZLevels;
+	bool m_hiZValid;
+	glm::mat4 m_hiZViewProjection;
+
+	bool m_created;
+};
@@ -0,0 +1,232 @@
+#include "Common.h"
+#include "GpuProfiler.h"
+
+CGpuProfiler::CGpuProfiler()
+{
+	m_currentFrame = 0;
+	m_frameTime = 0.0;
+	m_droppedFrames = 0;
+	m_debugGroups = false;
+	m_created = false;
+}
+
+CGpuProfiler::~CGpuProfiler()
+{
+	Release();
+}
+
+void CGpuProfiler::Create()
+{
+	for (int i = 0; i < FRAMES_IN_FLIGHT; i++) {
+		glGenQueries(MAX_TIMESTAMPS, m_frames[i].queries);
+		m_frames[i].iTimestamps = 0;
+		m_frames[i].bPending = false;
+	}
+	m_debugGroups = GLEW_KHR_debug != 0;
+	m_created = true;
+}
+
+void CGpuProfiler::Release()
+{
+	if (!m_created)
+		return;
+	for (int i = 0; i < FRAMES_IN_FLIGHT; i++)
+		glDeleteQueries(MAX_TIMESTAMPS, m_frames[i].queries);
+	m_created = false;
+}
+
+void CGpuProfiler::BeginFrame()
+{
+	m_currentFrame = (m_currentFrame + 1) % FRAMES_IN_FLIGHT;
+	FrameQueries &frame = m_frames[m_currentFrame];
+	if (frame.bPending)
+		ReadFrame(frame);
+
+	frame.iTimestamps = 0;
+	frame.intervals.clear();
+	frame.bPending = true;
+	m_openIntervals.clear();
+	BeginScope("Frame");
+}
+
+void CGpuProfiler::EndFrame()
+{
+	while (!m_openIntervals.empty())
+		EndScope();
+}
+
+void CGpuProfiler::BeginScope(const char* szName)
+{
+	FrameQueries &frame = m_frames[m_currentFrame];
+	int iParent = m_openIntervals.empty() ? -1 : frame.intervals[m_openIntervals.back()].iScope;
+
+	Interval interval;
+	interval.iScope = FindScope(iParent, szName);
+	interval.iBegin = AddTimestamp();
+	interval.iEnd = -1;
+	m_openIntervals.push_back((int) frame.intervals.size());
+	frame.intervals.push_back(interval);
+
+	if (m_debugGroups)
+		glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, szName);
+}
+
+void CGpuProfiler::EndScope()
+{
+	if (m_openIntervals.empty())
+		return;
+	if (m_debugGroups)
+		glPopDebugGroup();
+
+	FrameQueries &frame = m_frames[m_currentFrame];
+	Interval &interval = frame.intervals[m_openIntervals.back()];
+	m_openIntervals.pop_back();
+	if (interval.iBegin >= 0)
+		interval.iEnd = AddTimestamp();
+}
+
+int CGpuProfiler::FindScope(int iParent, const char* szName)
+{
+	for (unsigned int i = 0; i < m_scopes.size(); i++) {
+		if (m_scopes[i].iParent == iParent && m_scopes[i].name == szName)
+			return i;
+	}
+
+	Scope scope;
+	scope.name = szName;
+	scope.iParent = iParent;
+	scope.iDepth = iParent >= 0 ? m_scopes[iParent].iDepth + 1 : 0;
+	scope.frameTotal = 0.0;
+	scope.bInFrame = false;
+	scope.iNextSample = 0;
+	m_scopes.push_back(scope);
+	return (int) m_scopes.size() - 1;
+}
+
+// Returns the index of a new timestamp written when the GPU reaches this point, or -1 if the frame has run out
+int CGpuProfiler::AddTimestamp()
+{
+	FrameQueries &frame = m_frames[m_currentFrame];
+	if (frame.iTimestamps == MAX_TIMESTAMPS)
+		return -1;
+	glQueryCounter(frame.queries[frame.iTimestamps], GL_TIMESTAMP);
+	return frame.iTimestamps++;
+}
+
+// Adds a finished frame's intervals to the scope averages.  The GPU writes the timestamps in order, so once the last is
+// available the others are too.
+void CGpuProfiler::ReadFrame(FrameQueries &frame)
+{
+	frame.bPending = false;
+	if (frame.iTimestamps == 0)
+		return;
+	GLint iAvailable = 0;
+	glGetQueryObjectiv(frame.queries[frame.iTimestamps - 1], GL_QUERY_RESULT_AVAILABLE, &iAvailable);
+	if (!iAvailable) {
+		m_droppedFrames++;
+		return;
+	}
+
+	vector<GLuint64> timestamps(frame.iTimestamps);
+	for (int i = 0; i < frame.iTimestamps; i++)
+		glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &timestamps[i]);
+	m_frameTime = (timestamps[frame.iTimestamps - 1] - timestamps[0]) / 1000000.0;
+
+	for (unsigned int i = 0; i < m_scopes.size(); i++) {
+		m_scopes[i].frameTotal = 0.0;
+		m_scopes[i].bInFrame = false;
+	}
+	for (unsigned int i = 0; i < frame.intervals.size(); i++) {
+		const Interval &interval = frame.intervals[i];
+		if (interval.iBegin < 0 || interval.iEnd < 0)
+			continue;
+		Scope &scope = m_scopes[interval.iScope];
+		scope.frameTotal += (timestamps[interval.iEnd] - timestamps[interval.iBegin]) / 1000000.0;
+		scope.bInFrame = true;
+	}
+	for (unsigned int i = 0; i < m_scopes.size(); i++) {
+		Scope &scope = m_scopes[i];
+		if (!scope.bInFrame)
+			continue;
+		if ((int) scope.history.size() < AVERAGE_FRAMES)
+			scope.history.push_back(scope.frameTotal);
+		else
+			scope.history[scope.iNextSample] = scope.frameTotal;
+		scope.iNextSample = (scope.iNextSample + 1) % AVERAGE_FRAMES;
+	}
+}
+
+double CGpuProfiler::GetFrameTime()
+{
+	return m_frameTime;
+}
+
+void CGpuProfiler::GetScopeOrder(vector<int> &order)
+{
+	order.clear();
+	AddScopeChildren(-1, order);
+}
+
+void CGpuProfiler::AddScopeChildren(int iParent, vector<int> &order)
+{
+	for (unsigned int i = 0; i < m_scopes.size(); i++) {
+		if (m_scopes[i].iParent == iParent) {
+			order.push_back(i);
+			AddScopeChildren(i, order);
+		}
+	}
+}
+
+const string& CGpuProfiler::GetScopeName(int iScope)
+{
+	return m_scopes[iScope].name;
+}
+
+int CGpuProfiler::GetScopeDepth(int iScope)
+{
+	return m_scopes[iScope].iDepth;
+}
+
+double CGpuProfiler::GetScopeAverage(int iScope)
+{
+	const vector<double> &history = m_scopes[iScope].history;
+	if (history.empty())
+		return 0.0;
+	double dTotal = 0.0;
+	for (unsigned int i = 0; i < history.size(); i++)
+		dTotal += history[i];
+	return dTotal / history.size();
+}
+
+int CGpuProfiler::GetDroppedFrames()
+{
+	return m_droppedFrames;
+}
+
+// Writes each scope's path with its average, minimum and maximum over the recent frames, as CSV
+bool CGpuProfiler::Export(const char* szFilename)
+{
+	FILE* pFile = NULL;
+	if (fopen_s(&pFile, szFilename, "w") != 0 || !pFile)
+		return false;
+
+	fprintf(pFile, "scope,average ms,min ms,max ms,frames\n");
+	vector<int> order;
+	GetScopeOrder(order);
+	for (unsigned int i = 0; i < order.size(); i++) {
+		const Scope &scope = m_scopes[order[i]];
+		string sPath = scope.name;
+		for (int iParent = scope.iParent; iParent >= 0; iParent = m_scopes[iParent].iParent)
+			sPath = m_scopes[iParent].name + "/" + sPath;
+
+		double dMin = 0.0, dMax = 0.0;
+		for (unsigned int s = 0; s < scope.history.size(); s++) {
+			dMin = s == 0 ? scope.history[s] : min(dMin, scope.history[s]);
+			dMax = s == 0 ? scope.history[s] : max(dMax, scope.history[s]);
+		}
+		fprintf(pFile, "%s,%.4f,%.4f,%.4f,%d\n", sPath.c_str(), GetScopeAverage(order[i]), dMin, dMax, (int) scope.history.size());
+	}
+
+	fclose(pFile);
+	return true;
+}
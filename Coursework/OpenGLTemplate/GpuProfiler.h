@@ -0,0 +1,76 @@
+#pragma once
+
+#include "Common.h"
+
+// A class that times named, nestable scopes of the GPU's work with timestamp queries.  Each frame's queries are kept in a
+// ring and read a few frames later, once they are available, so the CPU never waits for them; a frame whose results are
+// still not ready when its slot comes round again is dropped.  Scopes are matched by name under the same parent, and a
+// scope opened more than once in a frame counts the sum of its intervals.  Each scope is also a KHR_debug group, so
+// capture tools show the same structure.
+class CGpuProfiler
+{
+public:
+	CGpuProfiler();
+	~CGpuProfiler();
+
+	void Create();
+	void Release();
+
+	void BeginFrame();						// Reads back the oldest frame, then opens the frame's root scope
+	void EndFrame();
+	void BeginScope(const char* szName);
+	void EndScope();
+
+	double GetFrameTime();					// Milliseconds, for the latest frame read back
+	void GetScopeOrder(vector<int> &order);	// Every scope, each followed by its children
+	const string& GetScopeName(int iScope);
+	int GetScopeDepth(int iScope);
+	double GetScopeAverage(int iScope);		// Milliseconds, over the recent frames that had the scope
+	int GetDroppedFrames();
+	bool Export(const char* szFilename);
+
+private:
+	static const int FRAMES_IN_FLIGHT = 3;
+	static const int MAX_TIMESTAMPS = 512;	// Per frame; scopes past this are not timed
+	static const int AVERAGE_FRAMES = 60;
+
+	struct Scope
+	{
+		string name;
+		int iParent;
+		int iDepth;
+		double frameTotal;					// Milliseconds, while a frame is being read back
+		bool bInFrame;
+		vector<double> history;
+		int iNextSample;
+	};
+
+	struct Interval
+	{
+		int iScope;
+		int iBegin;							// Timestamp indices, or -1 if the scope was not timed
+		int iEnd;
+	};
+
+	struct FrameQueries
+	{
+		UINT queries[MAX_TIMESTAMPS];
+		int iTimestamps;
+		vector<Interval> intervals;
+		bool bPending;
+	};
+
+	int FindScope(int iParent, const char* szName);
+	int AddTimestamp();
+	void ReadFrame(FrameQueries &frame);
+	void AddScopeChildren(int iParent, vector<int> &order);
+
+	vector<Scope> m_scopes;
+	FrameQueries m_frames[FRAMES_IN_FLIGHT];
+	int m_currentFrame;
+	vector<int> m_openIntervals;			// Indices into the current frame's intervals
+	double m_frameTime;
+	int m_droppedFrames;
+	bool m_debugGroups;
+	bool m_created;
+};
@@ -0,0 +1,95 @@
+#include "Common.h"
+#include "InstancedMeshBatch.h"
+#include "OpenAssetImportMesh.h"
+
+CInstancedMeshBatch::CInstancedMeshBatch()
+{
+	m_instanceBuffer = 0;
+	m_instanceCount = 0;
+	m_created = false;
+}
+
+CInstancedMeshBatch::~CInstancedMeshBatch()
+{
+	Release();
+}
+
+// Creates the buffer that holds the instance matrices
+void CInstancedMeshBatch::Create()
+{
+	glGenBuffers(1, &m_instanceBuffer);
+	m_created = true;
+}
+
+void CInstancedMeshBatch::Release()
+{
+	if (!m_created)
+		return;
+	glDeleteBuffers(1, &m_instanceBuffer);
+	m_created = false;
+}
+
+// Empties the batch, keeping the allocated space for the next frame
+void CInstancedMeshBatch::Clear()
+{
+	map<COpenAssetImportMesh*, vector<glm::mat4> >::iterator it;
+	for (it = m_instances.begin(); it != m_instances.end(); ++it)
+		it->second.clear();
+	m_instanceCount = 0;
+}
+
+// Adds one copy of a mesh.  The model matrix must be rigid (rotation, translation and uniform scale), since the shader
+// derives the normal matrix from it.
+void CInstancedMeshBatch::Add(COpenAssetImportMesh* pMesh, const glm::mat4 &modelMatrix)
+{
+	m_instances[pMesh].push_back(modelMatrix);
+	m_instanceCount++;
+}
+
+// Packs every mesh's matrices one after the other and uploads them, orphaning last frame's data so the driver does not stall
+void CInstancedMeshBatch::Upload()
+{
+	vector<glm::mat4> matrices;
+	matrices.reserve(m_instanceCount);
+	m_firstInstance.clear();
+
+	map<COpenAssetImportMesh*, vector<glm::mat4> >::iterator it;
+	for (it = m_instances.begin(); it != m_instances.end(); ++it) {
+		m_firstInstance[it->first] = (int)matrices.size();
+		matrices.insert(matrices.end(), it->second.begin(), it->second.end());
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_instanceBuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(glm::mat4) * matrices.size(), NULL, GL_STREAM_DRAW);
+	if (!matrices.empty())
+		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(glm::mat4) * matrices.size(), &matrices[0]);
+}
+
+// Draws all the instances.  The program's modelViewMatrix should be the view matrix; each instance's model matrix is applied in the shader.
+void CInstancedMeshBatch::Render()
+{
+	map<COpenAssetImportMesh*, vector<glm::mat4> >::iterator it;
+	for (it = m_instances.begin(); it != m_instances.end(); ++it) {
+		if (it->second.empty())
+			continue;
+		it->first->RenderInstanced(m_instanceBuffer, m_firstInstance[it->first] * sizeof(glm::mat4), (int)it->second.size());
+	}
+}
+
+// Number of instances added since the last Clear
+int CInstancedMeshBatch::GetInstanceCount()
+{
+	return m_instanceCount;
+}
+
+// Number of distinct meshes in the batch, which is the number of instanced draws per mesh entry
+int CInstancedMeshBatch::GetMeshCount()
+{
+	int iMeshes = 0;
+	map<COpenAssetImportMesh*, vector<glm::mat4> >::iterator it;
+	for (it = m_instances.begin(); it != m_instances.end(); ++it) {
+		if (!it->second.empty())
+			iMeshes++;
+	}
+	return iMeshes;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "Common.h"
+#include <map>
+
+class COpenAssetImportMesh;
+
+
+// A class that collects model matrices for many copies of a few meshes, and draws each mesh once with hardware 
+// instancing.  The matrices go in one streamed buffer, read as vertex attributes 4-7 by shaders with "instanced" set.
+class CInstancedMeshBatch
+{
+public:
+	CInstancedMeshBatch();
+	~CInstancedMeshBatch();
+
+	void Create();
+	void Release();
+
+	void Clear();											// Starts a new frame's batch
+	void Add(COpenAssetImportMesh* pMesh, const glm::mat4 &modelMatrix);
+	void Upload();											// Sends the matrices to the GPU; call once after adding
+	void Render();											// One instanced draw per mesh entry
+
+	int GetInstanceCount();
+	int GetMeshCount();
+
+private:
+	map<COpenAssetImportMesh*, vector<glm::mat4> > m_instances;
+	map<COpenAssetImportMesh*, int> m_firstInstance;		// Position of each mesh's matrices in the buffer after Upload
+	UINT m_instanceBuffer;
+	int m_instanceCount;
+	bool m_created;
+};
@@ -0,0 +1,122 @@
+#include "JobBenchmark.h"
+#include "JobSystem.h"
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+static const int SPAWN_JOBS = 100000;
+static const int CHAIN_JOBS = 10000;
+static const int PARALLEL_FOR_ITEMS = 1 << 20;
+static const int PARALLEL_FOR_GRAIN = 4096;
+static const int REPEATS = 5;				// Each figure is the best of this many runs
+
+static double ElapsedMilliseconds(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool CJobBenchmark::Run(const std::string &sFilename)
+{
+	std::ofstream file(sFilename.c_str());
+	if (!file)
+		return false;
+
+	int iMaxThreads = (int)std::thread::hardware_concurrency();
+	if (iMaxThreads < 1)
+		iMaxThreads = 1;
+
+	file << "Job system micro-benchmarks, " << iMaxThreads << " hardware threads\n\n";
+	BenchmarkSpawn(file, 1);
+	if (iMaxThreads > 1)
+		BenchmarkSpawn(file, iMaxThreads);
+	BenchmarkChain(file, 1);
+	if (iMaxThreads > 1)
+		BenchmarkChain(file, iMaxThreads);
+
+	file << "\nParallel-for over " << PARALLEL_FOR_ITEMS << " items in ranges of " << PARALLEL_FOR_GRAIN << "\n";
+	double fSerial = 0.0;
+	for (int iThreads = 1; iThreads <= iMaxThreads; iThreads++) {
+		double fTime = BenchmarkParallelFor(iThreads);
+		if (iThreads == 1)
+			fSerial = fTime;
+		file << "  " << iThreads << " threads: " << fTime << " ms, " << fSerial / fTime << "x\n";
+	}
+
+	return file.good();
+}
+
+// Creates and submits independent empty jobs from one thread, then waits for them all
+void CJobBenchmark::BenchmarkSpawn(std::ofstream &file, int iThreads)
+{
+	CJobSystem jobs;
+	jobs.Create(iThreads);
+
+	double fBest = 1e30;
+	std::vector<CJobSystem::Job*> spawned(SPAWN_JOBS);
+	for (int r = 0; r < REPEATS; r++) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int i = 0; i < SPAWN_JOBS; i++) {
+			spawned[i] = jobs.CreateJob([] {});
+			jobs.Submit(spawned[i]);
+		}
+		for (int i = 0; i < SPAWN_JOBS; i++)
+			jobs.Wait(spawned[i]);
+		double fTime = ElapsedMilliseconds(start);
+		if (fTime < fBest)
+			fBest = fTime;
+		jobs.Reset();
+	}
+
+	file << "Spawn, " << iThreads << " threads: " << fBest * 1000000.0 / SPAWN_JOBS << " ns per job\n";
+}
+
+// Each job depends on the one before, so this is the latency of handing a finished job's dependent on to run
+void CJobBenchmark::BenchmarkChain(std::ofstream &file, int iThreads)
+{
+	CJobSystem jobs;
+	jobs.Create(iThreads);
+
+	double fBest = 1e30;
+	std::vector<CJobSystem::Job*> chain(CHAIN_JOBS);
+	for (int r = 0; r < REPEATS; r++) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (int i = 0; i < CHAIN_JOBS; i++) {
+			chain[i] = jobs.CreateJob([] {});
+			if (i > 0)
+				jobs.AddDependency(chain[i], chain[i - 1]);
+		}
+		for (int i = CHAIN_JOBS - 1; i >= 0; i--)
+			jobs.Submit(chain[i]);
+		jobs.Wait(chain[CHAIN_JOBS - 1]);
+		double fTime = ElapsedMilliseconds(start);
+		if (fTime < fBest)
+			fBest = fTime;
+		jobs.Reset();
+	}
+
+	file << "Dependency chain, " << iThreads << " threads: " << fBest * 1000000.0 / CHAIN_JOBS << " ns per job\n";
+}
+
+// A fixed amount of arithmetic per item, summed per range so the threads do not share a cache line while they work
+double CJobBenchmark::BenchmarkParallelFor(int iThreads)
+{
+	CJobSystem jobs;
+	jobs.Create(iThreads);
+
+	std::vector<double> sums((PARALLEL_FOR_ITEMS + PARALLEL_FOR_GRAIN - 1) / PARALLEL_FOR_GRAIN);
+	double fBest = 1e30;
+	for (int r = 0; r < REPEATS; r++) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		jobs.ParallelFor(PARALLEL_FOR_ITEMS, PARALLEL_FOR_GRAIN, [&sums](int iBegin, int iEnd) {
+			double fSum = 0.0;
+			for (int i = iBegin; i < iEnd; i++)
+				fSum += sqrt((double)i) * sin((double)i);
+			sums[iBegin / PARALLEL_FOR_GRAIN] = fSum;
+		});
+		double fTime = ElapsedMilliseconds(start);
+		if (fTime < fBest)
+			fBest = fTime;
+		jobs.Reset();
+	}
+	return fBest;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+// Like JobSystem.h, this only depends on the standard library
+#include <string>
+#include <fstream>
+
+class CJobSystem;
+
+// Micro-benchmarks for CJobSystem (run the game with --jobbench).  They time how long it takes to spawn and run empty
+// jobs, a chain of dependent jobs, and a parallel-for over a fixed amount of work at each thread count, and write the
+// results to a text file.
+class CJobBenchmark
+{
+public:
+	bool Run(const std::string &sFilename);
+
+private:
+	void BenchmarkSpawn(std::ofstream &file, int iThreads);
+	void BenchmarkChain(std::ofstream &file, int iThreads);
+	double BenchmarkParallelFor(int iThreads);
+};
@@ -0,0 +1,203 @@
+#include "JobSystem.h"
+#include "CpuTrace.h"
+
+// The queue of the worker running on this thread
+static thread_local CJobSystem* t_pJobSystem = NULL;
+static thread_local int t_queue = 0;
+
+CJobSystem::CJobSystem()
+{
+	m_queuedJobs = 0;
+	m_unfinishedJobs = 0;
+	m_stopWorkers = false;
+}
+
+CJobSystem::~CJobSystem()
+{
+	Release();
+}
+
+void CJobSystem::Create(int iThreads)
+{
+	Release();
+	m_stopWorkers = false;
+	for (int i = 0; i < iThreads; i++)
+		m_queues.push_back(new Queue);
+	for (int i = 1; i < iThreads; i++)
+		m_workers.push_back(std::thread(&CJobSystem::WorkerLoop, this, i));
+}
+
+void CJobSystem::Release()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_wakeMutex);
+		m_stopWorkers = true;
+	}
+	m_wakeSignal.notify_all();
+	for (size_t i = 0; i < m_workers.size(); i++)
+		m_workers[i].join();
+	m_workers.clear();
+
+	for (size_t i = 0; i < m_queues.size(); i++)
+		delete m_queues[i];
+	m_queues.clear();
+	m_jobs.clear();
+	m_queuedJobs = 0;
+	m_unfinishedJobs = 0;
+}
+
+int CJobSystem::GetThreadCount()
+{
+	return (int)m_queues.size();
+}
+
+CJobSystem::Job* CJobSystem::CreateJob(const std::function<void()> &task)
+{
+	std::lock_guard<std::mutex> lock(m_jobsMutex);
+	m_jobs.emplace_back();
+	Job* pJob = &m_jobs.back();
+	pJob->task = task;
+	pJob->unmet = 1;
+	pJob->finished = false;
+	m_unfinishedJobs++;
+	return pJob;
+}
+
+void CJobSystem::AddDependency(Job* pJob, Job* pDependsOn)
+{
+	pDependsOn->dependents.push_back(pJob);
+	pJob->unmet++;
+}
+
+void CJobSystem::Submit(Job* pJob)
+{
+	if (--pJob->unmet == 0)
+		Push(pJob);
+}
+
+// Runs other jobs until this one has finished
+void CJobSystem::Wait(Job* pJob)
+{
+	while (!pJob->finished) {
+		if (!RunOne())
+			std::this_thread::yield();
+	}
+}
+
+void CJobSystem::ParallelFor(int iCount, int iGrain, const std::function<void(int iBegin, int iEnd)> &task)
+{
+	if (iGrain < 1)
+		iGrain = 1;
+	if (iCount <= iGrain || m_queues.size() < 2) {
+		if (iCount > 0)
+			task(0, iCount);
+		return;
+	}
+
+	std::vector<Job*> jobs;
+	for (int iBegin = 0; iBegin < iCount; iBegin += iGrain) {
+		int iEnd = iBegin + iGrain < iCount ? iBegin + iGrain : iCount;
+		jobs.push_back(CreateJob([&task, iBegin, iEnd] { task(iBegin, iEnd); }));
+	}
+	for (size_t i = 0; i < jobs.size(); i++)
+		Submit(jobs[i]);
+	for (size_t i = 0; i < jobs.size(); i++)
+		Wait(jobs[i]);
+}
+
+// A job's thread can still be finishing it after its dependents have run, so this waits for them all
+void CJobSystem::Reset()
+{
+	while (m_unfinishedJobs > 0) {
+		if (!RunOne())
+			std::this_thread::yield();
+	}
+	std::lock_guard<std::mutex> lock(m_jobsMutex);
+	m_jobs.clear();
+}
+
+// Queues a ready job on this thread's queue, and wakes a worker to take it or steal something older
+void CJobSystem::Push(Job* pJob)
+{
+	if (m_queues.empty()) {
+		Run(pJob);
+		return;
+	}
+
+	Queue* pQueue = m_queues[GetQueueIndex()];
+	{
+		std::lock_guard<std::mutex> lock(pQueue->mutex);
+		pQueue->jobs.push_back(pJob);
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_wakeMutex);
+		m_queuedJobs++;
+	}
+	m_wakeSignal.notify_one();
+}
+
+// The newest job from the thread's own queue, or else the oldest from another's
+CJobSystem::Job* CJobSystem::Take(int iQueue)
+{
+	int iQueues = (int)m_queues.size();
+	for (int i = 0; i < iQueues; i++) {
+		Queue* pQueue = m_queues[(iQueue + i) % iQueues];
+		std::lock_guard<std::mutex> lock(pQueue->mutex);
+		if (pQueue->jobs.empty())
+			continue;
+		Job* pJob;
+		if (i == 0) {
+			pJob = pQueue->jobs.back();
+			pQueue->jobs.pop_back();
+		}
+		else {
+			pJob = pQueue->jobs.front();
+			pQueue->jobs.pop_front();
+		}
+		m_queuedJobs--;
+		return pJob;
+	}
+	return NULL;
+}
+
+bool CJobSystem::RunOne()
+{
+	if (m_queues.empty())
+		return false;
+	Job* pJob = Take(GetQueueIndex());
+	if (!pJob)
+		return false;
+	Run(pJob);
+	return true;
+}
+
+// Runs a job, then queues the dependents it was the last dependency of
+void CJobSystem::Run(Job* pJob)
+{
+	pJob->task();
+	for (size_t i = 0; i < pJob->dependents.size(); i++)
+		Submit(pJob->dependents[i]);
+	pJob->finished = true;
+	m_unfinishedJobs--;
+}
+
+void CJobSystem::WorkerLoop(int iQueue)
+{
+	CPU_TRACE_THREAD_NAME("Job worker");
+	t_pJobSystem = this;
+	t_queue = iQueue;
+	while (true) {
+		if (RunOne())
+			continue;
+
+		std::unique_lock<std::mutex> lock(m_wakeMutex);
+		m_wakeSignal.wait(lock, [this] { return m_stopWorkers || m_queuedJobs > 0; });
+		if (m_stopWorkers)
+			return;
+	}
+}
+
+int CJobSystem::GetQueueIndex()
+{
+	return t_pJobSystem == this ? t_queue : 0;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+// Like WorkerThreads.h, this only depends on the standard library
+#include <vector>
+#include <deque>
+#include <functional>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// A work-stealing job scheduler.  Each thread has its own queue of jobs: it runs its newest job first, and once its queue
+// is empty it steals the oldest job from another thread's, so work spreads out without every thread fighting over one
+// queue.  Jobs can depend on other jobs, and only run once those have finished.  A thread waiting on a job runs other
+// jobs meanwhile, so jobs can wait too, as ParallelFor does.
+class CJobSystem
+{
+public:
+	struct Job
+	{
+		std::function<void()> task;
+		std::vector<Job*> dependents;
+		std::atomic<int> unmet;			// Dependencies not yet finished, plus one until the job is submitted
+		std::atomic<bool> finished;
+	};
+
+	CJobSystem();
+	~CJobSystem();
+
+	void Create(int iThreads);			// Starts iThreads - 1 workers; threads waiting on jobs make up the other
+	void Release();
+	int GetThreadCount();
+
+	// Build a graph of jobs, then submit them.  Dependencies must be added before either job is submitted.
+	Job* CreateJob(const std::function<void()> &task);
+	void AddDependency(Job* pJob, Job* pDependsOn);
+	void Submit(Job* pJob);
+	void Wait(Job* pJob);
+
+	// Calls task on ranges of at most iGrain of 0 to iCount, spread over the threads, and returns once they are all done
+	void ParallelFor(int iCount, int iGrain, const std::function<void(int iBegin, int iEnd)> &task);
+
+	void Reset();						// Frees the jobs created so far, once they finish.  They must all be submitted.
+
+private:
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<Job*> jobs;
+	};
+
+	void Push(Job* pJob);
+	Job* Take(int iQueue);
+	bool RunOne();
+	void Run(Job* pJob);
+	void WorkerLoop(int iQueue);
+	int GetQueueIndex();
+
+	std::vector<Queue*> m_queues;		// The first is shared by the threads that are not workers
+	std::vector<std::thread> m_workers;
+	std::mutex m_jobsMutex;
+	std::deque<Job> m_jobs;				// A deque, so jobs stay put as more are created
+	std::mutex m_wakeMutex;
+	std::condition_variable m_wakeSignal;
+	std::atomic<int> m_queuedJobs;
+	std::atomic<int> m_unfinishedJobs;
+	bool m_stopWorkers;
+};
@@ -0,0 +1,100 @@
+#include "Common.h"
+#include "MeshPool.h"
+#include "OpenAssetImportMesh.h"
+
+CMeshPool::CMeshPool()
+{
+	m_vertexCount = 0;
+	m_indexCount = 0;
+	m_vao = 0;
+	m_uploaded = false;
+}
+
+CMeshPool::~CMeshPool()
+{
+	Release();
+}
+
+void CMeshPool::Add(const vector<Vertex> &vertices, const vector<unsigned int> &indices, const vector<glm::vec4>* pColours,
+	int &iBaseVertex, unsigned int &uiFirstIndex)
+{
+	iBaseVertex = (int)m_vertices.size();
+	uiFirstIndex = (unsigned int)m_indices.size();
+	m_vertices.insert(m_vertices.end(), vertices.begin(), vertices.end());
+	m_indices.insert(m_indices.end(), indices.begin(), indices.end());
+
+	// The baked stream runs parallel to the vertices once any mesh has one
+	if (pColours || !m_colours.empty()) {
+		m_colours.resize(iBaseVertex, glm::vec4(0.0f));
+		if (pColours)
+			m_colours.insert(m_colours.end(), pColours->begin(), pColours->end());
+		m_colours.resize(m_vertices.size(), glm::vec4(0.0f));
+	}
+}
+
+void CMeshPool::Upload()
+{
+	Release();
+	if (m_vertices.empty())
+		return;
+
+	glGenVertexArrays(1, &m_vao);
+	glBindVertexArray(m_vao);
+	glGenBuffers(3, m_buffers);
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_buffers[0]);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * m_vertices.size(), &m_vertices[0], GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), 0);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const GLvoid*)12);
+	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const GLvoid*)20);
+
+	if (!m_colours.empty()) {
+		glBindBuffer(GL_ARRAY_BUFFER, m_buffers[1]);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec4) * m_colours.size(), &m_colours[0], GL_STATIC_DRAW);
+		glEnableVertexAttribArray(3);
+		glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), 0);
+	}
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_buffers[2]);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * m_indices.size(), &m_indices[0], GL_STATIC_DRAW);
+	glBindVertexArray(0);
+
+	m_vertexCount = (int)m_vertices.size();
+	m_indexCount = (int)m_indices.size();
+	vector<Vertex>().swap(m_vertices);
+	vector<unsigned int>().swap(m_indices);
+	vector<glm::vec4>().swap(m_colours);
+	m_uploaded = true;
+}
+
+void CMeshPool::Release()
+{
+	if (!m_uploaded)
+		return;
+	glDeleteBuffers(3, m_buffers);
+	glDeleteVertexArrays(1, &m_vao);
+	m_uploaded = false;
+}
+
+void CMeshPool::Bind()
+{
+	glBindVertexArray(m_vao);
+}
+
+bool CMeshPool::IsUploaded()
+{
+	return m_uploaded;
+}
+
+int CMeshPool::GetVertexCount()
+{
+	return m_vertexCount;
+}
+
+int CMeshPool::GetIndexCount()
+{
+	return m_indexCount;
+}
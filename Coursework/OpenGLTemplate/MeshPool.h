@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Common.h"
+
+struct Vertex;
+
+// A class holding the vertices and indices of many meshes in one shared set of buffers, behind one vertex array object.
+// Meshes are added on the CPU while loading, then uploaded together, and draw their ranges with a base vertex.  Sharing
+// the buffers lets the GPU-driven renderer draw any of them from a single indirect multi-draw.
+class CMeshPool
+{
+public:
+	CMeshPool();
+	~CMeshPool();
+
+	// Appends a mesh, returning where its vertices and indices start.  Colours is the optional baked lighting stream, one
+	// per vertex; meshes without one read zero.
+	void Add(const vector<Vertex> &vertices, const vector<unsigned int> &indices, const vector<glm::vec4>* pColours,
+		int &iBaseVertex, unsigned int &uiFirstIndex);
+	void Upload();						// Call once every mesh is added.  The CPU copies are released.
+	void Release();
+
+	void Bind();
+	bool IsUploaded();
+	int GetVertexCount();
+	int GetIndexCount();
+
+private:
+	vector<Vertex> m_vertices;
+	vector<unsigned int> m_indices;
+	vector<glm::vec4> m_colours;		// Empty until a mesh with baked lighting is added
+	int m_vertexCount;
+	int m_indexCount;
+
+	UINT m_vao;
+	UINT m_buffers[3];					// Vertices, baked lighting, indices
+	bool m_uploaded;
+};
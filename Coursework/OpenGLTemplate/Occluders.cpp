@@ -0,0 +1,187 @@
+#include "Occluders.h"
+#include <algorithm>
+#include <deque>
+#include <math.h>
+
+// Resolution of the voxel grid along the mesh's longest axis
+static const int OCCLUDER_GRID_RESOLUTION = 128;
+
+enum VoxelState
+{
+	VOXEL_EMPTY,
+	VOXEL_SURFACE,
+	VOXEL_OUTSIDE,
+	VOXEL_INTERIOR,
+	VOXEL_USED,		// Interior, and already part of a box
+};
+
+// A voxel grid with a one voxel border all round, so the flood fill can reach every side of the mesh
+struct VoxelGrid
+{
+	glm::vec3 origin;
+	float voxelSize;
+	int size[3];
+	std::vector<unsigned char> cells;
+
+	int Index(int x, int y, int z) const { return (z * size[1] + y) * size[0] + x; }
+	bool Inside(int x, int y, int z) const { return x >= 0 && y >= 0 && z >= 0 && x < size[0] && y < size[1] && z < size[2]; }
+};
+
+// Marks the voxels the triangles pass through, by sampling each triangle at a quarter of the voxel size.  Samples can 
+// miss a voxel the surface only clips, which is why the interior is shrunk afterwards.
+static void MarkSurface(const std::vector<glm::vec3> &triangles, VoxelGrid &grid)
+{
+	float fSpacing = grid.voxelSize * 0.25f;
+	for (size_t t = 0; t + 2 < triangles.size(); t += 3) {
+		const glm::vec3 &a = triangles[t];
+		const glm::vec3 &b = triangles[t + 1];
+		const glm::vec3 &c = triangles[t + 2];
+		int iSteps = (int)(std::max(glm::length(b - a), std::max(glm::length(c - a), glm::length(c - b))) / fSpacing) + 1;
+
+		for (int i = 0; i <= iSteps; i++) {
+			for (int j = 0; j <= iSteps - i; j++) {
+				glm::vec3 p = a + (b - a) * ((float)i / iSteps) + (c - a) * ((float)j / iSteps);
+				glm::ivec3 v = glm::ivec3(glm::floor((p - grid.origin) / grid.voxelSize));
+				if (grid.Inside(v.x, v.y, v.z))
+					grid.cells[grid.Index(v.x, v.y, v.z)] = VOXEL_SURFACE;
+			}
+		}
+	}
+}
+
+// Marks everything reachable from the sides and top of the grid as outside.  The bottom layer is left alone, so a 
+// building without a floor still counts as closed.
+static void FloodOutside(VoxelGrid &grid)
+{
+	std::deque<glm::ivec3> open;
+	for (int z = 0; z < grid.size[2]; z++) {
+		for (int y = 1; y < grid.size[1]; y++) {
+			for (int x = 0; x < grid.size[0]; x++) {
+				bool bBorder = x == 0 || z == 0 || x == grid.size[0] - 1 || z == grid.size[2] - 1 || y == grid.size[1] - 1;
+				if (bBorder && grid.cells[grid.Index(x, y, z)] == VOXEL_EMPTY) {
+					grid.cells[grid.Index(x, y, z)] = VOXEL_OUTSIDE;
+					open.push_back(glm::ivec3(x, y, z));
+				}
+			}
+		}
+	}
+
+	static const int neighbours[6][3] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+	while (!open.empty()) {
+		glm::ivec3 v = open.front();
+		open.pop_front();
+		for (int n = 0; n < 6; n++) {
+			int x = v.x + neighbours[n][0], y = v.y + neighbours[n][1], z = v.z + neighbours[n][2];
+			if (y < 1 || !grid.Inside(x, y, z) || grid.cells[grid.Index(x, y, z)] != VOXEL_EMPTY)
+				continue;
+			grid.cells[grid.Index(x, y, z)] = VOXEL_OUTSIDE;
+			open.push_back(glm::ivec3(x, y, z));
+		}
+	}
+}
+
+// Keeps the empty voxels that the flood fill did not reach and whose 26 neighbours are all enclosed too
+static void FindInterior(VoxelGrid &grid)
+{
+	std::vector<unsigned char> enclosed(grid.cells.size(), 0);
+	for (size_t i = 0; i < grid.cells.size(); i++)
+		enclosed[i] = grid.cells[i] == VOXEL_EMPTY;
+
+	for (int z = 1; z < grid.size[2] - 1; z++) {
+		for (int y = 1; y < grid.size[1] - 1; y++) {
+			for (int x = 1; x < grid.size[0] - 1; x++) {
+				if (!enclosed[grid.Index(x, y, z)])
+					continue;
+				bool bInterior = true;
+				for (int dz = -1; dz <= 1 && bInterior; dz++)
+					for (int dy = -1; dy <= 1 && bInterior; dy++)
+						for (int dx = -1; dx <= 1 && bInterior; dx++)
+							bInterior = enclosed[grid.Index(x + dx, y + dy, z + dz)] != 0;
+				if (bInterior)
+					grid.cells[grid.Index(x, y, z)] = VOXEL_INTERIOR;
+			}
+		}
+	}
+}
+
+static bool IsSlabInterior(const VoxelGrid &grid, int x0, int x1, int y0, int y1, int z0, int z1)
+{
+	for (int z = z0; z < z1; z++)
+		for (int y = y0; y < y1; y++)
+			for (int x = x0; x < x1; x++)
+				if (grid.cells[grid.Index(x, y, z)] != VOXEL_INTERIOR)
+					return false;
+	return true;
+}
+
+// Greedily grows boxes of interior voxels along x, then z, then y
+static int MergeInterior(VoxelGrid &grid, const glm::mat4 &modelMatrix, float fMinVolume, std::vector<OccluderBox> &occluders)
+{
+	// Volume of one voxel once placed in the world
+	float fVoxelVolume = grid.voxelSize * grid.voxelSize * grid.voxelSize * fabs(glm::determinant(glm::mat3(modelMatrix)));
+
+	int iAdded = 0;
+	for (int z = 0; z < grid.size[2]; z++) {
+		for (int y = 0; y < grid.size[1]; y++) {
+			for (int x = 0; x < grid.size[0]; x++) {
+				if (grid.cells[grid.Index(x, y, z)] != VOXEL_INTERIOR)
+					continue;
+
+				int x1 = x + 1, y1 = y + 1, z1 = z + 1;
+				while (x1 < grid.size[0] && IsSlabInterior(grid, x1, x1 + 1, y, y1, z, z1))
+					x1++;
+				while (z1 < grid.size[2] && IsSlabInterior(grid, x, x1, y, y1, z1, z1 + 1))
+					z1++;
+				while (y1 < grid.size[1] && IsSlabInterior(grid, x, x1, y1, y1 + 1, z, z1))
+					y1++;
+
+				for (int k = z; k < z1; k++)
+					for (int j = y; j < y1; j++)
+						for (int i = x; i < x1; i++)
+							grid.cells[grid.Index(i, j, k)] = VOXEL_USED;
+
+				if ((x1 - x) * (y1 - y) * (z1 - z) * fVoxelVolume < fMinVolume)
+					continue;
+
+				glm::vec3 boxMin = grid.origin + glm::vec3(x, y, z) * grid.voxelSize;
+				glm::vec3 boxMax = grid.origin + glm::vec3(x1, y1, z1) * grid.voxelSize;
+				OccluderBox box;
+				for (int c = 0; c < 8; c++) {
+					glm::vec3 corner((c & 1) ? boxMax.x : boxMin.x, (c & 2) ? boxMax.y : boxMin.y, (c & 4) ? boxMax.z : boxMin.z);
+					box.corners[c] = glm::vec3(modelMatrix * glm::vec4(corner, 1.0f));
+				}
+				occluders.push_back(box);
+				iAdded++;
+			}
+		}
+	}
+	return iAdded;
+}
+
+int GenerateOccluders(const std::vector<glm::vec3> &triangles, const glm::mat4 &modelMatrix, float fMinVolume, 
+	std::vector<OccluderBox> &occluders)
+{
+	if (triangles.size() < 3)
+		return 0;
+
+	glm::vec3 boundsMin = triangles[0], boundsMax = triangles[0];
+	for (size_t i = 1; i < triangles.size(); i++) {
+		boundsMin = glm::min(boundsMin, triangles[i]);
+		boundsMax = glm::max(boundsMax, triangles[i]);
+	}
+
+	glm::vec3 extent = boundsMax - boundsMin;
+	VoxelGrid grid;
+	grid.voxelSize = std::max(extent.x, std::max(extent.y, extent.z)) / OCCLUDER_GRID_RESOLUTION;
+	if (grid.voxelSize <= 0.0f)
+		return 0;
+	grid.origin = boundsMin - glm::vec3(grid.voxelSize);
+	for (int i = 0; i < 3; i++)
+		grid.size[i] = (int)ceil(extent[i] / grid.voxelSize) + 3;
+	grid.cells.assign((size_t)grid.size[0] * grid.size[1] * grid.size[2], VOXEL_EMPTY);
+
+	MarkSurface(triangles, grid);
+	FloodOutside(grid);
+	FindInterior(grid);
+	return MergeInterior(grid, modelMatrix, fMinVolume, occluders);
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+// Occluder generation for the software occlusion culling (COcclusionBuffer).  Like StaticLighting.h, this only depends on
+// glm and the standard library, so it can be built and run without Windows or GL.
+#include <vector>
+#include "include/glm/glm.hpp"
+
+// A solid box that lies wholly inside a mesh, so anything it hides is really hidden.  Corners are in world space, 
+// ordered by bit: bit 0 = +x, bit 1 = +y, bit 2 = +z in the box's own axes.
+struct OccluderBox
+{
+	glm::vec3 corners[8];
+};
+
+// Finds the enclosed space inside a triangle soup (object-space positions, three per triangle) by voxelising it and 
+// flood filling from outside.  The interior is shrunk by one voxel, merged into boxes, and boxes smaller than 
+// fMinVolume (world units cubed) are dropped.  Meshes are assumed to stand on the ground, so the floor of the grid is 
+// treated as closed.  Returns the number of boxes added.
+int GenerateOccluders(const std::vector<glm::vec3> &triangles, const glm::mat4 &modelMatrix, float fMinVolume, 
+	std::vector<OccluderBox> &occluders);
@@ -0,0 +1,334 @@
+#include "OcclusionBuffer.h"
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+#include <xmmintrin.h>
+
+// Vertices closer than this (in clip w) are not rasterised, so occluders are never clipped against the near plane
+static const float OCCLUSION_NEAR_W = 0.5f;
+
+// The six faces of an occluder box, indexing OccluderBox::corners around each face
+static const int boxFaces[6][4] = {
+	{ 0, 1, 3, 2 },	// -z
+	{ 4, 5, 7, 6 },	// +z
+	{ 0, 2, 6, 4 },	// -x
+	{ 1, 3, 7, 5 },	// +x
+	{ 0, 1, 5, 4 },	// -y
+	{ 2, 3, 7, 6 },	// +y
+};
+
+static float Cross(const glm::vec2 &o, const glm::vec2 &a, const glm::vec2 &b)
+{
+	return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+}
+
+static bool ComparePoints(const glm::vec2 &a, const glm::vec2 &b)
+{
+	return a.x < b.x || (a.x == b.x && a.y < b.y);
+}
+
+COcclusionBuffer::COcclusionBuffer()
+{
+	m_width = 0;
+	m_height = 0;
+	m_bandCount = 1;
+	m_frame = 0;
+	m_bandsRemaining = 0;
+	m_stopWorkers = false;
+}
+
+COcclusionBuffer::~COcclusionBuffer()
+{
+	Release();
+}
+
+// Allocates the depth buffer and starts iThreads - 1 band workers
+void COcclusionBuffer::Create(int iWidth, int iHeight, int iThreads)
+{
+	m_width = (iWidth + 3) & ~3;
+	m_height = iHeight;
+	m_depth.assign(m_width * m_height, 1.0f);
+
+	m_bandCount = std::max(1, std::min(iThreads, m_height));
+	m_stopWorkers = false;
+	for (int i = 1; i < m_bandCount; i++)
+		m_workers.push_back(std::thread(&COcclusionBuffer::WorkerLoop, this, i));
+}
+
+void COcclusionBuffer::Release()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopWorkers = true;
+	}
+	m_startSignal.notify_all();
+	for (size_t i = 0; i < m_workers.size(); i++)
+		m_workers[i].join();
+	m_workers.clear();
+}
+
+// Sets the world-space boxes to rasterise each frame
+void COcclusionBuffer::SetOccluders(const std::vector<OccluderBox> &occluders)
+{
+	m_occluders = occluders;
+}
+
+// Projects the occluders for this view and rasterises them across all the bands
+void COcclusionBuffer::Render(const glm::mat4 &viewProjectionMatrix)
+{
+	m_viewProjectionMatrix = viewProjectionMatrix;
+	m_polygons.clear();
+
+	for (size_t i = 0; i < m_occluders.size(); i++) {
+		glm::vec3 screen[8];
+		bool bUsable = true;
+		for (int c = 0; c < 8 && bUsable; c++) {
+			glm::vec4 clip = viewProjectionMatrix * glm::vec4(m_occluders[i].corners[c], 1.0f);
+			bUsable = clip.w > OCCLUSION_NEAR_W;
+			screen[c] = glm::vec3((clip.x / clip.w * 0.5f + 0.5f) * m_width, (clip.y / clip.w * 0.5f + 0.5f) * m_height, clip.z / clip.w);
+		}
+		if (!bUsable)
+			continue;
+
+		// Skip boxes wholly off screen or beyond the far plane
+		glm::vec3 screenMin = screen[0], screenMax = screen[0];
+		for (int c = 1; c < 8; c++) {
+			screenMin = glm::min(screenMin, screen[c]);
+			screenMax = glm::max(screenMax, screen[c]);
+		}
+		if (screenMax.x < 0.0f || screenMax.y < 0.0f || screenMin.x > m_width || screenMin.y > m_height || screenMin.z > 1.0f)
+			continue;
+
+		AddOutline(screen);
+		for (int f = 0; f < 6; f++)
+			AddFace(screen, boxFaces[f]);
+	}
+
+	std::fill(m_depth.begin(), m_depth.end(), 1.0f);
+
+	if (m_bandCount > 1) {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_bandsRemaining = m_bandCount - 1;
+			m_frame++;
+		}
+		m_startSignal.notify_all();
+	}
+
+	RasteriseBand(0);
+
+	if (m_bandCount > 1) {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_doneSignal.wait(lock, [this] { return m_bandsRemaining == 0; });
+	}
+}
+
+// Adds the box's outline (the convex hull of its corners) at the depth of its farthest corner.  This fills the seams 
+// between faces, which the faces alone leave uncovered.
+void COcclusionBuffer::AddOutline(const glm::vec3* pScreen)
+{
+	glm::vec2 points[8];
+	float fMaxZ = pScreen[0].z;
+	for (int c = 0; c < 8; c++) {
+		points[c] = glm::vec2(pScreen[c]);
+		fMaxZ = std::max(fMaxZ, pScreen[c].z);
+	}
+	std::sort(points, points + 8, ComparePoints);
+
+	// Monotone chain, giving a counter-clockwise hull
+	ScreenPolygon polygon;
+	glm::vec2 hull[16];
+	int n = 0;
+	for (int i = 0; i < 8; i++) {
+		while (n >= 2 && Cross(hull[n - 2], hull[n - 1], points[i]) <= 0.0f)
+			n--;
+		hull[n++] = points[i];
+	}
+	for (int i = 6, iLower = n + 1; i >= 0; i--) {
+		while (n >= iLower && Cross(hull[n - 2], hull[n - 1], points[i]) <= 0.0f)
+			n--;
+		hull[n++] = points[i];
+	}
+	n--;
+	if (n < 3)
+		return;
+
+	polygon.count = std::min(n, 8);
+	for (int i = 0; i < polygon.count; i++)
+		polygon.v[i] = hull[i];
+	polygon.dzdx = polygon.dzdy = 0.0f;
+	polygon.z0 = polygon.maxZ = fMaxZ;
+	m_polygons.push_back(polygon);
+}
+
+// Adds one face with its own depth plane
+void COcclusionBuffer::AddFace(const glm::vec3* pScreen, const int* pCorners)
+{
+	glm::vec3 a = pScreen[pCorners[0]], b = pScreen[pCorners[1]], c = pScreen[pCorners[2]], d = pScreen[pCorners[3]];
+	float fArea = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+	if (fabs(fArea) < 1e-3f)
+		return;
+
+	ScreenPolygon polygon;
+	polygon.count = 4;
+	polygon.v[0] = glm::vec2(a);
+	polygon.v[1] = glm::vec2(b);
+	polygon.v[2] = glm::vec2(c);
+	polygon.v[3] = glm::vec2(d);
+	if (fArea < 0.0f) {
+		std::swap(polygon.v[1], polygon.v[3]);
+	}
+
+	// Depth plane through a, b and c, pushed back by the most it can change within half a pixel
+	polygon.dzdx = ((b.z - a.z) * (c.y - a.y) - (c.z - a.z) * (b.y - a.y)) / fArea;
+	polygon.dzdy = ((c.z - a.z) * (b.x - a.x) - (b.z - a.z) * (c.x - a.x)) / fArea;
+	polygon.z0 = a.z - polygon.dzdx * a.x - polygon.dzdy * a.y + 0.5f * (fabs(polygon.dzdx) + fabs(polygon.dzdy));
+	polygon.maxZ = std::max(std::max(a.z, b.z), std::max(c.z, d.z));
+	m_polygons.push_back(polygon);
+}
+
+void COcclusionBuffer::WorkerLoop(int iBand)
+{
+	unsigned int uiFrame = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_startSignal.wait(lock, [this, uiFrame] { return m_stopWorkers || m_frame != uiFrame; });
+			if (m_stopWorkers)
+				return;
+			uiFrame = m_frame;
+		}
+
+		RasteriseBand(iBand);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_bandsRemaining--;
+		}
+		m_doneSignal.notify_one();
+	}
+}
+
+// Rasterises every polygon, clipped to this band's rows
+void COcclusionBuffer::RasteriseBand(int iBand)
+{
+	int iMinY = m_height * iBand / m_bandCount;
+	int iMaxY = m_height * (iBand + 1) / m_bandCount;
+	for (size_t i = 0; i < m_polygons.size(); i++)
+		RasterisePolygon(m_polygons[i], iMinY, iMaxY);
+}
+
+// Writes the polygon's depth to the pixels it covers completely.  Each edge function is pulled in by half a pixel in 
+// each axis, so only pixels wholly inside pass.
+void COcclusionBuffer::RasterisePolygon(const ScreenPolygon &polygon, int iMinY, int iMaxY)
+{
+	glm::vec2 boundsMin = polygon.v[0], boundsMax = polygon.v[0];
+	for (int i = 1; i < polygon.count; i++) {
+		boundsMin = glm::min(boundsMin, polygon.v[i]);
+		boundsMax = glm::max(boundsMax, polygon.v[i]);
+	}
+
+	int iX0 = std::max(0, (int)floor(boundsMin.x));
+	int iX1 = std::min(m_width - 1, (int)ceil(boundsMax.x));
+	int iY0 = std::max(iMinY, (int)floor(boundsMin.y));
+	int iY1 = std::min(iMaxY - 1, (int)ceil(boundsMax.y));
+	if (iX0 > iX1 || iY0 > iY1)
+		return;
+	iX0 &= ~3;
+
+	// Edge functions E = A x + B y + C, positive inside for counter-clockwise polygons
+	__m128 edgeA[8];
+	float fB[8], fC[8];
+	for (int e = 0; e < polygon.count; e++) {
+		const glm::vec2 &p = polygon.v[e], &q = polygon.v[(e + 1) % polygon.count];
+		float fA = p.y - q.y;
+		fB[e] = q.x - p.x;
+		fC[e] = p.x * q.y - p.y * q.x - 0.5f * (fabs(fA) + fabs(fB[e]));
+		edgeA[e] = _mm_set1_ps(fA);
+	}
+
+	const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	const __m128 zero = _mm_setzero_ps();
+	__m128 dzdx = _mm_set1_ps(polygon.dzdx);
+	__m128 maxZ = _mm_set1_ps(polygon.maxZ);
+
+	for (int y = iY0; y <= iY1; y++) {
+		float fY = y + 0.5f;
+		float* pRow = &m_depth[y * m_width];
+		__m128 edgeRow[8];
+		for (int e = 0; e < polygon.count; e++)
+			edgeRow[e] = _mm_set1_ps(fB[e] * fY + fC[e]);
+		__m128 zRow = _mm_set1_ps(polygon.dzdy * fY + polygon.z0);
+
+		for (int x = iX0; x <= iX1; x += 4) {
+			__m128 px = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+			__m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[0], px), edgeRow[0]), zero);
+			for (int e = 1; e < polygon.count; e++)
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[e], px), edgeRow[e]), zero));
+			if (_mm_movemask_ps(inside) == 0)
+				continue;
+
+			__m128 z = _mm_min_ps(_mm_add_ps(_mm_mul_ps(dzdx, px), zRow), maxZ);
+			__m128 depth = _mm_loadu_ps(pRow + x);
+			__m128 nearer = _mm_min_ps(depth, z);
+			_mm_storeu_ps(pRow + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, depth)));
+		}
+	}
+}
+
+// Tests a world-space box against the last Render.  It is hidden only if its nearest point is behind the occluders at 
+// every pixel its screen rectangle touches.
+bool COcclusionBuffer::IsVisible(const glm::vec3 &centre, const glm::vec3 &extents)
+{
+	float fMinX = FLT_MAX, fMaxX = -FLT_MAX, fMinY = FLT_MAX, fMaxY = -FLT_MAX, fMinZ = FLT_MAX;
+	for (int c = 0; c < 8; c++) {
+		glm::vec3 corner = centre + glm::vec3((c & 1) ? extents.x : -extents.x, (c & 2) ? extents.y : -extents.y, (c & 4) ? extents.z : -extents.z);
+		glm::vec4 clip = m_viewProjectionMatrix * glm::vec4(corner, 1.0f);
+		if (clip.w <= OCCLUSION_NEAR_W)
+			return true;
+		float fX = (clip.x / clip.w * 0.5f + 0.5f) * m_width;
+		float fY = (clip.y / clip.w * 0.5f + 0.5f) * m_height;
+		fMinX = std::min(fMinX, fX);
+		fMaxX = std::max(fMaxX, fX);
+		fMinY = std::min(fMinY, fY);
+		fMaxY = std::max(fMaxY, fY);
+		fMinZ = std::min(fMinZ, clip.z / clip.w);
+	}
+
+	int iX0 = std::max(0, (int)floor(fMinX));
+	int iX1 = std::min(m_width - 1, (int)floor(fMaxX));
+	int iY0 = std::max(0, (int)floor(fMinY));
+	int iY1 = std::min(m_height - 1, (int)floor(fMaxY));
+	if (iX0 > iX1 || iY0 > iY1)
+		return true;	// Off screen; left to the frustum test
+
+	__m128 minZ = _mm_set1_ps(fMinZ);
+	for (int y = iY0; y <= iY1; y++) {
+		const float* pRow = &m_depth[y * m_width];
+		int x = iX0;
+		for (; x + 4 <= iX1 + 1; x += 4) {
+			if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(pRow + x), minZ)) != 0)
+				return true;
+		}
+		for (; x <= iX1; x++) {
+			if (pRow[x] >= fMinZ)
+				return true;
+		}
+	}
+	return false;
+}
+
+int COcclusionBuffer::GetOccluderCount()
+{
+	return (int)m_occluders.size();
+}
+
+int COcclusionBuffer::GetPolygonCount()
+{
+	return (int)m_polygons.size();
+}
+
+const float* COcclusionBuffer::GetDepth()
+{
+	return &m_depth[0];
+}
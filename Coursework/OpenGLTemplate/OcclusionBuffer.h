@@ -0,0 +1,64 @@
+#pragma once
+
+// Software occlusion culling.  Like Occluders.h, this only depends on glm and the standard library, so it can be built
+// and run without Windows or GL; Coursework/Tools/OcclusionTest tests and times it that way.
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "include/glm/glm.hpp"
+#include "Occluders.h"
+
+// A class that rasterises occluder boxes into a small depth buffer on the CPU, then tests bounding boxes against it.  
+// Each box is drawn as its screen outline at the depth of its farthest corner, then as its six faces at their own depth.
+// Coverage and depth are both rounded towards the occluder's far side, so nothing visible is ever reported as hidden.
+// The rows are split into bands, each rasterised by its own thread; the pixels are processed four at a time with SSE.
+class COcclusionBuffer
+{
+public:
+	COcclusionBuffer();
+	~COcclusionBuffer();
+
+	void Create(int iWidth, int iHeight, int iThreads);		// iWidth is rounded up to a multiple of 4
+	void Release();
+
+	void SetOccluders(const std::vector<OccluderBox> &occluders);
+	void Render(const glm::mat4 &viewProjectionMatrix);
+	bool IsVisible(const glm::vec3 &centre, const glm::vec3 &extents);
+
+	int GetOccluderCount();
+	int GetPolygonCount();						// Occluder outlines and faces rasterised by the last Render
+	const float* GetDepth();					// Normalised device depth, bottom row first
+
+private:
+	// A convex polygon in pixels, with a depth plane that is already pushed back by half a pixel
+	struct ScreenPolygon
+	{
+		glm::vec2 v[8];
+		int count;
+		float dzdx, dzdy, z0;
+		float maxZ;
+	};
+
+	void AddOutline(const glm::vec3* pScreen);
+	void AddFace(const glm::vec3* pScreen, const int* pCorners);
+	void RasteriseBand(int iBand);
+	void RasterisePolygon(const ScreenPolygon &polygon, int iMinY, int iMaxY);
+	void WorkerLoop(int iBand);
+
+	int m_width, m_height;
+	std::vector<float> m_depth;
+	std::vector<OccluderBox> m_occluders;
+	std::vector<ScreenPolygon> m_polygons;
+	glm::mat4 m_viewProjectionMatrix;
+
+	// Band workers.  Band 0 is rasterised on the calling thread.
+	int m_bandCount;
+	std::vector<std::thread> m_workers;
+	std::mutex m_mutex;
+	std::condition_variable m_startSignal;
+	std::condition_variable m_doneSignal;
+	unsigned int m_frame;
+	int m_bandsRemaining;
+	bool m_stopWorkers;
+};
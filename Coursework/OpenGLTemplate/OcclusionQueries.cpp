@@ -0,0 +1,185 @@
+#include "Common.h"
+#include "OcclusionQueries.h"
+
+COcclusionQueries::COcclusionQueries()
+{
+	m_target = GL_ANY_SAMPLES_PASSED;
+	m_frame = 1;
+	m_hiddenCount = 0;
+	m_queryCount = 0;
+	m_queriesThisFrame = 0;
+	m_boxVao = 0;
+	m_created = false;
+}
+
+COcclusionQueries::~COcclusionQueries()
+{
+	Release();
+}
+
+// Creates the box used for the bounding box queries, and picks the query type
+void COcclusionQueries::Create()
+{
+	// Conservative queries may report a few false positives, but are cheaper for the driver to answer
+	if (GLEW_VERSION_4_3 || GLEW_ARB_ES3_compatibility)
+		m_target = GL_ANY_SAMPLES_PASSED_CONSERVATIVE;
+
+	glm::vec3 corners[8];
+	for (int c = 0; c < 8; c++)
+		corners[c] = glm::vec3((c & 1) ? 1.0f : -1.0f, (c & 2) ? 1.0f : -1.0f, (c & 4) ? 1.0f : -1.0f);
+	unsigned int indices[36] = {
+		0, 2, 3, 0, 3, 1,	4, 5, 7, 4, 7, 6,
+		0, 4, 6, 0, 6, 2,	1, 3, 7, 1, 7, 5,
+		0, 1, 5, 0, 5, 4,	2, 6, 7, 2, 7, 3,
+	};
+
+	glGenVertexArrays(1, &m_boxVao);
+	glBindVertexArray(m_boxVao);
+	glGenBuffers(2, m_boxBuffers);
+	glBindBuffer(GL_ARRAY_BUFFER, m_boxBuffers[0]);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_boxBuffers[1]);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+
+	m_created = true;
+}
+
+void COcclusionQueries::Release()
+{
+	if (!m_created)
+		return;
+	for (size_t i = 0; i < m_objects.size(); i++)
+		glDeleteQueries(QUERIES_PER_OBJECT, m_objects[i].queries);
+	m_objects.clear();
+	glDeleteBuffers(2, m_boxBuffers);
+	glDeleteVertexArrays(1, &m_boxVao);
+	m_created = false;
+}
+
+// Collects finished queries.  A query still in flight leaves the object's visibility as it was.
+void COcclusionQueries::BeginFrame(int iObjectCount)
+{
+	m_frame++;
+	m_queryCount = m_queriesThisFrame;
+	m_queriesThisFrame = 0;
+
+	while ((int)m_objects.size() < iObjectCount) {
+		ObjectQueries object;
+		glGenQueries(QUERIES_PER_OBJECT, object.queries);
+		for (int q = 0; q < QUERIES_PER_OBJECT; q++) {
+			object.issueFrame[q] = 0;
+			object.pending[q] = false;
+		}
+		object.latest = -1;
+		object.resultFrame = 0;
+		object.culledFrame = 0;
+		object.visible = true;
+		m_objects.push_back(object);
+	}
+
+	m_hiddenCount = 0;
+	for (size_t i = 0; i < m_objects.size(); i++) {
+		ObjectQueries &object = m_objects[i];
+		for (int q = 0; q < QUERIES_PER_OBJECT; q++) {
+			if (!object.pending[q])
+				continue;
+			GLuint uiAvailable = 0;
+			glGetQueryObjectuiv(object.queries[q], GL_QUERY_RESULT_AVAILABLE, &uiAvailable);
+			if (!uiAvailable)
+				continue;
+
+			GLuint uiSamplesPassed = 0;
+			glGetQueryObjectuiv(object.queries[q], GL_QUERY_RESULT, &uiSamplesPassed);
+			object.pending[q] = false;
+			if (object.issueFrame[q] > object.culledFrame && object.issueFrame[q] >= object.resultFrame) {
+				object.visible = uiSamplesPassed != 0;
+				object.resultFrame = object.issueFrame[q];
+			}
+		}
+		if (!object.visible)
+			m_hiddenCount++;
+	}
+}
+
+void COcclusionQueries::MarkCulled(int iObject)
+{
+	ObjectQueries &object = m_objects[iObject];
+	if (!object.visible)
+		m_hiddenCount--;
+	object.visible = true;
+	object.culledFrame = m_frame;
+}
+
+bool COcclusionQueries::WasVisible(int iObject)
+{
+	return m_objects[iObject].visible;
+}
+
+// Hidden objects are queried every frame, visible ones every few frames, spread out so they do not all land together
+bool COcclusionQueries::IsQueryDue(int iObject)
+{
+	if (FindFreeSlot(iObject) < 0)
+		return false;
+	if (!m_objects[iObject].visible)
+		return true;
+	return (m_frame + iObject) % VISIBLE_QUERY_INTERVAL == 0;
+}
+
+void COcclusionQueries::BeginQuery(int iObject)
+{
+	ObjectQueries &object = m_objects[iObject];
+	int iSlot = FindFreeSlot(iObject);
+	object.pending[iSlot] = true;
+	object.issueFrame[iSlot] = m_frame;
+	object.latest = iSlot;
+	glBeginQuery(m_target, object.queries[iSlot]);
+	m_queriesThisFrame++;
+}
+
+void COcclusionQueries::EndQuery()
+{
+	glEndQuery(m_target);
+}
+
+void COcclusionQueries::RenderBox()
+{
+	glBindVertexArray(m_boxVao);
+	glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+}
+
+// Draws following geometry only if the object's latest query passes.  If that query has not finished, the GPU draws
+// anyway rather than waiting.
+bool COcclusionQueries::BeginConditionalRender(int iObject)
+{
+	ObjectQueries &object = m_objects[iObject];
+	if (object.latest < 0 || object.issueFrame[object.latest] <= object.culledFrame)
+		return false;
+	glBeginConditionalRender(object.queries[object.latest], GL_QUERY_NO_WAIT);
+	return true;
+}
+
+void COcclusionQueries::EndConditionalRender()
+{
+	glEndConditionalRender();
+}
+
+int COcclusionQueries::GetHiddenCount()
+{
+	return m_hiddenCount;
+}
+
+int COcclusionQueries::GetQueryCount()
+{
+	return m_queryCount;
+}
+
+int COcclusionQueries::FindFreeSlot(int iObject)
+{
+	for (int q = 0; q < QUERIES_PER_OBJECT; q++) {
+		if (!m_objects[iObject].pending[q])
+			return q;
+	}
+	return -1;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Common.h"
+
+// A class for GPU occlusion culling with temporal coherence, after CHC++.  Objects seen last frame are drawn as usual,
+// and have their draw queried every few frames.  Objects hidden last frame get a bounding box query each frame and are
+// drawn under conditional rendering, so the GPU skips them if the box is still hidden.  Results are only read once 
+// they are available, so the CPU never waits for the GPU.
+class COcclusionQueries
+{
+public:
+	COcclusionQueries();
+	~COcclusionQueries();
+
+	void Create();
+	void Release();
+
+	void BeginFrame(int iObjectCount);		// Reads whatever results have arrived
+	void MarkCulled(int iObject);			// Culled on the CPU, so assumed visible when it comes back into view
+
+	bool WasVisible(int iObject);
+	bool IsQueryDue(int iObject);
+	void BeginQuery(int iObject);
+	void EndQuery();
+	void RenderBox();						// A cube from -1 to 1, to be scaled onto an object's bounds
+
+	bool BeginConditionalRender(int iObject);	// Returns false if the object has no query to test against
+	void EndConditionalRender();
+
+	int GetHiddenCount();
+	int GetQueryCount();					// Queries issued last frame
+
+private:
+	static const int QUERIES_PER_OBJECT = 3;	// Enough to keep a query in flight each frame while older ones finish
+	static const int VISIBLE_QUERY_INTERVAL = 8;
+
+	struct ObjectQueries
+	{
+		UINT queries[QUERIES_PER_OBJECT];
+		unsigned int issueFrame[QUERIES_PER_OBJECT];
+		bool pending[QUERIES_PER_OBJECT];
+		int latest;						// Slot of the most recent query, or -1
+		unsigned int resultFrame;		// Frame of the query the visibility came from
+		unsigned int culledFrame;		// Results from queries issued before this are ignored
+		bool visible;
+	};
+
+	int FindFreeSlot(int iObject);
+
+	GLenum m_target;
+	vector<ObjectQueries> m_objects;
+	unsigned int m_frame;
+	int m_hiddenCount;
+	int m_queryCount;
+	int m_queriesThisFrame;
+	UINT m_boxVao;
+	UINT m_boxBuffers[2];
+	bool m_created;
+};
@@ -17,43 +17,30 @@
 */
 
 #include <assert.h>
+#include <float.h>
 #include "OpenAssetImportMesh.h"
+#include "BakedLighting.h"
+#include "MeshPool.h"
+#include "CpuTrace.h"
 
 #pragma comment(lib, "lib/assimp.lib")
 
 COpenAssetImportMesh::MeshEntry::MeshEntry()
 {
-    vbo = INVALID_OGL_VALUE;
-    ibo = INVALID_OGL_VALUE;
+    BaseVertex = 0;
+    FirstIndex = 0;
     NumIndices  = 0;
     MaterialIndex = INVALID_MATERIAL;
 };
 
-COpenAssetImportMesh::MeshEntry::~MeshEntry()
-{
-    if (vbo != INVALID_OGL_VALUE)
-        glDeleteBuffers(1, &vbo);
-
-    if (ibo != INVALID_OGL_VALUE)
-        glDeleteBuffers(1, &ibo);
-}
-
-void COpenAssetImportMesh::MeshEntry::Init(const std::vector<Vertex>& Vertices,
-                          const std::vector<unsigned int>& Indices)
-{
-    NumIndices = Indices.size();
-
-	glGenBuffers(1, &vbo);
-  	glBindBuffer(GL_ARRAY_BUFFER, vbo);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * Vertices.size(), &Vertices[0], GL_STATIC_DRAW);
-
-    glGenBuffers(1, &ibo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * NumIndices, &Indices[0], GL_STATIC_DRAW);
-}
-
 COpenAssetImportMesh::COpenAssetImportMesh()
 {
+	m_bakedLighting = false;
+	m_boundsMin = glm::vec3(0.0f);
+	m_boundsMax = glm::vec3(0.0f);
+	m_chunkGrid = 1;
+	m_pPool = NULL;
+	m_ownPool = false;
 }
 
 
@@ -68,12 +55,19 @@ void COpenAssetImportMesh::Clear()
     for (unsigned int i = 0 ; i < m_Textures.size() ; i++) {
         SAFE_DELETE(m_Textures[i]);
     }
-	glDeleteVertexArrays(1, &m_vao);
+    if (m_ownPool) {
+        SAFE_DELETE(m_pPool);
+        m_ownPool = false;
+    }
 }
 
 
-bool COpenAssetImportMesh::Load(const std::string& Filename)
+// Loads a mesh.  If pBakedLighting is given, each vertex also gets the colour baked for it by the offline light baker.
+// If pTriangles is given, the object-space positions of every triangle are appended to it, three per triangle.
+bool COpenAssetImportMesh::Load(const std::string& Filename, CBakedLighting* pBakedLighting, std::vector<glm::vec3>* pTriangles)
 {
+    CPU_TRACE_SCOPE("COpenAssetImportMesh::Load");
+
     // Release the previously loaded mesh (if it exists)
     Clear();
     
@@ -82,8 +76,15 @@ bool COpenAssetImportMesh::Load(const std::string& Filename)
 
     const aiScene* pScene = Importer.ReadFile(Filename.c_str(), aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs);
     
+    if (!m_pPool) {
+        m_pPool = new CMeshPool;
+        m_ownPool = true;
+    }
+
     if (pScene) {
-        Ret = InitFromScene(pScene, Filename);
+        Ret = InitFromScene(pScene, Filename, pBakedLighting, pTriangles);
+        if (m_ownPool)
+            m_pPool->Upload();
     }
     else {
         MessageBox(NULL, Importer.GetErrorString(), "Error loading mesh model", MB_ICONHAND);
@@ -92,25 +93,50 @@ bool COpenAssetImportMesh::Load(const std::string& Filename)
     return Ret;
 }
 
-bool COpenAssetImportMesh::InitFromScene(const aiScene* pScene, const std::string& Filename)
+bool COpenAssetImportMesh::InitFromScene(const aiScene* pScene, const std::string& Filename, CBakedLighting* pBakedLighting, std::vector<glm::vec3>* pTriangles)
 {  
+    m_bakedLighting = pBakedLighting != NULL;
     m_Entries.resize(pScene->mNumMeshes);
     m_Textures.resize(pScene->mNumMaterials);
 
-	glGenVertexArrays(1, &m_vao); 
-	glBindVertexArray(m_vao);
+    // The bounds of the whole mesh are needed first, to place the chunk grid
+    m_boundsMin = glm::vec3(FLT_MAX);
+    m_boundsMax = glm::vec3(-FLT_MAX);
+    for (unsigned int i = 0 ; i < pScene->mNumMeshes ; i++) {
+        for (unsigned int j = 0 ; j < pScene->mMeshes[i]->mNumVertices ; j++) {
+            const aiVector3D& Pos = pScene->mMeshes[i]->mVertices[j];
+            m_boundsMin = glm::min(m_boundsMin, glm::vec3(Pos.x, Pos.y, Pos.z));
+            m_boundsMax = glm::max(m_boundsMax, glm::vec3(Pos.x, Pos.y, Pos.z));
+        }
+    }
 
+    int Cells = m_chunkGrid * m_chunkGrid;
+    std::vector<Chunk> CellChunks(Cells);
+    for (int i = 0 ; i < Cells ; i++) {
+        CellChunks[i].Cell = i;
+        CellChunks[i].BoundsMin = glm::vec3(FLT_MAX);
+        CellChunks[i].BoundsMax = glm::vec3(-FLT_MAX);
+    }
+    m_chunks = CellChunks;
 
     // Initialize the meshes in the scene one by one
     for (unsigned int i = 0 ; i < m_Entries.size() ; i++) {
         const aiMesh* paiMesh = pScene->mMeshes[i];
-        InitMesh(i, paiMesh);
+        InitMesh(i, paiMesh, pBakedLighting, pTriangles);
+    }
+
+    // Keep only the cells that have triangles
+    CellChunks.clear();
+    for (int i = 0 ; i < Cells ; i++) {
+        if (m_chunks[i].BoundsMin.x <= m_chunks[i].BoundsMax.x)
+            CellChunks.push_back(m_chunks[i]);
     }
+    m_chunks = CellChunks;
 
     return InitMaterials(pScene, Filename);
 }
 
-void COpenAssetImportMesh::InitMesh(unsigned int Index, const aiMesh* paiMesh)
+void COpenAssetImportMesh::InitMesh(unsigned int Index, const aiMesh* paiMesh, CBakedLighting* pBakedLighting, std::vector<glm::vec3>* pTriangles)
 {
     m_Entries[Index].MaterialIndex = paiMesh->mMaterialIndex;
     
@@ -139,7 +165,72 @@ void COpenAssetImportMesh::InitMesh(unsigned int Index, const aiMesh* paiMesh)
         Indices.push_back(Face.mIndices[2]);
     }
 
-    m_Entries[Index].Init(Vertices, Indices);
+    if (pTriangles) {
+        for (unsigned int i = 0 ; i < Indices.size() ; i++)
+            pTriangles->push_back(Vertices[Indices[i]].m_pos);
+    }
+
+    std::vector<glm::vec3> Positions(Vertices.size());
+    for (unsigned int i = 0 ; i < Vertices.size() ; i++)
+        Positions[i] = Vertices[i].m_pos;
+    InitChunks(Positions, Indices, Index);
+
+    // The baked lighting stream has one colour per vertex, in the same order as the vertices
+    std::vector<glm::vec4> Colours;
+    if (pBakedLighting) {
+        Colours.resize(Vertices.size());
+        for (unsigned int i = 0 ; i < Vertices.size() ; i++)
+            pBakedLighting->Lookup(Vertices[i].m_pos, Vertices[i].m_normal, &Colours[i]);
+    }
+
+    m_Entries[Index].NumIndices = Indices.size();
+    m_pPool->Add(Vertices, Indices, pBakedLighting ? &Colours : NULL, m_Entries[Index].BaseVertex, m_Entries[Index].FirstIndex);
+}
+
+// Sorts an entry's triangles by the grid cell holding their centre, so each cell is one range of the index buffer
+void COpenAssetImportMesh::InitChunks(std::vector<glm::vec3>& EntryPositions, std::vector<unsigned int>& Indices, unsigned int Index)
+{
+    int Cells = m_chunkGrid * m_chunkGrid;
+    unsigned int NumTriangles = Indices.size() / 3;
+
+    std::vector<int> TriangleCell(NumTriangles);
+    std::vector<unsigned int> CellTriangles(Cells, 0);
+    for (unsigned int t = 0 ; t < NumTriangles ; t++) {
+        glm::vec3 Centre = (EntryPositions[Indices[t * 3]] + EntryPositions[Indices[t * 3 + 1]] + EntryPositions[Indices[t * 3 + 2]]) / 3.0f;
+        TriangleCell[t] = GetChunkCell(Centre);
+        CellTriangles[TriangleCell[t]]++;
+    }
+
+    MeshEntry& Entry = m_Entries[Index];
+    Entry.ChunkFirst.resize(Cells);
+    Entry.ChunkCount.resize(Cells);
+    unsigned int First = 0;
+    for (int c = 0 ; c < Cells ; c++) {
+        Entry.ChunkFirst[c] = First;
+        Entry.ChunkCount[c] = 0;
+        First += CellTriangles[c] * 3;
+    }
+
+    std::vector<unsigned int> Sorted(Indices.size());
+    for (unsigned int t = 0 ; t < NumTriangles ; t++) {
+        int Cell = TriangleCell[t];
+        unsigned int Dest = Entry.ChunkFirst[Cell] + Entry.ChunkCount[Cell];
+        for (int k = 0 ; k < 3 ; k++) {
+            Sorted[Dest + k] = Indices[t * 3 + k];
+            m_chunks[Cell].BoundsMin = glm::min(m_chunks[Cell].BoundsMin, EntryPositions[Indices[t * 3 + k]]);
+            m_chunks[Cell].BoundsMax = glm::max(m_chunks[Cell].BoundsMax, EntryPositions[Indices[t * 3 + k]]);
+        }
+        Entry.ChunkCount[Cell] += 3;
+    }
+    Indices.swap(Sorted);
+}
+
+int COpenAssetImportMesh::GetChunkCell(const glm::vec3 &TriangleCentre)
+{
+    glm::vec3 Extent = glm::max(m_boundsMax - m_boundsMin, glm::vec3(1e-6f));
+    int CellX = glm::clamp((int)((TriangleCentre.x - m_boundsMin.x) / Extent.x * m_chunkGrid), 0, m_chunkGrid - 1);
+    int CellZ = glm::clamp((int)((TriangleCentre.z - m_boundsMin.z) / Extent.z * m_chunkGrid), 0, m_chunkGrid - 1);
+    return CellZ * m_chunkGrid + CellX;
 }
 
 bool COpenAssetImportMesh::InitMaterials(const aiScene* pScene, const std::string& Filename)
@@ -205,34 +296,124 @@ bool COpenAssetImportMesh::InitMaterials(const aiScene* pScene, const std::strin
 
 void COpenAssetImportMesh::Render()
 {
-	glBindVertexArray(m_vao);
+	m_pPool->Bind();
+
+    for (unsigned int i = 0 ; i < m_Entries.size() ; i++)
+        RenderEntry(i, 0, m_Entries[i].NumIndices);
+}
+
+// Draws one chunk, which is a range of indices in each entry
+void COpenAssetImportMesh::RenderChunk(int Chunk)
+{
+	m_pPool->Bind();
 
+    int Cell = m_chunks[Chunk].Cell;
     for (unsigned int i = 0 ; i < m_Entries.size() ; i++) {
-		glEnableVertexAttribArray(0);
-		glEnableVertexAttribArray(1);
-		glEnableVertexAttribArray(2);
-        glBindBuffer(GL_ARRAY_BUFFER, m_Entries[i].vbo);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), 0);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const GLvoid*)12);
-        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const GLvoid*)20);
+        if (m_Entries[i].ChunkCount[Cell] > 0)
+            RenderEntry(i, m_Entries[i].ChunkFirst[Cell], m_Entries[i].ChunkCount[Cell]);
+    }
+}
+
+int COpenAssetImportMesh::FindChunk(const glm::vec3 &TriangleCentre)
+{
+    int Cell = GetChunkCell(TriangleCentre);
+    for (unsigned int i = 0 ; i < m_chunks.size() ; i++) {
+        if (m_chunks[i].Cell == Cell)
+            return i;
+    }
+    return -1;
+}
+
+// Draws a range of an entry's indices.  FirstIndex is relative to the start of the entry.
+void COpenAssetImportMesh::RenderEntry(unsigned int i, unsigned int FirstIndex, unsigned int Count)
+{
+    const unsigned int MaterialIndex = m_Entries[i].MaterialIndex;
 
+    if (MaterialIndex < m_Textures.size() && m_Textures[MaterialIndex]) {
+        m_Textures[MaterialIndex]->Bind(0);
+    }
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_Entries[i].ibo);
+    glDrawElementsBaseVertex(GL_TRIANGLES, Count, GL_UNSIGNED_INT, (GLvoid*)((m_Entries[i].FirstIndex + FirstIndex) * sizeof(unsigned int)), 
+        m_Entries[i].BaseVertex);
+}
 
+// Draws InstanceCount copies of the mesh.  InstanceBuffer holds one model matrix per instance starting at InstanceOffset 
+// bytes, which is read as a mat4 vertex attribute at locations 4-7.
+void COpenAssetImportMesh::RenderInstanced(GLuint InstanceBuffer, GLintptr InstanceOffset, int InstanceCount)
+{
+	m_pPool->Bind();
+
+    // One matrix column per attribute location, advancing once per instance rather than per vertex.  The pool's vertex 
+    // array is shared, so they are switched off again afterwards.
+    glBindBuffer(GL_ARRAY_BUFFER, InstanceBuffer);
+    for (int c = 0 ; c < 4 ; c++) {
+        glEnableVertexAttribArray(4 + c);
+        glVertexAttribPointer(4 + c, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (const GLvoid*)(InstanceOffset + c * sizeof(glm::vec4)));
+        glVertexAttribDivisor(4 + c, 1);
+    }
 
+    for (unsigned int i = 0 ; i < m_Entries.size() ; i++) {
         const unsigned int MaterialIndex = m_Entries[i].MaterialIndex;
 
         if (MaterialIndex < m_Textures.size() && m_Textures[MaterialIndex]) {
             m_Textures[MaterialIndex]->Bind(0);
         }
 
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, m_Entries[i].NumIndices, GL_UNSIGNED_INT, 
+            (GLvoid*)(m_Entries[i].FirstIndex * sizeof(unsigned int)), InstanceCount, m_Entries[i].BaseVertex);
+    }
 
-        glDrawElements(GL_TRIANGLES, m_Entries[i].NumIndices, GL_UNSIGNED_INT, 0);
-		glDisableVertexAttribArray(0);
-		glDisableVertexAttribArray(1);
-		glDisableVertexAttribArray(2);
+    for (int c = 0 ; c < 4 ; c++) {
+        glVertexAttribDivisor(4 + c, 0);
+        glDisableVertexAttribArray(4 + c);
     }
+}
+
+// Returns true if the mesh was loaded with a baked lighting stream
+bool COpenAssetImportMesh::HasBakedLighting()
+{
+	return m_bakedLighting;
+}
+
+void COpenAssetImportMesh::SetChunkGrid(int Cells)
+{
+	m_chunkGrid = Cells;
+}
+
+int COpenAssetImportMesh::GetChunkCount()
+{
+	return (int)m_chunks.size();
+}
+
+void COpenAssetImportMesh::GetChunkBounds(int Chunk, glm::vec3 &BoundsMin, glm::vec3 &BoundsMax)
+{
+	BoundsMin = m_chunks[Chunk].BoundsMin;
+	BoundsMax = m_chunks[Chunk].BoundsMax;
+}
 
+// Gets the object-space bounding box, used for culling
+void COpenAssetImportMesh::GetBounds(glm::vec3 &BoundsMin, glm::vec3 &BoundsMax)
+{
+	BoundsMin = m_boundsMin;
+	BoundsMax = m_boundsMax;
+}
 
+void COpenAssetImportMesh::SetMeshPool(CMeshPool* pPool)
+{
+	m_pPool = pPool;
+}
 
+// Lists the index ranges that draw a chunk, or the whole mesh, with the texture each range uses
+void COpenAssetImportMesh::GetDrawRanges(int Chunk, std::vector<MeshDrawRange> &Ranges)
+{
+    int Cell = Chunk >= 0 ? m_chunks[Chunk].Cell : -1;
+    for (unsigned int i = 0 ; i < m_Entries.size() ; i++) {
+        MeshDrawRange Range;
+        Range.FirstIndex = m_Entries[i].FirstIndex + (Cell >= 0 ? m_Entries[i].ChunkFirst[Cell] : 0);
+        Range.Count = Cell >= 0 ? m_Entries[i].ChunkCount[Cell] : m_Entries[i].NumIndices;
+        Range.BaseVertex = m_Entries[i].BaseVertex;
+        Range.pTexture = m_Entries[i].MaterialIndex < m_Textures.size() ? m_Textures[m_Entries[i].MaterialIndex] : NULL;
+        if (Range.Count > 0)
+            Ranges.push_back(Range);
+    }
 }
@@ -30,6 +30,9 @@
 #include "Common.h"
 #include "Texture.h"
 
+class CBakedLighting;
+class CMeshPool;
+
 #define INVALID_OGL_VALUE 0xFFFFFFFF
 #define SAFE_DELETE(p) if (p) { delete p; p = NULL; }
 
@@ -50,19 +53,47 @@ struct Vertex
     }
 };
 
+// A range of the shared index buffer drawn with one texture, as used by the indirect draws
+struct MeshDrawRange
+{
+    unsigned int FirstIndex;
+    unsigned int Count;
+    int BaseVertex;
+    CTexture* pTexture;
+};
+
 
 class COpenAssetImportMesh
 {
 public:
     COpenAssetImportMesh();
     ~COpenAssetImportMesh();
-    bool Load(const std::string& Filename);
+    bool Load(const std::string& Filename, CBakedLighting* pBakedLighting = NULL, std::vector<glm::vec3>* pTriangles = NULL);
     void Render();
+    void RenderInstanced(GLuint InstanceBuffer, GLintptr InstanceOffset, int InstanceCount);
+    bool HasBakedLighting();
+    void GetBounds(glm::vec3 &BoundsMin, glm::vec3 &BoundsMax);
+
+    // Chunks split the mesh on a grid over its x-z footprint, so large meshes can be culled a piece at a time.  Call 
+    // SetChunkGrid before Load; the default is a single chunk.
+    void SetChunkGrid(int Cells);
+    int GetChunkCount();
+    void GetChunkBounds(int Chunk, glm::vec3 &BoundsMin, glm::vec3 &BoundsMax);
+    void RenderChunk(int Chunk);
+    int FindChunk(const glm::vec3 &TriangleCentre);	// The chunk holding a triangle, by its object-space centre
+
+    // Meshes given a pool before Load keep their geometry in its shared buffers, which the caller uploads once every mesh 
+    // is loaded.  Otherwise the mesh gets a pool of its own.
+    void SetMeshPool(CMeshPool* pPool);
+    void GetDrawRanges(int Chunk, std::vector<MeshDrawRange> &Ranges);	// Pass -1 for the whole mesh
 
 private:
-    bool InitFromScene(const aiScene* pScene, const std::string& Filename);
-    void InitMesh(unsigned int Index, const aiMesh* paiMesh);
+    bool InitFromScene(const aiScene* pScene, const std::string& Filename, CBakedLighting* pBakedLighting, std::vector<glm::vec3>* pTriangles);
+    void InitMesh(unsigned int Index, const aiMesh* paiMesh, CBakedLighting* pBakedLighting, std::vector<glm::vec3>* pTriangles);
     bool InitMaterials(const aiScene* pScene, const std::string& Filename);
+    void InitChunks(std::vector<glm::vec3>& EntryPositions, std::vector<unsigned int>& Indices, unsigned int Index);
+    int GetChunkCell(const glm::vec3 &TriangleCentre);
+    void RenderEntry(unsigned int Index, unsigned int FirstIndex, unsigned int Count);
     void Clear();
 	
 
@@ -71,19 +102,29 @@ private:
     struct MeshEntry {
         MeshEntry();
 
-        ~MeshEntry();
-
-        void Init(const std::vector<Vertex>& Vertices,
-                  const std::vector<unsigned int>& Indices);
-        GLuint vbo;
-        GLuint ibo;
+        int BaseVertex;            // Where the entry's vertices and indices start in the pool
+        unsigned int FirstIndex;
         unsigned int NumIndices;
         unsigned int MaterialIndex;
+        std::vector<unsigned int> ChunkFirst;   // Range of the index buffer in each grid cell
+        std::vector<unsigned int> ChunkCount;
+    };
+
+    struct Chunk {
+        int Cell;
+        glm::vec3 BoundsMin;
+        glm::vec3 BoundsMax;
     };
 
     std::vector<MeshEntry> m_Entries;
     std::vector<CTexture*> m_Textures;
-	GLuint m_vao;
+	CMeshPool* m_pPool;
+	bool m_ownPool;				// The pool was created by Load, rather than shared
+	bool m_bakedLighting;
+	glm::vec3 m_boundsMin;		// Object-space bounding box of all the entries
+	glm::vec3 m_boundsMax;
+	int m_chunkGrid;
+	std::vector<Chunk> m_chunks;	// Non-empty grid cells
 };
 
 
@@ -0,0 +1,370 @@
+#include "PotentiallyVisibleSet.h"
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <thread>
+#include <atomic>
+
+// Size of the object ID buffer rendered from each sampled viewpoint.  Objects smaller than a pixel may be missed.
+static const int PVS_RASTER_WIDTH = 480;
+static const int PVS_RASTER_HEIGHT = 270;
+
+// A triangle after clipping against the near plane has at most four corners
+static const int MAX_CLIPPED_CORNERS = 4;
+
+
+// An object's triangles, which are sorted by object, and its world-space bounding box
+struct PvsObjectRange
+{
+	int first, count;
+	glm::vec3 boundsMin, boundsMax;
+};
+
+// Depth and object ID buffers for one viewpoint.  Each baking thread has its own.
+struct PvsRaster
+{
+	std::vector<float> depth;
+	std::vector<int> ids;
+};
+
+
+// Whether a world-space box lies wholly outside one of the clip planes
+static bool IsBoxOutside(const glm::mat4 &viewProjectionMatrix, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax)
+{
+	int iOutside[6] = { 0, 0, 0, 0, 0, 0 };
+	for (int i = 0; i < 8; i++) {
+		glm::vec3 corner((i & 1) ? boundsMax.x : boundsMin.x, (i & 2) ? boundsMax.y : boundsMin.y, (i & 4) ? boundsMax.z : boundsMin.z);
+		glm::vec4 clip = viewProjectionMatrix * glm::vec4(corner, 1.0f);
+		iOutside[0] += clip.x < -clip.w;
+		iOutside[1] += clip.x > clip.w;
+		iOutside[2] += clip.y < -clip.w;
+		iOutside[3] += clip.y > clip.w;
+		iOutside[4] += clip.z < -clip.w;
+		iOutside[5] += clip.z > clip.w;
+	}
+	for (int i = 0; i < 6; i++) {
+		if (iOutside[i] == 8)
+			return true;
+	}
+	return false;
+}
+
+// Clips a triangle in clip space against the near plane (z >= -w).  Returns the number of corners left.
+static int ClipNear(const glm::vec4 *pIn, glm::vec4 *pOut)
+{
+	int iCount = 0;
+	for (int i = 0; i < 3; i++) {
+		const glm::vec4 &a = pIn[i];
+		const glm::vec4 &b = pIn[(i + 1) % 3];
+		float da = a.z + a.w;
+		float db = b.z + b.w;
+		if (da >= 0.0f)
+			pOut[iCount++] = a;
+		if ((da >= 0.0f) != (db >= 0.0f))
+			pOut[iCount++] = a + (b - a) * (da / (da - db));
+	}
+	return iCount;
+}
+
+// Draws one screen-space triangle (x, y in pixels, z in normalised device depth) with a depth test, writing the object ID.
+// Both windings are drawn, since the City mesh is rendered without back face culling.
+static void RasteriseTriangle(const glm::vec3 &v0, const glm::vec3 &v1, const glm::vec3 &v2, int iObject, PvsRaster &raster)
+{
+	float fArea = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+	if (fArea == 0.0f)
+		return;
+	float fInvArea = 1.0f / fArea;
+
+	int iMinX = std::max(0, (int)floorf(std::min(v0.x, std::min(v1.x, v2.x))));
+	int iMaxX = std::min(PVS_RASTER_WIDTH - 1, (int)ceilf(std::max(v0.x, std::max(v1.x, v2.x))));
+	int iMinY = std::max(0, (int)floorf(std::min(v0.y, std::min(v1.y, v2.y))));
+	int iMaxY = std::min(PVS_RASTER_HEIGHT - 1, (int)ceilf(std::max(v0.y, std::max(v1.y, v2.y))));
+
+	for (int y = iMinY; y <= iMaxY; y++) {
+		float py = y + 0.5f;
+		for (int x = iMinX; x <= iMaxX; x++) {
+			float px = x + 0.5f;
+
+			// Barycentric weights, which are all positive inside the triangle whichever way it winds
+			float w0 = ((v1.x - px) * (v2.y - py) - (v1.y - py) * (v2.x - px)) * fInvArea;
+			float w1 = ((v2.x - px) * (v0.y - py) - (v2.y - py) * (v0.x - px)) * fInvArea;
+			float w2 = 1.0f - w0 - w1;
+			if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+				continue;
+
+			float z = w0 * v0.z + w1 * v1.z + w2 * v2.z;
+			int iPixel = y * PVS_RASTER_WIDTH + x;
+			if (z > 1.0f || z >= raster.depth[iPixel])
+				continue;
+			raster.depth[iPixel] = z;
+			raster.ids[iPixel] = iObject;
+		}
+	}
+}
+
+// Renders the object IDs from one viewpoint and marks every object that ends up in the buffer
+static void RasteriseView(const glm::mat4 &viewProjectionMatrix, const std::vector<glm::vec3> &triangles,
+	const std::vector<PvsObjectRange> &objects, PvsRaster &raster, std::vector<unsigned char> &visible)
+{
+	std::fill(raster.depth.begin(), raster.depth.end(), FLT_MAX);
+	std::fill(raster.ids.begin(), raster.ids.end(), -1);
+
+	glm::vec2 screenScale(PVS_RASTER_WIDTH * 0.5f, PVS_RASTER_HEIGHT * 0.5f);
+	for (int iObject = 0; iObject < (int)objects.size(); iObject++) {
+		const PvsObjectRange &object = objects[iObject];
+		if (object.count == 0 || IsBoxOutside(viewProjectionMatrix, object.boundsMin, object.boundsMax))
+			continue;
+
+		for (int t = object.first; t < object.first + object.count; t++) {
+			glm::vec4 clip[3];
+			for (int k = 0; k < 3; k++)
+				clip[k] = viewProjectionMatrix * glm::vec4(triangles[t * 3 + k], 1.0f);
+
+			// Skip triangles wholly outside a side plane, before clipping
+			if ((clip[0].x < -clip[0].w && clip[1].x < -clip[1].w && clip[2].x < -clip[2].w) ||
+				(clip[0].x > clip[0].w && clip[1].x > clip[1].w && clip[2].x > clip[2].w) ||
+				(clip[0].y < -clip[0].w && clip[1].y < -clip[1].w && clip[2].y < -clip[2].w) ||
+				(clip[0].y > clip[0].w && clip[1].y > clip[1].w && clip[2].y > clip[2].w))
+				continue;
+
+			glm::vec4 clipped[MAX_CLIPPED_CORNERS];
+			int iCorners = ClipNear(clip, clipped);
+			if (iCorners < 3)
+				continue;
+
+			glm::vec3 screen[MAX_CLIPPED_CORNERS];
+			for (int k = 0; k < iCorners; k++) {
+				glm::vec3 ndc = glm::vec3(clipped[k]) / clipped[k].w;
+				screen[k] = glm::vec3((ndc.x + 1.0f) * screenScale.x, (ndc.y + 1.0f) * screenScale.y, ndc.z);
+			}
+			for (int k = 1; k + 1 < iCorners; k++)
+				RasteriseTriangle(screen[0], screen[k], screen[k + 1], iObject, raster);
+		}
+	}
+
+	for (int i = 0; i < (int)raster.ids.size(); i++) {
+		if (raster.ids[i] >= 0)
+			visible[raster.ids[i]] = 1;
+	}
+}
+
+
+CPotentiallyVisibleSet::CPotentiallyVisibleSet()
+{
+	m_objectCount = 0;
+	m_modeCount = 0;
+	m_sectorCount = 0;
+	m_trackLength = 0.0f;
+	m_currentSet = -1;
+}
+
+bool CPotentiallyVisibleSet::Load(const std::string &filename, int iObjectCount, float fTrackLength)
+{
+	m_sets.clear();
+	m_currentSet = -1;
+
+	FILE *pFile = fopen(filename.c_str(), "rb");
+	if (pFile == NULL)
+		return false;
+
+	PvsHeader header;
+	bool bValid = fread(&header, sizeof(header), 1, pFile) == 1 && header.magic == PVS_MAGIC && header.version == PVS_VERSION &&
+		(int)header.objectCount == iObjectCount && fabs(header.trackLength - fTrackLength) < 1.0f;
+
+	if (bValid) {
+		m_sets.resize(header.modeCount * header.sectorCount);
+		for (unsigned int i = 0; i < m_sets.size() && bValid; i++) {
+			unsigned int uiSize = 0;
+			bValid = fread(&uiSize, sizeof(uiSize), 1, pFile) == 1;
+			if (bValid) {
+				m_sets[i].resize(uiSize);
+				bValid = uiSize == 0 || fread(&m_sets[i][0], uiSize, 1, pFile) == 1;
+			}
+		}
+	}
+	fclose(pFile);
+
+	if (!bValid) {
+		m_sets.clear();
+		return false;
+	}
+	m_objectCount = header.objectCount;
+	m_modeCount = header.modeCount;
+	m_sectorCount = header.sectorCount;
+	m_trackLength = header.trackLength;
+	return true;
+}
+
+bool CPotentiallyVisibleSet::Save(const std::string &filename)
+{
+	FILE *pFile = fopen(filename.c_str(), "wb");
+	if (pFile == NULL)
+		return false;
+
+	PvsHeader header;
+	header.magic = PVS_MAGIC;
+	header.version = PVS_VERSION;
+	header.objectCount = m_objectCount;
+	header.modeCount = m_modeCount;
+	header.sectorCount = m_sectorCount;
+	header.trackLength = m_trackLength;
+	bool bWritten = fwrite(&header, sizeof(header), 1, pFile) == 1;
+
+	for (unsigned int i = 0; i < m_sets.size() && bWritten; i++) {
+		unsigned int uiSize = (unsigned int)m_sets[i].size();
+		bWritten = fwrite(&uiSize, sizeof(uiSize), 1, pFile) == 1 && (uiSize == 0 || fwrite(&m_sets[i][0], uiSize, 1, pFile) == 1);
+	}
+	fclose(pFile);
+	return bWritten;
+}
+
+bool CPotentiallyVisibleSet::IsLoaded()
+{
+	return !m_sets.empty();
+}
+
+void CPotentiallyVisibleSet::Bake(int iObjectCount, const std::vector<glm::vec3> &triangles, const std::vector<int> &triangleObjects,
+	int iModeCount, int iSectorCount, float fTrackLength, const std::vector<std::vector<glm::mat4> > &setViews, int iThreads)
+{
+	m_objectCount = iObjectCount;
+	m_modeCount = iModeCount;
+	m_sectorCount = iSectorCount;
+	m_trackLength = fTrackLength;
+	m_currentSet = -1;
+	m_sets.assign(iModeCount * iSectorCount, std::vector<unsigned char>());
+
+	// Sort the triangles by object, so each view can skip whole objects outside its frustum
+	int iTriangles = (int)triangleObjects.size();
+	std::vector<PvsObjectRange> objects(iObjectCount);
+	for (int i = 0; i < iObjectCount; i++) {
+		objects[i].count = 0;
+		objects[i].boundsMin = glm::vec3(FLT_MAX);
+		objects[i].boundsMax = glm::vec3(-FLT_MAX);
+	}
+	for (int t = 0; t < iTriangles; t++)
+		objects[triangleObjects[t]].count++;
+	int iFirst = 0;
+	for (int i = 0; i < iObjectCount; i++) {
+		objects[i].first = iFirst;
+		iFirst += objects[i].count;
+		objects[i].count = 0;
+	}
+	std::vector<glm::vec3> sorted(triangles.size());
+	for (int t = 0; t < iTriangles; t++) {
+		PvsObjectRange &object = objects[triangleObjects[t]];
+		for (int k = 0; k < 3; k++) {
+			const glm::vec3 &corner = triangles[t * 3 + k];
+			sorted[(object.first + object.count) * 3 + k] = corner;
+			object.boundsMin = glm::min(object.boundsMin, corner);
+			object.boundsMax = glm::max(object.boundsMax, corner);
+		}
+		object.count++;
+	}
+
+	// Each thread takes the next set to bake until they are all done
+	std::atomic<int> nextSet(0);
+	std::vector<std::thread> workers;
+	for (int i = 0; i < std::max(1, iThreads); i++) {
+		workers.push_back(std::thread([&]() {
+			PvsRaster raster;
+			raster.depth.resize(PVS_RASTER_WIDTH * PVS_RASTER_HEIGHT);
+			raster.ids.resize(PVS_RASTER_WIDTH * PVS_RASTER_HEIGHT);
+			for (int iSet = nextSet++; iSet < (int)m_sets.size(); iSet = nextSet++) {
+				std::vector<unsigned char> visible(m_objectCount, 0);
+				for (unsigned int v = 0; v < setViews[iSet].size(); v++)
+					RasteriseView(setViews[iSet][v], sorted, objects, raster, visible);
+				Compress(visible, m_sets[iSet]);
+			}
+		}));
+	}
+	for (unsigned int i = 0; i < workers.size(); i++)
+		workers[i].join();
+}
+
+int CPotentiallyVisibleSet::GetSector(float fDistance)
+{
+	if (m_sectorCount == 0 || m_trackLength <= 0.0f)
+		return 0;
+	float fLength = fmodf(fDistance, m_trackLength);
+	if (fLength < 0.0f)
+		fLength += m_trackLength;
+	return std::min((int)(fLength / GetSectorLength()), m_sectorCount - 1);
+}
+
+float CPotentiallyVisibleSet::GetSectorLength()
+{
+	return m_sectorCount > 0 ? m_trackLength / m_sectorCount : 0.0f;
+}
+
+int CPotentiallyVisibleSet::GetSectorCount()
+{
+	return m_sectorCount;
+}
+
+int CPotentiallyVisibleSet::GetModeCount()
+{
+	return m_modeCount;
+}
+
+int CPotentiallyVisibleSet::GetObjectCount()
+{
+	return m_objectCount;
+}
+
+int CPotentiallyVisibleSet::GetCompressedSize()
+{
+	int iSize = 0;
+	for (unsigned int i = 0; i < m_sets.size(); i++)
+		iSize += (int)m_sets[i].size();
+	return iSize;
+}
+
+// Unpacks the set for a mode and sector, unless it is the one already unpacked
+const std::vector<unsigned char>& CPotentiallyVisibleSet::GetVisibleObjects(int iMode, int iSector)
+{
+	int iSet = glm::clamp(iMode, 0, m_modeCount - 1) * m_sectorCount + glm::clamp(iSector, 0, m_sectorCount - 1);
+	if (iSet != m_currentSet) {
+		m_currentVisible.assign(m_objectCount, 0);
+		Decompress(m_sets[iSet], m_currentVisible);
+		m_currentSet = iSet;
+	}
+	return m_currentVisible;
+}
+
+void CPotentiallyVisibleSet::Compress(const std::vector<unsigned char> &visible, std::vector<unsigned char> &compressed)
+{
+	compressed.clear();
+	unsigned char uiRunValue = 0;
+	unsigned int i = 0;
+	while (i < visible.size()) {
+		unsigned int uiRun = 0;
+		while (i < visible.size() && (visible[i] != 0) == (uiRunValue != 0)) {
+			uiRun++;
+			i++;
+		}
+		do {
+			compressed.push_back((unsigned char)((uiRun & 0x7f) | (uiRun > 0x7f ? 0x80 : 0)));
+			uiRun >>= 7;
+		} while (uiRun > 0);
+		uiRunValue = !uiRunValue;
+	}
+}
+
+void CPotentiallyVisibleSet::Decompress(const std::vector<unsigned char> &compressed, std::vector<unsigned char> &visible)
+{
+	unsigned char uiRunValue = 0;
+	unsigned int i = 0, uiObject = 0;
+	while (i < compressed.size()) {
+		unsigned int uiRun = 0;
+		int iShift = 0;
+		do {
+			uiRun |= (compressed[i] & 0x7f) << iShift;
+			iShift += 7;
+		} while (compressed[i++] & 0x80 && i < compressed.size());
+
+		for (unsigned int j = 0; j < uiRun && uiObject < visible.size(); j++)
+			visible[uiObject++] = uiRunValue;
+		uiRunValue = !uiRunValue;
+	}
+}
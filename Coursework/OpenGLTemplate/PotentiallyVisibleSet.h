@@ -0,0 +1,61 @@
+#pragma once
+
+// Precomputed visibility along the track.  Like Occluders.h, this only depends on glm and the standard library, so the
+// baking can be run and checked without Windows or GL.
+#include <string>
+#include <vector>
+#include "include/glm/glm.hpp"
+
+// Potentially visible set files (.pvs) hold one set per camera mode and track sector.  Each set is a run-length encoded
+// bit per object: alternating runs of hidden and visible objects, starting with a hidden run, each run a 7-bit varint.
+static const unsigned int PVS_MAGIC = 0x31535650; // "PVS1"
+static const unsigned int PVS_VERSION = 1;
+
+struct PvsHeader
+{
+	unsigned int magic;
+	unsigned int version;
+	unsigned int objectCount;
+	unsigned int modeCount;
+	unsigned int sectorCount;
+	float trackLength;			// Used to spot a file baked for a different track
+};
+
+// A class holding which objects can be seen from each sector of the track, for each camera mode.  The sets are baked by
+// rasterising object IDs on the CPU from camera positions sampled along each sector, and kept compressed in memory; the
+// set in use is unpacked when the camera moves into a new sector.
+class CPotentiallyVisibleSet
+{
+public:
+	CPotentiallyVisibleSet();
+
+	bool Load(const std::string &filename, int iObjectCount, float fTrackLength);	// Fails if missing or stale
+	bool Save(const std::string &filename);
+	bool IsLoaded();
+
+	// Bakes the sets.  triangles holds three world-space corners per triangle and triangleObjects the object of each
+	// triangle.  setViews holds the view-projection matrices sampled for each set, indexed by mode * sectors + sector.
+	void Bake(int iObjectCount, const std::vector<glm::vec3> &triangles, const std::vector<int> &triangleObjects, int iModeCount,
+		int iSectorCount, float fTrackLength, const std::vector<std::vector<glm::mat4> > &setViews, int iThreads);
+
+	int GetSector(float fDistance);				// Wraps distances from any lap onto the track
+	float GetSectorLength();
+	int GetSectorCount();
+	int GetModeCount();
+	int GetObjectCount();
+	int GetCompressedSize();					// Bytes used by all the sets
+	const std::vector<unsigned char>& GetVisibleObjects(int iMode, int iSector);	// One flag per object
+
+private:
+	static void Compress(const std::vector<unsigned char> &visible, std::vector<unsigned char> &compressed);
+	static void Decompress(const std::vector<unsigned char> &compressed, std::vector<unsigned char> &visible);
+
+	int m_objectCount;
+	int m_modeCount;
+	int m_sectorCount;
+	float m_trackLength;
+	std::vector<std::vector<unsigned char> > m_sets;	// Compressed, indexed by mode * m_sectorCount + sector
+
+	int m_currentSet;
+	std::vector<unsigned char> m_currentVisible;
+};
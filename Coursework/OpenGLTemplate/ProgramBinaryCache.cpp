@@ -0,0 +1,190 @@
+#include "Common.h"
+#include "ProgramBinaryCache.h"
+#include "Shaders.h"
+
+// Entry file header.  The key's check and length are kept in the file, since the file name only gives its hash.
+static const unsigned int PROGRAM_BINARY_MAGIC = 0x4e494250; // "PBIN"
+static const unsigned int PROGRAM_BINARY_VERSION = 2;
+
+struct ProgramBinaryHeader
+{
+	unsigned int magic;
+	unsigned int version;
+	unsigned long long check;
+	unsigned long long sourceLength;
+	unsigned int format;
+	unsigned int length;
+};
+
+
+// Continues the key's hashes over a string: FNV-1a for the hash, and djb2 for the check
+static void HashString(ProgramBinaryKey &key, const string &s)
+{
+	for (int i = 0; i < (int)s.size(); i++) {
+		key.hash ^= (unsigned char)s[i];
+		key.hash *= 1099511628211ULL;
+		key.check = key.check * 33 + (unsigned char)s[i];
+	}
+	key.length += s.size();
+}
+
+
+CProgramBinaryCache::CProgramBinaryCache()
+{
+	m_supported = false;
+	m_hits = 0;
+	m_misses = 0;
+}
+
+CProgramBinaryCache::~CProgramBinaryCache()
+{}
+
+// Sets the folder used to store binaries and checks that the driver can return at least one binary format
+void CProgramBinaryCache::Create(string sDirectory)
+{
+	m_directory = sDirectory;
+	CreateDirectory(m_directory.c_str(), NULL);
+
+	const char* sVendor = (const char*)glGetString(GL_VENDOR);
+	const char* sRenderer = (const char*)glGetString(GL_RENDERER);
+	const char* sVersion = (const char*)glGetString(GL_VERSION);
+	m_driver = string(sVendor ? sVendor : "") + "|" + (sRenderer ? sRenderer : "") + "|" + (sVersion ? sVersion : "");
+
+	int iNumFormats = 0;
+	if (GLEW_ARB_get_program_binary)
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &iNumFormats);
+	m_supported = iNumFormats > 0;
+}
+
+// Returns true if the driver supports program binaries
+bool CProgramBinaryCache::IsSupported()
+{
+	return m_supported;
+}
+
+CShaderProgram* CProgramBinaryCache::BuildProgram(string sVertexFile, string sFragmentFile, const vector<string> &sDefines)
+{
+	CShader vertexShader, fragmentShader;
+	vector<string> sVertexSource, sFragmentSource;
+	vertexShader.GetShaderSource(sVertexFile, sDefines, &sVertexSource);
+	fragmentShader.GetShaderSource(sFragmentFile, sDefines, &sFragmentSource);
+
+	CShaderProgram* pProgram = new CShaderProgram;
+	pProgram->CreateProgram();
+
+	ProgramBinaryKey key = ComputeKey(sVertexSource, sFragmentSource);
+	if (Load(key, pProgram))
+		return pProgram;
+
+	// The cache was missing or rejected by the driver.  A rejected program object is reset, so it can be linked as normal.
+	vertexShader.CompileShader(sVertexSource, sVertexFile, GL_VERTEX_SHADER);
+	fragmentShader.CompileShader(sFragmentSource, sFragmentFile, GL_FRAGMENT_SHADER);
+	pProgram->AddShaderToProgram(&vertexShader);
+	pProgram->AddShaderToProgram(&fragmentShader);
+	pProgram->SetBinaryRetrievable();
+	if (pProgram->LinkProgram())
+		Save(key, pProgram);
+
+	vertexShader.DeleteShader();
+	fragmentShader.DeleteShader();
+
+	return pProgram;
+}
+
+// Hashes the preprocessed source of both stages together with the driver strings
+ProgramBinaryKey CProgramBinaryCache::ComputeKey(const vector<string> &sVertexSource, const vector<string> &sFragmentSource)
+{
+	ProgramBinaryKey key;
+	key.hash = 14695981039346656037ULL;
+	key.check = 5381;
+	key.length = 0;
+	HashString(key, m_driver);
+
+	for (int i = 0; i < (int)sVertexSource.size(); i++)
+		HashString(key, sVertexSource[i]);
+	HashString(key, "|");
+	for (int i = 0; i < (int)sFragmentSource.size(); i++)
+		HashString(key, sFragmentSource[i]);
+
+	return key;
+}
+
+// Loads a cached binary into the program.  Returns false if there is no entry or the driver rejects it.
+bool CProgramBinaryCache::Load(const ProgramBinaryKey &key, CShaderProgram* pProgram)
+{
+	if (!m_supported)
+		return false;
+
+	FILE* fp;
+	fopen_s(&fp, GetEntryPath(key).c_str(), "rb");
+	if (!fp) {
+		m_misses++;
+		return false;
+	}
+
+	ProgramBinaryHeader header;
+	vector<BYTE> data;
+	bool bValid = fread(&header, sizeof(header), 1, fp) == 1 && header.magic == PROGRAM_BINARY_MAGIC &&
+		header.version == PROGRAM_BINARY_VERSION && header.check == key.check && header.sourceLength == key.length && 
+		header.length > 0;
+	if (bValid) {
+		data.resize(header.length);
+		bValid = fread(&data[0], 1, header.length, fp) == header.length;
+	}
+	fclose(fp);
+
+	if (!bValid || !pProgram->LoadProgramBinary(header.format, data)) {
+		m_misses++;
+		return false;
+	}
+
+	m_hits++;
+	return true;
+}
+
+// Stores the binary of a linked program.  Failure to write is not an error; the program is just compiled next time.
+void CProgramBinaryCache::Save(const ProgramBinaryKey &key, CShaderProgram* pProgram)
+{
+	if (!m_supported)
+		return;
+
+	GLenum format;
+	vector<BYTE> data;
+	if (!pProgram->GetProgramBinary(&format, &data))
+		return;
+
+	FILE* fp;
+	fopen_s(&fp, GetEntryPath(key).c_str(), "wb");
+	if (!fp)
+		return;
+
+	ProgramBinaryHeader header;
+	header.magic = PROGRAM_BINARY_MAGIC;
+	header.version = PROGRAM_BINARY_VERSION;
+	header.check = key.check;
+	header.sourceLength = key.length;
+	header.format = format;
+	header.length = (unsigned int)data.size();
+	fwrite(&header, sizeof(header), 1, fp);
+	fwrite(&data[0], 1, data.size(), fp);
+	fclose(fp);
+}
+
+// Number of programs loaded from the cache since startup
+int CProgramBinaryCache::GetHitCount()
+{
+	return m_hits;
+}
+
+// Number of programs that had to be compiled because the cache was missing or rejected
+int CProgramBinaryCache::GetMissCount()
+{
+	return m_misses;
+}
+
+string CProgramBinaryCache::GetEntryPath(const ProgramBinaryKey &key)
+{
+	char sName[32];
+	sprintf_s(sName, "%016llx.bin", key.hash);
+	return m_directory + sName;
+}
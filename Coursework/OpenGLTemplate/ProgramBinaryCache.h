@@ -0,0 +1,45 @@
+#pragma once
+
+#include "Common.h"
+
+class CShaderProgram;
+
+// Identifies a cache entry.  The file is named by the hash; the check is a second, unrelated hash of the same text, kept
+// in the file with the text's length, so a different program whose hash collides on the name is not loaded.
+struct ProgramBinaryKey
+{
+	unsigned long long hash;
+	unsigned long long check;
+	unsigned long long length;
+};
+
+// A class that stores linked shader programs on disk using glGetProgramBinary, so later runs can skip compiling 
+// and linking.  Entries are keyed by a hash of the preprocessed shader source and the driver vendor/renderer/version.
+class CProgramBinaryCache
+{
+public:
+	CProgramBinaryCache();
+	~CProgramBinaryCache();
+
+	void Create(string sDirectory);
+	bool IsSupported();
+
+	// Loads the program from the cache, or compiles, links and stores it if there is no usable entry
+	CShaderProgram* BuildProgram(string sVertexFile, string sFragmentFile, const vector<string> &sDefines);
+
+	ProgramBinaryKey ComputeKey(const vector<string> &sVertexSource, const vector<string> &sFragmentSource);
+	bool Load(const ProgramBinaryKey &key, CShaderProgram* pProgram);
+	void Save(const ProgramBinaryKey &key, CShaderProgram* pProgram);
+
+	int GetHitCount();
+	int GetMissCount();
+
+private:
+	string GetEntryPath(const ProgramBinaryKey &key);
+
+	string m_directory;
+	string m_driver;			// Vendor, renderer and version strings, which are part of every key
+	bool m_supported;
+	int m_hits;
+	int m_misses;
+};
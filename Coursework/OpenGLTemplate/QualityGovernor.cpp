@@ -0,0 +1,148 @@
+#include "QualityGovernor.h"
+
+#include <algorithm>
+#include <cmath>
+
+static const double TIME_SMOOTHING = 0.1;		// Weight of each new frame in the smoothed times
+static const double RAISE_BELOW = 0.85;		// Of the target; between this and the target, the level holds
+static const float LOWER_GAIN = 0.25f;			// Level dropped per unit of overshoot
+static const float MAX_LOWER_STEP = 0.1f;
+static const float RAISE_STEP = 0.02f;
+static const float RESOLUTION_STEP = 0.05f;	// Coarse, so small level changes do not resize the render target
+static const int COOLDOWN_FRAMES = 15;			// Frames after a change before the next, so its effect shows in the times
+
+// Where a setting moves across the quality level: below fLow it is at its lowest, above fHigh at its highest
+static float Band(float fLevel, float fLow, float fHigh)
+{
+	return std::min(1.0f, std::max(0.0f, (fLevel - fLow) / (fHigh - fLow)));
+}
+
+static float Blend(float fLowest, float fHighest, float t)
+{
+	return fLowest + (fHighest - fLowest) * t;
+}
+
+CQualityGovernor::CQualityGovernor()
+{
+	m_highest.resolutionScale = 1.0f;
+	m_highest.farPlane = 1.0f;
+	m_highest.spotlights = 0;
+	m_highest.cullDistanceScale = 1.0f;
+	m_lowest = m_highest;
+	m_settings = m_highest;
+	m_target = 1000.0 / 60.0;
+	m_cpuTime = 0.0;
+	m_gpuTime = 0.0;
+	m_level = 1.0f;
+	m_cooldown = 0;
+	m_decision = HOLD;
+	m_enabled = true;
+	m_hasTimes = false;
+}
+
+void CQualityGovernor::SetBounds(const QualitySettings &highest, const QualitySettings &lowest)
+{
+	m_highest = highest;
+	m_lowest = lowest;
+	ApplyLevel();
+}
+
+void CQualityGovernor::SetTarget(double dFrameTime)
+{
+	m_target = dFrameTime;
+}
+
+void CQualityGovernor::SetEnabled(bool bEnabled)
+{
+	m_enabled = bEnabled;
+	m_level = 1.0f;
+	m_cooldown = 0;
+	m_decision = HOLD;
+	ApplyLevel();
+}
+
+bool CQualityGovernor::IsEnabled()
+{
+	return m_enabled;
+}
+
+void CQualityGovernor::Update(double dCpuTime, double dGpuTime)
+{
+	if (!m_hasTimes) {
+		m_cpuTime = dCpuTime;
+		m_gpuTime = dGpuTime;
+		m_hasTimes = true;
+	} else {
+		m_cpuTime += (dCpuTime - m_cpuTime) * TIME_SMOOTHING;
+		m_gpuTime += (dGpuTime - m_gpuTime) * TIME_SMOOTHING;
+	}
+
+	if (!m_enabled)
+		return;
+
+	if (m_cooldown > 0) {
+		m_cooldown--;
+		m_decision = COOLING;
+		return;
+	}
+
+	double dError = GetFrameTime() / m_target;
+	float fLevel = m_level;
+	if (dError > 1.0)
+		fLevel -= std::min(MAX_LOWER_STEP, LOWER_GAIN * (float)(dError - 1.0));
+	else if (dError < RAISE_BELOW)
+		fLevel += RAISE_STEP;
+	fLevel = std::min(1.0f, std::max(0.0f, fLevel));
+
+	if (fLevel == m_level) {
+		m_decision = HOLD;
+		return;
+	}
+	m_decision = fLevel < m_level ? LOWER : RAISE;
+	m_level = fLevel;
+	m_cooldown = COOLDOWN_FRAMES;
+	ApplyLevel();
+}
+
+// Lights go first, then the cull distance, then the far plane and resolution together
+void CQualityGovernor::ApplyLevel()
+{
+	float fLevel = m_enabled ? m_level : 1.0f;
+	m_settings.spotlights = (int)(Blend((float)m_lowest.spotlights, (float)m_highest.spotlights, Band(fLevel, 0.5f, 1.0f)) + 0.5f);
+	m_settings.cullDistanceScale = Blend(m_lowest.cullDistanceScale, m_highest.cullDistanceScale, Band(fLevel, 0.25f, 0.75f));
+	m_settings.farPlane = Blend(m_lowest.farPlane, m_highest.farPlane, Band(fLevel, 0.0f, 0.5f));
+	float fScale = Blend(m_lowest.resolutionScale, m_highest.resolutionScale, Band(fLevel, 0.0f, 0.6f));
+	m_settings.resolutionScale = std::floor(fScale / RESOLUTION_STEP + 0.5f) * RESOLUTION_STEP;
+}
+
+const QualitySettings &CQualityGovernor::GetSettings()
+{
+	return m_settings;
+}
+
+float CQualityGovernor::GetLevel()
+{
+	return m_enabled ? m_level : 1.0f;
+}
+
+double CQualityGovernor::GetFrameTime()
+{
+	return std::max(m_cpuTime, m_gpuTime);
+}
+
+const char* CQualityGovernor::GetBottleneckName()
+{
+	return m_gpuTime > m_cpuTime ? "GPU" : "CPU";
+}
+
+const char* CQualityGovernor::GetDecisionName()
+{
+	if (!m_enabled)
+		return "off";
+	switch (m_decision) {
+	case LOWER: return "lower";
+	case RAISE: return "raise";
+	case COOLING: return "cooling";
+	default: return "hold";
+	}
+}
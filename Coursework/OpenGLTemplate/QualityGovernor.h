@@ -0,0 +1,54 @@
+#pragma once
+
+// Like TripleBuffer.h, this only depends on the standard library
+#include <string>
+
+// The settings the governor controls.  Each one is blended between the highest and lowest quality bounds.
+struct QualitySettings
+{
+	float resolutionScale;			// Of the window size, for the scene pass
+	float farPlane;
+	int spotlights;					// City lights, besides the headlight
+	float cullDistanceScale;		// Of the fog cut-off distance
+};
+
+// A class that holds the frame time to a budget by trading away quality.  It keeps smoothed CPU and GPU frame times;
+// whichever is larger is the bottleneck.  Over budget, it drops a single quality level in proportion to the overshoot;
+// comfortably under budget, it raises the level in small steps.  A dead band between the two, and a cool-down after each
+// change, keep it from oscillating.  The settings are read from the level, each over its own band, so the cheapest
+// losses to the picture (fewer lights, a shorter cull distance) go first and the resolution last.
+class CQualityGovernor
+{
+public:
+	CQualityGovernor();
+
+	void SetBounds(const QualitySettings &highest, const QualitySettings &lowest);
+	void SetTarget(double dFrameTime);		// Milliseconds
+	void SetEnabled(bool bEnabled);			// While disabled, the settings are the highest bounds
+	bool IsEnabled();
+
+	void Update(double dCpuTime, double dGpuTime);	// Once a frame, with the frame's times in milliseconds
+
+	const QualitySettings &GetSettings();
+	float GetLevel();						// 1 for the highest quality, 0 for the lowest
+	double GetFrameTime();					// The smoothed time of the bottleneck
+	const char* GetBottleneckName();
+	const char* GetDecisionName();
+
+private:
+	enum Decision {HOLD, LOWER, RAISE, COOLING};
+
+	void ApplyLevel();
+
+	QualitySettings m_highest;
+	QualitySettings m_lowest;
+	QualitySettings m_settings;
+	double m_target;
+	double m_cpuTime;
+	double m_gpuTime;
+	float m_level;
+	int m_cooldown;
+	Decision m_decision;
+	bool m_enabled;
+	bool m_hasTimes;
+};
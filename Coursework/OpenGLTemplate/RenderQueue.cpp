@@ -0,0 +1,172 @@
+#include "Common.h"
+#include "RenderQueue.h"
+
+// Bits of each field in the sort keys
+static const int KEY_PASS_BITS = 2;
+static const int KEY_PROGRAM_BITS = 8;
+static const int KEY_STATE_BITS = 4;
+static const int KEY_MATERIAL_BITS = 16;
+static const int KEY_DEPTH_BITS = 24;
+static const unsigned int KEY_DEPTH_MAX = (1 << KEY_DEPTH_BITS) - 1;
+
+CRenderQueue::CRenderQueue()
+{
+	m_farDepth = 1.0f;
+	m_unsortedStateChanges = 0;
+	m_sortedStateChanges = 0;
+}
+
+void CRenderQueue::Clear(float fFarDepth)
+{
+	m_commands.clear();
+	m_farDepth = fFarDepth;
+	m_unsortedStateChanges = 0;
+	m_sortedStateChanges = 0;
+}
+
+void CRenderQueue::Add(int iPass, int iProgram, int iMaterial, unsigned int uiState, float fViewDepth, int iDraw)
+{
+	m_commands.push_back(CRenderCommandList::MakeCommand(iPass, iProgram, iMaterial, uiState, fViewDepth, iDraw, m_farDepth));
+}
+
+void CRenderQueue::Append(CRenderCommandList &list, int iDrawOffset)
+{
+	for (unsigned int i = 0; i < list.m_commands.size(); i++) {
+		m_commands.push_back(list.m_commands[i]);
+		m_commands.back().iDraw += iDrawOffset;
+	}
+}
+
+// Least significant digit radix sort, a byte at a time.  Bytes that are the same in every key are skipped, which is
+// most of them, since the unused low bits are zero and there are few programs and materials.
+void CRenderQueue::Finish(bool bSort)
+{
+	m_unsortedStateChanges = CountStateChanges(m_commands);
+	m_sortedStateChanges = m_unsortedStateChanges;
+	if (!bSort)
+		return;
+
+	int iCount = (int)m_commands.size();
+	m_scratch.resize(iCount);
+	for (int iByte = 0; iByte < 8; iByte++) {
+		int iShift = iByte * 8;
+		int counts[256] = { 0 };
+		for (int i = 0; i < iCount; i++)
+			counts[(m_commands[i].key >> iShift) & 0xff]++;
+		if (iCount == 0 || counts[(m_commands[0].key >> iShift) & 0xff] == iCount)
+			continue;
+
+		int iOffset = 0;
+		for (int b = 0; b < 256; b++) {
+			int iBucket = counts[b];
+			counts[b] = iOffset;
+			iOffset += iBucket;
+		}
+		for (int i = 0; i < iCount; i++)
+			m_scratch[counts[(m_commands[i].key >> iShift) & 0xff]++] = m_commands[i];
+		m_commands.swap(m_scratch);
+	}
+
+	m_sortedStateChanges = CountStateChanges(m_commands);
+}
+
+int CRenderQueue::GetCount()
+{
+	return (int)m_commands.size();
+}
+
+const RenderCommand& CRenderQueue::GetCommand(int i)
+{
+	return m_commands[i];
+}
+
+int CRenderQueue::GetUnsortedStateChanges()
+{
+	return m_unsortedStateChanges;
+}
+
+int CRenderQueue::GetSortedStateChanges()
+{
+	return m_sortedStateChanges;
+}
+
+// Counts each program, state or material that differs from the previous command's, including the first command's
+int CRenderQueue::CountStateChanges(const vector<RenderCommand> &commands)
+{
+	int iChanges = 0;
+	for (unsigned int i = 0; i < commands.size(); i++) {
+		bool bFirst = i == 0;
+		iChanges += (bFirst || commands[i].program != commands[i - 1].program) ? 1 : 0;
+		iChanges += (bFirst || commands[i].state != commands[i - 1].state) ? 1 : 0;
+		iChanges += (bFirst || commands[i].material != commands[i - 1].material) ? 1 : 0;
+	}
+	return iChanges;
+}
+
+CRenderCommandList::CRenderCommandList()
+{
+	m_farDepth = 1.0f;
+}
+
+void CRenderCommandList::Clear(float fFarDepth)
+{
+	m_commands.clear();
+	m_farDepth = fFarDepth;
+}
+
+void CRenderCommandList::Add(int iPass, int iProgram, int iMaterial, unsigned int uiState, float fViewDepth, int iDraw)
+{
+	m_commands.push_back(MakeCommand(iPass, iProgram, iMaterial, uiState, fViewDepth, iDraw, m_farDepth));
+}
+
+int CRenderCommandList::GetCount()
+{
+	return (int)m_commands.size();
+}
+
+const RenderCommand& CRenderCommandList::GetCommand(int i)
+{
+	return m_commands[i];
+}
+
+// Builds a command and its sort key
+RenderCommand CRenderCommandList::MakeCommand(int iPass, int iProgram, int iMaterial, unsigned int uiState, float fViewDepth, int iDraw, 
+	float fFarDepth)
+{
+	unsigned long long depth = (unsigned long long)(glm::clamp(fViewDepth / fFarDepth, 0.0f, 1.0f) * KEY_DEPTH_MAX);
+	unsigned long long pass = (unsigned long long)iPass;
+	unsigned long long program = (unsigned long long)iProgram & ((1 << KEY_PROGRAM_BITS) - 1);
+	unsigned long long state = (unsigned long long)uiState & ((1 << KEY_STATE_BITS) - 1);
+	unsigned long long material = (unsigned long long)iMaterial & ((1 << KEY_MATERIAL_BITS) - 1);
+
+	RenderCommand command;
+	int iShift = 64 - KEY_PASS_BITS;
+	command.key = pass << iShift;
+	if (iPass == RENDER_PASS_TRANSPARENT) {
+		iShift -= KEY_DEPTH_BITS;
+		command.key |= (KEY_DEPTH_MAX - depth) << iShift;
+		iShift -= KEY_PROGRAM_BITS;
+		command.key |= program << iShift;
+		iShift -= KEY_STATE_BITS;
+		command.key |= state << iShift;
+		iShift -= KEY_MATERIAL_BITS;
+		command.key |= material << iShift;
+	}
+	else {
+		iShift -= KEY_PROGRAM_BITS;
+		command.key |= program << iShift;
+		iShift -= KEY_STATE_BITS;
+		command.key |= state << iShift;
+		iShift -= KEY_MATERIAL_BITS;
+		command.key |= material << iShift;
+		iShift -= KEY_DEPTH_BITS;
+		command.key |= depth << iShift;
+	}
+
+	command.iDraw = iDraw;
+	command.material = (unsigned short)material;
+	command.program = (unsigned char)program;
+	command.pass = (unsigned char)pass;
+	command.state = (unsigned char)state;
+	return command;
+}
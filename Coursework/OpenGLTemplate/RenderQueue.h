@@ -0,0 +1,83 @@
+#pragma once
+
+#include "Common.h"
+
+// The parts of the frame a queued draw can belong to, in the order they are drawn
+enum RenderPass
+{
+	RENDER_PASS_OPAQUE,
+	RENDER_PASS_TRANSPARENT,
+	RENDER_PASS_COUNT,
+};
+
+// Fixed-function state a draw needs, applied by whoever executes the queue when it changes between commands
+enum RenderStateBits
+{
+	RENDER_STATE_NO_CULL = 1,		// Both sides are drawn
+	RENDER_STATE_BLEND = 2,			// Alpha blended
+};
+
+// One draw.  iDraw is the caller's own index for what to draw; the other fields say which state it needs.
+struct RenderCommand
+{
+	unsigned long long key;
+	int iDraw;
+	unsigned short material;
+	unsigned char program;
+	unsigned char pass;
+	unsigned char state;
+};
+
+
+// A list of commands recorded on its own, such as by one of several threads, to be merged into a CRenderQueue.  The keys
+// are built the same way as CRenderQueue::Add.
+class CRenderCommandList
+{
+public:
+	CRenderCommandList();
+
+	void Clear(float fFarDepth);
+	void Add(int iPass, int iProgram, int iMaterial, unsigned int uiState, float fViewDepth, int iDraw);
+
+	int GetCount();
+	const RenderCommand& GetCommand(int i);
+
+private:
+	friend class CRenderQueue;
+	static RenderCommand MakeCommand(int iPass, int iProgram, int iMaterial, unsigned int uiState, float fViewDepth, int iDraw, 
+		float fFarDepth);
+
+	vector<RenderCommand> m_commands;
+	float m_farDepth;
+};
+
+
+// A class that collects the frame's draws as commands with 64-bit sort keys, and radix sorts them so draws sharing a
+// program, state and material run together.  Opaque keys are pass, program, state, material, then depth front to back.
+// Transparent keys put depth right after the pass, back to front, since blending needs that order.
+class CRenderQueue
+{
+public:
+	CRenderQueue();
+
+	void Clear(float fFarDepth);		// Starts a new frame; view depths are quantised over 0 to fFarDepth
+	void Add(int iPass, int iProgram, int iMaterial, unsigned int uiState, float fViewDepth, int iDraw);
+	void Append(CRenderCommandList &list, int iDrawOffset);	// Adds a list's commands, with iDrawOffset added to their draws
+	void Finish(bool bSort);			// Call once the frame's draws are added.  Counts the state changes, and sorts unless told not to.
+
+	int GetCount();
+	const RenderCommand& GetCommand(int i);
+
+	// Program, state and material changes in the order the draws were added, and in the sorted order
+	int GetUnsortedStateChanges();
+	int GetSortedStateChanges();
+
+private:
+	static int CountStateChanges(const vector<RenderCommand> &commands);
+
+	vector<RenderCommand> m_commands;
+	vector<RenderCommand> m_scratch;
+	float m_farDepth;
+	int m_unsortedStateChanges;
+	int m_sortedStateChanges;
+};
@@ -0,0 +1,98 @@
+#include "Common.h"
+#include "RenderTarget.h"
+
+CRenderTarget::CRenderTarget()
+{
+	m_framebuffer = 0;
+	m_colourTexture = 0;
+	m_depthTexture = 0;
+	m_width = 0;
+	m_height = 0;
+	m_created = false;
+}
+
+CRenderTarget::~CRenderTarget()
+{
+	Release();
+}
+
+void CRenderTarget::Create(int iWidth, int iHeight)
+{
+	if (m_created && iWidth == m_width && iHeight == m_height)
+		return;
+	Release();
+
+	glGenTextures(1, &m_colourTexture);
+	glBindTexture(GL_TEXTURE_2D, m_colourTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, iWidth, iHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glGenTextures(1, &m_depthTexture);
+	glBindTexture(GL_TEXTURE_2D, m_depthTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH24_STENCIL8, iWidth, iHeight, 0, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenFramebuffers(1, &m_framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_colourTexture, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, m_depthTexture, 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		MessageBox(NULL, "Could not create the offscreen render target", "Error", MB_ICONERROR);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	m_width = iWidth;
+	m_height = iHeight;
+	m_created = true;
+}
+
+void CRenderTarget::Release()
+{
+	if (!m_created)
+		return;
+	glDeleteFramebuffers(1, &m_framebuffer);
+	glDeleteTextures(1, &m_colourTexture);
+	glDeleteTextures(1, &m_depthTexture);
+	m_created = false;
+}
+
+void CRenderTarget::Bind()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+	glViewport(0, 0, m_width, m_height);
+}
+
+void CRenderTarget::BlitToScreen(int iWidth, int iHeight)
+{
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_framebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glBlitFramebuffer(0, 0, m_width, m_height, 0, 0, iWidth, iHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, iWidth, iHeight);
+}
+
+int CRenderTarget::GetWidth()
+{
+	return m_width;
+}
+
+int CRenderTarget::GetHeight()
+{
+	return m_height;
+}
+
+UINT CRenderTarget::GetColourTexture()
+{
+	return m_colourTexture;
+}
+
+UINT CRenderTarget::GetDepthTexture()
+{
+	return m_depthTexture;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "Common.h"
+
+// A class for an offscreen framebuffer with a colour and a depth-stencil texture, so the scene can be drawn at a
+// different size from the window and then scaled onto it.
+class CRenderTarget
+{
+public:
+	CRenderTarget();
+	~CRenderTarget();
+
+	void Create(int iWidth, int iHeight);	// Does nothing if the target is already this size
+	void Release();
+
+	void Bind();							// Also sets the viewport to the whole target
+	void BlitToScreen(int iWidth, int iHeight);	// Scales the colour onto the window, and leaves the window bound
+
+	int GetWidth();
+	int GetHeight();
+	UINT GetColourTexture();
+	UINT GetDepthTexture();
+
+private:
+	UINT m_framebuffer;
+	UINT m_colourTexture;
+	UINT m_depthTexture;
+	int m_width;
+	int m_height;
+	bool m_created;
+};
@@ -0,0 +1,244 @@
+#include "Common.h"
+#include "ShaderCompiler.h"
+#include "Shaders.h"
+#include "ProgramBinaryCache.h"
+#include "CpuTrace.h"
+
+// A program waiting for the driver (or the worker thread) to finish compiling and linking it
+struct ShaderCompileJob
+{
+	CShaderProgram* pProgram;
+	CShader vertexShader;
+	CShader fragmentShader;
+	string sVertexFile;
+	string sFragmentFile;
+	vector<string> sVertexSource;
+	vector<string> sFragmentSource;
+	ProgramBinaryKey key;
+	bool bLinking;				// Parallel mode: both stages compiled and the link has been issued
+	atomic<bool> bWorkerDone;	// Worker mode: compile and link have been issued and flushed by the worker
+};
+
+
+CShaderCompiler::CShaderCompiler()
+{
+	m_pBinaryCache = NULL;
+	m_mode = COMPILE_IMMEDIATE;
+	m_hdc = NULL;
+	m_hrcWorker = NULL;
+	m_stopWorker = false;
+}
+
+CShaderCompiler::~CShaderCompiler()
+{
+	Release();
+}
+
+// Picks how programs are compiled.  hdc and hrcShared are only used if the driver cannot compile in parallel itself;
+// the worker then gets its own context sharing objects with hrcShared (which may be NULL to disable the worker).
+void CShaderCompiler::Create(CProgramBinaryCache* pBinaryCache, HDC hdc, HGLRC hrcShared)
+{
+	m_pBinaryCache = pBinaryCache;
+
+	if (GLEW_KHR_parallel_shader_compile) {
+		// Let the driver use as many threads as it likes
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+		m_mode = COMPILE_PARALLEL_KHR;
+	}
+	else if (hrcShared != NULL) {
+		m_hdc = hdc;
+		m_hrcWorker = hrcShared;
+		m_stopWorker = false;
+		m_worker = thread(&CShaderCompiler::WorkerLoop, this);
+		m_mode = COMPILE_WORKER_THREAD;
+	}
+	else
+		m_mode = COMPILE_IMMEDIATE;
+}
+
+// Stops the worker and drops any programs that have not finished.  Their program objects stay owned by the caller.
+void CShaderCompiler::Release()
+{
+	if (m_worker.joinable()) {
+		{
+			lock_guard<mutex> lock(m_queueMutex);
+			m_stopWorker = true;
+			m_queue.clear();
+		}
+		m_queueSignal.notify_one();
+		m_worker.join();
+	}
+
+	if (m_hrcWorker != NULL) {
+		wglDeleteContext(m_hrcWorker);
+		m_hrcWorker = NULL;
+	}
+
+	for (int i = 0; i < (int)m_pending.size(); i++) {
+		glDeleteShader(m_pending[i]->vertexShader.GetShaderID());
+		glDeleteShader(m_pending[i]->fragmentShader.GetShaderID());
+		delete m_pending[i];
+	}
+	m_pending.clear();
+}
+
+// Starts building a program and returns it straight away.  The program is only usable once IsLinked() returns true,
+// which is immediate if the binary cache has it.  Nothing here waits for the compiler.
+CShaderProgram* CShaderCompiler::Submit(string sVertexFile, string sFragmentFile, const vector<string> &sDefines)
+{
+	if (m_mode == COMPILE_IMMEDIATE)
+		return m_pBinaryCache->BuildProgram(sVertexFile, sFragmentFile, sDefines);
+
+	ShaderCompileJob* pJob = new ShaderCompileJob;
+	pJob->sVertexFile = sVertexFile;
+	pJob->sFragmentFile = sFragmentFile;
+	pJob->vertexShader.GetShaderSource(sVertexFile, sDefines, &pJob->sVertexSource);
+	pJob->fragmentShader.GetShaderSource(sFragmentFile, sDefines, &pJob->sFragmentSource);
+	pJob->bLinking = false;
+	pJob->bWorkerDone = false;
+
+	CShaderProgram* pProgram = new CShaderProgram;
+	pProgram->CreateProgram();
+	pJob->pProgram = pProgram;
+
+	pJob->key = m_pBinaryCache->ComputeKey(pJob->sVertexSource, pJob->sFragmentSource);
+	if (m_pBinaryCache->Load(pJob->key, pProgram)) {
+		delete pJob;
+		return pProgram;
+	}
+
+	if (m_mode == COMPILE_PARALLEL_KHR) {
+		pJob->vertexShader.BeginCompile(pJob->sVertexSource, sVertexFile, GL_VERTEX_SHADER);
+		pJob->fragmentShader.BeginCompile(pJob->sFragmentSource, sFragmentFile, GL_FRAGMENT_SHADER);
+	}
+	else {
+		// Make sure the program object exists before the worker's context uses it
+		glFlush();
+		{
+			lock_guard<mutex> lock(m_queueMutex);
+			m_queue.push_back(pJob);
+		}
+		m_queueSignal.notify_one();
+	}
+
+	m_pending.push_back(pJob);
+	return pProgram;
+}
+
+// Finishes every program whose compile and link have completed.  Called once per frame; never waits.
+void CShaderCompiler::Poll()
+{
+	for (int i = 0; i < (int)m_pending.size(); ) {
+		if (TryFinish(m_pending[i])) {
+			delete m_pending[i];
+			m_pending.erase(m_pending.begin() + i);
+		}
+		else
+			i++;
+	}
+}
+
+// Number of submitted programs that are still being compiled or linked
+int CShaderCompiler::GetPendingCount()
+{
+	return (int)m_pending.size();
+}
+
+CShaderCompiler::CompileMode CShaderCompiler::GetMode()
+{
+	return m_mode;
+}
+
+// Moves a job on as far as it can go without waiting.  Returns true when the job is finished (linked or failed).
+bool CShaderCompiler::TryFinish(ShaderCompileJob* pJob)
+{
+	CShader* pVertexShader = &pJob->vertexShader;
+	CShader* pFragmentShader = &pJob->fragmentShader;
+
+	if (m_mode == COMPILE_WORKER_THREAD) {
+		if (!pJob->bWorkerDone)
+			return false;
+
+		// The worker linked regardless of the compile results, so only read the link status if both stages compiled
+		bool bCompiled = pVertexShader->FinishCompile();
+		bCompiled = pFragmentShader->FinishCompile() && bCompiled;
+		if (bCompiled)
+			Finish(pJob);
+		else {
+			glDeleteShader(pVertexShader->GetShaderID());
+			glDeleteShader(pFragmentShader->GetShaderID());
+		}
+		return true;
+	}
+
+	if (!pJob->bLinking) {
+		if (!pVertexShader->IsCompileComplete() || !pFragmentShader->IsCompileComplete())
+			return false;
+
+		bool bCompiled = pVertexShader->FinishCompile();
+		bCompiled = pFragmentShader->FinishCompile() && bCompiled;
+		if (!bCompiled) {
+			glDeleteShader(pVertexShader->GetShaderID());
+			glDeleteShader(pFragmentShader->GetShaderID());
+			return true;
+		}
+
+		pJob->pProgram->AddShaderToProgram(pVertexShader);
+		pJob->pProgram->AddShaderToProgram(pFragmentShader);
+		pJob->pProgram->SetBinaryRetrievable();
+		pJob->pProgram->BeginLink();
+		pJob->bLinking = true;
+		return false;
+	}
+
+	if (!pJob->pProgram->IsLinkComplete())
+		return false;
+
+	Finish(pJob);
+	return true;
+}
+
+// Reads the link status, stores the binary and frees the shader objects
+void CShaderCompiler::Finish(ShaderCompileJob* pJob)
+{
+	if (pJob->pProgram->FinishLink())
+		m_pBinaryCache->Save(pJob->key, pJob->pProgram);
+
+	pJob->vertexShader.DeleteShader();
+	pJob->fragmentShader.DeleteShader();
+}
+
+// Worker thread: compiles and links queued jobs in its own context.  Results are read back on the GL thread, so
+// error reporting stays in one place.
+void CShaderCompiler::WorkerLoop()
+{
+	CPU_TRACE_THREAD_NAME("Shader compiler");
+	wglMakeCurrent(m_hdc, m_hrcWorker);
+
+	while (true) {
+		ShaderCompileJob* pJob;
+		{
+			unique_lock<mutex> lock(m_queueMutex);
+			m_queueSignal.wait(lock, [this] { return m_stopWorker || !m_queue.empty(); });
+			if (m_stopWorker)
+				break;
+			pJob = m_queue.front();
+			m_queue.pop_front();
+		}
+
+		pJob->vertexShader.BeginCompile(pJob->sVertexSource, pJob->sVertexFile, GL_VERTEX_SHADER);
+		pJob->fragmentShader.BeginCompile(pJob->sFragmentSource, pJob->sFragmentFile, GL_FRAGMENT_SHADER);
+
+		UINT uiProgram = pJob->pProgram->GetProgramID();
+		glAttachShader(uiProgram, pJob->vertexShader.GetShaderID());
+		glAttachShader(uiProgram, pJob->fragmentShader.GetShaderID());
+		pJob->pProgram->SetBinaryRetrievable();
+		pJob->pProgram->BeginLink();
+
+		// Objects changed in one context are only guaranteed to be complete in another after a finish
+		glFinish();
+		pJob->bWorkerDone = true;
+	}
+
+	wglMakeCurrent(NULL, NULL);
+}
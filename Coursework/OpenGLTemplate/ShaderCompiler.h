@@ -0,0 +1,58 @@
+#pragma once
+
+#include "Common.h"
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+class CShaderProgram;
+class CProgramBinaryCache;
+struct ShaderCompileJob;
+
+
+// A class that compiles and links shader programs without stalling the GL thread.  Submit issues the work and returns
+// a program that is not linked yet; Poll, called once per frame, finishes whatever the driver has completed.
+// With GL_KHR_parallel_shader_compile the driver compiles on its own threads, otherwise a worker thread with a
+// shared context does the compiling and linking.  If neither is available Submit compiles immediately.
+class CShaderCompiler
+{
+public:
+	enum CompileMode
+	{
+		COMPILE_IMMEDIATE,
+		COMPILE_PARALLEL_KHR,
+		COMPILE_WORKER_THREAD,
+	};
+
+	CShaderCompiler();
+	~CShaderCompiler();
+
+	void Create(CProgramBinaryCache* pBinaryCache, HDC hdc, HGLRC hrcShared);
+	void Release();
+
+	CShaderProgram* Submit(string sVertexFile, string sFragmentFile, const vector<string> &sDefines);
+	void Poll();
+
+	int GetPendingCount();
+	CompileMode GetMode();
+
+private:
+	bool TryFinish(ShaderCompileJob* pJob);
+	void Finish(ShaderCompileJob* pJob);
+	void WorkerLoop();
+
+	CProgramBinaryCache* m_pBinaryCache;
+	CompileMode m_mode;
+	vector<ShaderCompileJob*> m_pending;
+
+	// Worker thread, only used in COMPILE_WORKER_THREAD mode
+	HDC m_hdc;
+	HGLRC m_hrcWorker;
+	thread m_worker;
+	mutex m_queueMutex;
+	condition_variable m_queueSignal;
+	deque<ShaderCompileJob*> m_queue;
+	bool m_stopWorker;
+};
@@ -0,0 +1,126 @@
+#include "Common.h"
+#include "ShaderPermutations.h"
+#include "Shaders.h"
+#include "ProgramBinaryCache.h"
+#include "ShaderCompiler.h"
+
+
+CShaderPermutations::CShaderPermutations()
+{
+	m_pUberProgram = NULL;
+	m_pBinaryCache = NULL;
+	m_pCompiler = NULL;
+}
+
+CShaderPermutations::~CShaderPermutations()
+{
+	Release();
+}
+
+// Sets up the source files and the names of the feature #defines.  Feature i is controlled by bit (1 << i) of the key.
+// Linked variants are stored in the binary cache, so each one is only compiled from source once per driver.  The uber 
+// program is built here, blocking, so there is always something to render with.
+void CShaderPermutations::Create(string sVertexFile, string sFragmentFile, const vector<string> &sFeatureNames, CProgramBinaryCache* pBinaryCache, 
+	CShaderCompiler* pCompiler)
+{
+	m_pBinaryCache = pBinaryCache;
+	m_pCompiler = pCompiler;
+	m_vertexFile = sVertexFile;
+	m_fragmentFile = sFragmentFile;
+	m_featureNames = sFeatureNames;
+
+	GetUberProgram();
+}
+
+// Deletes all programs, including variants that never finished building
+void CShaderPermutations::Release()
+{
+	if (m_pUberProgram != NULL) {
+		m_pUberProgram->DeleteProgram();
+		delete m_pUberProgram;
+		m_pUberProgram = NULL;
+	}
+
+	map<unsigned int, CShaderProgram*>::iterator it;
+	for (it = m_variants.begin(); it != m_variants.end(); ++it) {
+		if (it->second->IsLinked())
+			it->second->DeleteProgram();
+		else
+			glDeleteProgram(it->second->GetProgramID());
+		delete it->second;
+	}
+	m_variants.clear();
+}
+
+// Does not build the uber program, so this is safe before Create
+bool CShaderPermutations::IsUberProgram(CShaderProgram* pProgram)
+{
+	return pProgram != NULL && pProgram == m_pUberProgram;
+}
+
+// Returns the program compiled without any defines, which selects its paths at runtime
+CShaderProgram* CShaderPermutations::GetUberProgram()
+{
+	if (m_pUberProgram == NULL)
+		m_pUberProgram = m_pBinaryCache->BuildProgram(m_vertexFile, m_fragmentFile, vector<string>());
+
+	return m_pUberProgram;
+}
+
+// Returns the variant for the given feature key if it has finished building.  Otherwise the variant is requested and
+// the uber program is returned, so callers must also set the feature uniforms.
+CShaderProgram* CShaderPermutations::GetProgram(unsigned int uiFeatures)
+{
+	Request(uiFeatures);
+
+	CShaderProgram* pProgram = m_variants[uiFeatures];
+	if (pProgram->IsLinked())
+		return pProgram;
+
+	return GetUberProgram();
+}
+
+// Submits the variant to the compiler if it has not been requested before
+void CShaderPermutations::Request(unsigned int uiFeatures)
+{
+	if (m_variants.find(uiFeatures) != m_variants.end())
+		return;
+
+	m_variants[uiFeatures] = m_pCompiler->Submit(m_vertexFile, m_fragmentFile, BuildDefines(uiFeatures));
+}
+
+// Returns true if the variant has been requested and is linked
+bool CShaderPermutations::IsReady(unsigned int uiFeatures)
+{
+	map<unsigned int, CShaderProgram*>::iterator it = m_variants.find(uiFeatures);
+	return it != m_variants.end() && it->second->IsLinked();
+}
+
+// Returns the number of specialised variants requested so far
+int CShaderPermutations::GetVariantCount()
+{
+	return (int)m_variants.size();
+}
+
+// Returns the number of requested variants that are ready to use
+int CShaderPermutations::GetReadyCount()
+{
+	int iReady = 0;
+	map<unsigned int, CShaderProgram*>::iterator it;
+	for (it = m_variants.begin(); it != m_variants.end(); ++it) {
+		if (it->second->IsLinked())
+			iReady++;
+	}
+	return iReady;
+}
+
+// Every feature is always defined (to 0 or 1), so the shader can use them in #if and constant expressions
+vector<string> CShaderPermutations::BuildDefines(unsigned int uiFeatures)
+{
+	vector<string> sDefines;
+	sDefines.push_back("PERMUTATION");
+	for (int i = 0; i < (int)m_featureNames.size(); i++)
+		sDefines.push_back(m_featureNames[i] + ((uiFeatures & (1u << i)) ? " 1" : " 0"));
+
+	return sDefines;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "Common.h"
+#include <map>
+
+class CShaderProgram;
+class CProgramBinaryCache;
+class CShaderCompiler;
+
+// Feature bits used to pick a specialised variant of the spotlight shader.  The bit index matches the 
+// position of the corresponding #define name passed to CShaderPermutations::Create.
+enum ShaderFeature
+{
+	SHADER_RENDER_SKYBOX	= 1 << 0,
+	SHADER_RENDER_TRACK		= 1 << 1,
+	SHADER_SHOW_TRACK		= 1 << 2,
+	SHADER_FOG_ON			= 1 << 3,
+	SHADER_BAKED_LIGHTING	= 1 << 4,
+};
+
+
+// A class that compiles specialised variants (permutations) of a vertex/fragment shader pair on demand.  
+// Each variant is compiled with PERMUTATION and one #define per feature (0 or 1), and cached by its feature key.
+// Variants are built in the background by a CShaderCompiler; until one is ready the uber program is used instead.
+class CShaderPermutations
+{
+public:
+	CShaderPermutations();
+	~CShaderPermutations();
+
+	void Create(string sVertexFile, string sFragmentFile, const vector<string> &sFeatureNames, CProgramBinaryCache* pBinaryCache, 
+		CShaderCompiler* pCompiler);
+	void Release();
+
+	CShaderProgram* GetUberProgram();						// The unspecialised program, switched at runtime using uniforms
+	bool IsUberProgram(CShaderProgram* pProgram);
+	CShaderProgram* GetProgram(unsigned int uiFeatures);	// The specialised program, or the uber program until it is ready
+	void Request(unsigned int uiFeatures);					// Starts building a variant without using it yet
+	bool IsReady(unsigned int uiFeatures);
+
+	int GetVariantCount();
+	int GetReadyCount();
+
+private:
+	vector<string> BuildDefines(unsigned int uiFeatures);
+
+	string m_vertexFile;
+	string m_fragmentFile;
+	vector<string> m_featureNames;
+	CProgramBinaryCache* m_pBinaryCache;
+	CShaderCompiler* m_pCompiler;
+
+	CShaderProgram* m_pUberProgram;
+	map<unsigned int, CShaderProgram*> m_variants;
+};
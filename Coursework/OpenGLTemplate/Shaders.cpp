@@ -5,6 +5,7 @@
 
 CShader::CShader()
 {
+	m_uiShader = 0;
 	m_bLoaded = false;
 }
 CShader::~CShader()
@@ -12,16 +13,46 @@ CShader::~CShader()
 
 // Loads a shader, stored as a text file with filename sFile.  The shader is of type iType (vertex, fragment, geometry, etc.)
 bool CShader::LoadShader(string sFile, int iType)
+{
+	return LoadShader(sFile, iType, vector<string>());
+}
+
+// Loads a shader as above, but with each entry of sDefines injected as a #define after the #version line.  
+// This is used to compile specialised variants of the same source file.
+bool CShader::LoadShader(string sFile, int iType, const vector<string> &sDefines)
 {
 	vector<string> sLines;
 
-	if(!GetLinesFromFile(sFile, false, &sLines)) {
+	if (!GetShaderSource(sFile, sDefines, &sLines))
+		return false;
+
+	return CompileShader(sLines, sFile, iType);
+}
+
+// Reads a shader file and injects the defines, giving the exact source that is passed to the compiler
+bool CShader::GetShaderSource(string sFile, const vector<string> &sDefines, vector<string>* vResult)
+{
+	if(!GetLinesFromFile(sFile, false, vResult)) {
 		char message[1024];
 		sprintf_s(message, "Cannot load shader\n%s\n", sFile.c_str());
 		MessageBox(NULL, message, "Error", MB_ICONERROR);
 		return false;
 	}
 
+	InsertDefines(sDefines, vResult);
+	return true;
+}
+
+// Compiles shader source that has already been loaded.  sFile is only used for error messages.
+bool CShader::CompileShader(const vector<string> &sLines, string sFile, int iType)
+{
+	BeginCompile(sLines, sFile, iType);
+	return FinishCompile();
+}
+
+// Hands the source to the driver and starts compiling, without asking for the result
+void CShader::BeginCompile(const vector<string> &sLines, string sFile, int iType)
+{
 	const char** sProgram = new const char*[(int)sLines.size()];
 	for (int i = 0; i < (int)sLines.size(); i++) 
 		sProgram[i] = sLines[i].c_str();
@@ -33,6 +64,25 @@ bool CShader::LoadShader(string sFile, int iType)
 
 	delete[] sProgram;
 
+	m_iType = iType;
+	m_sFile = sFile;
+}
+
+// Returns true if FinishCompile can be called without waiting.  Without GL_KHR_parallel_shader_compile the driver 
+// cannot tell us, so this always returns true.
+bool CShader::IsCompileComplete()
+{
+	if (!GLEW_KHR_parallel_shader_compile)
+		return true;
+
+	int iComplete = GL_TRUE;
+	glGetShaderiv(m_uiShader, GL_COMPLETION_STATUS_KHR, &iComplete);
+	return iComplete == GL_TRUE;
+}
+
+// Reads the compile status (waiting for the compiler if it has not finished) and reports any errors
+bool CShader::FinishCompile()
+{
 	int iCompilationStatus;
 	glGetShaderiv(m_uiShader, GL_COMPILE_STATUS, &iCompilationStatus);
 
@@ -43,25 +93,24 @@ bool CShader::LoadShader(string sFile, int iType)
 		int iLogLength;
 		glGetShaderInfoLog(m_uiShader, 1024, &iLogLength, sInfoLog);
 		char sShaderType[64];
-		if (iType == GL_VERTEX_SHADER)
+		if (m_iType == GL_VERTEX_SHADER)
 			sprintf_s(sShaderType, "vertex shader");
-		else if (iType == GL_FRAGMENT_SHADER)
+		else if (m_iType == GL_FRAGMENT_SHADER)
 			sprintf_s(sShaderType, "fragment shader");
-		else if (iType == GL_GEOMETRY_SHADER)
+		else if (m_iType == GL_GEOMETRY_SHADER)
 			sprintf_s(sShaderType, "geometry shader");
-		else if (iType == GL_TESS_CONTROL_SHADER)
+		else if (m_iType == GL_TESS_CONTROL_SHADER)
 			sprintf_s(sShaderType, "tesselation control shader");
-		else if (iType == GL_TESS_EVALUATION_SHADER)
+		else if (m_iType == GL_TESS_EVALUATION_SHADER)
 			sprintf_s(sShaderType, "tesselation evaluation shader");
 		else
 			sprintf_s(sShaderType, "unknown shader type");
 
-		sprintf_s(sFinalMessage, "Error in %s!\n%s\nShader file not compiled.  The compiler returned:\n\n%s", sShaderType, sFile.c_str(), sInfoLog);
+		sprintf_s(sFinalMessage, "Error in %s!\n%s\nShader file not compiled.  The compiler returned:\n\n%s", sShaderType, m_sFile.c_str(), sInfoLog);
 
 		MessageBox(NULL, sFinalMessage, "Error", MB_ICONERROR);
 		return false;
 	}
-	m_iType = iType;
 	m_bLoaded = true;
 
 	return true;
@@ -123,6 +172,30 @@ bool CShader::GetLinesFromFile(string sFile, bool bIncludePart, vector<string>*
 }
 
 
+// Inserts "#define X" lines directly after the #version directive (which must stay the first statement in GLSL)
+void CShader::InsertDefines(const vector<string> &sDefines, vector<string>* vLines)
+{
+	if (sDefines.empty())
+		return;
+
+	int iInsertAt = 0;
+	for (int i = 0; i < (int)vLines->size(); i++) {
+		stringstream ss((*vLines)[i]);
+		string sFirst;
+		ss >> sFirst;
+		if (sFirst == "#version") {
+			iInsertAt = i + 1;
+			break;
+		}
+	}
+
+	vector<string> sDefineLines;
+	for (int i = 0; i < (int)sDefines.size(); i++)
+		sDefineLines.push_back("#define " + sDefines[i] + "\n");
+
+	vLines->insert(vLines->begin() + iInsertAt, sDefineLines.begin(), sDefineLines.end());
+}
+
 // Returns true if the shader was loaded and compiled
 bool CShader::IsLoaded()
 {
@@ -168,8 +241,31 @@ bool CShaderProgram::AddShaderToProgram(CShader* shShader)
 
 // Performs final linkage of the OpenGL shader program
 bool CShaderProgram::LinkProgram()
+{
+	BeginLink();
+	return FinishLink();
+}
+
+// Starts linking, without asking for the result
+void CShaderProgram::BeginLink()
 {
 	glLinkProgram(m_uiProgram);
+}
+
+// Returns true if FinishLink can be called without waiting (always true without GL_KHR_parallel_shader_compile)
+bool CShaderProgram::IsLinkComplete()
+{
+	if (!GLEW_KHR_parallel_shader_compile)
+		return true;
+
+	int iComplete = GL_TRUE;
+	glGetProgramiv(m_uiProgram, GL_COMPLETION_STATUS_KHR, &iComplete);
+	return iComplete == GL_TRUE;
+}
+
+// Reads the link status (waiting for the linker if it has not finished) and reports any errors
+bool CShaderProgram::FinishLink()
+{
 	int iLinkStatus;
 	glGetProgramiv(m_uiProgram, GL_LINK_STATUS, &iLinkStatus);
 
@@ -188,6 +284,50 @@ bool CShaderProgram::LinkProgram()
 	return m_bLinked;
 }
 
+// Returns true once the program has been linked (or loaded from a binary) and is ready to use
+bool CShaderProgram::IsLinked()
+{
+	return m_bLinked;
+}
+
+// Asks the driver to keep the binary of this program available after linking.  Call before LinkProgram.
+void CShaderProgram::SetBinaryRetrievable()
+{
+	if (GLEW_ARB_get_program_binary)
+		glProgramParameteri(m_uiProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+// Gets the driver-specific binary of a linked program
+bool CShaderProgram::GetProgramBinary(GLenum* pFormat, vector<BYTE>* pData)
+{
+	if (!m_bLinked || !GLEW_ARB_get_program_binary)
+		return false;
+
+	int iLength = 0;
+	glGetProgramiv(m_uiProgram, GL_PROGRAM_BINARY_LENGTH, &iLength);
+	if (iLength <= 0)
+		return false;
+
+	pData->resize(iLength);
+	glGetProgramBinary(m_uiProgram, iLength, NULL, pFormat, &(*pData)[0]);
+	return true;
+}
+
+// Creates the program from a binary returned by GetProgramBinary.  The driver may reject binaries that were 
+// made by a different driver version, in which case this returns false and the program must be compiled from source.
+bool CShaderProgram::LoadProgramBinary(GLenum format, const vector<BYTE> &data)
+{
+	if (!GLEW_ARB_get_program_binary || data.empty())
+		return false;
+
+	glProgramBinary(m_uiProgram, format, &data[0], (int)data.size());
+
+	int iLinkStatus;
+	glGetProgramiv(m_uiProgram, GL_LINK_STATUS, &iLinkStatus);
+	m_bLinked = iLinkStatus == GL_TRUE;
+	return m_bLinked;
+}
+
 // Deletes the program and frees memory on the GPU
 void CShaderProgram::DeleteProgram()
 {
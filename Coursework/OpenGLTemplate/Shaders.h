@@ -11,9 +11,18 @@ public:
 	~CShader();
 
 	bool LoadShader(string sFile, int iType);
+	bool LoadShader(string sFile, int iType, const vector<string> &sDefines);
+	bool CompileShader(const vector<string> &sLines, string sFile, int iType);
 	void DeleteShader();
 
+	// Compiling in two steps lets the driver work on several shaders before anything waits for a result
+	void BeginCompile(const vector<string> &sLines, string sFile, int iType);
+	bool IsCompileComplete();
+	bool FinishCompile();
+
+	bool GetShaderSource(string sFile, const vector<string> &sDefines, vector<string>* vResult);
 	bool GetLinesFromFile(string sFile, bool bIncludePart, vector<string>* vResult);
+	void InsertDefines(const vector<string> &sDefines, vector<string>* vLines);
 
 	bool IsLoaded();
 	UINT GetShaderID();
@@ -23,6 +32,7 @@ private:
 	UINT m_uiShader; // ID of shader
 	int m_iType; // GL_VERTEX_SHADER, GL_FRAGMENT_SHADER...
 	bool m_bLoaded; // Whether shader was loaded and compiled
+	string m_sFile; // Source file, used in error messages
 };
 
 
@@ -38,6 +48,17 @@ public:
 	bool AddShaderToProgram(CShader* shShader);
 	bool LinkProgram();
 
+	// Linking in two steps, as for CShader
+	void BeginLink();
+	bool IsLinkComplete();
+	bool FinishLink();
+	bool IsLinked();
+
+	// Program binaries, used to skip compiling and linking on later runs
+	void SetBinaryRetrievable();
+	bool GetProgramBinary(GLenum* pFormat, vector<BYTE>* pData);
+	bool LoadProgramBinary(GLenum format, const vector<BYTE> &data);
+
 	void UseProgram();
 
 	UINT GetProgramID();
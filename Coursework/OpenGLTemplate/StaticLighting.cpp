@@ -0,0 +1,161 @@
+#include "StaticLighting.h"
+#include <cmath>
+#include <cstring>
+#include "include/glm/gtc/matrix_transform.hpp"
+
+// Deliberately does not include Common.h; see StaticLighting.h
+
+static void AddCityLight(std::vector<CityLight>* pLights, glm::vec3 position, glm::vec3 colour, glm::vec3 direction)
+{
+	CityLight light;
+	light.position = position;
+	light.colour = colour;
+	light.direction = glm::normalize(direction);
+	light.exponent = 5.f;
+	light.cutoff = 30.f;
+	pLights->push_back(light);
+}
+
+// Returns the 61 fixed city spotlights, in the order they are uploaded to spotlight[1..61]
+const std::vector<CityLight>& GetCityLights()
+{
+	static std::vector<CityLight> lights;
+
+	if (lights.empty()) {
+		const glm::vec3 white = glm::vec3(5.f);
+		const glm::vec3 red = glm::vec3(1, 0.050, 0.2) * 5.f;
+		const glm::vec3 green = glm::vec3(0.450, 0.941, 0.078) * 5.f;
+		const glm::vec3 blue = glm::vec3(0.078, 0.262, 0.941) * 5.f;
+		const glm::vec3 teal = glm::vec3(0.f, 5.f, 5.f);
+		const glm::vec3 aqua = glm::vec3(0.043f, 0.796f, 0.486f) * 5.f;
+		const glm::vec3 pink = glm::vec3(1, 0.321, 0.745) * 8.f;
+		const glm::vec3 purple = glm::vec3(0.450, 0.141, 0.898) * 5.f;
+		const glm::vec3 yellow = glm::vec3(0.996, 0.803, 0.403) * 5.f;
+		const glm::vec3 magenta = glm::vec3(1, 0, 1) * 4.f;
+
+		AddCityLight(&lights, glm::vec3(-1018, 20 - 120, 489), teal, glm::vec3(0, 1, 0));	// spotlight[1]
+		AddCityLight(&lights, glm::vec3(-1304, 60 - 120, 145), white, glm::vec3(0, 1, 0));	// spotlight[2]
+		AddCityLight(&lights, glm::vec3(-1221, 104 - 120, 26), white, glm::vec3(0, 1, 0));	// spotlight[3]
+		AddCityLight(&lights, glm::vec3(-1180, 60 - 120, -129), white, glm::vec3(0, 1, 0));	// spotlight[4]
+		AddCityLight(&lights, glm::vec3(-779, 20 - 120, -198), pink, glm::vec3(0, 1, 0));	// spotlight[5]
+		AddCityLight(&lights, glm::vec3(-600, 132 - 120, -79), green, glm::vec3(0, 1, 0));	// spotlight[6]
+		AddCityLight(&lights, glm::vec3(-462, 245 - 120, -256), blue, glm::vec3(0, 1, 0));	// spotlight[7]
+		AddCityLight(&lights, glm::vec3(-613, 211 - 120, -461), purple, glm::vec3(0, 1, 0));	// spotlight[8]
+		AddCityLight(&lights, glm::vec3(-720, 15 - 120, -617), teal, glm::vec3(0, 1, 0));	// spotlight[9]
+		AddCityLight(&lights, glm::vec3(-344, 10 - 120, -787), aqua, glm::vec3(0, 1, 0));	// spotlight[10]
+		AddCityLight(&lights, glm::vec3(614, 15 - 120, -1082), teal, glm::vec3(0, 1, 0));	// spotlight[11]
+		AddCityLight(&lights, glm::vec3(849, 12 - 120, -1204), red, glm::vec3(0, 1, 0));	// spotlight[12]
+		AddCityLight(&lights, glm::vec3(1106, 12 - 120, -1179), purple, glm::vec3(0, 1, 0));	// spotlight[13]
+		AddCityLight(&lights, glm::vec3(1295, 12 - 120, -987), yellow, glm::vec3(0, 1, 0));	// spotlight[14]
+		AddCityLight(&lights, glm::vec3(1627, 24 - 120, -813), purple, glm::vec3(0, 1, 0));	// spotlight[15]
+		AddCityLight(&lights, glm::vec3(1883, 212 - 120, -732), green, glm::vec3(0, 1, 0));	// spotlight[16]
+		AddCityLight(&lights, glm::vec3(906, 17 - 120, 230), yellow, glm::vec3(0, 1, 0));	// spotlight[17]
+		AddCityLight(&lights, glm::vec3(708, 17 - 120, 180), yellow, glm::vec3(0, 1, 0));	// spotlight[18]
+		AddCityLight(&lights, glm::vec3(1806, 231 - 120, -516), teal, glm::vec3(0, 1, 0));	// spotlight[19]
+		AddCityLight(&lights, glm::vec3(1658, 100 - 120, -353), blue, glm::vec3(0, 1, 0));	// spotlight[20]
+		AddCityLight(&lights, glm::vec3(1648, 619 - 120, -331), blue, glm::vec3(0, 1, 0));	// spotlight[21]
+		AddCityLight(&lights, glm::vec3(1968, 13 - 120, -360), purple, glm::vec3(0, 1, 0));	// spotlight[22]
+		AddCityLight(&lights, glm::vec3(1910, 13 - 120, 23), blue * 2.f, glm::vec3(0, 1, 0));	// spotlight[23]
+		AddCityLight(&lights, glm::vec3(1858, 15 - 120, 257), blue * 2.f, glm::vec3(0, 1, 0));	// spotlight[24]
+		AddCityLight(&lights, glm::vec3(1586, 13 - 120, 117), aqua, glm::vec3(0, 1, 0));	// spotlight[25]
+		AddCityLight(&lights, glm::vec3(1581, 445 - 120, 29), yellow * 2.f, glm::vec3(0, 1, 0));	// spotlight[26]
+		AddCityLight(&lights, glm::vec3(1296, 363 - 120, -9), teal, glm::vec3(0, 1, 0));	// spotlight[27]
+		AddCityLight(&lights, glm::vec3(1272, 15 - 120, 22), teal, glm::vec3(0, 1, 0));	// spotlight[28]
+		AddCityLight(&lights, glm::vec3(1101, 15 - 120, 79), pink, glm::vec3(0, 1, 0));	// spotlight[29]
+		AddCityLight(&lights, glm::vec3(888, 143 - 120, 82), teal, glm::vec3(0, 1, 0));	// spotlight[30]
+		AddCityLight(&lights, glm::vec3(985, 15 - 120, -148), purple, glm::vec3(0, 1, 0));	// spotlight[31]
+		AddCityLight(&lights, glm::vec3(1342, 15 - 120, -367), teal, glm::vec3(0, 1, 0));	// spotlight[32]
+		AddCityLight(&lights, glm::vec3(1109, 15 - 120, -356), teal, glm::vec3(0, 1, 0));	// spotlight[33]
+		AddCityLight(&lights, glm::vec3(689, 125 - 120, -20), green, glm::vec3(0, 1, 0));	// spotlight[34]
+		AddCityLight(&lights, glm::vec3(788, 15 - 120, -253), blue, glm::vec3(0, 1, 0));	// spotlight[35]
+		AddCityLight(&lights, glm::vec3(955, 15 - 120, -556), red, glm::vec3(0, 1, 0));	// spotlight[36]
+		AddCityLight(&lights, glm::vec3(888, 15 - 120, -453), magenta, glm::vec3(0, 1, 0));	// spotlight[37]
+		AddCityLight(&lights, glm::vec3(446, 15 - 120, -116), blue, glm::vec3(0, 1, 0));	// spotlight[38]
+		AddCityLight(&lights, glm::vec3(597, 15 - 120, -389), green, glm::vec3(0, 1, 0));	// spotlight[39]
+		AddCityLight(&lights, glm::vec3(764, 15 - 120, -668), yellow, glm::vec3(0, 1, 0));	// spotlight[40]
+		AddCityLight(&lights, glm::vec3(700, 15 - 120, -552), yellow, glm::vec3(0, 1, 0));	// spotlight[41]
+		AddCityLight(&lights, glm::vec3(249, 15 - 120, -276), yellow, glm::vec3(0, 1, 0));	// spotlight[42]
+		AddCityLight(&lights, glm::vec3(391, 15 - 120, -476), red, glm::vec3(0, 1, 0));	// spotlight[43]
+		AddCityLight(&lights, glm::vec3(139, 15 - 120, -495), magenta, glm::vec3(0, 1, 0));	// spotlight[44]
+		AddCityLight(&lights, glm::vec3(637, 15 - 120, -736), red, glm::vec3(0, 1, 0));	// spotlight[45]
+		AddCityLight(&lights, glm::vec3(514, 15 - 120, -672), purple, glm::vec3(0, 1, 0));	// spotlight[46]
+		AddCityLight(&lights, glm::vec3(353, 15 - 120, -875), aqua, glm::vec3(0, 1, 0));	// spotlight[47]
+		AddCityLight(&lights, glm::vec3(-399, 209 - 120, -481), purple, glm::vec3(0, 1, 0));	// spotlight[48]
+		AddCityLight(&lights, glm::vec3(-64, 85 - 120, -656), red, glm::vec3(0, 1, 0));	// spotlight[49]
+		AddCityLight(&lights, glm::vec3(-83, 268 - 120, -211), purple, glm::vec3(0, 1, 0));	// spotlight[50]
+		AddCityLight(&lights, glm::vec3(-226, 170 - 120, -241), purple, glm::vec3(0, 1, 0));	// spotlight[51]
+		AddCityLight(&lights, glm::vec3(-118, 19 - 123, 90), aqua * 2.f, glm::vec3(0, 1, 0));	// spotlight[52]
+		AddCityLight(&lights, glm::vec3(25, 19 - 120, 380), magenta, glm::vec3(0, 1, -0.5));	// spotlight[53]
+		AddCityLight(&lights, glm::vec3(221, 19 - 120, 351), purple, glm::vec3(0, 1, -0.5));	// spotlight[54]
+		AddCityLight(&lights, glm::vec3(135, 17 - 120, 412), blue, glm::vec3(0, 1, 0));	// spotlight[55]
+		AddCityLight(&lights, glm::vec3(525, 19 - 120, 227), red * 3.f, glm::vec3(0, 1, 0));	// spotlight[56]
+		AddCityLight(&lights, glm::vec3(1332, 10 - 120, 270), aqua, glm::vec3(0, 1, 0));	// spotlight[57]
+		AddCityLight(&lights, glm::vec3(-758, 19 - 120, 518), purple * 3.f, glm::vec3(0, 1, 0));	// spotlight[58]
+		AddCityLight(&lights, glm::vec3(-815, 0 - 120, 240), green * 0.2f, glm::vec3(0, 1, 0));	// spotlight[59]
+		AddCityLight(&lights, glm::vec3(-965, 13 - 120, -89), purple, glm::vec3(0, 1, 0));	// spotlight[60]
+		AddCityLight(&lights, glm::vec3(-391, 276, 209), yellow, glm::vec3(0, -1, 0));	// spotlight[61]
+	}
+
+	return lights;
+}
+
+// Returns where a static mesh is drawn.  The angles are passed straight to glm::rotate, so they are in radians.
+const StaticMeshPlacement& GetStaticMeshPlacement(int iMesh)
+{
+	static const StaticMeshPlacement placements[STATIC_MESH_COUNT] =
+	{
+		// Downloaded from https://free3d.com/3d-model/sci-fi-downtown-city-23035.html on 17/03/2021
+		{ "resources\\models\\Downtown\\downtown.obj", glm::vec3(120.f, 0.f, 290.0f), glm::radians(10.f), glm::vec3(1.7f, 3.5f, 1.7f) },
+		// Downloaded from https://free3d.com/3d-model/sci-fi-city-83682.html on 17/03/2021
+		{ "resources\\models\\City\\City.obj", glm::vec3(0.0f, 0.0f, 0.0f), 0.0f, glm::vec3(1.f) },
+		// Downloaded from https://free3d.com/3d-model/sci-fi-downtown-city-53758.html on 17/03/2021
+		{ "resources\\models\\CenterCity\\CenterCity.obj", glm::vec3(1050.0f, -54.f, -450.0f), glm::radians(60.f), glm::vec3(1.2f, 2.5f, 1.2f) },
+	};
+
+	return placements[iMesh];
+}
+
+// Object to world transform, matching the Translate, Rotate, Scale sequence used when rendering
+glm::mat4 StaticMeshPlacement::GetModelMatrix() const
+{
+	glm::mat4 modelMatrix = glm::translate(glm::mat4(1.0f), translation);
+	modelMatrix = glm::rotate(modelMatrix, rotationY, glm::vec3(0.0f, 1.0f, 0.0f));
+	modelMatrix = glm::scale(modelMatrix, scale);
+	return modelMatrix;
+}
+
+// Replaces the extension of the mesh file with .bake
+std::string GetBakedLightingFilename(const std::string &sMeshFilename)
+{
+	std::string::size_type dot = sMeshFilename.find_last_of('.');
+	if (dot == std::string::npos)
+		return sMeshFilename + ".bake";
+	return sMeshFilename.substr(0, dot) + ".bake";
+}
+
+// Positions are quantised to 1/64 unit and normals to 1/127, which absorbs differences between OBJ parsers
+void QuantiseBakedVertex(const glm::vec3 &position, const glm::vec3 &normal, BakedVertexRecord* pRecord)
+{
+	glm::vec3 n = glm::length(normal) > 0.0f ? glm::normalize(normal) : glm::vec3(0.0f);
+	for (int i = 0; i < 3; i++) {
+		pRecord->position[i] = (int)floor(position[i] * 64.0f + 0.5f);
+		pRecord->normal[i] = (signed char)floor(n[i] * 127.0f + 0.5f);
+	}
+	pRecord->pad = 0;
+}
+
+// FNV-1a hash of the quantised position, and optionally the normal
+unsigned long long GetBakedVertexKey(const BakedVertexRecord &record, bool bUseNormal)
+{
+	unsigned char bytes[15];
+	memcpy(bytes, record.position, 12);
+	memcpy(bytes + 12, record.normal, 3);
+
+	unsigned long long ullHash = 14695981039346656037ULL;
+	int iLength = bUseNormal ? 15 : 12;
+	for (int i = 0; i < iLength; i++) {
+		ullHash ^= bytes[i];
+		ullHash *= 1099511628211ULL;
+	}
+	return ullHash;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+// Static scene data shared by the game and the offline light baker (Coursework/Tools/LightBaker).  This header and
+// StaticLighting.cpp only depend on glm and the standard library, so the baker can build them on Linux without Windows or GL.
+#include <string>
+#include <vector>
+#include "include/glm/glm.hpp"
+
+// A fixed spotlight in the city.  Position and direction are in world coordinates.
+struct CityLight
+{
+	glm::vec3 position;
+	glm::vec3 colour;		// Used for both the diffuse and specular colour
+	glm::vec3 direction;
+	float exponent;
+	float cutoff;			// Degrees
+};
+
+// A static mesh and where it is placed in the world
+struct StaticMeshPlacement
+{
+	std::string filename;
+	glm::vec3 translation;
+	float rotationY;		// Radians
+	glm::vec3 scale;
+
+	glm::mat4 GetModelMatrix() const;
+};
+
+enum StaticMeshId
+{
+	STATIC_MESH_DOWNTOWN,
+	STATIC_MESH_CITY,
+	STATIC_MESH_CENTER_CITY,
+	STATIC_MESH_COUNT,
+};
+
+// The city lights occupy spotlight[1] onwards in the spotlight shader; spotlight[0] is the player's headlight
+const std::vector<CityLight>& GetCityLights();
+const StaticMeshPlacement& GetStaticMeshPlacement(int iMesh);
+
+
+// Baked lighting files (.bake, next to the .obj) store one record per distinct vertex of a static mesh.  Vertices are
+// matched by their quantised object-space position and normal, since the baker and Assimp number vertices differently.
+static const unsigned int BAKED_LIGHTING_MAGIC = 0x454b4142; // "BAKE"
+static const unsigned int BAKED_LIGHTING_VERSION = 1;
+
+struct BakedLightingHeader
+{
+	unsigned int magic;
+	unsigned int version;
+	unsigned int count;
+};
+
+struct BakedVertexRecord
+{
+	int position[3];
+	signed char normal[3];
+	signed char pad;
+	float colour[4];		// rgb: sum of the city light diffuse terms, a: ambient occlusion
+};
+
+std::string GetBakedLightingFilename(const std::string &sMeshFilename);
+void QuantiseBakedVertex(const glm::vec3 &position, const glm::vec3 &normal, BakedVertexRecord* pRecord);
+unsigned long long GetBakedVertexKey(const BakedVertexRecord &record, bool bUseNormal);
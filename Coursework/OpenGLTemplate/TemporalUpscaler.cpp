@@ -0,0 +1,223 @@
+#include "Common.h"
+#include "TemporalUpscaler.h"
+#include "Shaders.h"
+#include "RenderTarget.h"
+
+// The radical inverse of i in the given base, which spreads successive samples evenly over [0, 1)
+static float Halton(int i, int iBase)
+{
+	float fResult = 0.0f;
+	float fFraction = 1.0f;
+	while (i > 0) {
+		fFraction /= iBase;
+		fResult += fFraction * (i % iBase);
+		i /= iBase;
+	}
+	return fResult;
+}
+
+static void SetTextureParameters(GLint iFilter)
+{
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, iFilter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, iFilter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+CTemporalUpscaler::CTemporalUpscaler()
+{
+	m_pMotionProgram = NULL;
+	m_pResolveProgram = NULL;
+	m_vao = 0;
+	m_sceneWidth = 0;
+	m_sceneHeight = 0;
+	m_outputWidth = 0;
+	m_outputHeight = 0;
+	m_current = 0;
+	m_jitterIndex = 0;
+	m_jitterPixels = glm::vec2(0.0f);
+	m_historyValid = false;
+	m_previousDepthValid = false;
+	m_created = false;
+}
+
+CTemporalUpscaler::~CTemporalUpscaler()
+{
+	Release();
+}
+
+void CTemporalUpscaler::Create(CShaderProgram* pMotionProgram, CShaderProgram* pResolveProgram)
+{
+	m_pMotionProgram = pMotionProgram;
+	m_pResolveProgram = pResolveProgram;
+	glGenVertexArrays(1, &m_vao);
+	m_created = true;
+}
+
+void CTemporalUpscaler::Release()
+{
+	if (!m_created)
+		return;
+	ReleaseSceneTextures();
+	ReleaseHistory();
+	glDeleteVertexArrays(1, &m_vao);
+	m_created = false;
+}
+
+void CTemporalUpscaler::CreateSceneTextures(int iWidth, int iHeight)
+{
+	ReleaseSceneTextures();
+
+	glGenTextures(1, &m_motionTexture);
+	glBindTexture(GL_TEXTURE_2D, m_motionTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, iWidth, iHeight, 0, GL_RGBA, GL_HALF_FLOAT, NULL);
+	SetTextureParameters(GL_NEAREST);
+
+	glGenTextures(2, m_linearDepthTextures);
+	glGenFramebuffers(2, m_motionFramebuffers);
+	GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	for (int i = 0; i < 2; i++) {
+		glBindTexture(GL_TEXTURE_2D, m_linearDepthTextures[i]);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, iWidth, iHeight, 0, GL_RED, GL_FLOAT, NULL);
+		SetTextureParameters(GL_NEAREST);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, m_motionFramebuffers[i]);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_motionTexture, 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, m_linearDepthTextures[i], 0);
+		glDrawBuffers(2, drawBuffers);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	m_sceneWidth = iWidth;
+	m_sceneHeight = iHeight;
+	m_previousDepthValid = false;
+}
+
+void CTemporalUpscaler::CreateHistory(int iWidth, int iHeight)
+{
+	ReleaseHistory();
+
+	glGenTextures(2, m_historyTextures);
+	glGenFramebuffers(2, m_historyFramebuffers);
+	for (int i = 0; i < 2; i++) {
+		glBindTexture(GL_TEXTURE_2D, m_historyTextures[i]);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, iWidth, iHeight, 0, GL_RGBA, GL_HALF_FLOAT, NULL);
+		SetTextureParameters(GL_LINEAR);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, m_historyFramebuffers[i]);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_historyTextures[i], 0);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	m_outputWidth = iWidth;
+	m_outputHeight = iHeight;
+	m_historyValid = false;
+}
+
+void CTemporalUpscaler::ReleaseSceneTextures()
+{
+	if (m_sceneWidth == 0)
+		return;
+	glDeleteFramebuffers(2, m_motionFramebuffers);
+	glDeleteTextures(2, m_linearDepthTextures);
+	glDeleteTextures(1, &m_motionTexture);
+	m_sceneWidth = 0;
+	m_sceneHeight = 0;
+}
+
+void CTemporalUpscaler::ReleaseHistory()
+{
+	if (m_outputWidth == 0)
+		return;
+	glDeleteFramebuffers(2, m_historyFramebuffers);
+	glDeleteTextures(2, m_historyTextures);
+	m_outputWidth = 0;
+	m_outputHeight = 0;
+}
+
+// Steps through a Halton (2, 3) sequence, centred on the pixel
+glm::vec2 CTemporalUpscaler::NextJitter(int iSceneWidth, int iSceneHeight)
+{
+	m_jitterIndex = m_jitterIndex % JITTER_PHASES + 1;
+	m_jitterPixels = glm::vec2(Halton(m_jitterIndex, 2) - 0.5f, Halton(m_jitterIndex, 3) - 0.5f);
+	return glm::vec2(2.0f * m_jitterPixels.x / iSceneWidth, 2.0f * m_jitterPixels.y / iSceneHeight);
+}
+
+void CTemporalUpscaler::ResetHistory()
+{
+	m_historyValid = false;
+	m_previousDepthValid = false;
+}
+
+void CTemporalUpscaler::Resolve(CRenderTarget* pScene, int iWidth, int iHeight, const glm::mat4 &viewProjection, 
+	const glm::mat4 &previousViewProjection)
+{
+	if (pScene->GetWidth() != m_sceneWidth || pScene->GetHeight() != m_sceneHeight)
+		CreateSceneTextures(pScene->GetWidth(), pScene->GetHeight());
+	if (iWidth != m_outputWidth || iHeight != m_outputHeight)
+		CreateHistory(iWidth, iHeight);
+	int iPrevious = 1 - m_current;
+
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_CULL_FACE);
+	glDisable(GL_BLEND);
+	glBindVertexArray(m_vao);
+
+	// Motion vectors and linear depth, at the scene's resolution
+	glBindFramebuffer(GL_FRAMEBUFFER, m_motionFramebuffers[m_current]);
+	glViewport(0, 0, m_sceneWidth, m_sceneHeight);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, pScene->GetDepthTexture());
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, m_linearDepthTextures[iPrevious]);
+	m_pMotionProgram->UseProgram();
+	m_pMotionProgram->SetUniform("depthTexture", 0);
+	m_pMotionProgram->SetUniform("previousLinearDepth", 1);
+	m_pMotionProgram->SetUniform("previousDepthValid", m_previousDepthValid ? 1 : 0);
+	m_pMotionProgram->SetUniform("viewProjection", viewProjection);
+	m_pMotionProgram->SetUniform("inverseViewProjection", glm::inverse(viewProjection));
+	m_pMotionProgram->SetUniform("previousViewProjection", previousViewProjection);
+	m_pMotionProgram->SetUniform("jitter", glm::vec2(2.0f * m_jitterPixels.x / m_sceneWidth, 2.0f * m_jitterPixels.y / m_sceneHeight));
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	// Resolve into this frame's history, at the window's resolution
+	glBindFramebuffer(GL_FRAMEBUFFER, m_historyFramebuffers[m_current]);
+	glViewport(0, 0, m_outputWidth, m_outputHeight);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, pScene->GetColourTexture());
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, m_motionTexture);
+	glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_2D, m_linearDepthTextures[m_current]);
+	glActiveTexture(GL_TEXTURE3);
+	glBindTexture(GL_TEXTURE_2D, m_historyTextures[iPrevious]);
+	m_pResolveProgram->UseProgram();
+	m_pResolveProgram->SetUniform("sceneColour", 0);
+	m_pResolveProgram->SetUniform("motion", 1);
+	m_pResolveProgram->SetUniform("sceneLinearDepth", 2);
+	m_pResolveProgram->SetUniform("history", 3);
+	m_pResolveProgram->SetUniform("historyValid", m_historyValid ? 1 : 0);
+	m_pResolveProgram->SetUniform("sceneSize", glm::vec2((float) m_sceneWidth, (float) m_sceneHeight));
+	m_pResolveProgram->SetUniform("jitterPixels", m_jitterPixels);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+
+	// Then onto the window
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, m_historyFramebuffers[m_current]);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glBlitFramebuffer(0, 0, m_outputWidth, m_outputHeight, 0, 0, m_outputWidth, m_outputHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	for (int i = 3; i >= 0; i--) {
+		glActiveTexture(GL_TEXTURE0 + i);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+	glBindVertexArray(0);
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_CULL_FACE);
+
+	m_current = iPrevious;
+	m_historyValid = true;
+	m_previousDepthValid = true;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Common.h"
+
+class CShaderProgram;
+class CRenderTarget;
+
+// A class that rebuilds a full resolution image from a scene drawn at a lower resolution.  Each frame the projection is
+// jittered by a different fraction of a scene pixel, so over a few frames every output pixel is covered by a sample near
+// its centre.  A motion pass reprojects the scene's depth to find where each pixel was last frame, and a resolve pass
+// blends the new samples into the history from there, clamping it to the new samples' colour range to reject stale data.
+class CTemporalUpscaler
+{
+public:
+	CTemporalUpscaler();
+	~CTemporalUpscaler();
+
+	void Create(CShaderProgram* pMotionProgram, CShaderProgram* pResolveProgram);
+	void Release();
+
+	glm::vec2 NextJitter(int iSceneWidth, int iSceneHeight);	// Returns the projection offset, in normalised device coordinates
+	void ResetHistory();									// After a camera cut, or when the upscaler was off
+
+	// Draws the result to the window, from the scene drawn into pScene with this frame's jitter, and leaves the window
+	// bound.  The view projections are without the jitter.
+	void Resolve(CRenderTarget* pScene, int iWidth, int iHeight, const glm::mat4 &viewProjection, const glm::mat4 &previousViewProjection);
+
+private:
+	static const int JITTER_PHASES = 16;
+
+	void CreateSceneTextures(int iWidth, int iHeight);
+	void CreateHistory(int iWidth, int iHeight);
+	void ReleaseSceneTextures();
+	void ReleaseHistory();
+
+	CShaderProgram* m_pMotionProgram;
+	CShaderProgram* m_pResolveProgram;
+	UINT m_vao;								// Empty; the full screen triangle is made from the vertex index
+
+	// At the scene's size.  The linear depth alternates between frames, so each frame can test against the last.
+	UINT m_motionTexture;
+	UINT m_linearDepthTextures[2];
+	UINT m_motionFramebuffers[2];
+	int m_sceneWidth;
+	int m_sceneHeight;
+
+	// At the window's size, also alternating
+	UINT m_historyTextures[2];
+	UINT m_historyFramebuffers[2];
+	int m_outputWidth;
+	int m_outputHeight;
+
+	int m_current;							// Which of each pair this frame writes
+	int m_jitterIndex;
+	glm::vec2 m_jitterPixels;
+	bool m_historyValid;
+	bool m_previousDepthValid;
+	bool m_created;
+};
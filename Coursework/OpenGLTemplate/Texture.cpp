@@ -3,6 +3,7 @@
 #include "texture.h"
 
 #include "include\freeimage\FreeImage.h"
+#include "CpuTrace.h"
 #pragma comment(lib, "lib/FreeImage.lib")
 
 CTexture::CTexture()
@@ -38,6 +39,8 @@ void CTexture::CreateFromData(BYTE* data, int width, int height, int bpp, GLenum
 // Loads a 2D texture given the filename (sPath).  bGenerateMipMaps will generate a mipmapped texture if true
 bool CTexture::Load(string path, bool generateMipMaps)
 {
+	CPU_TRACE_SCOPE("CTexture::Load");
+
 	FREE_IMAGE_FORMAT fif = FIF_UNKNOWN;
 	FIBITMAP* dib(0);
 
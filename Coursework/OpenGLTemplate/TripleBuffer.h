@@ -0,0 +1,52 @@
+#pragma once
+
+// Like OcclusionBuffer.h, this only depends on the standard library
+#include <atomic>
+
+// A class that hands the latest value from one writing thread to one reading thread without either waiting.  The writer
+// fills its buffer then publishes it, swapping it with the middle buffer; the reader swaps its buffer with the middle one
+// only when something new has been published.  Values the reader is too slow to take are overwritten.
+template <class T>
+class CTripleBuffer
+{
+public:
+	CTripleBuffer()
+	{
+		m_write = 0;
+		m_middle = 1;
+		m_read = 2;
+	}
+
+	T& GetWriteBuffer()
+	{
+		return m_buffers[m_write];
+	}
+
+	void Publish()
+	{
+		m_write = m_middle.exchange(m_write | FRESH) & INDEX;
+	}
+
+	// Takes the latest published value, returning false if nothing new has been published since the last call
+	bool Acquire()
+	{
+		if (!(m_middle.load() & FRESH))
+			return false;
+		m_read = m_middle.exchange(m_read) & INDEX;
+		return true;
+	}
+
+	const T& GetReadBuffer()
+	{
+		return m_buffers[m_read];
+	}
+
+private:
+	static const int INDEX = 3;
+	static const int FRESH = 4;		// Set on the middle index when it holds a value the reader has not taken
+
+	T m_buffers[3];
+	int m_write;
+	std::atomic<int> m_middle;
+	int m_read;
+};
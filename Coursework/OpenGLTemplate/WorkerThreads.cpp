@@ -0,0 +1,96 @@
+#include "WorkerThreads.h"
+#include "CpuTrace.h"
+
+CWorkerThreads::CWorkerThreads()
+{
+	m_batch = 0;
+	m_workersRemaining = 0;
+	m_stopWorkers = false;
+	m_pTasks = NULL;
+	m_nextTask = 0;
+}
+
+CWorkerThreads::~CWorkerThreads()
+{
+	Release();
+}
+
+void CWorkerThreads::Create(int iThreads)
+{
+	m_stopWorkers = false;
+	for (int i = 1; i < iThreads; i++)
+		m_workers.push_back(std::thread(&CWorkerThreads::WorkerLoop, this));
+}
+
+void CWorkerThreads::Release()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopWorkers = true;
+	}
+	m_startSignal.notify_all();
+	for (size_t i = 0; i < m_workers.size(); i++)
+		m_workers[i].join();
+	m_workers.clear();
+}
+
+// Wakes the workers, then works through the tasks alongside them.  Each worker takes part in every batch, so the batch
+// is only over once they have all run out of tasks.
+void CWorkerThreads::Run(const std::vector<std::function<void()> > &tasks)
+{
+	if (m_workers.empty()) {
+		for (size_t i = 0; i < tasks.size(); i++)
+			tasks[i]();
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_pTasks = &tasks;
+		m_nextTask = 0;
+		m_workersRemaining = (int)m_workers.size();
+		m_batch++;
+	}
+	m_startSignal.notify_all();
+
+	RunTasks();
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_doneSignal.wait(lock, [this] { return m_workersRemaining == 0; });
+	m_pTasks = NULL;
+}
+
+int CWorkerThreads::GetThreadCount()
+{
+	return (int)m_workers.size() + 1;
+}
+
+void CWorkerThreads::RunTasks()
+{
+	const std::vector<std::function<void()> > &tasks = *m_pTasks;
+	for (int i = m_nextTask++; i < (int)tasks.size(); i = m_nextTask++)
+		tasks[i]();
+}
+
+void CWorkerThreads::WorkerLoop()
+{
+	CPU_TRACE_THREAD_NAME("Render worker");
+	unsigned int uiBatch = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_startSignal.wait(lock, [this, uiBatch] { return m_stopWorkers || m_batch != uiBatch; });
+			if (m_stopWorkers)
+				return;
+			uiBatch = m_batch;
+		}
+
+		RunTasks();
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_workersRemaining--;
+		}
+		m_doneSignal.notify_one();
+	}
+}
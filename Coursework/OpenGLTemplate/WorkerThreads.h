@@ -0,0 +1,40 @@
+#pragma once
+
+// Like OcclusionBuffer.h, this only depends on the standard library
+#include <vector>
+#include <functional>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// A class that runs a batch of independent tasks across a few persistent threads.  The calling thread takes tasks as
+// well, and Run returns once every task has finished.  Tasks are handed out one at a time in order, so a slow task does
+// not hold up the others.
+class CWorkerThreads
+{
+public:
+	CWorkerThreads();
+	~CWorkerThreads();
+
+	void Create(int iThreads);		// Starts iThreads - 1 workers; the caller is the other thread
+	void Release();
+
+	void Run(const std::vector<std::function<void()> > &tasks);
+	int GetThreadCount();
+
+private:
+	void RunTasks();
+	void WorkerLoop();
+
+	std::vector<std::thread> m_workers;
+	std::mutex m_mutex;
+	std::condition_variable m_startSignal;
+	std::condition_variable m_doneSignal;
+	unsigned int m_batch;
+	int m_workersRemaining;
+	bool m_stopWorkers;
+
+	const std::vector<std::function<void()> >* m_pTasks;
+	std::atomic<int> m_nextTask;
+};
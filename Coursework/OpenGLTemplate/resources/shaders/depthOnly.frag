@@ -0,0 +1,6 @@
+#version 400 core
+
+// Depth pre-pass: only the depth buffer is written, so there is nothing to compute here
+void main()
+{
+}
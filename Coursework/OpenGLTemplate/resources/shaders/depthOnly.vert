@@ -0,0 +1,27 @@
+#version 400 core
+
+// Structure for matrices
+uniform struct Matrices
+{
+	mat4 projMatrix;
+	mat4 modelViewMatrix; 
+	mat3 normalMatrix;
+} matrices;
+
+// Layout of vertex attributes in VBO
+layout (location = 0) in vec3 inPosition;
+layout (location = 4) in mat4 inInstanceMatrix;
+
+uniform bool instanced;
+
+// Must match spotlightShader.vert exactly, so the main pass can test against this depth with GL_EQUAL
+invariant gl_Position;
+
+void main()
+{	
+	mat4 modelViewMatrix = matrices.modelViewMatrix;
+	if (instanced)
+		modelViewMatrix = matrices.modelViewMatrix * inInstanceMatrix;
+
+	gl_Position = matrices.projMatrix * modelViewMatrix * vec4(inPosition, 1.0);
+} 
@@ -0,0 +1,10 @@
+#version 400 core
+
+uniform vec4 vColour;
+
+out vec4 vOutputColour;
+
+void main()
+{
+	vOutputColour = vColour;
+}
@@ -0,0 +1,11 @@
+#version 400 core
+
+uniform mat4 projMatrix;
+
+// Pixels from the bottom left of the window
+layout (location = 0) in vec2 inPosition;
+
+void main()
+{
+	gl_Position = projMatrix * vec4(inPosition, 0.0, 1.0);
+}
@@ -0,0 +1,11 @@
+#version 400 core
+
+// A single triangle covering the screen, made from the vertex index so no vertex buffer is needed
+out vec2 vTexCoord;
+
+void main()
+{
+	vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+	vTexCoord = corner;
+	gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -0,0 +1,63 @@
+#version 430 core
+
+// Vertex shader for the GPU-driven draws.  A whole bucket of draws is submitted with one indirect multi-draw, so the model 
+// matrix cannot be a uniform: each draw's base instance is its object, and the object's matrices come from a buffer.
+
+// Structure for matrices
+uniform struct Matrices
+{
+	mat4 projMatrix;
+	mat4 modelViewMatrix;	// Only the view matrix here
+	mat3 normalMatrix;
+} matrices;
+
+// Written each frame by the CPU; the bounds are only used by cullDraws.comp
+struct SceneObject
+{
+	mat4 modelMatrix;
+	mat4 normalMatrix;	// Inverse transpose of the model matrix, since the city meshes are not scaled uniformly
+	vec4 centre;
+	vec4 extents;
+};
+
+layout (std430, binding = 0) readonly buffer Objects
+{
+	SceneObject objects[];
+};
+
+// Layout of vertex attributes in VBO
+layout (location = 0) in vec3 inPosition;
+layout (location = 1) in vec2 inCoord;
+layout (location = 2) in vec3 inNormal;
+layout (location = 3) in vec4 inBakedLight;	// City lighting (rgb) and ambient occlusion (a) from the light baker
+layout (location = 8) in uint inObject;		// Read per instance from a buffer of 0, 1, 2..., so it is the base instance
+
+out vec2 vTexCoord;	// Texture coordinate
+
+out vec3 n;
+out vec4 p;
+
+out vec3 worldPosition;	// used for skybox
+
+out vec4 vBakedLight;
+
+// The depth pre-pass uses this shader too; both must be invariant for GL_EQUAL to work
+invariant gl_Position;
+
+void main()
+{	
+	worldPosition = inPosition;
+
+	// The view matrix is rigid, so it serves as its own normal matrix
+	mat4 modelViewMatrix = matrices.modelViewMatrix * objects[inObject].modelMatrix;
+	mat3 normalMatrix = mat3(matrices.modelViewMatrix) * mat3(objects[inObject].normalMatrix);
+
+	gl_Position = matrices.projMatrix * modelViewMatrix * vec4(inPosition, 1.0);
+	
+	n = normalize(normalMatrix * inNormal);
+	p = modelViewMatrix * vec4(inPosition, 1.0f);
+
+	vTexCoord = inCoord;
+
+	vBakedLight = inBakedLight;
+} 
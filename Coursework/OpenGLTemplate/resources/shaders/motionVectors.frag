@@ -0,0 +1,44 @@
+#version 400 core
+
+// Works out where each pixel of the scene was on screen last frame, by reprojecting its depth with last frame's camera.
+// Only the camera's motion is captured, so moving objects rely on the resolve's history clamping.  The pixel is marked
+// disoccluded if something nearer covered that spot last frame, or it was off screen.
+
+uniform sampler2D depthTexture;				// The scene's depth buffer
+uniform sampler2D previousLinearDepth;		// Last frame's output of linearDepth
+uniform bool previousDepthValid;
+uniform mat4 viewProjection;				// Without the jitter
+uniform mat4 inverseViewProjection;
+uniform mat4 previousViewProjection;
+uniform vec2 jitter;						// The projection's offset this frame, in normalised device coordinates
+
+in vec2 vTexCoord;
+
+layout (location = 0) out vec4 vMotion;		// xy: offset back to last frame's texture coordinates, z: 1 if disoccluded
+layout (location = 1) out float linearDepth;	// Distance along the view direction, for next frame's test
+
+// How much nearer last frame's surface must be for the pixel to count as newly uncovered
+const float DISOCCLUSION_TOLERANCE = 0.05;
+
+void main()
+{
+	float depth = texelFetch(depthTexture, ivec2(gl_FragCoord.xy), 0).r;
+
+	// The point this pixel sampled, with the jitter taken out
+	vec2 ndc = vTexCoord * 2.0 - 1.0 - jitter;
+	vec4 worldPosition = inverseViewProjection * vec4(ndc, depth * 2.0 - 1.0, 1.0);
+	worldPosition /= worldPosition.w;
+
+	vec4 previousClip = previousViewProjection * worldPosition;
+	vec2 previousTexCoord = previousClip.xy / previousClip.w * 0.5 + 0.5;
+	vec2 texCoord = ndc * 0.5 + 0.5;
+
+	float disoccluded = 0.0;
+	if (!previousDepthValid || any(lessThan(previousTexCoord, vec2(0.0))) || any(greaterThan(previousTexCoord, vec2(1.0))))
+		disoccluded = 1.0;
+	else if (texture(previousLinearDepth, previousTexCoord).r < previousClip.w * (1.0 - DISOCCLUSION_TOLERANCE))
+		disoccluded = 1.0;
+
+	vMotion = vec4(texCoord - previousTexCoord, disoccluded, 0.0);
+	linearDepth = (viewProjection * worldPosition).w;
+}
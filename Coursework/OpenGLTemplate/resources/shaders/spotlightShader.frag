@@ -5,9 +5,11 @@ in vec2 vTexCoord;			// Interpolated texture coordinate using texture coordinate
 uniform sampler2D sampler0;  // The texture sampler
 uniform samplerCube CubeMapTex;
 
-uniform bool fogOn;
 uniform float discardTime;
 
+uniform float fogDensity;		// Fog falls off as exp(-fogDensity * distance)
+uniform float fogLodBias;		// Texture LOD bias for fully fogged fragments
+
 out vec4 vOutputColour;
 
 in vec3 n;
@@ -35,13 +37,29 @@ struct MaterialInfo
 uniform LightInfo light1; 
 uniform LightInfo pointlight; 
 uniform LightInfo spotlight[62]; 
+uniform int spotlightCount;		// The headlight and the city lights nearest the camera
 
 uniform MaterialInfo material1; 
 
 in vec3 worldPosition;
+in vec4 vBakedLight;
+
+#ifdef PERMUTATION
+// Specialised variant: the switches are compile time constants, so the compiler strips the unused paths
+const bool renderSkybox = RENDER_SKYBOX != 0;
+const bool renderTrack = RENDER_TRACK != 0;
+const bool showTrack = SHOW_TRACK != 0;
+const bool fogOn = FOG_ON != 0;
+const bool bakedLighting = BAKED_LIGHTING != 0;
+#else
 uniform bool renderSkybox;
 uniform bool renderTrack;
 uniform bool showTrack;
+uniform bool fogOn;
+uniform bool bakedLighting;
+#endif
+
+float m_ambientOcclusion = 1.0;
 
 
 // This function implements the Phong shading model
@@ -52,7 +70,7 @@ vec3 PhongModel(vec4 p, vec3 n)
 	vec3 s = normalize(vec3(light1.position - p));
 	vec3 v = normalize(-p.xyz);
 	vec3 r = reflect(-s, n);
-	vec3 ambient = light1.La * material1.Ma;
+	vec3 ambient = light1.La * material1.Ma * m_ambientOcclusion;
 	float sDotN = max(dot(s, n), 0.0);
 	vec3 diffuse = light1.Ld * material1.Md * sDotN;
 	vec3 specular = vec3(0.0);
@@ -127,6 +145,8 @@ vec3 PointlightModel(LightInfo light, vec4 p, vec3 n)
 
 void main()
 {	
+	// How much of the fragment survives the fog.  Fogged fragments can sample coarser mip levels, since detail is lost.
+	float fogWeight = fogOn ? exp(-fogDensity * length(p.xyz)) : 1.0;
 
 	if (renderSkybox) {
 		vOutputColour = texture(CubeMapTex, worldPosition);
@@ -146,7 +166,7 @@ void main()
 
 		vColour += PointlightModel(pointlight, p, normalised_n);
 
-		for (int i = 0 ; i < 63 ; i++) { 
+		for (int i = 0 ; i < spotlightCount ; i++) { 
 			vColour += BlinnPhongSpotlightModel(spotlight[i], p, normalised_n);
 		}
 
@@ -155,25 +175,32 @@ void main()
 	} else {
 
 		vec3 normalised_n = normalize(n);
+
+		if (bakedLighting) {
+			m_ambientOcclusion = vBakedLight.a;
+		}
+
 		vec3 vColour = PhongModel(p, normalised_n);
 
 		vColour += PointlightModel(pointlight, p, normalised_n);
 
-		for (int i = 0 ; i < 62 ; i++) { 
-			vColour += BlinnPhongSpotlightModel(spotlight[i], p, normalised_n);
+		if (bakedLighting) {
+			// The city lights (spotlight[1] onwards) are baked into the vertex colour; only the headlight is dynamic
+			vColour += vBakedLight.rgb;
+			vColour += BlinnPhongSpotlightModel(spotlight[0], p, normalised_n);
+		} else {
+			for (int i = 0 ; i < spotlightCount ; i++) { 
+				vColour += BlinnPhongSpotlightModel(spotlight[i], p, normalised_n);
+			}
 		}
 
-		vec4 vTexColour = texture(sampler0, vTexCoord);	
+		vec4 vTexColour = texture(sampler0, vTexCoord, fogLodBias * (1.0 - fogWeight));	
 
 		vOutputColour = vTexColour*vec4(vColour, 1);
 
 	}
 
 	if(fogOn){
-
-		float dist = length(p.xyz);
-		float w = exp(-0.0007f * dist);
-
-		vOutputColour.rgb = mix(vec3(0.5), vOutputColour.rgb, w);
+		vOutputColour.rgb = mix(vec3(0.5), vOutputColour.rgb, fogWeight);
 	}
 }
@@ -12,6 +12,16 @@ uniform struct Matrices
 layout (location = 0) in vec3 inPosition;
 layout (location = 1) in vec2 inCoord;
 layout (location = 2) in vec3 inNormal;
+layout (location = 3) in vec4 inBakedLight;	// City lighting (rgb) and ambient occlusion (a) from the light baker
+layout (location = 4) in mat4 inInstanceMatrix;	// Model matrix per instance (locations 4-7), used when instanced is set
+
+uniform bool instanced;	// matrices.modelViewMatrix then holds only the view matrix
+
+#ifdef PERMUTATION
+const bool renderSkybox = RENDER_SKYBOX != 0;
+#else
+uniform bool renderSkybox;
+#endif
 
 out vec2 vTexCoord;	// Texture coordinate
 
@@ -20,19 +30,38 @@ out vec4 p;
 
 out vec3 worldPosition;	// used for skybox
 
+out vec4 vBakedLight;
+
+// The depth pre-pass (depthOnly.vert) computes gl_Position the same way; both must be invariant for GL_EQUAL to work
+invariant gl_Position;
+
 void main()
 {	
 	// Save the world position for rendering the skybox
 	worldPosition = inPosition;
 
+	// Instances are rigid, so the upper 3x3 of the modelview matrix serves as the normal matrix
+	mat4 modelViewMatrix = matrices.modelViewMatrix;
+	mat3 normalMatrix = matrices.normalMatrix;
+	if (instanced) {
+		modelViewMatrix = matrices.modelViewMatrix * inInstanceMatrix;
+		normalMatrix = mat3(modelViewMatrix);
+	}
+
 	// Transform the vertex spatial position using the projection and modelview matrices
-	gl_Position = matrices.projMatrix * matrices.modelViewMatrix * vec4(inPosition, 1.0);
+	gl_Position = matrices.projMatrix * modelViewMatrix * vec4(inPosition, 1.0);
+
+	// The skybox goes at the far plane's depth, however near the far plane is, so it is never clipped
+	if (renderSkybox)
+		gl_Position = gl_Position.xyww;
 	
 	// Get the vertex normal and vertex position in eye coordinates
-	n = normalize(matrices.normalMatrix * inNormal);
-	p = matrices.modelViewMatrix * vec4(inPosition, 1.0f);
+	n = normalize(normalMatrix * inNormal);
+	p = modelViewMatrix * vec4(inPosition, 1.0f);
 
 	// Pass through the texture coordinate
 	vTexCoord = inCoord;
+
+	vBakedLight = inBakedLight;
 } 
 
@@ -0,0 +1,77 @@
+#version 400 core
+
+// Rebuilds the full resolution image from the jittered, lower resolution scene and the accumulated history.  The history
+// is fetched from where the pixel was last frame, and clamped to the range of the scene colours around it, in YCoCg, so 
+// stale colours from moving or newly visible surfaces are rejected.  Each frame's sample is weighted by how close its
+// jittered position falls to the output pixel.  Where the pixel was disoccluded there is no usable history, so the scene 
+// colour is used as it is.
+
+uniform sampler2D sceneColour;
+uniform sampler2D motion;					// From motionVectors.frag
+uniform sampler2D sceneLinearDepth;
+uniform sampler2D history;					// The previous output, at full resolution
+uniform bool historyValid;
+uniform vec2 sceneSize;
+uniform vec2 jitterPixels;					// The projection's offset this frame, in scene pixels
+
+in vec2 vTexCoord;
+
+out vec4 vOutputColour;
+
+// Weight of a new sample that lands right on the output pixel, and of one that lands far from it
+const float MAX_BLEND = 0.2;
+const float MIN_BLEND = 0.03;
+
+vec3 RGBToYCoCg(vec3 c)
+{
+	return vec3(0.25 * c.r + 0.5 * c.g + 0.25 * c.b, 0.5 * c.r - 0.5 * c.b, -0.25 * c.r + 0.5 * c.g - 0.25 * c.b);
+}
+
+vec3 YCoCgToRGB(vec3 c)
+{
+	return vec3(c.x + c.y - c.z, c.x + c.z, c.x - c.y - c.z);
+}
+
+void main()
+{
+	// This pixel's position in scene pixels, and the scene texel whose jittered sample is nearest to it
+	vec2 position = vTexCoord * sceneSize;
+	vec2 samplePosition = position + jitterPixels;
+	ivec2 sceneMax = ivec2(sceneSize) - 1;
+	ivec2 centre = clamp(ivec2(floor(samplePosition)), ivec2(0), sceneMax);
+
+	// The colour range of the neighbourhood, and the texel nearest the camera, whose motion is used so edges keep the
+	// motion of the foreground
+	vec3 minColour = vec3(1e9);
+	vec3 maxColour = vec3(-1e9);
+	ivec2 nearest = centre;
+	float nearestDepth = 1e9;
+	for (int y = -1; y <= 1; y++) {
+		for (int x = -1; x <= 1; x++) {
+			ivec2 texel = clamp(centre + ivec2(x, y), ivec2(0), sceneMax);
+			vec3 colour = RGBToYCoCg(texelFetch(sceneColour, texel, 0).rgb);
+			minColour = min(minColour, colour);
+			maxColour = max(maxColour, colour);
+			float depth = texelFetch(sceneLinearDepth, texel, 0).r;
+			if (depth < nearestDepth) {
+				nearestDepth = depth;
+				nearest = texel;
+			}
+		}
+	}
+
+	vec3 filtered = texture(sceneColour, samplePosition / sceneSize).rgb;
+	vec4 pixelMotion = texelFetch(motion, nearest, 0);
+	vec2 historyTexCoord = vTexCoord - pixelMotion.xy;
+	if (!historyValid || pixelMotion.z > 0.5 || any(lessThan(historyTexCoord, vec2(0.0))) || any(greaterThan(historyTexCoord, vec2(1.0)))) {
+		vOutputColour = vec4(filtered, 1.0);
+		return;
+	}
+
+	vec3 previous = clamp(RGBToYCoCg(texture(history, historyTexCoord).rgb), minColour, maxColour);
+	vec3 current = RGBToYCoCg(texelFetch(sceneColour, centre, 0).rgb);
+	vec2 offset = vec2(centre) + 0.5 - jitterPixels - position;
+	float blend = mix(MIN_BLEND, MAX_BLEND, exp(-2.0 * dot(offset, offset)));
+
+	vOutputColour = vec4(YCoCgToRGB(mix(previous, current, blend)), 1.0);
+}
@@ -0,0 +1,511 @@
+/*
+	LightBaker: offline baker for the static city lighting.
+
+	For every vertex of the static city meshes (StaticLighting.cpp) this computes the diffuse contribution of the 61
+	fixed city spotlights, using the same spotlight model as spotlightShader.frag, and an ambient occlusion term from
+	rays cast against all the static meshes.  The results are written to a .bake file next to each .obj, which
+	Game::LoadStaticMesh picks up so the spotlight shader only has to evaluate the headlight and point light.
+
+	Specular is view dependent and is not baked, so the baked meshes lose the city light highlights.  The city lights
+	are not shadowed at runtime either (most of them sit below the street), so no shadow rays are cast for them.
+
+	It only uses the standard library and glm, and runs headless.  Build and run on Linux from this folder:
+
+		g++ -O2 -std=c++11 -pthread -I../../OpenGLTemplate LightBaker.cpp ../../OpenGLTemplate/StaticLighting.cpp -o LightBaker
+		./LightBaker ../../OpenGLTemplate [threads] [ao rays per vertex]
+
+	The game folder is the one containing resources\models.
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+#include "StaticLighting.h"
+#include "include/glm/gtc/matrix_inverse.hpp"
+
+using namespace std;
+
+static const float AO_DISTANCE = 30.0f;		// World units; occluders further away than this do not darken a vertex
+static const float RAY_OFFSET = 0.05f;		// Moves ray origins off the surface to avoid hitting the vertex's own triangles
+static const int VERTICES_PER_JOB = 256;
+static const float PI = 3.14159265358979f;
+
+
+// A triangle corner as read from the OBJ file, in object coordinates
+struct Corner
+{
+	glm::vec3 position;
+	glm::vec3 normal;
+};
+
+struct Triangle
+{
+	glm::vec3 v0, v1, v2;
+};
+
+// A distinct vertex to bake: its record in the output file, and where it is in the world
+struct BakeVertex
+{
+	BakedVertexRecord record;
+	glm::vec3 worldPosition;
+	glm::vec3 worldNormal;
+};
+
+
+// Converts the Windows paths used by the game into paths for this platform
+static string NativePath(string sPath)
+{
+#ifndef _WIN32
+	replace(sPath.begin(), sPath.end(), '\\', '/');
+#endif
+	return sPath;
+}
+
+// Resolves a 1-based (or negative, relative) OBJ index
+static int ObjIndex(int iIndex, int iCount)
+{
+	return iIndex > 0 ? iIndex - 1 : iCount + iIndex;
+}
+
+// Reads the triangles of an OBJ file.  Polygons are split into fans, as Assimp's aiProcess_Triangulate does.  Corners
+// without a normal get a smooth normal averaged from the faces sharing their position, like aiProcess_GenSmoothNormals.
+static bool LoadObj(const string &sFilename, vector<Corner>* pCorners)
+{
+	FILE* fp = fopen(sFilename.c_str(), "r");
+	if (!fp) {
+		fprintf(stderr, "Could not open %s\n", sFilename.c_str());
+		return false;
+	}
+
+	vector<glm::vec3> positions;
+	vector<glm::vec3> normals;
+	vector<int> cornerPosition;		// Index into positions, kept to generate missing normals
+	vector<bool> cornerHasNormal;
+	bool bMissingNormals = false;
+
+	char sLine[4096];
+	int iLine = 0;
+	while (fgets(sLine, sizeof(sLine), fp)) {
+		iLine++;
+		if (sLine[0] == 'v' && sLine[1] == ' ') {
+			glm::vec3 v;
+			sscanf(sLine + 2, "%f %f %f", &v.x, &v.y, &v.z);
+			positions.push_back(v);
+		}
+		else if (sLine[0] == 'v' && sLine[1] == 'n') {
+			glm::vec3 n;
+			sscanf(sLine + 3, "%f %f %f", &n.x, &n.y, &n.z);
+			normals.push_back(n);
+		}
+		else if (sLine[0] == 'f' && sLine[1] == ' ') {
+			vector<int> facePositions, faceNormals;
+			char* pToken = strtok(sLine + 2, " \t\r\n");
+			while (pToken) {
+				int iPosition = 0, iTexCoord = 0, iNormal = 0;
+				if (sscanf(pToken, "%d/%d/%d", &iPosition, &iTexCoord, &iNormal) != 3 && sscanf(pToken, "%d//%d", &iPosition, &iNormal) != 2) {
+					iNormal = 0;
+					sscanf(pToken, "%d", &iPosition);
+				}
+				bool bHasNormal = iNormal != 0;
+				iPosition = ObjIndex(iPosition, (int)positions.size());
+				iNormal = bHasNormal ? ObjIndex(iNormal, (int)normals.size()) : -1;
+
+				// A bad index means the file is not what the game loads, so the bake would not match it
+				bool bBadNormal = bHasNormal && (iNormal < 0 || iNormal >= (int)normals.size());
+				if (iPosition < 0 || iPosition >= (int)positions.size() || bBadNormal) {
+					fprintf(stderr, "%s:%d: face refers to a vertex that does not exist\n", sFilename.c_str(), iLine);
+					fclose(fp);
+					return false;
+				}
+				facePositions.push_back(iPosition);
+				faceNormals.push_back(iNormal);
+				pToken = strtok(NULL, " \t\r\n");
+			}
+
+			for (int i = 1; i + 1 < (int)facePositions.size(); i++) {
+				int corners[3] = { 0, i, i + 1 };
+				for (int j = 0; j < 3; j++) {
+					int iPosition = facePositions[corners[j]];
+					int iNormal = faceNormals[corners[j]];
+
+					Corner corner;
+					corner.position = positions[iPosition];
+					corner.normal = iNormal >= 0 ? normals[iNormal] : glm::vec3(0.0f);
+					pCorners->push_back(corner);
+					cornerPosition.push_back(iPosition);
+					cornerHasNormal.push_back(iNormal >= 0);
+					bMissingNormals = bMissingNormals || iNormal < 0;
+				}
+			}
+		}
+	}
+	fclose(fp);
+
+	if (bMissingNormals) {
+		vector<glm::vec3> smoothNormals(positions.size(), glm::vec3(0.0f));
+		for (int i = 0; i < (int)pCorners->size(); i += 3) {
+			glm::vec3 faceNormal = glm::cross((*pCorners)[i + 1].position - (*pCorners)[i].position, (*pCorners)[i + 2].position - (*pCorners)[i].position);
+			if (glm::length(faceNormal) > 0.0f)
+				faceNormal = glm::normalize(faceNormal);
+			for (int j = 0; j < 3; j++)
+				smoothNormals[cornerPosition[i + j]] += faceNormal;
+		}
+		for (int i = 0; i < (int)pCorners->size(); i++) {
+			if (!cornerHasNormal[i])
+				(*pCorners)[i].normal = smoothNormals[cornerPosition[i]];
+		}
+	}
+
+	return true;
+}
+
+
+// A bounding volume hierarchy over world space triangles, used for ambient occlusion rays
+class CTriangleBVH
+{
+public:
+	void Build(const vector<Triangle> &triangles)
+	{
+		m_triangles = triangles;
+		m_nodes.clear();
+		m_nodes.reserve(m_triangles.size() * 2 / LEAF_SIZE + 1);
+
+		vector<glm::vec3> centroids(m_triangles.size());
+		for (int i = 0; i < (int)m_triangles.size(); i++)
+			centroids[i] = (m_triangles[i].v0 + m_triangles[i].v1 + m_triangles[i].v2) / 3.0f;
+
+		m_order.resize(m_triangles.size());
+		for (int i = 0; i < (int)m_order.size(); i++)
+			m_order[i] = i;
+
+		if (!m_triangles.empty()) {
+			m_nodes.resize(1);
+			BuildNode(0, 0, (int)m_triangles.size(), centroids);
+		}
+
+		// Store the triangles in leaf order so leaves index a contiguous range
+		vector<Triangle> sorted(m_triangles.size());
+		for (int i = 0; i < (int)m_order.size(); i++)
+			sorted[i] = m_triangles[m_order[i]];
+		m_triangles.swap(sorted);
+	}
+
+	// Returns true if the ray hits any triangle closer than fMaxDistance.  Triangles are two-sided.
+	bool Occluded(const glm::vec3 &origin, const glm::vec3 &direction, float fMaxDistance) const
+	{
+		if (m_nodes.empty())
+			return false;
+
+		glm::vec3 inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+
+		int stack[64];
+		int iStackSize = 0;
+		stack[iStackSize++] = 0;
+
+		while (iStackSize > 0) {
+			const Node &node = m_nodes[stack[--iStackSize]];
+			if (!HitsBox(node, origin, inverseDirection, fMaxDistance))
+				continue;
+
+			if (node.count > 0) {
+				for (int i = node.first; i < node.first + node.count; i++) {
+					if (HitsTriangle(m_triangles[i], origin, direction, fMaxDistance))
+						return true;
+				}
+			}
+			else if (iStackSize + 2 <= 64) {
+				stack[iStackSize++] = node.first;
+				stack[iStackSize++] = node.first + 1;
+			}
+		}
+
+		return false;
+	}
+
+private:
+	static const int LEAF_SIZE = 4;
+
+	struct Node
+	{
+		glm::vec3 boundsMin;
+		glm::vec3 boundsMax;
+		int first;		// Leaf: first triangle.  Interior: index of the left child; the right child follows it.
+		int count;		// Number of triangles, 0 for interior nodes
+	};
+
+	void BuildNode(int iNode, int iBegin, int iEnd, const vector<glm::vec3> &centroids)
+	{
+		glm::vec3 boundsMin(1e30f), boundsMax(-1e30f), centroidMin(1e30f), centroidMax(-1e30f);
+		for (int i = iBegin; i < iEnd; i++) {
+			const Triangle &triangle = m_triangles[m_order[i]];
+			boundsMin = glm::min(boundsMin, glm::min(triangle.v0, glm::min(triangle.v1, triangle.v2)));
+			boundsMax = glm::max(boundsMax, glm::max(triangle.v0, glm::max(triangle.v1, triangle.v2)));
+			centroidMin = glm::min(centroidMin, centroids[m_order[i]]);
+			centroidMax = glm::max(centroidMax, centroids[m_order[i]]);
+		}
+		m_nodes[iNode].boundsMin = boundsMin;
+		m_nodes[iNode].boundsMax = boundsMax;
+
+		if (iEnd - iBegin <= LEAF_SIZE) {
+			m_nodes[iNode].first = iBegin;
+			m_nodes[iNode].count = iEnd - iBegin;
+			return;
+		}
+
+		// Split at the median centroid along the longest axis
+		glm::vec3 extent = centroidMax - centroidMin;
+		int iAxis = (extent.x > extent.y && extent.x > extent.z) ? 0 : (extent.y > extent.z ? 1 : 2);
+		int iMiddle = (iBegin + iEnd) / 2;
+		nth_element(m_order.begin() + iBegin, m_order.begin() + iMiddle, m_order.begin() + iEnd,
+			[&centroids, iAxis](int a, int b) { return centroids[a][iAxis] < centroids[b][iAxis]; });
+
+		// Children are allocated together so the right child is always left + 1
+		int iLeft = (int)m_nodes.size();
+		m_nodes.resize(m_nodes.size() + 2);
+		m_nodes[iNode].first = iLeft;
+		m_nodes[iNode].count = 0;
+
+		BuildNode(iLeft, iBegin, iMiddle, centroids);
+		BuildNode(iLeft + 1, iMiddle, iEnd, centroids);
+	}
+
+	static bool HitsBox(const Node &node, const glm::vec3 &origin, const glm::vec3 &inverseDirection, float fMaxDistance)
+	{
+		glm::vec3 t0 = (node.boundsMin - origin) * inverseDirection;
+		glm::vec3 t1 = (node.boundsMax - origin) * inverseDirection;
+		glm::vec3 tNear = glm::min(t0, t1);
+		glm::vec3 tFar = glm::max(t0, t1);
+		float fEnter = max(max(tNear.x, tNear.y), max(tNear.z, 0.0f));
+		float fExit = min(min(tFar.x, tFar.y), min(tFar.z, fMaxDistance));
+		return fEnter <= fExit;
+	}
+
+	// Moller-Trumbore intersection
+	static bool HitsTriangle(const Triangle &triangle, const glm::vec3 &origin, const glm::vec3 &direction, float fMaxDistance)
+	{
+		glm::vec3 edge1 = triangle.v1 - triangle.v0;
+		glm::vec3 edge2 = triangle.v2 - triangle.v0;
+		glm::vec3 p = glm::cross(direction, edge2);
+		float fDet = glm::dot(edge1, p);
+		if (fabs(fDet) < 1e-12f)
+			return false;
+
+		float fInvDet = 1.0f / fDet;
+		glm::vec3 s = origin - triangle.v0;
+		float u = glm::dot(s, p) * fInvDet;
+		if (u < 0.0f || u > 1.0f)
+			return false;
+
+		glm::vec3 q = glm::cross(s, edge1);
+		float v = glm::dot(direction, q) * fInvDet;
+		if (v < 0.0f || u + v > 1.0f)
+			return false;
+
+		float t = glm::dot(edge2, q) * fInvDet;
+		return t > 1e-4f && t < fMaxDistance;
+	}
+
+	vector<Triangle> m_triangles;
+	vector<int> m_order;
+	vector<Node> m_nodes;
+};
+
+
+// Sum of the diffuse terms of BlinnPhongSpotlightModel in spotlightShader.frag, for all the city lights
+static glm::vec3 CityLighting(const glm::vec3 &position, const glm::vec3 &normal)
+{
+	const vector<CityLight> &lights = GetCityLights();
+	glm::vec3 colour(0.0f);
+
+	for (int i = 0; i < (int)lights.size(); i++) {
+		glm::vec3 toLight = lights[i].position - position;
+		float fDistance = glm::length(toLight);
+		if (fDistance <= 0.0f)
+			continue;
+
+		glm::vec3 s = toLight / fDistance;
+		float fCosAngle = glm::dot(-s, lights[i].direction);
+		float fAngle = acos(glm::clamp(fCosAngle, -1.0f, 1.0f));
+		float fCutoff = glm::radians(glm::clamp(lights[i].cutoff, 0.0f, 90.0f));
+		if (fAngle >= fCutoff)
+			continue;
+
+		float fSpotFactor = pow(fCosAngle, lights[i].exponent);
+		float fSDotN = max(glm::dot(s, normal), 0.0f);
+		colour += fSpotFactor * (lights[i].colour * fSDotN) / (fDistance * 0.008f);
+	}
+
+	return colour;
+}
+
+// Small deterministic random number generator, so bakes are reproducible regardless of thread count
+struct Random
+{
+	unsigned int state;
+
+	explicit Random(unsigned int seed) : state(seed * 747796405u + 2891336453u) {}
+
+	float Next()
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return (state >> 8) * (1.0f / 16777216.0f);
+	}
+};
+
+// Fraction of cosine-weighted hemisphere rays that escape within AO_DISTANCE
+static float AmbientOcclusion(const CTriangleBVH &bvh, const glm::vec3 &position, const glm::vec3 &normal, int iRays, unsigned int uiSeed)
+{
+	if (iRays <= 0)
+		return 1.0f;
+
+	// Build a basis around the normal
+	glm::vec3 tangent = fabs(normal.x) > 0.9f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+	tangent = glm::normalize(glm::cross(tangent, normal));
+	glm::vec3 bitangent = glm::cross(normal, tangent);
+
+	glm::vec3 origin = position + normal * RAY_OFFSET;
+	Random random(uiSeed);
+	int iOpen = 0;
+
+	for (int i = 0; i < iRays; i++) {
+		float r = sqrt(random.Next());
+		float phi = 2.0f * PI * random.Next();
+		float x = r * cos(phi);
+		float y = r * sin(phi);
+		float z = sqrt(max(0.0f, 1.0f - x * x - y * y));
+		glm::vec3 direction = x * tangent + y * bitangent + z * normal;
+
+		if (!bvh.Occluded(origin, direction, AO_DISTANCE))
+			iOpen++;
+	}
+
+	return (float)iOpen / (float)iRays;
+}
+
+// Writes the records of one mesh
+static bool WriteBake(const string &sFilename, const vector<BakeVertex> &vertices)
+{
+	FILE* fp = fopen(sFilename.c_str(), "wb");
+	if (!fp) {
+		fprintf(stderr, "Could not write %s\n", sFilename.c_str());
+		return false;
+	}
+
+	BakedLightingHeader header;
+	header.magic = BAKED_LIGHTING_MAGIC;
+	header.version = BAKED_LIGHTING_VERSION;
+	header.count = (unsigned int)vertices.size();
+	fwrite(&header, sizeof(header), 1, fp);
+	for (int i = 0; i < (int)vertices.size(); i++)
+		fwrite(&vertices[i].record, sizeof(BakedVertexRecord), 1, fp);
+	fclose(fp);
+
+	return true;
+}
+
+
+int main(int argc, char** argv)
+{
+	if (argc < 2) {
+		printf("Usage: %s <game folder> [threads] [ao rays per vertex]\n", argv[0]);
+		return 1;
+	}
+
+	string sGameFolder = string(argv[1]) + "/";
+	int iThreads = argc > 2 ? atoi(argv[2]) : (int)thread::hardware_concurrency();
+	int iRays = argc > 3 ? atoi(argv[3]) : 64;
+	if (iThreads < 1)
+		iThreads = 1;
+
+	// Load every static mesh, collect its distinct vertices, and gather all triangles in world space for the AO rays
+	vector<vector<BakeVertex> > meshVertices(STATIC_MESH_COUNT);
+	vector<Triangle> triangles;
+
+	for (int iMesh = 0; iMesh < STATIC_MESH_COUNT; iMesh++) {
+		const StaticMeshPlacement &placement = GetStaticMeshPlacement(iMesh);
+		vector<Corner> corners;
+		if (!LoadObj(NativePath(sGameFolder + placement.filename), &corners))
+			return 1;
+
+		glm::mat4 modelMatrix = placement.GetModelMatrix();
+		glm::mat3 normalMatrix = glm::inverseTranspose(glm::mat3(modelMatrix));
+
+		map<unsigned long long, int> vertexIndex;
+		for (int i = 0; i < (int)corners.size(); i++) {
+			BakeVertex vertex;
+			QuantiseBakedVertex(corners[i].position, corners[i].normal, &vertex.record);
+			unsigned long long ullKey = GetBakedVertexKey(vertex.record, true);
+			if (vertexIndex.count(ullKey))
+				continue;
+
+			vertex.worldPosition = glm::vec3(modelMatrix * glm::vec4(corners[i].position, 1.0f));
+			vertex.worldNormal = normalMatrix * corners[i].normal;
+			if (glm::length(vertex.worldNormal) > 0.0f)
+				vertex.worldNormal = glm::normalize(vertex.worldNormal);
+			vertexIndex[ullKey] = (int)meshVertices[iMesh].size();
+			meshVertices[iMesh].push_back(vertex);
+		}
+
+		for (int i = 0; i + 2 < (int)corners.size(); i += 3) {
+			Triangle triangle;
+			triangle.v0 = glm::vec3(modelMatrix * glm::vec4(corners[i].position, 1.0f));
+			triangle.v1 = glm::vec3(modelMatrix * glm::vec4(corners[i + 1].position, 1.0f));
+			triangle.v2 = glm::vec3(modelMatrix * glm::vec4(corners[i + 2].position, 1.0f));
+			triangles.push_back(triangle);
+		}
+
+		printf("%s: %d triangles, %d vertices to bake\n", placement.filename.c_str(), (int)corners.size() / 3, (int)meshVertices[iMesh].size());
+	}
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+	CTriangleBVH bvh;
+	bvh.Build(triangles);
+
+	// Bake each mesh with a pool of threads pulling fixed-size jobs off a shared counter
+	for (int iMesh = 0; iMesh < STATIC_MESH_COUNT; iMesh++) {
+		vector<BakeVertex> &vertices = meshVertices[iMesh];
+		atomic<int> nextJob(0);
+		int iJobs = ((int)vertices.size() + VERTICES_PER_JOB - 1) / VERTICES_PER_JOB;
+
+		vector<thread> workers;
+		for (int t = 0; t < iThreads; t++) {
+			workers.push_back(thread([&]() {
+				for (int iJob = nextJob++; iJob < iJobs; iJob = nextJob++) {
+					int iEnd = min((iJob + 1) * VERTICES_PER_JOB, (int)vertices.size());
+					for (int i = iJob * VERTICES_PER_JOB; i < iEnd; i++) {
+						BakeVertex &vertex = vertices[i];
+						glm::vec3 colour = CityLighting(vertex.worldPosition, vertex.worldNormal);
+						float fOcclusion = AmbientOcclusion(bvh, vertex.worldPosition, vertex.worldNormal, iRays, (unsigned int)i);
+						vertex.record.colour[0] = colour.r;
+						vertex.record.colour[1] = colour.g;
+						vertex.record.colour[2] = colour.b;
+						vertex.record.colour[3] = fOcclusion;
+					}
+				}
+			}));
+		}
+		for (int t = 0; t < (int)workers.size(); t++)
+			workers[t].join();
+
+		string sBakeFile = GetBakedLightingFilename(GetStaticMeshPlacement(iMesh).filename);
+		if (!WriteBake(NativePath(sGameFolder + sBakeFile), vertices))
+			return 1;
+		printf("Wrote %s\n", sBakeFile.c_str());
+	}
+
+	double dSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	printf("Baked %d lights with %d AO rays per vertex on %d threads in %.1fs\n", (int)GetCityLights().size(), iRays, iThreads, dSeconds);
+	return 0;
+}
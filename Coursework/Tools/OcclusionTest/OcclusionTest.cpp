@@ -0,0 +1,204 @@
+/*
+	OcclusionTest: headless checks and timings for the software occlusion culling.
+
+	COcclusionBuffer and GenerateOccluders only use the standard library and glm, so they are tested here without
+	Windows or GL.  The checks rasterise a box occluder and make sure boxes behind it are hidden while boxes in front
+	of it, beside it or only partly behind it are not, at every thread count, and that the occluders found inside a
+	closed mesh lie wholly within it.  The timings draw a grid of city blocks from street level and give the best
+	Render and IsVisible times at 1 to N threads.
+
+	Build and run on Linux from this folder:
+
+		g++ -O2 -std=c++11 -pthread -msse2 -I../../OpenGLTemplate OcclusionTest.cpp ../../OpenGLTemplate/OcclusionBuffer.cpp ../../OpenGLTemplate/Occluders.cpp -o OcclusionTest
+		./OcclusionTest [threads]
+
+	It exits with 1 if a check fails.
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+
+#include "OcclusionBuffer.h"
+#include "Occluders.h"
+#include "include/glm/gtc/matrix_transform.hpp"
+
+using namespace std;
+
+// The game's occlusion buffer size (Game.cpp)
+static const int BUFFER_WIDTH = 256;
+static const int BUFFER_HEIGHT = 128;
+
+static const int CITY_BLOCKS = 32;			// Along each side of the benchmark's grid
+static const float BLOCK_SPACING = 40.0f;
+static const int TEST_BOXES = 10000;		// Tested against the buffer per benchmark pass
+static const int REPEATS = 20;				// Each figure is the best of this many runs
+
+static int s_failures = 0;
+
+
+static double ElapsedMilliseconds(chrono::steady_clock::time_point start)
+{
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+// An axis-aligned occluder, with its corners in the bit order OccluderBox expects
+static OccluderBox MakeBox(const glm::vec3 &boxMin, const glm::vec3 &boxMax)
+{
+	OccluderBox box;
+	for (int c = 0; c < 8; c++)
+		box.corners[c] = glm::vec3((c & 1) ? boxMax.x : boxMin.x, (c & 2) ? boxMax.y : boxMin.y, (c & 4) ? boxMax.z : boxMin.z);
+	return box;
+}
+
+static glm::mat4 ViewProjection(const glm::vec3 &eye, const glm::vec3 &target)
+{
+	glm::mat4 projection = glm::perspective(45.0f, (float)BUFFER_WIDTH / (float)BUFFER_HEIGHT, 0.5f, 5000.0f);
+	return projection * glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+static void Check(bool bPassed, const char* szWhat, int iThreads)
+{
+	if (!bPassed) {
+		printf("FAILED: %s, %d threads\n", szWhat, iThreads);
+		s_failures++;
+	}
+}
+
+// A wall 20 units wide and high, 40 to 50 units in front of a camera looking down -z
+static void TestBoxOccluder(int iThreads)
+{
+	COcclusionBuffer buffer;
+	buffer.Create(BUFFER_WIDTH, BUFFER_HEIGHT, iThreads);
+	buffer.SetOccluders(vector<OccluderBox>(1, MakeBox(glm::vec3(-10.0f, -10.0f, -50.0f), glm::vec3(10.0f, 10.0f, -40.0f))));
+	buffer.Render(ViewProjection(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f)));
+
+	Check(buffer.GetPolygonCount() > 0, "the occluder is rasterised", iThreads);
+	Check(!buffer.IsVisible(glm::vec3(0.0f, 0.0f, -80.0f), glm::vec3(2.0f)), "a box behind the wall is hidden", iThreads);
+	Check(!buffer.IsVisible(glm::vec3(0.0f, 0.0f, -60.0f), glm::vec3(5.0f)), "a box just behind the wall is hidden", iThreads);
+	Check(buffer.IsVisible(glm::vec3(0.0f, 0.0f, -20.0f), glm::vec3(2.0f)), "a box in front of the wall is visible", iThreads);
+	Check(buffer.IsVisible(glm::vec3(0.0f, 0.0f, -40.0f), glm::vec3(2.0f)), "a box through the front of the wall is visible", iThreads);
+	Check(buffer.IsVisible(glm::vec3(40.0f, 0.0f, -80.0f), glm::vec3(2.0f)), "a box beside the wall is visible", iThreads);
+	Check(buffer.IsVisible(glm::vec3(15.0f, 0.0f, -80.0f), glm::vec3(8.0f)), "a box partly behind the wall is visible", iThreads);
+	Check(buffer.IsVisible(glm::vec3(0.0f, 0.0f, 20.0f), glm::vec3(2.0f)), "a box behind the camera is visible", iThreads);
+}
+
+// Every thread count must write the same depth as one thread
+static void TestBandsMatch(int iThreads, const vector<OccluderBox> &occluders, const glm::mat4 &viewProjection)
+{
+	COcclusionBuffer single, banded;
+	single.Create(BUFFER_WIDTH, BUFFER_HEIGHT, 1);
+	banded.Create(BUFFER_WIDTH, BUFFER_HEIGHT, iThreads);
+	single.SetOccluders(occluders);
+	banded.SetOccluders(occluders);
+	single.Render(viewProjection);
+	banded.Render(viewProjection);
+
+	bool bSame = equal(single.GetDepth(), single.GetDepth() + BUFFER_WIDTH * BUFFER_HEIGHT, banded.GetDepth());
+	Check(bSame, "the bands write the same depth as one thread", iThreads);
+}
+
+// A closed 20 unit cube standing on the ground, which should give occluders that stay inside it
+static void TestGenerateOccluders()
+{
+	glm::vec3 corners[8];
+	for (int c = 0; c < 8; c++)
+		corners[c] = glm::vec3((c & 1) ? 10.0f : -10.0f, (c & 2) ? 20.0f : 0.0f, (c & 4) ? 10.0f : -10.0f);
+	static const int faces[6][4] = { { 0, 1, 3, 2 }, { 4, 5, 7, 6 }, { 0, 2, 6, 4 }, { 1, 3, 7, 5 }, { 0, 1, 5, 4 }, { 2, 3, 7, 6 } };
+
+	vector<glm::vec3> triangles;
+	for (int f = 0; f < 6; f++) {
+		int triangleCorners[6] = { 0, 1, 2, 0, 2, 3 };
+		for (int i = 0; i < 6; i++)
+			triangles.push_back(corners[faces[f][triangleCorners[i]]]);
+	}
+
+	vector<OccluderBox> occluders;
+	int iAdded = GenerateOccluders(triangles, glm::mat4(1.0f), 1.0f, occluders);
+	Check(iAdded > 0 && iAdded == (int)occluders.size(), "a closed cube gives occluders", 1);
+
+	bool bInside = true;
+	for (size_t i = 0; i < occluders.size(); i++) {
+		for (int c = 0; c < 8; c++) {
+			glm::vec3 p = occluders[i].corners[c];
+			bInside = bInside && p.x >= -10.0f && p.x <= 10.0f && p.y >= 0.0f && p.y <= 20.0f && p.z >= -10.0f && p.z <= 10.0f;
+		}
+	}
+	Check(bInside, "the cube's occluders lie inside it", 1);
+}
+
+// A grid of buildings of varying height round the camera, like the city's blocks
+static vector<OccluderBox> MakeCity()
+{
+	vector<OccluderBox> occluders;
+	srand(1);
+	for (int x = 0; x < CITY_BLOCKS; x++) {
+		for (int z = 0; z < CITY_BLOCKS; z++) {
+			glm::vec3 centre((x - CITY_BLOCKS / 2 + 0.5f) * BLOCK_SPACING, 0.0f, (z - CITY_BLOCKS / 2 + 0.5f) * BLOCK_SPACING);
+			float fHeight = 20.0f + (float)(rand() % 100);
+			occluders.push_back(MakeBox(centre - glm::vec3(12.0f, 0.0f, 12.0f), centre + glm::vec3(12.0f, fHeight, 12.0f)));
+		}
+	}
+	return occluders;
+}
+
+// Times Render and IsVisible at one thread count, looking down a street
+static void BenchmarkCity(int iThreads, const vector<OccluderBox> &occluders, const glm::mat4 &viewProjection,
+	const vector<glm::vec3> &testCentres)
+{
+	COcclusionBuffer buffer;
+	buffer.Create(BUFFER_WIDTH, BUFFER_HEIGHT, iThreads);
+	buffer.SetOccluders(occluders);
+
+	double dBestRender = 1e30, dBestTest = 1e30;
+	int iHidden = 0;
+	for (int r = 0; r < REPEATS; r++) {
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		buffer.Render(viewProjection);
+		dBestRender = min(dBestRender, ElapsedMilliseconds(start));
+
+		start = chrono::steady_clock::now();
+		iHidden = 0;
+		for (size_t i = 0; i < testCentres.size(); i++)
+			iHidden += buffer.IsVisible(testCentres[i], glm::vec3(4.0f)) ? 0 : 1;
+		dBestTest = min(dBestTest, ElapsedMilliseconds(start));
+	}
+
+	printf("  %d threads: Render %.3f ms (%d polygons), IsVisible %.1f ns per box (%d of %d hidden)\n", iThreads, dBestRender,
+		buffer.GetPolygonCount(), dBestTest * 1000000.0 / testCentres.size(), iHidden, (int)testCentres.size());
+}
+
+int main(int argc, char** argv)
+{
+	int iMaxThreads = argc > 1 ? atoi(argv[1]) : (int)thread::hardware_concurrency();
+	if (iMaxThreads < 1)
+		iMaxThreads = 1;
+
+	vector<OccluderBox> city = MakeCity();
+	glm::mat4 streetView = ViewProjection(glm::vec3(BLOCK_SPACING * 0.5f, 5.0f, 0.0f), glm::vec3(BLOCK_SPACING * 0.5f, 5.0f, -1.0f));
+
+	for (int iThreads = 1; iThreads <= iMaxThreads; iThreads++) {
+		TestBoxOccluder(iThreads);
+		TestBandsMatch(iThreads, city, streetView);
+	}
+	TestGenerateOccluders();
+	if (s_failures > 0) {
+		printf("%d checks failed\n", s_failures);
+		return 1;
+	}
+	printf("All checks passed\n\n");
+
+	vector<glm::vec3> testCentres;
+	srand(2);
+	float fCitySize = CITY_BLOCKS * BLOCK_SPACING;
+	for (int i = 0; i < TEST_BOXES; i++)
+		testCentres.push_back(glm::vec3((rand() / (float)RAND_MAX - 0.5f) * fCitySize, 10.0f, -(rand() / (float)RAND_MAX) * fCitySize * 0.5f));
+
+	printf("%d occluders at %dx%d, %d test boxes\n", (int)city.size(), BUFFER_WIDTH, BUFFER_HEIGHT, TEST_BOXES);
+	for (int iThreads = 1; iThreads <= iMaxThreads; iThreads++)
+		BenchmarkCity(iThreads, city, streetView, testCentres);
+	return 0;
+}